@@ -0,0 +1,54 @@
+/*
+ * Benchmark.hpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#ifndef Benchmark_hpp
+#define Benchmark_hpp
+
+/*
+ * Minimal benchmark support for the host build. Every benchmark executable
+ * links BenchmarkMain.cpp, which runs the benchmarks defined with BENCHMARK in
+ * registration order, or only those whose name contains the filter argument.
+ * The number of iterations is doubled until a run takes long enough to be
+ * measured, and the time per iteration is reported.
+ */
+#include <stddef.h>
+#include <stdint.h>
+
+struct BenchmarkState {
+    /* Number of operations the benchmark has to execute */
+    uint64_t iterations;
+    /*
+     * Optional quantity besides the host time, like the time on the simulated
+     * bus: the benchmark names it and sums it over all operations, and it is
+     * reported per operation
+     */
+    const char* metric;
+    double metric_total;
+};
+
+struct BenchmarkCase {
+    const char* name;
+    void (*function)(BenchmarkState* state);
+    BenchmarkCase* next;
+};
+
+struct BenchmarkRegistration {
+    BenchmarkRegistration(BenchmarkCase* benchmark);
+};
+
+#define BENCHMARK(name) \
+    static void benchmark_##name(BenchmarkState* state); \
+    static BenchmarkCase benchmark_case_##name = { #name, benchmark_##name, NULL }; \
+    static BenchmarkRegistration benchmark_registration_##name(&benchmark_case_##name); \
+    static void benchmark_##name(BenchmarkState* state)
+
+/* Keeps the compiler from optimizing away the computation of @value */
+template <typename T>
+static inline void benchmark_keep(const T& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+#endif /* Benchmark_hpp */
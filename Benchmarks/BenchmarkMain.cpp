@@ -0,0 +1,189 @@
+/*
+ * BenchmarkMain.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include <map>
+#include "Benchmark.hpp"
+
+/* Shortest run that is measured */
+#define BENCHMARK_MIN_TIME_NS   200000000ULL
+/* Slowdown against the baseline that counts as a regression, in percent */
+#define BENCHMARK_THRESHOLD     10.0
+
+static BenchmarkCase* first_benchmark = NULL;
+static BenchmarkCase** last_benchmark = &first_benchmark;
+
+BenchmarkRegistration::BenchmarkRegistration(BenchmarkCase* benchmark) {
+    *last_benchmark = benchmark;
+    last_benchmark = &benchmark->next;
+}
+
+enum format {
+    FORMAT_TEXT,
+    FORMAT_JSON,
+    FORMAT_CSV,
+};
+
+static uint64_t monotonic_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t run(BenchmarkCase* benchmark, BenchmarkState* state) {
+    uint64_t start = monotonic_ns();
+    state->metric = NULL;
+    state->metric_total = 0.0;
+    benchmark->function(state);
+    return monotonic_ns() - start;
+}
+
+/*
+ * Reads the ns/op of a previous run, in the JSON or CSV output of this program
+ * @return false if the file can't be read
+ */
+static bool read_baseline(const char* path, std::map<std::string, double>* baseline) {
+    FILE* file = fopen(path, "r");
+    char line[512], name[256];
+    unsigned long long iterations;
+    double per_op;
+    
+    if (!file)
+        return false;
+    while (fgets(line, sizeof(line), file)) {
+        if (sscanf(line, " { \"name\": \"%255[^\"]\", \"iterations\": %llu, \"ns_per_op\": %lf", name, &iterations, &per_op) == 3 ||
+            sscanf(line, "%255[^,],%llu,%lf", name, &iterations, &per_op) == 3)
+            (*baseline)[name] = per_op;
+    }
+    fclose(file);
+    return true;
+}
+
+static void usage(const char* program) {
+    fprintf(stderr, "usage: %s [--smoke] [--format text|json|csv] [--baseline FILE] [--threshold PERCENT] [FILTER]\n", program);
+}
+
+int main(int argc, char** argv) {
+    const char* filter = NULL;
+    const char* baseline_path = NULL;
+    std::map<std::string, double> baseline;
+    double threshold = BENCHMARK_THRESHOLD;
+    enum format format = FORMAT_TEXT;
+    bool smoke = false;
+    int regressions = 0;
+    bool first = true;
+    
+    for (int i = 1; i < argc; i++) {
+        // --smoke runs every benchmark once, so the tests can check that they still work
+        if (!strcmp(argv[i], "--smoke")) {
+            smoke = true;
+        } else if (!strcmp(argv[i], "--format") && i + 1 < argc) {
+            i++;
+            if (!strcmp(argv[i], "json"))
+                format = FORMAT_JSON;
+            else if (!strcmp(argv[i], "csv"))
+                format = FORMAT_CSV;
+            else if (strcmp(argv[i], "text")) {
+                usage(argv[0]);
+                return 2;
+            }
+        } else if (!strcmp(argv[i], "--baseline") && i + 1 < argc) {
+            baseline_path = argv[++i];
+        } else if (!strcmp(argv[i], "--threshold") && i + 1 < argc) {
+            threshold = strtod(argv[++i], NULL);
+        } else if (argv[i][0] == '-') {
+            usage(argv[0]);
+            return 2;
+        } else {
+            filter = argv[i];
+        }
+    }
+    
+    if (baseline_path && !read_baseline(baseline_path, &baseline)) {
+        fprintf(stderr, "can't read baseline %s\n", baseline_path);
+        return 2;
+    }
+    
+    if (format == FORMAT_JSON)
+        printf("[\n");
+    else if (format == FORMAT_CSV)
+        printf("name,iterations,ns_per_op,ops_per_s,baseline_ns_per_op,change_percent,metric,metric_per_op\n");
+    else if (baseline_path)
+        printf("%-40s %12s %12s %14s %10s\n", "benchmark", "iterations", "ns/op", "ops/s", "change");
+    else
+        printf("%-40s %12s %12s %14s\n", "benchmark", "iterations", "ns/op", "ops/s");
+    
+    for (BenchmarkCase* benchmark = first_benchmark; benchmark; benchmark = benchmark->next) {
+        if (filter && !strstr(benchmark->name, filter))
+            continue;
+        
+        BenchmarkState state = { 1 };
+        uint64_t elapsed = run(benchmark, &state);
+        while (!smoke && elapsed < BENCHMARK_MIN_TIME_NS) {
+            state.iterations *= 2;
+            elapsed = run(benchmark, &state);
+        }
+        
+        uint64_t iterations = state.iterations;
+        double per_op = (double) elapsed / iterations;
+        double ops = per_op > 0 ? 1e9 / per_op : 0.0;
+        double metric_per_op = state.metric_total / iterations;
+        
+        // benchmarks that are new since the baseline are reported without a change
+        std::map<std::string, double>::const_iterator reference = baseline.find(benchmark->name);
+        bool compared = reference != baseline.end() && reference->second > 0;
+        double change = compared ? (per_op / reference->second - 1.0) * 100.0 : 0.0;
+        bool regression = compared && change > threshold;
+        if (regression)
+            regressions++;
+        
+        switch (format) {
+            case FORMAT_JSON:
+                printf("%s  { \"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.3f, \"ops_per_s\": %.0f",
+                       first ? "" : ",\n", benchmark->name, (unsigned long long) iterations, per_op, ops);
+                if (compared)
+                    printf(", \"baseline_ns_per_op\": %.3f, \"change_percent\": %.1f, \"regression\": %s",
+                           reference->second, change, regression ? "true" : "false");
+                if (state.metric)
+                    printf(", \"%s_per_op\": %.3f", state.metric, metric_per_op);
+                printf(" }");
+                break;
+            case FORMAT_CSV:
+                printf("%s,%llu,%.3f,%.0f,", benchmark->name, (unsigned long long) iterations, per_op, ops);
+                if (compared)
+                    printf("%.3f,%.1f,", reference->second, change);
+                else
+                    printf(",,");
+                if (state.metric)
+                    printf("%s,%.3f\n", state.metric, metric_per_op);
+                else
+                    printf(",\n");
+                break;
+            case FORMAT_TEXT:
+                printf("%-40s %12llu %12.1f %14.0f", benchmark->name, (unsigned long long) iterations, per_op, ops);
+                if (compared)
+                    printf(" %+9.1f%%%s", change, regression ? " REGRESSION" : "");
+                if (state.metric)
+                    printf("  %.1f %s/op", metric_per_op, state.metric);
+                printf("\n");
+                break;
+        }
+        first = false;
+    }
+    
+    if (format == FORMAT_JSON)
+        printf("%s]\n", first ? "" : "\n");
+    
+    if (regressions) {
+        fprintf(stderr, "%d benchmarks are more than %.1f%% slower than %s\n", regressions, threshold, baseline_path);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,83 @@
+/*
+ * ConfigurationBenchmarks.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include <pthread.h>
+#include "Benchmark.hpp"
+#include "ELANContact.hpp"
+#include "SMBusCommandStream.hpp"
+
+/*
+ * The configuration snapshot of ELANTouchpadDriver, with a pthread mutex in
+ * place of the IOLock: every report takes a reference to the current snapshot
+ * and releases it when it is done
+ */
+struct configuration {
+    volatile int32_t references;
+    struct elan_palm_configuration palm;
+    uint64_t disable_while_typing_timeout;
+};
+
+static pthread_mutex_t configuration_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static const configuration* copy_configuration(configuration* const* current) {
+    pthread_mutex_lock(&configuration_lock);
+    configuration* config = *current;
+    __sync_fetch_and_add(&config->references, 1);
+    pthread_mutex_unlock(&configuration_lock);
+    return config;
+}
+
+static void release_configuration(const configuration* config) {
+    __sync_fetch_and_sub(&const_cast<configuration*>(config)->references, 1);
+}
+
+/* A snapshot per report, as the Host Notify threads take it */
+BENCHMARK(configuration_snapshot) {
+    configuration snapshot = {};
+    configuration* current = &snapshot;
+    uint64_t sum = 0;
+    
+    snapshot.references = 1;
+    elan_palm_defaults(&snapshot.palm);
+    for (uint64_t i = 0; i < state->iterations; i++) {
+        const configuration* config = copy_configuration(&current);
+        sum += config->palm.width + config->disable_while_typing_timeout;
+        release_configuration(config);
+    }
+    benchmark_keep(sum);
+}
+
+/* Reading the fields without a snapshot, the lower bound of a lookup */
+BENCHMARK(configuration_direct) {
+    configuration snapshot = {};
+    configuration* volatile current = &snapshot;
+    uint64_t sum = 0;
+    
+    elan_palm_defaults(&snapshot.palm);
+    for (uint64_t i = 0; i < state->iterations; i++) {
+        const configuration* config = current;
+        sum += config->palm.width + config->disable_while_typing_timeout;
+    }
+    benchmark_keep(sum);
+}
+
+/* The address check of every command of a user client command stream */
+BENCHMARK(configuration_allowlist_lookup) {
+    struct smbus_stream_allowlist allowlist = {};
+    struct smbus_stream_command command = {};
+    unsigned int allowed = 0;
+    
+    for (uint8_t address = 0x50; address <= 0x57; address++)
+        smbus_stream_allow(&allowlist, address, false);
+    smbus_stream_allow(&allowlist, 0x36, true);
+    smbus_stream_allow(&allowlist, 0x37, true);
+    for (uint64_t i = 0; i < state->iterations; i++) {
+        command.address = (uint8_t) (i & 0x7f);
+        command.read_write = i & 0x80 ? SMBUS_STREAM_WRITE : SMBUS_STREAM_READ;
+        allowed += smbus_stream_allowed(&allowlist, &command);
+    }
+    benchmark_keep(allowed);
+}
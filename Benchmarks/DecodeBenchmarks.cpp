@@ -0,0 +1,130 @@
+/*
+ * DecodeBenchmarks.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include <string.h>
+#include <vector>
+#include "Benchmark.hpp"
+#include "ELANContact.hpp"
+#include "ELANReport.hpp"
+
+#define MAX_X           3052
+#define MAX_Y           1888
+#define TRACE_REPORTS   1024
+
+struct report {
+    uint8_t data[ETP_MAX_REPORT_LEN];
+};
+
+static void add_finger(uint8_t *report, int slot, unsigned int x, unsigned int y) {
+    int record = __builtin_popcount(report[ETP_TOUCH_INFO_OFFSET] & ETP_TOUCH_INFO_FINGERS);
+    uint8_t *finger = &report[ETP_FINGER_DATA_OFFSET + record * ETP_FINGER_DATA_LEN];
+    
+    report[ETP_TOUCH_INFO_OFFSET] |= 1 << (3 + slot);
+    finger[0] = ((x >> 4) & 0xf0) | ((y >> 8) & 0x0f);
+    finger[1] = x & 0xff;
+    finger[2] = y & 0xff;
+    finger[3] = 0x33;
+    finger[4] = 60;
+}
+
+/* @fingers fingers moving to the right in small steps */
+static std::vector<report> touchpad_trace(int fingers) {
+    std::vector<report> trace(TRACE_REPORTS);
+    
+    for (int i = 0; i < TRACE_REPORTS; i++) {
+        uint8_t *data = trace[i].data;
+        memset(data, 0, ETP_MAX_REPORT_LEN);
+        data[ETP_REPORT_ID_OFFSET] = ETP_REPORT_ID;
+        for (int slot = 0; slot < fingers; slot++)
+            add_finger(data, slot, 200 + slot * 500 + i % 400, 400 + slot * 200);
+    }
+    return trace;
+}
+
+/*
+ * The part of ELANTouchpadDriver::reportAbsolute that runs for every report:
+ * validation, decoding and palm classification of every finger
+ */
+static void report_absolute(BenchmarkState* state, const std::vector<report>& trace) {
+    struct elan_contact_state contacts[ETP_MAX_FINGERS] = {};
+    struct elan_palm_configuration palm;
+    struct elan_finger finger;
+    unsigned int touching = 0;
+    
+    elan_palm_defaults(&palm);
+    for (uint64_t i = 0; i < state->iterations; i++) {
+        const uint8_t *data = trace[i % TRACE_REPORTS].data;
+        if (elan_validate_report(data, contacts, MAX_X, MAX_Y) != ETP_REPORT_OK)
+            continue;
+        
+        const uint8_t *finger_data = &data[ETP_FINGER_DATA_OFFSET];
+        for (int slot = 0; slot < ETP_MAX_FINGERS; slot++) {
+            struct elan_contact_state *contact = &contacts[slot];
+            if (!elan_finger_valid(data, slot)) {
+                if (contact->touching)
+                    elan_contact_lift(contact);
+                continue;
+            }
+            elan_decode_finger(finger_data, &finger);
+            finger_data += ETP_FINGER_DATA_LEN;
+            
+            unsigned int pressure = elan_adjust_pressure(finger.pressure, 0);
+            elan_contact_touch(contact, finger.pos_x, finger.pos_y, i * 8000000);
+            contact->palm = elan_is_palm(contact, &palm, MAX_X, finger.pos_x, finger.pos_y,
+                                         finger.mk_x > finger.mk_y ? finger.mk_x : finger.mk_y, pressure);
+            touching += !contact->palm;
+        }
+    }
+    benchmark_keep(touching);
+}
+
+BENCHMARK(elan_report_absolute_one_finger) {
+    std::vector<report> trace = touchpad_trace(1);
+    report_absolute(state, trace);
+}
+
+BENCHMARK(elan_report_absolute_five_fingers) {
+    std::vector<report> trace = touchpad_trace(5);
+    report_absolute(state, trace);
+}
+
+/* Only the decoding of the finger records */
+BENCHMARK(elan_decode_finger) {
+    std::vector<report> trace = touchpad_trace(5);
+    struct elan_finger finger;
+    unsigned int sum = 0;
+    
+    for (uint64_t i = 0; i < state->iterations; i++) {
+        const uint8_t *data = trace[i % TRACE_REPORTS].data;
+        elan_decode_finger(&data[ETP_FINGER_DATA_OFFSET + (i % ETP_MAX_FINGERS) * ETP_FINGER_DATA_LEN], &finger);
+        sum += finger.pos_x + finger.pos_y;
+    }
+    benchmark_keep(sum);
+}
+
+BENCHMARK(trackpoint_decode) {
+    std::vector<report> trace(TRACE_REPORTS);
+    struct elan_trackpoint trackpoint;
+    int sum = 0;
+    
+    for (int i = 0; i < TRACE_REPORTS; i++) {
+        uint8_t *packet = &trace[i].data[ETP_REPORT_ID_OFFSET + 1];
+        memset(trace[i].data, 0, ETP_MAX_REPORT_LEN);
+        trace[i].data[ETP_REPORT_ID_OFFSET] = ETP_TP_REPORT_ID;
+        packet[0] = i % 3 == 0 ? 0x01 : 0x00;
+        packet[1] = i % 2 ? 0x80 : 0x7f;
+        packet[2] = i % 5 ? 0x80 : 0x7f;
+        packet[3] = i % 7 ? 0x06 : 0x00;
+        packet[4] = (uint8_t) (i * 37);
+        packet[5] = (uint8_t) (i * 11);
+    }
+    
+    for (uint64_t i = 0; i < state->iterations; i++) {
+        elan_decode_trackpoint(trace[i % TRACE_REPORTS].data, &trackpoint);
+        sum += trackpoint.x - trackpoint.y + trackpoint.buttons;
+    }
+    benchmark_keep(sum);
+}
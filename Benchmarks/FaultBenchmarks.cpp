@@ -0,0 +1,136 @@
+/*
+ * FaultBenchmarks.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include <string.h>
+#include "Benchmark.hpp"
+#include "I801Simulator.hpp"
+
+#define DEVICE_ADDRESS      0x50
+/* Retries on arbitration loss, as VoodooSMBusControllerDriver configures the adapter */
+#define RETRIES             3
+/* Interval in which a caller retries a transfer on a busy host */
+#define BUSY_RETRY_NS       1000000ULL
+
+/*
+ * i801_access on a simulated bus with faults. Besides the host time of the
+ * transaction code, the benchmarks report the virtual time on the bus, which
+ * is where the faults cost: timeouts, retries and the kill of a transaction.
+ */
+struct FaultBenchmark {
+    I801Simulator simulator;
+    struct i801_adapter adapter;
+    SimulatedRegisterDevice device;
+    
+    FaultBenchmark(unsigned int features) {
+        simulator.setup(&adapter, features | FEATURE_IRQ);
+        simulator.attach(DEVICE_ADDRESS, &device);
+        device.registers[0] = I2C_SMBUS_BLOCK_MAX;
+    }
+    
+    /* The retry on arbitration loss of VoodooSMBusControllerDriver::transferGated */
+    s32 transfer(int protocol) {
+        union i2c_smbus_data data;
+        s32 result = 0;
+        
+        for (int attempt = 0; attempt <= RETRIES; attempt++) {
+            memset(&data, 0, sizeof(data));
+            result = i801_access(&adapter, DEVICE_ADDRESS, 0, I2C_SMBUS_READ, 0, protocol, &data);
+            if (result != -EAGAIN)
+                break;
+        }
+        return result;
+    }
+    
+    /* A transfer that is retried until it succeeds, @return its virtual time in ns */
+    uint64_t transferUntilSuccess(int protocol) {
+        uint64_t start = simulator.now();
+        s32 result;
+        
+        while ((result = transfer(protocol)) < 0) {
+            if (result == -EBUSY)
+                simulator.advance(BUSY_RETRY_NS);
+        }
+        return simulator.now() - start;
+    }
+};
+
+/* Word reads with every fault in 1% of the transactions, each retried until it succeeds */
+BENCHMARK(i801_throughput_under_faults) {
+    FaultBenchmark benchmark(FEATURE_BLOCK_BUFFER);
+    uint64_t start = benchmark.simulator.now();
+    s32 result = 0;
+    
+    for (int fault = 0; fault < SIM_FAULTS; fault++)
+        benchmark.simulator.setFault((enum SimulatedFault) fault, 10);
+    for (uint64_t i = 0; i < state->iterations; i++)
+        result |= benchmark.transferUntilSuccess(I2C_SMBUS_WORD_DATA) == 0;
+    state->metric = "bus_us";
+    state->metric_total = (benchmark.simulator.now() - start) / 1000.0;
+    benchmark_keep(result);
+}
+
+/* The same reads without faults, the reference for the throughput under faults */
+BENCHMARK(i801_throughput_without_faults) {
+    FaultBenchmark benchmark(FEATURE_BLOCK_BUFFER);
+    uint64_t start = benchmark.simulator.now();
+    s32 result = 0;
+    
+    for (uint64_t i = 0; i < state->iterations; i++)
+        result |= benchmark.transferUntilSuccess(I2C_SMBUS_WORD_DATA) == 0;
+    state->metric = "bus_us";
+    state->metric_total = (benchmark.simulator.now() - start) / 1000.0;
+    benchmark_keep(result);
+}
+
+/*
+ * A transaction whose interrupt is lost: the driver waits for the timeout,
+ * kills the transaction and the next transfer has to succeed. The metric is
+ * the time from the start of the lost transaction to the end of the next one.
+ */
+BENCHMARK(i801_recovery_dropped_interrupt) {
+    FaultBenchmark benchmark(FEATURE_BLOCK_BUFFER);
+    double recovery_us = 0.0;
+    s32 result = 0;
+    
+    for (uint64_t i = 0; i < state->iterations; i++) {
+        uint64_t start = benchmark.simulator.now();
+        benchmark.simulator.setFault(SIM_FAULT_DROPPED_INTERRUPT, 1000);
+        result |= benchmark.transfer(I2C_SMBUS_BYTE_DATA);
+        benchmark.simulator.setFault(SIM_FAULT_DROPPED_INTERRUPT, 0);
+        result |= benchmark.transfer(I2C_SMBUS_BYTE_DATA) < 0;
+        recovery_us += (benchmark.simulator.now() - start) / 1000.0;
+    }
+    state->metric = "recovery_us";
+    state->metric_total = recovery_us;
+    benchmark_keep(result);
+}
+
+/* A transfer that finds the bus held by another master and is retried until it is free */
+BENCHMARK(i801_recovery_host_busy) {
+    FaultBenchmark benchmark(FEATURE_BLOCK_BUFFER);
+    double recovery_us = 0.0;
+    
+    for (uint64_t i = 0; i < state->iterations; i++) {
+        benchmark.simulator.setFault(SIM_FAULT_HOST_BUSY, 1000);
+        benchmark.transfer(I2C_SMBUS_BYTE_DATA);
+        benchmark.simulator.setFault(SIM_FAULT_HOST_BUSY, 0);
+        recovery_us += benchmark.transferUntilSuccess(I2C_SMBUS_BYTE_DATA) / 1000.0;
+    }
+    state->metric = "recovery_us";
+    state->metric_total = recovery_us;
+}
+
+/* Arbitration loss in half of the transactions, absorbed by the retries */
+BENCHMARK(i801_recovery_arbitration_loss) {
+    FaultBenchmark benchmark(FEATURE_BLOCK_BUFFER);
+    double recovery_us = 0.0;
+    
+    benchmark.simulator.setFault(SIM_FAULT_ARBITRATION_LOSS, 500);
+    for (uint64_t i = 0; i < state->iterations; i++)
+        recovery_us += benchmark.transferUntilSuccess(I2C_SMBUS_BYTE_DATA) / 1000.0;
+    state->metric = "recovery_us";
+    state->metric_total = recovery_us;
+}
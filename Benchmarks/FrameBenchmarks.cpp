@@ -0,0 +1,120 @@
+/*
+ * FrameBenchmarks.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include <string.h>
+#include <vector>
+#include "Benchmark.hpp"
+#include "ELANReport.hpp"
+
+/* Frames every 8 ms, a cycle of resting, swiping and lifting takes about 3 s */
+#define FRAME_INTERVAL      8000000ULL
+#define KEEP_ALIVE          100000000ULL
+#define RESTING_FRAMES      250
+#define SWIPE_FRAMES        60
+#define LIFTED_FRAMES       40
+#define CYCLE_FRAMES        (RESTING_FRAMES + SWIPE_FRAMES + LIFTED_FRAMES)
+
+struct frame {
+    uint8_t report[ETP_MAX_REPORT_LEN];
+};
+
+static void set_finger(uint8_t *report, int slot, unsigned int x, unsigned int y) {
+    uint8_t *finger = &report[ETP_FINGER_DATA_OFFSET + slot * ETP_FINGER_DATA_LEN];
+    
+    report[ETP_TOUCH_INFO_OFFSET] |= 1 << (3 + slot);
+    finger[0] = ((x >> 4) & 0xf0) | ((y >> 8) & 0x0f);
+    finger[1] = x & 0xff;
+    finger[2] = y & 0xff;
+    finger[3] = 0x33;
+    finger[4] = 60;
+}
+
+/*
+ * A finger resting on the touchpad, which moves by a count now and then, a
+ * two finger swipe and no contact
+ */
+static std::vector<frame> resting_trace() {
+    std::vector<frame> trace(CYCLE_FRAMES);
+    
+    for (int i = 0; i < CYCLE_FRAMES; i++) {
+        uint8_t *report = trace[i].report;
+        memset(report, 0, ETP_MAX_REPORT_LEN);
+        report[ETP_REPORT_ID_OFFSET] = ETP_REPORT_ID;
+        
+        if (i < RESTING_FRAMES) {
+            set_finger(report, 0, 1500 + (i / 40) % 2, 900);
+        } else if (i < RESTING_FRAMES + SWIPE_FRAMES) {
+            int step = i - RESTING_FRAMES;
+            set_finger(report, 0, 800 + step * 20, 900);
+            set_finger(report, 1, 800 + step * 20, 1300);
+        }
+    }
+    return trace;
+}
+
+/*
+ * Stand-in for the multitouch interface: the transducers of a frame are
+ * decoded and their movement since the last dispatched frame is accumulated,
+ * which is the least work the gesture engine does for every frame it gets
+ */
+struct multitouch_sink {
+    struct elan_finger last[ETP_MAX_FINGERS];
+    int64_t movement;
+    uint64_t frames;
+};
+
+static void deliver(struct multitouch_sink *sink, const uint8_t *report) {
+    const uint8_t *finger_data = &report[ETP_FINGER_DATA_OFFSET];
+    
+    for (int i = 0; i < ETP_MAX_FINGERS; i++) {
+        if (!elan_finger_valid(report, i))
+            continue;
+        struct elan_finger finger;
+        elan_decode_finger(finger_data, &finger);
+        finger_data += ETP_FINGER_DATA_LEN;
+        sink->movement += (int64_t) finger.pos_x - sink->last[i].pos_x + (int64_t) finger.pos_y - sink->last[i].pos_y;
+        sink->last[i] = finger;
+    }
+    sink->frames++;
+    benchmark_keep(*sink);
+}
+
+static void replay(BenchmarkState* state, uint64_t keep_alive) {
+    static const std::vector<frame> trace = resting_trace();
+    struct elan_frame_filter filter = {};
+    struct multitouch_sink sink = {};
+    
+    for (uint64_t i = 0; i < state->iterations; i++) {
+        const uint8_t *report = trace[i % CYCLE_FRAMES].report;
+        unsigned int contacts = 0;
+        for (int finger = 0; finger < ETP_MAX_FINGERS; finger++)
+            contacts += elan_finger_valid(report, finger);
+        
+        if (elan_frame_dispatch(&filter, report, contacts, i * FRAME_INTERVAL, keep_alive))
+            deliver(&sink, report);
+    }
+    benchmark_keep(sink);
+}
+
+/* Every frame is dispatched, like before the filter */
+BENCHMARK(frame_replay_every_frame) {
+    replay(state, 0);
+}
+
+/* Unchanged frames are dispatched every 100 ms, the default */
+BENCHMARK(frame_replay_keep_alive) {
+    replay(state, KEEP_ALIVE);
+}
+
+/* Cost of the filter alone for a resting finger */
+BENCHMARK(frame_filter_resting) {
+    static const std::vector<frame> trace = resting_trace();
+    struct elan_frame_filter filter = {};
+    
+    for (uint64_t i = 0; i < state->iterations; i++)
+        elan_frame_dispatch(&filter, trace[0].report, 1, i * FRAME_INTERVAL, KEEP_ALIVE);
+    benchmark_keep(filter);
+}
@@ -0,0 +1,115 @@
+/*
+ * I801Benchmarks.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include <string.h>
+#include "Benchmark.hpp"
+#include "I801Simulator.hpp"
+
+#define DEVICE_ADDRESS      0x50
+
+/*
+ * i801_access per protocol on the simulated controller. The bus takes no host
+ * time, so this is the cost of the transaction code itself: register accesses,
+ * status checks and the interrupt handling of the driver.
+ */
+struct AccessBenchmark {
+    I801Simulator simulator;
+    struct i801_adapter adapter;
+    SimulatedRegisterDevice device;
+    
+    AccessBenchmark(unsigned int features) {
+        simulator.setup(&adapter, features | FEATURE_IRQ);
+        simulator.attach(DEVICE_ADDRESS, &device);
+        device.registers[0] = I2C_SMBUS_BLOCK_MAX;
+        for (int i = 1; i < 256; i++)
+            device.registers[i] = (u8) i;
+    }
+    
+    void run(BenchmarkState* state, char read_write, int protocol, int length) {
+        union i2c_smbus_data data;
+        s32 result = 0;
+        
+        for (uint64_t i = 0; i < state->iterations; i++) {
+            memset(&data, 0, sizeof(data));
+            data.block[0] = (u8) length;
+            result |= i801_access(&adapter, DEVICE_ADDRESS, 0, read_write, 0, protocol, &data);
+        }
+        benchmark_keep(result);
+    }
+};
+
+BENCHMARK(i801_access_quick) {
+    AccessBenchmark benchmark(0);
+    benchmark.run(state, I2C_SMBUS_WRITE, I2C_SMBUS_QUICK, 0);
+}
+
+BENCHMARK(i801_access_byte) {
+    AccessBenchmark benchmark(0);
+    benchmark.run(state, I2C_SMBUS_READ, I2C_SMBUS_BYTE, 0);
+}
+
+BENCHMARK(i801_access_byte_data) {
+    AccessBenchmark benchmark(0);
+    benchmark.run(state, I2C_SMBUS_READ, I2C_SMBUS_BYTE_DATA, 0);
+}
+
+BENCHMARK(i801_access_word_data) {
+    AccessBenchmark benchmark(0);
+    benchmark.run(state, I2C_SMBUS_READ, I2C_SMBUS_WORD_DATA, 0);
+}
+
+BENCHMARK(i801_access_block_data_buffer) {
+    AccessBenchmark benchmark(FEATURE_BLOCK_BUFFER);
+    benchmark.run(state, I2C_SMBUS_READ, I2C_SMBUS_BLOCK_DATA, 0);
+}
+
+BENCHMARK(i801_access_block_data_byte_by_byte) {
+    AccessBenchmark benchmark(0);
+    benchmark.run(state, I2C_SMBUS_READ, I2C_SMBUS_BLOCK_DATA, 0);
+}
+
+BENCHMARK(i801_access_i2c_block_read) {
+    AccessBenchmark benchmark(FEATURE_I2C_BLOCK_READ);
+    benchmark.run(state, I2C_SMBUS_READ, I2C_SMBUS_I2C_BLOCK_DATA, I2C_SMBUS_BLOCK_MAX);
+}
+
+/*
+ * Registers of a controller that always has the next byte of a block read
+ * ready, so the interrupt handler runs without a simulated bus behind it
+ */
+static u8 null_inb(void *context, u16 port) {
+    if (port == SMBHSTSTS(static_cast<struct i801_adapter*>(context)))
+        return SMBHSTSTS_BYTE_DONE;
+    if (port == SMBHSTDAT0(static_cast<struct i801_adapter*>(context)))
+        return I2C_SMBUS_BLOCK_MAX;
+    return 0x5a;
+}
+
+static void null_outb(void *context, u8 value, u16 port) {
+}
+
+/* The BYTE_DONE interrupts of one 32 byte block read, as the filter interrupt handles them */
+BENCHMARK(block_read_completion) {
+    static const struct i801_ops null_ops = { null_outb, null_inb, NULL, NULL, NULL, NULL };
+    struct i801_adapter adapter;
+    u8 block[I2C_SMBUS_BLOCK_MAX + 1];
+    u8 handled = 0;
+    
+    memset(&adapter, 0, sizeof(adapter));
+    adapter.ops = &null_ops;
+    adapter.context = &adapter;
+    adapter.is_read = true;
+    adapter.cmd = I801_BLOCK_DATA | SMBHSTCNT_INTREN;
+    for (uint64_t i = 0; i < state->iterations; i++) {
+        adapter.count = 0;
+        adapter.len = 0;
+        adapter.data = &block[1];
+        for (int byte = 0; byte < I2C_SMBUS_BLOCK_MAX; byte++)
+            handled |= i801_isr(&adapter);
+    }
+    benchmark_keep(handled);
+    benchmark_keep(block);
+}
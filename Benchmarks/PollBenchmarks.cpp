@@ -0,0 +1,170 @@
+/*
+ * PollBenchmarks.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include <string.h>
+#include <deque>
+#include "Benchmark.hpp"
+#include "ELANSimulator.hpp"
+#include "JC42Simulator.hpp"
+#include "SMBusPoll.hpp"
+
+/* Frames come every 7 to 9 ms, the touchpad doesn't run in step with the poll timer */
+#define FRAME_INTERVAL      7000000ULL
+#define FRAME_JITTER        2000000ULL
+/* The touchpad reports for about a second, then pauses for one */
+#define SWIPE_FRAMES        120
+#define SWIPE_PAUSE         1000000000ULL
+#define SENSORS             4
+/* Much shorter than the default interval, so windows meet the touchpad often */
+#define POLL_INTERVAL       100000000ULL
+#define POLL_BUDGET         2000000ULL
+
+/*
+ * The impact of the sensor poll windows on touchpad reports, on the simulated
+ * bus. The touchpad announces its frames with Host Notify while four JC-42.4
+ * sensors are polled with the schedule of VoodooSMBusControllerDriver. A
+ * report whose notify arrives during a window is read after it. The metric is
+ * the time from the notify until the report was read, the host time is that
+ * of the driver code.
+ */
+struct PollImpact {
+    I801Simulator simulator;
+    struct i801_adapter adapter;
+    SimulatedELANTouchpad touchpad;
+    SimulatedJC42Sensor sensors[SENSORS];
+    struct i2c_smbus_client touchpad_client;
+    struct i2c_smbus_client sensor_clients[SENSORS];
+    struct smbus_poll_schedule schedule = {};
+    bool polling;
+    uint64_t poll_timer = 0;
+    
+    uint64_t last_notify = 0;
+    std::deque<uint64_t> notifies;
+    std::deque<uint64_t> frames;
+    uint64_t frames_queued = 0;
+    uint64_t last_frame = 0;
+    uint32_t jitter_seed = 1;
+    uint64_t reports = 0;
+    double latency_us = 0.0;
+    
+    PollImpact(bool polling, uint64_t backoff) : touchpad(&simulator), polling(polling) {
+        simulator.setup(&adapter, FEATURE_IRQ | FEATURE_BLOCK_BUFFER | FEATURE_I2C_BLOCK_READ | FEATURE_HOST_NOTIFY);
+        simulator.setInterruptHandler(&PollImpact::filterInterrupt, this);
+        simulator.outb(SMBSLVCMD_HST_NTFY_INTREN, SMBSLVCMD(&adapter));
+        simulator.attach(SIM_ELAN_ADDRESS, &touchpad);
+        touchpad_client = simulator.client(SIM_ELAN_ADDRESS);
+        for (int i = 0; i < SENSORS; i++) {
+            simulator.attach(SIM_JC42_ADDRESS + i, &sensors[i]);
+            sensor_clients[i] = simulator.client(SIM_JC42_ADDRESS + i);
+        }
+        
+        // like after boot, the touchpad didn't report for a while
+        simulator.advance(SWIPE_PAUSE);
+        schedule.interval = POLL_INTERVAL;
+        schedule.backoff = backoff;
+        schedule.budget = POLL_BUDGET;
+        smbus_poll_start(&schedule, simulator.now());
+        poll_timer = simulator.now();
+        last_frame = simulator.now();
+    }
+    
+    static void filterInterrupt(void *context) {
+        PollImpact *impact = static_cast<PollImpact*>(context);
+        struct i801_adapter *adapter = &impact->adapter;
+        
+        if (adapter->inb_p(SMBSLVSTS(adapter)) & SMBSLVSTS_HST_NTFY_STS) {
+            impact->last_notify = impact->simulator.now();
+            impact->notifies.push_back(impact->simulator.now());
+            adapter->outb_p(SMBSLVSTS_HST_NTFY_STS, SMBSLVSTS(adapter));
+        }
+        i801_isr(adapter);
+    }
+    
+    /* Queues the next swipe after a pause, at most @limit frames */
+    void queueSwipe(uint64_t limit) {
+        uint64_t count = limit < SWIPE_FRAMES ? limit : SWIPE_FRAMES;
+        uint64_t time = last_frame + SWIPE_PAUSE;
+        u8 report[ETP_MAX_REPORT_LEN];
+        
+        for (uint64_t i = 0; i < count; i++) {
+            memset(report, 0, sizeof(report));
+            report[ETP_REPORT_ID_OFFSET] = ETP_REPORT_ID;
+            SimulatedELANTouchpad::addFinger(report, 0, 100 + (unsigned int) i * 20, SIM_ELAN_MAX_Y / 2, 60);
+            touchpad.queueReport(report, time);
+            frames.push_back(time);
+            
+            jitter_seed ^= jitter_seed << 13;
+            jitter_seed ^= jitter_seed >> 17;
+            jitter_seed ^= jitter_seed << 5;
+            time += FRAME_INTERVAL + jitter_seed % FRAME_JITTER;
+        }
+        last_frame = frames.back();
+        frames_queued += count;
+    }
+    
+    /* The poll timer of the controller */
+    void pollDevices() {
+        uint64_t window_start = simulator.now();
+        uint32_t polled;
+        
+        if (smbus_poll_defer(&schedule, simulator.now(), last_notify)) {
+            poll_timer = simulator.now() + schedule.backoff;
+            return;
+        }
+        for (polled = 0; polled < SENSORS && smbus_poll_continue(&schedule, polled, window_start, simulator.now()); polled++)
+            jc42_read_register(&sensor_clients[(schedule.next + polled) % SENSORS], JC42_REG_TEMP);
+        smbus_poll_finish(&schedule, polled, SENSORS, simulator.now());
+        poll_timer = simulator.now() + schedule.interval;
+    }
+    
+    void readReports() {
+        u8 report[ETP_MAX_REPORT_LEN];
+        
+        while (!notifies.empty()) {
+            i2c_smbus_read_block_data(&touchpad_client, SIM_ELAN_PACKET_QUERY, &report[2]);
+            latency_us += (simulator.now() - notifies.front()) / 1000.0;
+            notifies.pop_front();
+            reports++;
+        }
+    }
+    
+    void run(BenchmarkState* state) {
+        while (reports < state->iterations) {
+            if (frames.empty() && frames_queued < state->iterations)
+                queueSwipe(state->iterations - frames_queued);
+            
+            uint64_t next = frames.empty() ? simulator.now() : frames.front();
+            if (polling && poll_timer < next)
+                next = poll_timer;
+            if (next > simulator.now())
+                simulator.advance(next - simulator.now());
+            while (!frames.empty() && frames.front() <= simulator.now())
+                frames.pop_front();
+            
+            if (polling && poll_timer <= simulator.now())
+                pollDevices();
+            readReports();
+        }
+        state->metric = "report_latency_us";
+        state->metric_total = latency_us;
+    }
+};
+
+BENCHMARK(poll_impact_without_polling) {
+    PollImpact impact(false, 0);
+    impact.run(state);
+}
+
+/* Windows run whenever they are due, also in the middle of a swipe */
+BENCHMARK(poll_impact_without_backoff) {
+    PollImpact impact(true, 0);
+    impact.run(state);
+}
+
+BENCHMARK(poll_impact_with_backoff) {
+    PollImpact impact(true, 50000000ULL);
+    impact.run(state);
+}
@@ -0,0 +1,47 @@
+/*
+ * SPDBenchmarks.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include "Benchmark.hpp"
+#include "SPDSimulator.hpp"
+
+#define FEATURES_KEXT   (FEATURE_IRQ | FEATURE_BLOCK_BUFFER | FEATURE_I2C_BLOCK_READ | FEATURE_SMBUS_PEC)
+
+/*
+ * Reading the SPD contents of a module as SPDEEPROMDriver does it at start.
+ * The metric is the time of a read on the simulated bus at 100 kHz, which is
+ * what the first copySPDData of a module takes.
+ */
+static void read_contents(BenchmarkState* state, enum spd_device_type device_type, u8 memory_type) {
+    I801Simulator simulator;
+    struct i801_adapter adapter;
+    SimulatedEE1004PageSelect page_select;
+    SimulatedSPDDevice module(device_type, &page_select);
+    struct i2c_smbus_client client;
+    u8 buffer[SPD_MAX_SIZE];
+    int length = 0;
+    
+    simulator.setup(&adapter, FEATURES_KEXT);
+    page_select.attach(&simulator);
+    simulator.attach(SIM_SPD_ADDRESS, &module);
+    client = simulator.client(SIM_SPD_ADDRESS);
+    module.fill(memory_type, "BENCHMARK");
+    
+    uint64_t start = simulator.now();
+    for (uint64_t i = 0; i < state->iterations; i++)
+        length |= spd_read_contents(&client, spd_detect_device(&client), buffer);
+    state->metric = "bus_us";
+    state->metric_total = (simulator.now() - start) / 1000.0;
+    benchmark_keep(length);
+    benchmark_keep(buffer);
+}
+
+BENCHMARK(spd_read_ddr4_ee1004) {
+    read_contents(state, SPD_DEVICE_EE1004, SPD_MEMORY_TYPE_DDR4);
+}
+
+BENCHMARK(spd_read_ddr5_hub) {
+    read_contents(state, SPD_DEVICE_SPD5_HUB, SPD_MEMORY_TYPE_DDR5);
+}
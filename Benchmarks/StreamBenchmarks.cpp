@@ -0,0 +1,105 @@
+/*
+ * StreamBenchmarks.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include <string.h>
+#include "Benchmark.hpp"
+#include "I801Simulator.hpp"
+#include "SMBusCommandStream.hpp"
+
+#define DEVICE_ADDRESS      0x50
+/* A dump of a 512 byte SPD EEPROM, the typical stream of a tool */
+#define DUMP_COMMANDS       16
+#define DUMP_BLOCK          32
+
+/* The stream a tool builds for the dump */
+static size_t encode_dump(uint8_t *stream, size_t capacity) {
+    size_t length = smbus_stream_begin(stream, capacity);
+    struct smbus_stream_command command = { DEVICE_ADDRESS, SMBUS_STREAM_I2C_BLOCK_DATA, SMBUS_STREAM_READ, 0, 0, DUMP_BLOCK, NULL };
+    
+    for (int i = 0; i < DUMP_COMMANDS; i++) {
+        command.command = (uint8_t) (i * DUMP_BLOCK);
+        smbus_stream_add(stream, capacity, &length, &command);
+    }
+    return length;
+}
+
+/* Answers every command without a bus, so only the stream handling is measured */
+static int null_transfer(void *context, const struct smbus_stream_command *command, uint8_t *data) {
+    if (command->read_write == SMBUS_STREAM_READ)
+        data[0] = DUMP_BLOCK;
+    return 0;
+}
+
+static int simulator_transfer(void *context, const struct smbus_stream_command *command, uint8_t *data) {
+    return i801_access(static_cast<struct i801_adapter*>(context), command->address, 0, command->read_write,
+                       command->command, command->protocol, reinterpret_cast<union i2c_smbus_data*>(data));
+}
+
+BENCHMARK(stream_encode_dump) {
+    uint8_t stream[SMBUS_STREAM_BUFFER_SIZE];
+    size_t length = 0;
+    
+    for (uint64_t i = 0; i < state->iterations; i++)
+        length += encode_dump(stream, sizeof(stream));
+    benchmark_keep(length);
+}
+
+/* Decoding of the results by the tool */
+BENCHMARK(stream_decode_dump_results) {
+    uint8_t stream[SMBUS_STREAM_BUFFER_SIZE], results[SMBUS_STREAM_BUFFER_SIZE];
+    struct smbus_stream_allowlist allowlist = {};
+    struct smbus_stream_result result;
+    size_t length = encode_dump(stream, sizeof(stream));
+    size_t results_length;
+    unsigned int sum = 0;
+    
+    smbus_stream_allow(&allowlist, DEVICE_ADDRESS, false);
+    smbus_stream_execute(stream, length, results, sizeof(results), &results_length, &allowlist, null_transfer, NULL);
+    for (uint64_t i = 0; i < state->iterations; i++) {
+        size_t offset = SMBUS_STREAM_HEADER_SIZE;
+        int count = smbus_stream_decode_header(results, results_length, SMBUS_STREAM_RESULT_MAGIC);
+        for (int j = 0; j < count && !smbus_stream_decode_result(results, results_length, &offset, &result); j++)
+            sum += result.length + result.data[0];
+    }
+    benchmark_keep(sum);
+}
+
+/* Validation, allowlist checks and result encoding of the kext, per stream */
+BENCHMARK(stream_execute_overhead) {
+    uint8_t stream[SMBUS_STREAM_BUFFER_SIZE], results[SMBUS_STREAM_BUFFER_SIZE];
+    struct smbus_stream_allowlist allowlist = {};
+    size_t length = encode_dump(stream, sizeof(stream));
+    size_t results_length;
+    int executed = 0;
+    
+    smbus_stream_allow(&allowlist, DEVICE_ADDRESS, false);
+    for (uint64_t i = 0; i < state->iterations; i++)
+        executed += smbus_stream_execute(stream, length, results, sizeof(results), &results_length, &allowlist, null_transfer, NULL);
+    benchmark_keep(executed);
+}
+
+/* The whole dump on the simulated bus, where the stream overhead meets the transfers */
+BENCHMARK(stream_execute_dump_on_bus) {
+    I801Simulator simulator;
+    struct i801_adapter adapter;
+    SimulatedRegisterDevice device;
+    uint8_t stream[SMBUS_STREAM_BUFFER_SIZE], results[SMBUS_STREAM_BUFFER_SIZE];
+    struct smbus_stream_allowlist allowlist = {};
+    size_t length = encode_dump(stream, sizeof(stream));
+    size_t results_length;
+    uint64_t start;
+    int executed = 0;
+    
+    simulator.setup(&adapter, FEATURE_IRQ | FEATURE_BLOCK_BUFFER | FEATURE_I2C_BLOCK_READ);
+    simulator.attach(DEVICE_ADDRESS, &device);
+    smbus_stream_allow(&allowlist, DEVICE_ADDRESS, false);
+    start = simulator.now();
+    for (uint64_t i = 0; i < state->iterations; i++)
+        executed += smbus_stream_execute(stream, length, results, sizeof(results), &results_length, &allowlist, simulator_transfer, &adapter);
+    state->metric = "bus_us";
+    state->metric_total = (simulator.now() - start) / 1000.0;
+    benchmark_keep(executed);
+}
@@ -0,0 +1,79 @@
+/*
+ * SuppressionBenchmarks.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include "Benchmark.hpp"
+#include "ELANSuppression.hpp"
+
+/* Reports every 8 ms, the timeout of the default configuration */
+#define REPORT_INTERVAL     8000000ULL
+#define TYPING_TIMEOUT      500000000ULL
+/* A key press every 150 ms while typing */
+#define KEY_INTERVAL        150000000ULL
+
+/*
+ * Timebase of Apple silicon, where absolute time units are not nanoseconds.
+ * Volatile, so the conversion is not folded like the kernel can't fold it.
+ */
+static volatile uint32_t timebase_numer = 125;
+static volatile uint32_t timebase_denom = 3;
+
+static uint64_t absolutetime_to_nanoseconds(uint64_t absolutetime) {
+    return absolutetime * timebase_numer / timebase_denom;
+}
+
+/* The check of every report while nobody types */
+BENCHMARK(suppression_check_idle) {
+    struct elan_suppression suppression = {};
+    uint64_t dropped = 0;
+    
+    for (uint64_t i = 0; i < state->iterations; i++)
+        dropped += elan_suppressed(&suppression.touchpad_until, i * REPORT_INTERVAL);
+    benchmark_keep(dropped);
+}
+
+/* Reports interleaved with key presses, which move the deadlines */
+BENCHMARK(suppression_check_typing) {
+    struct elan_suppression suppression = {};
+    uint64_t dropped = 0;
+    uint64_t next_key = 0;
+    
+    for (uint64_t i = 0; i < state->iterations; i++) {
+        uint64_t now = i * REPORT_INTERVAL;
+        if (now >= next_key) {
+            elan_suppression_extend(&suppression.touchpad_until, now + TYPING_TIMEOUT);
+            elan_suppression_extend(&suppression.trackpoint_until, now + TYPING_TIMEOUT);
+            next_key = now + KEY_INTERVAL;
+        }
+        dropped += elan_suppressed(&suppression.touchpad_until, now);
+    }
+    benchmark_keep(dropped);
+}
+
+/* Cost of a key press or trackpoint movement */
+BENCHMARK(suppression_extend) {
+    struct elan_suppression suppression = {};
+    
+    for (uint64_t i = 0; i < state->iterations; i++)
+        elan_suppression_extend(&suppression.touchpad_until, i * KEY_INTERVAL + TYPING_TIMEOUT);
+    benchmark_keep(suppression);
+}
+
+/*
+ * The check before the deadlines: every report converted the clock and the
+ * time of the last key press to nanoseconds, as a baseline for the above
+ */
+BENCHMARK(suppression_check_nanoseconds) {
+    uint64_t last_keyboard = 0;
+    uint64_t dropped = 0;
+    
+    for (uint64_t i = 0; i < state->iterations; i++) {
+        uint64_t now = i * REPORT_INTERVAL;
+        if (i % (KEY_INTERVAL / REPORT_INTERVAL) == 0)
+            last_keyboard = now;
+        dropped += absolutetime_to_nanoseconds(now) - absolutetime_to_nanoseconds(last_keyboard) < TYPING_TIMEOUT / 1000000 * 1000000;
+    }
+    benchmark_keep(dropped);
+}
@@ -0,0 +1,109 @@
+/*
+ * TouchpadBenchmarks.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include <string.h>
+#include "Benchmark.hpp"
+#include "ELANContact.hpp"
+#include "ELANSimulator.hpp"
+
+#define FRAME_INTERVAL      8000000ULL
+#define KEEP_ALIVE          100000000ULL
+#define SWIPE_FRAMES        120
+
+/*
+ * The path of a touchpad frame through the driver, on the simulated bus: the
+ * filter interrupt takes the Host Notify, the report is read with a block read
+ * and validated, decoded and filtered like in ELANTouchpadDriver. The time is
+ * the host CPU time of the driver code, the bus itself takes no time.
+ */
+struct TouchpadPipeline {
+    I801Simulator simulator;
+    struct i801_adapter adapter;
+    SimulatedELANTouchpad touchpad;
+    struct i2c_smbus_client client;
+    struct elan_contact_state contacts[ETP_MAX_FINGERS] = {};
+    struct elan_frame_filter filter = {};
+    struct elan_palm_configuration palm;
+    unsigned int notifies = 0;
+
+    TouchpadPipeline(unsigned int features) : touchpad(&simulator) {
+        simulator.setup(&adapter, features | FEATURE_IRQ | FEATURE_HOST_NOTIFY);
+        simulator.setInterruptHandler(&TouchpadPipeline::filterInterrupt, this);
+        simulator.outb(SMBSLVCMD_HST_NTFY_INTREN, SMBSLVCMD(&adapter));
+        simulator.attach(SIM_ELAN_ADDRESS, &touchpad);
+        client = simulator.client(SIM_ELAN_ADDRESS);
+        elan_palm_defaults(&palm);
+    }
+
+    static void filterInterrupt(void *context) {
+        TouchpadPipeline *pipeline = static_cast<TouchpadPipeline*>(context);
+        struct i801_adapter *adapter = &pipeline->adapter;
+
+        if (adapter->inb_p(SMBSLVSTS(adapter)) & SMBSLVSTS_HST_NTFY_STS) {
+            pipeline->notifies++;
+            adapter->outb_p(SMBSLVSTS_HST_NTFY_STS, SMBSLVSTS(adapter));
+        }
+        i801_isr(adapter);
+    }
+
+    /* Handles one Host Notify, @return number of contacts */
+    unsigned int handleNotify() {
+        u8 report[ETP_MAX_REPORT_LEN];
+        struct elan_finger finger;
+        unsigned int contact_count = 0;
+
+        notifies--;
+        if (i2c_smbus_read_block_data(&client, SIM_ELAN_PACKET_QUERY, &report[2]) != SIM_ELAN_BLOCK_LEN)
+            return 0;
+        if (elan_validate_report(report, contacts, SIM_ELAN_MAX_X, SIM_ELAN_MAX_Y) != ETP_REPORT_OK)
+            return 0;
+
+        const u8 *finger_data = &report[ETP_FINGER_DATA_OFFSET];
+        for (int i = 0; i < ETP_MAX_FINGERS; i++) {
+            struct elan_contact_state *contact = &contacts[i];
+
+            if (!elan_finger_valid(report, i)) {
+                if (contact->touching)
+                    elan_contact_lift(contact);
+                continue;
+            }
+            elan_decode_finger(finger_data, &finger);
+            finger_data += ETP_FINGER_DATA_LEN;
+            elan_contact_touch(contact, finger.pos_x, finger.pos_y, simulator.now());
+            contact->palm = elan_is_palm(contact, &palm, SIM_ELAN_MAX_X, finger.pos_x, finger.pos_y,
+                                         finger.mk_x > finger.mk_y ? finger.mk_x : finger.mk_y, finger.pressure);
+            contact_count++;
+        }
+        elan_frame_dispatch(&filter, report, contact_count, simulator.now(), KEEP_ALIVE);
+        return contact_count;
+    }
+
+    void run(uint64_t frames) {
+        unsigned int contacts = 0;
+
+        while (frames) {
+            uint64_t batch = frames < SWIPE_FRAMES ? frames : SWIPE_FRAMES;
+            touchpad.queueSwipe((unsigned int) batch - 1, simulator.now() + FRAME_INTERVAL, FRAME_INTERVAL);
+            for (uint64_t i = 0; i < batch; i++) {
+                simulator.advance(FRAME_INTERVAL);
+                while (notifies)
+                    contacts += handleNotify();
+            }
+            frames -= batch;
+        }
+        benchmark_keep(contacts);
+    }
+};
+
+BENCHMARK(notify_read_decode_block_buffer) {
+    TouchpadPipeline pipeline(FEATURE_BLOCK_BUFFER);
+    pipeline.run(state->iterations);
+}
+
+BENCHMARK(notify_read_decode_byte_by_byte) {
+    TouchpadPipeline pipeline(0);
+    pipeline.run(state->iterations);
+}
@@ -0,0 +1,118 @@
+/*
+ * TrackpointBenchmarks.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include <vector>
+#include "Benchmark.hpp"
+#include "TrackpointMotion.hpp"
+
+/* Packets of a synthetic stick trace, a trackpoint reports at about 100 Hz */
+#define TRACE_PACKETS   4096
+
+struct stick_packet {
+    int dx;
+    int dy;
+};
+
+/* Deterministic pseudo random numbers, so every run replays the same trace */
+static uint32_t next_random(uint32_t *state) {
+    *state = *state * 1664525 + 1013904223;
+    return *state >> 8;
+}
+
+/* Precise pointing: small deltas around zero */
+static std::vector<stick_packet> slow_trace() {
+    std::vector<stick_packet> trace(TRACE_PACKETS);
+    uint32_t state = 1;
+    for (stick_packet& packet : trace) {
+        packet.dx = (int) (next_random(&state) % 7) - 3;
+        packet.dy = (int) (next_random(&state) % 7) - 3;
+    }
+    return trace;
+}
+
+/* Flicks across the screen: the force ramps up to a large delta and back */
+static std::vector<stick_packet> flick_trace() {
+    std::vector<stick_packet> trace(TRACE_PACKETS);
+    for (int i = 0; i < TRACE_PACKETS; i++) {
+        int phase = i % 64;
+        int force = phase < 32 ? phase * 5 : (64 - phase) * 5;
+        trace[i].dx = (i / 64) % 2 ? force : -force;
+        trace[i].dy = force / 3;
+    }
+    return trace;
+}
+
+/* A resting finger: noise within and just outside the deadzone */
+static std::vector<stick_packet> jitter_trace() {
+    std::vector<stick_packet> trace(TRACE_PACKETS);
+    uint32_t state = 7;
+    for (stick_packet& packet : trace) {
+        packet.dx = (int) (next_random(&state) % 9) - 4;
+        packet.dy = (int) (next_random(&state) % 9) - 4;
+    }
+    return trace;
+}
+
+static void accelerate_trace(BenchmarkState* state, const std::vector<stick_packet>& trace,
+                             uint32_t sensitivity, uint32_t acceleration, uint32_t deadzone) {
+    struct trackpoint_acceleration accel;
+    int64_t remainder_x = 0, remainder_y = 0;
+    int x = 0, y = 0;
+    
+    trackpoint_set_acceleration(&accel, sensitivity, acceleration, deadzone);
+    for (uint64_t i = 0; i < state->iterations; i++) {
+        const stick_packet& packet = trace[i % TRACE_PACKETS];
+        x += trackpoint_accelerate(&accel, packet.dx, &remainder_x);
+        y += trackpoint_accelerate(&accel, packet.dy, &remainder_y);
+    }
+    benchmark_keep(x);
+    benchmark_keep(y);
+}
+
+BENCHMARK(accelerate_slow) {
+    static const std::vector<stick_packet> trace = slow_trace();
+    accelerate_trace(state, trace, 100, 50, 1);
+}
+
+BENCHMARK(accelerate_flick) {
+    static const std::vector<stick_packet> trace = flick_trace();
+    accelerate_trace(state, trace, 100, 50, 1);
+}
+
+BENCHMARK(accelerate_jitter_deadzone) {
+    static const std::vector<stick_packet> trace = jitter_trace();
+    accelerate_trace(state, trace, 100, 50, 3);
+}
+
+BENCHMARK(accelerate_linear) {
+    static const std::vector<stick_packet> trace = flick_trace();
+    accelerate_trace(state, trace, 150, 0, 0);
+}
+
+/* Cost of a configuration change */
+BENCHMARK(set_acceleration) {
+    struct trackpoint_acceleration accel;
+    for (uint64_t i = 0; i < state->iterations; i++) {
+        trackpoint_set_acceleration(&accel, 100 + (uint32_t) (i % 8), 50, 1);
+        benchmark_keep(accel);
+    }
+}
+
+/* Scrolling with the default engine, packets every 10 ms */
+BENCHMARK(scroll_update) {
+    static const std::vector<stick_packet> trace = flick_trace();
+    struct trackpoint_scroll scroll;
+    struct trackpoint_scroll_event event;
+    int lines = 0;
+    
+    trackpoint_set_scrolling(&scroll, 100, 16000000, 15);
+    for (uint64_t i = 0; i < state->iterations; i++) {
+        const stick_packet& packet = trace[i % TRACE_PACKETS];
+        if (trackpoint_scroll_update(&scroll, packet.dx, packet.dy, (i + 1) * 10000000, &event))
+            lines += event.lines_y;
+    }
+    benchmark_keep(lines);
+}
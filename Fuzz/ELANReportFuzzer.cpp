@@ -0,0 +1,103 @@
+/*
+ * ELANReportFuzzer.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include <string.h>
+#include "Fuzz.hpp"
+#include "ELANContact.hpp"
+#include "ELANReport.hpp"
+
+#define MAX_X               3052
+#define MAX_Y               1888
+#define FRAME_INTERVAL_NS   100000ULL
+#define KEEP_ALIVE_NS       8000000ULL
+
+/*
+ * Runs the input as a sequence of raw reports through the same steps as the
+ * touchpad driver: validation, decoding, palm classification and the frame
+ * filter. Reports that pass the validation must not decode to a position
+ * outside of the touchpad or to a finger that jumped across it.
+ */
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    struct elan_contact_state contacts[ETP_MAX_FINGERS] = {};
+    struct elan_frame_filter filter = {};
+    struct elan_palm_configuration palm;
+    /* Positions of the last accepted frame, to check the validation */
+    bool touched[ETP_MAX_FINGERS] = {};
+    unsigned int last_x[ETP_MAX_FINGERS], last_y[ETP_MAX_FINGERS];
+    uint64_t timestamp = 0, frames = 0;
+    
+    elan_palm_defaults(&palm);
+    for (size_t offset = 0; offset + ETP_MAX_REPORT_LEN <= size; offset += ETP_MAX_REPORT_LEN) {
+        uint8_t report[ETP_MAX_REPORT_LEN];
+        memcpy(report, data + offset, ETP_MAX_REPORT_LEN);
+        // the length bytes are not looked at by the driver, they set the time to the next report
+        timestamp += FRAME_INTERVAL_NS * (1 + report[0]);
+        
+        enum elan_report_error error = elan_validate_report(report, contacts, MAX_X, MAX_Y);
+        FUZZ_CHECK(error < ETP_REPORT_ERRORS);
+        if (error != ETP_REPORT_OK) {
+            memset(touched, 0, sizeof(touched));
+            continue;
+        }
+        
+        if (report[ETP_REPORT_ID_OFFSET] == ETP_TP_REPORT_ID) {
+            struct elan_trackpoint trackpoint;
+            elan_decode_trackpoint(report, &trackpoint);
+            FUZZ_CHECK(trackpoint.x >= -510 && trackpoint.x <= 255);
+            FUZZ_CHECK(trackpoint.y >= -255 && trackpoint.y <= 510);
+            FUZZ_CHECK(trackpoint.buttons >= 0 && trackpoint.buttons <= 7);
+            continue;
+        }
+        
+        FUZZ_CHECK(report[ETP_REPORT_ID_OFFSET] == ETP_REPORT_ID);
+        const uint8_t *finger_data = &report[ETP_FINGER_DATA_OFFSET];
+        unsigned int contact_count = 0;
+        
+        for (int i = 0; i < ETP_MAX_FINGERS; i++) {
+            struct elan_contact_state *contact = &contacts[i];
+            
+            if (!elan_finger_valid(report, i)) {
+                if (contact->touching)
+                    elan_contact_lift(contact);
+                touched[i] = false;
+                continue;
+            }
+            
+            // the bitmap was checked against the records, so they never run past the report
+            FUZZ_CHECK(finger_data + ETP_FINGER_DATA_LEN <= report + ETP_MAX_REPORT_LEN);
+            struct elan_finger finger;
+            elan_decode_finger(finger_data, &finger);
+            finger_data += ETP_FINGER_DATA_LEN;
+            FUZZ_CHECK(finger.pos_x <= MAX_X && finger.pos_y <= MAX_Y);
+            
+            if (touched[i] && !contact->palm) {
+                unsigned int dx = finger.pos_x > last_x[i] ? finger.pos_x - last_x[i] : last_x[i] - finger.pos_x;
+                unsigned int dy = finger.pos_y > last_y[i] ? finger.pos_y - last_y[i] : last_y[i] - finger.pos_y;
+                FUZZ_CHECK(dx <= MAX_X / ETP_MAX_POSITION_JUMP_DIVIDER && dy <= MAX_Y / ETP_MAX_POSITION_JUMP_DIVIDER);
+            }
+            touched[i] = true;
+            last_x[i] = finger.pos_x;
+            last_y[i] = finger.pos_y;
+            
+            if (elan_finger_hovering(report, i)) {
+                if (contact->touching)
+                    elan_contact_lift(contact);
+                continue;
+            }
+            
+            elan_contact_touch(contact, finger.pos_x, finger.pos_y, timestamp);
+            contact->palm = elan_is_palm(contact, &palm, MAX_X, finger.pos_x, finger.pos_y,
+                                         finger.mk_x > finger.mk_y ? finger.mk_x : finger.mk_y, finger.pressure);
+            contact_count++;
+        }
+        
+        elan_frame_dispatch(&filter, report, contact_count, timestamp, KEEP_ALIVE_NS);
+        frames++;
+    }
+    
+    FUZZ_CHECK(filter.dispatched + filter.suppressed == frames);
+    return 0;
+}
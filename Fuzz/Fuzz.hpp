@@ -0,0 +1,32 @@
+/*
+ * Fuzz.hpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#ifndef Fuzz_hpp
+#define Fuzz_hpp
+
+/*
+ * Fuzzing support for the host build. Every fuzzer implements the libFuzzer
+ * entry point, so it can be linked against libFuzzer with clang, or against
+ * FuzzMain.cpp, which mutates the seed inputs with a deterministic random
+ * generator and works with any compiler.
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+/* Aborts if @condition is false, so the fuzzer reports the input as a crash */
+#define FUZZ_CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            abort(); \
+        } \
+    } while (0)
+
+#endif /* Fuzz_hpp */
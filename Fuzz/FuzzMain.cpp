@@ -0,0 +1,144 @@
+/*
+ * FuzzMain.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include <dirent.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "Fuzz.hpp"
+
+/* Largest input that is generated */
+#define FUZZ_MAX_LEN        4096
+/* Mutations applied to a seed for one input */
+#define FUZZ_MAX_MUTATIONS  8
+
+typedef std::vector<uint8_t> Input;
+
+static uint32_t random_state;
+
+static uint32_t next_random() {
+    // xorshift32, the same sequence for the same --seed on every platform
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+static bool read_file(const char *path, Input *input) {
+    FILE *file = fopen(path, "rb");
+    uint8_t buffer[4096];
+    size_t length;
+    
+    if (!file)
+        return false;
+    while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        input->insert(input->end(), buffer, buffer + length);
+    fclose(file);
+    return true;
+}
+
+/* Adds a file or all files of a directory to the seeds */
+static bool add_seeds(const char *path, std::vector<Input> *seeds) {
+    DIR *directory = opendir(path);
+    
+    if (!directory) {
+        Input input;
+        if (!read_file(path, &input))
+            return false;
+        seeds->push_back(input);
+        return true;
+    }
+    
+    struct dirent *entry;
+    while ((entry = readdir(directory))) {
+        if (entry->d_name[0] == '.')
+            continue;
+        std::string file = std::string(path) + "/" + entry->d_name;
+        Input input;
+        if (read_file(file.c_str(), &input))
+            seeds->push_back(input);
+    }
+    closedir(directory);
+    return true;
+}
+
+static void mutate(Input *input) {
+    static const uint8_t interesting[] = { 0x00, 0x01, 0x7f, 0x80, 0xff };
+    int mutations = 1 + next_random() % FUZZ_MAX_MUTATIONS;
+    
+    for (int i = 0; i < mutations; i++) {
+        size_t size = input->size();
+        size_t offset = size ? next_random() % size : 0;
+        
+        switch (next_random() % 6) {
+            case 0:
+                if (size)
+                    (*input)[offset] ^= 1 << (next_random() % 8);
+                break;
+            case 1:
+                if (size)
+                    (*input)[offset] = (uint8_t) next_random();
+                break;
+            case 2:
+                if (size)
+                    (*input)[offset] = interesting[next_random() % sizeof(interesting)];
+                break;
+            case 3:
+                if (size < FUZZ_MAX_LEN)
+                    input->insert(input->begin() + offset, (uint8_t) next_random());
+                break;
+            case 4:
+                if (size)
+                    input->erase(input->begin() + offset);
+                break;
+            case 5: {
+                // repeats a part of the input, e.g. a whole report
+                if (!size)
+                    break;
+                size_t length = 1 + next_random() % (size - offset);
+                if (size + length > FUZZ_MAX_LEN)
+                    break;
+                Input part(input->begin() + offset, input->begin() + offset + length);
+                input->insert(input->begin() + next_random() % (size + 1), part.begin(), part.end());
+                break;
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    std::vector<Input> seeds;
+    unsigned long runs = 100000;
+    
+    random_state = 1;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--runs") && i + 1 < argc) {
+            runs = strtoul(argv[++i], NULL, 0);
+        } else if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+            random_state = (uint32_t) strtoul(argv[++i], NULL, 0);
+            if (!random_state)
+                random_state = 1;
+        } else if (!add_seeds(argv[i], &seeds)) {
+            fprintf(stderr, "can't read %s\n", argv[i]);
+            return 1;
+        }
+    }
+    
+    // the seeds themselves are run first, so a crashing input can be reproduced by passing it alone
+    for (size_t i = 0; i < seeds.size(); i++)
+        LLVMFuzzerTestOneInput(seeds[i].data(), seeds[i].size());
+    if (seeds.empty())
+        seeds.push_back(Input());
+    
+    for (unsigned long run = 0; run < runs; run++) {
+        Input input = seeds[next_random() % seeds.size()];
+        mutate(&input);
+        LLVMFuzzerTestOneInput(input.data(), input.size());
+    }
+    
+    printf("%lu runs, %zu seeds\n", runs, seeds.size());
+    return 0;
+}
@@ -0,0 +1,31 @@
+/*
+ * HostPlatform.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+/*
+ * Implements smbus_platform.h for the host build of the portable core. The
+ * host uses nanoseconds as absolute time units. Messages are only written to
+ * stderr if VOODOOSMBUS_LOG is set, so the expected errors of the tests don't
+ * clutter their output.
+ */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "smbus_platform.h"
+
+void smbus_log(const char* format, ...) {
+    static const bool enabled = getenv("VOODOOSMBUS_LOG") != NULL;
+    if (!enabled)
+        return;
+    
+    va_list arguments;
+    va_start(arguments, format);
+    vfprintf(stderr, format, arguments);
+    va_end(arguments);
+}
+
+uint64_t smbus_absolutetime_to_nanoseconds(uint64_t absolutetime) {
+    return absolutetime;
+}
@@ -0,0 +1,71 @@
+/*
+ * ELANSimulator.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include <string.h>
+#include "ELANSimulator.hpp"
+
+SimulatedELANTouchpad::SimulatedELANTouchpad(I801Simulator *simulator, u8 address)
+    : simulator(simulator), address(address) {
+    last_report[ETP_REPORT_ID_OFFSET] = ETP_REPORT_ID;
+}
+
+void SimulatedELANTouchpad::queueReport(const u8 *report, uint64_t time) {
+    Report queued;
+
+    queued.time = time;
+    memcpy(queued.data, report, ETP_MAX_REPORT_LEN);
+    reports.push_back(queued);
+    simulator->scheduleHostNotify(address, time);
+}
+
+void SimulatedELANTouchpad::queueSwipe(unsigned int frames, uint64_t time, uint64_t interval) {
+    u8 report[ETP_MAX_REPORT_LEN];
+    unsigned int step = frames > 1 ? 2 * (SIM_ELAN_MAX_X - 200) / frames : 0;
+
+    for (unsigned int i = 0; i < frames; i++) {
+        // there and back, a step is far below the position jump limit
+        unsigned int distance = i * step;
+        unsigned int x = distance < SIM_ELAN_MAX_X - 200 ? 100 + distance : 100 + 2 * (SIM_ELAN_MAX_X - 200) - distance;
+
+        memset(report, 0, sizeof(report));
+        report[ETP_REPORT_ID_OFFSET] = ETP_REPORT_ID;
+        addFinger(report, 0, x, SIM_ELAN_MAX_Y / 2 + (i % 8), 60);
+        queueReport(report, time + i * interval);
+    }
+
+    memset(report, 0, sizeof(report));
+    report[ETP_REPORT_ID_OFFSET] = ETP_REPORT_ID;
+    queueReport(report, time + frames * interval);
+}
+
+void SimulatedELANTouchpad::addFinger(u8 *report, int slot, unsigned int x, unsigned int y, unsigned int pressure) {
+    int record = __builtin_popcount(report[ETP_TOUCH_INFO_OFFSET] & ETP_TOUCH_INFO_FINGERS);
+    u8 *finger = &report[ETP_FINGER_DATA_OFFSET + record * ETP_FINGER_DATA_LEN];
+
+    report[ETP_TOUCH_INFO_OFFSET] |= 1 << (3 + slot);
+    finger[0] = ((x >> 4) & 0xf0) | ((y >> 8) & 0x0f);
+    finger[1] = x & 0xff;
+    finger[2] = y & 0xff;
+    finger[3] = 0x22;
+    finger[4] = pressure;
+}
+
+int SimulatedELANTouchpad::transfer(char read_write, u8 command, int protocol, union i2c_smbus_data *data) {
+    if (read_write != I2C_SMBUS_READ || protocol != I2C_SMBUS_BLOCK_DATA || command != SIM_ELAN_PACKET_QUERY)
+        return 0;
+
+    queries++;
+    if (!reports.empty() && reports.front().time <= simulator->now()) {
+        memcpy(last_report, reports.front().data, ETP_MAX_REPORT_LEN);
+        reports.pop_front();
+    } else {
+        stale_queries++;
+    }
+
+    data->block[0] = SIM_ELAN_BLOCK_LEN;
+    memcpy(&data->block[1], &last_report[2], SIM_ELAN_BLOCK_LEN);
+    return 0;
+}
@@ -0,0 +1,63 @@
+/*
+ * ELANSimulator.hpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#ifndef ELANSimulator_hpp
+#define ELANSimulator_hpp
+
+/*
+ * An ELAN touchpad on the simulated bus. Every report it is given is announced
+ * with a Host Notify at its time and returned by the next report query, like
+ * the touchpad does once a frame is ready. A query without a new frame returns
+ * the last one again.
+ */
+#include <deque>
+#include "I801Simulator.hpp"
+#include "ELANReport.hpp"
+
+#define SIM_ELAN_ADDRESS        0x15
+#define SIM_ELAN_PACKET_QUERY   0xa8
+/* Bytes of the report after the two length bytes, the block the query returns */
+#define SIM_ELAN_BLOCK_LEN      (ETP_MAX_REPORT_LEN - 2)
+
+#define SIM_ELAN_MAX_X          3052
+#define SIM_ELAN_MAX_Y          1888
+
+class SimulatedELANTouchpad : public SimulatedDevice {
+public:
+    SimulatedELANTouchpad(I801Simulator *simulator, u8 address = SIM_ELAN_ADDRESS);
+
+    /* Queues a raw report of ETP_MAX_REPORT_LEN bytes, which is ready at @time */
+    void queueReport(const u8 *report, uint64_t time);
+
+    /*
+     * Queues the frames of a finger moving from left to right and back, one
+     * every @interval starting at @time, followed by a frame without a contact
+     */
+    void queueSwipe(unsigned int frames, uint64_t time, uint64_t interval);
+
+    /* Adds a finger to a touchpad report, the records of the fingers must be added in slot order */
+    static void addFinger(u8 *report, int slot, unsigned int x, unsigned int y, unsigned int pressure);
+
+    int transfer(char read_write, u8 command, int protocol, union i2c_smbus_data *data) override;
+
+    /* Statistics */
+    uint64_t queries = 0;
+    /* Queries that returned the last report again */
+    uint64_t stale_queries = 0;
+
+private:
+    struct Report {
+        uint64_t time;
+        u8 data[ETP_MAX_REPORT_LEN];
+    };
+
+    I801Simulator *simulator;
+    u8 address;
+    std::deque<Report> reports;
+    u8 last_report[ETP_MAX_REPORT_LEN] = {};
+};
+
+#endif /* ELANSimulator_hpp */
@@ -0,0 +1,609 @@
+/*
+ * I801Simulator.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include <string.h>
+#include "I801Simulator.hpp"
+
+/* Register offsets, the macros of i2c_i801.hpp relative to an I/O base of 0 */
+static const struct {
+    unsigned long smba;
+} registers = { 0 };
+
+int SimulatedRegisterDevice::transfer(char read_write, u8 command, int protocol, union i2c_smbus_data *data) {
+    bool read = read_write == I2C_SMBUS_READ;
+    int length;
+
+    if (read)
+        reads[protocol]++;
+    else
+        writes[protocol]++;
+
+    switch (protocol) {
+        case I2C_SMBUS_QUICK:
+            return 0;
+        case I2C_SMBUS_BYTE:
+            // "receive byte" reads at the register pointer, "send byte" sets it
+            if (read)
+                data->byte = registers[pointer++];
+            else
+                pointer = command;
+            return 0;
+        case I2C_SMBUS_BYTE_DATA:
+            if (read)
+                data->byte = registers[command];
+            else
+                registers[command] = data->byte;
+            return 0;
+        case I2C_SMBUS_WORD_DATA:
+            if (read)
+                data->word = registers[command] | registers[(u8) (command + 1)] << 8;
+            else {
+                registers[command] = data->word & 0xff;
+                registers[(u8) (command + 1)] = data->word >> 8;
+            }
+            return 0;
+        case I2C_SMBUS_BLOCK_DATA:
+            // the register at the command holds the length of the block following it
+            if (read) {
+                length = registers[command];
+                data->block[0] = length;
+                for (int i = 0; i < length && i < I2C_SMBUS_BLOCK_MAX; i++)
+                    data->block[1 + i] = registers[(u8) (command + 1 + i)];
+            } else {
+                registers[command] = data->block[0];
+                for (int i = 0; i < data->block[0]; i++)
+                    registers[(u8) (command + 1 + i)] = data->block[1 + i];
+            }
+            return 0;
+        case I2C_SMBUS_I2C_BLOCK_DATA:
+            for (int i = 0; i < data->block[0]; i++) {
+                if (read)
+                    data->block[1 + i] = registers[(u8) (command + i)];
+                else
+                    registers[(u8) (command + i)] = data->block[1 + i];
+            }
+            return 0;
+        default:
+            return -EOPNOTSUPP;
+    }
+}
+
+bool I801Simulator::AlertResponder::lineAsserted() const {
+    for (int address = 0; address < 128; address++) {
+        if (asserted[address])
+            return true;
+    }
+    return false;
+}
+
+int I801Simulator::AlertResponder::transfer(char read_write, u8 command, int protocol, union i2c_smbus_data *data) {
+    if (read_write != I2C_SMBUS_READ || protocol != I2C_SMBUS_BYTE)
+        return -EOPNOTSUPP;
+
+    // the lowest address wins the arbitration of the response and releases SMBALERT#
+    for (int address = 0; address < 128; address++) {
+        if (asserted[address]) {
+            data->byte = (u8) (address << 1) | flags[address];
+            asserted[address] = false;
+            (*responses)++;
+            return 0;
+        }
+    }
+    return -ENXIO;
+}
+
+static void sim_outb(void *context, u8 value, u16 port) {
+    static_cast<I801Simulator*>(context)->outb(value, port);
+}
+
+static u8 sim_inb(void *context, u16 port) {
+    return static_cast<I801Simulator*>(context)->inb(port);
+}
+
+static u8 sim_config_read8(void *context, u16 offset) {
+    return static_cast<I801Simulator*>(context)->configRead8(offset);
+}
+
+static void sim_config_write8(void *context, u8 value, u16 offset) {
+    static_cast<I801Simulator*>(context)->configWrite8(value, offset);
+}
+
+static void sim_udelay(void *context, unsigned int us) {
+    static_cast<I801Simulator*>(context)->advance(us * 1000ULL);
+}
+
+static int sim_wait_status(void *context, struct i801_adapter *priv) {
+    return static_cast<I801Simulator*>(context)->waitStatus(priv);
+}
+
+static const struct i801_ops sim_ops = {
+    .outb = sim_outb,
+    .inb = sim_inb,
+    .config_read8 = sim_config_read8,
+    .config_write8 = sim_config_write8,
+    .udelay = sim_udelay,
+    .wait_status = sim_wait_status,
+};
+
+static s32 sim_xfer(void *context, u16 addr, unsigned short flags, char read_write,
+                    u8 command, int protocol, union i2c_smbus_data *data) {
+    return i801_access(static_cast<struct i801_adapter*>(context), addr, flags, read_write, command, protocol, data);
+}
+
+I801Simulator::I801Simulator() {
+    config[SMBHSTCFG] = SMBHSTCFG_HST_EN;
+    memset(buffer, 0, sizeof(buffer));
+    memset(&data, 0, sizeof(data));
+    alert_responder.responses = &alert_responses;
+    devices[SMBUS_ALERT_RESPONSE_ADDRESS] = &alert_responder;
+}
+
+void I801Simulator::setup(struct i801_adapter *adapter, unsigned int features) {
+    memset(adapter, 0, sizeof(*adapter));
+    adapter->name = "i801-simulator";
+    adapter->ops = &sim_ops;
+    adapter->context = this;
+    adapter->smba = SIM_SMBA;
+    adapter->features = features;
+    adapter->retries = 3;
+    adapter->timeout = 200000000;
+    adapter->original_hstcfg = config[SMBHSTCFG];
+    adapter->original_slvcmd = slvcmd;
+
+    this->adapter = adapter;
+    setInterruptHandler(&I801Simulator::defaultInterruptHandler, this);
+}
+
+void I801Simulator::setFault(enum SimulatedFault fault, unsigned int permille) {
+    fault_permille[fault] = permille;
+}
+
+void I801Simulator::setFaultSeed(uint32_t seed) {
+    fault_seed = seed ? seed : 1;
+}
+
+bool I801Simulator::faultHappens(enum SimulatedFault fault) {
+    if (!fault_permille[fault])
+        return false;
+
+    // xorshift32, only advanced for enabled faults so a seed replays the same faults
+    fault_seed ^= fault_seed << 13;
+    fault_seed ^= fault_seed >> 17;
+    fault_seed ^= fault_seed << 5;
+    if (fault_seed % 1000 >= fault_permille[fault])
+        return false;
+
+    faults[fault]++;
+    return true;
+}
+
+void I801Simulator::attach(u8 address, SimulatedDevice *device) {
+    devices[address & 0x7f] = device;
+}
+
+void I801Simulator::detach(u8 address) {
+    devices[address & 0x7f] = NULL;
+}
+
+struct i2c_smbus_client I801Simulator::client(u8 address, unsigned short flags) {
+    struct i2c_smbus_client client = {
+        .xfer = sim_xfer,
+        .context = adapter,
+        .addr = address,
+        .flags = flags,
+    };
+    return client;
+}
+
+void I801Simulator::setInterruptHandler(InterruptHandler handler, void *context) {
+    interrupt_handler = handler;
+    interrupt_context = context;
+}
+
+void I801Simulator::defaultInterruptHandler(void *context) {
+    I801Simulator *simulator = static_cast<I801Simulator*>(context);
+    i801_isr(simulator->adapter);
+}
+
+void I801Simulator::advance(uint64_t ns) {
+    uint64_t target = clock + ns;
+
+    for (;;) {
+        bool transaction = (phase == PHASE_RUNNING || phase == PHASE_BYTE) && event_time <= target;
+        bool notify = !notifies.empty() && notifies.front().time <= target;
+
+        if (notify && (!transaction || notifies.front().time < event_time)) {
+            ScheduledNotify next = notifies.front();
+            notifies.erase(notifies.begin());
+            clock = next.time;
+            if (!hostNotify(next.address))
+                notifies_lost++;
+        } else if (transaction) {
+            clock = event_time;
+            fire();
+        } else {
+            break;
+        }
+    }
+    clock = target;
+}
+
+int I801Simulator::waitStatus(struct i801_adapter *priv) {
+    uint64_t deadline = clock + priv->timeout;
+
+    while (!priv->status) {
+        if ((phase != PHASE_RUNNING && phase != PHASE_BYTE) || event_time > deadline) {
+            advance(deadline - clock);
+            return priv->status ? 0 : -ETIMEDOUT;
+        }
+        advance(event_time - clock);
+    }
+    return 0;
+}
+
+bool I801Simulator::hostNotify(u8 address) {
+    if (slvsts & SMBSLVSTS_HST_NTFY_STS)
+        return false;
+
+    slvsts |= SMBSLVSTS_HST_NTFY_STS;
+    ntfdadd = address << 1;
+    deliverInterrupt();
+    return true;
+}
+
+void I801Simulator::scheduleHostNotify(u8 address, uint64_t time) {
+    ScheduledNotify notify = { time < clock ? clock : time, address };
+    std::vector<ScheduledNotify>::iterator position = notifies.begin();
+
+    while (position != notifies.end() && position->time <= notify.time)
+        position++;
+    notifies.insert(position, notify);
+}
+
+void I801Simulator::assertAlert(u8 address, u8 flag) {
+    bool asserted = alert_responder.lineAsserted();
+
+    alert_responder.asserted[address & 0x7f] = true;
+    alert_responder.flags[address & 0x7f] = flag & 1;
+    // SMBALERT# is wired-OR, only the falling edge sets the status
+    if (!asserted) {
+        hststs |= SMBHSTSTS_SMBALERT_STS;
+        deliverInterrupt();
+    }
+}
+
+bool I801Simulator::alertAsserted(u8 address) const {
+    return alert_responder.asserted[address & 0x7f];
+}
+
+bool I801Simulator::interruptAsserted() {
+    if (!drop_interrupt && (hstcnt & SMBHSTCNT_INTREN) && (hststs & (SMBHSTSTS_BYTE_DONE | SMBHSTSTS_INTR | STATUS_ERROR_FLAGS)))
+        return true;
+    if ((slvcmd & SMBSLVCMD_HST_NTFY_INTREN) && (slvsts & SMBSLVSTS_HST_NTFY_STS))
+        return true;
+    return !(slvcmd & SMBSLVCMD_SMBALERT_DISABLE) && (hststs & SMBHSTSTS_SMBALERT_STS);
+}
+
+void I801Simulator::deliverInterrupt() {
+    if (in_interrupt || !interrupt_handler || !interruptAsserted())
+        return;
+
+    in_interrupt = true;
+    interrupts++;
+    interrupt_handler(interrupt_context);
+    in_interrupt = false;
+}
+
+void I801Simulator::complete(u8 status, uint64_t delay) {
+    phase = PHASE_RUNNING;
+    result = status;
+    event_time = clock + delay;
+    bus_time += delay;
+}
+
+void I801Simulator::startByteByByte(int header_bytes) {
+    uint64_t delay = SIM_START_STOP_NS / 2 + (header_bytes + 1) * SIM_BYTE_TIME_NS;
+
+    byte_index = 0;
+    last_byte = false;
+    phase = PHASE_BYTE;
+    event_time = clock + delay;
+    bus_time += delay;
+}
+
+void I801Simulator::start(u8 control) {
+    if (phase != PHASE_IDLE || !(config[SMBHSTCFG] & SMBHSTCFG_HST_EN))
+        return;
+
+    u8 xact = control & 0x1c;
+    int bytes;
+    bool pec;
+    int status;
+
+    transactions++;
+    device = devices[hstadd >> 1];
+    read_write = hstadd & 0x01;
+    command = hstcmd;
+    length_on_wire = false;
+    memset(&data, 0, sizeof(data));
+
+    drop_interrupt = faultHappens(SIM_FAULT_DROPPED_INTERRUPT);
+    if (faultHappens(SIM_FAULT_ARBITRATION_LOSS)) {
+        complete(SMBHSTSTS_BUS_ERR, SIM_START_STOP_NS / 2 + SIM_BYTE_TIME_NS / 2);
+        return;
+    }
+    // the transaction then fails like for a missing device
+    if (faultHappens(SIM_FAULT_NAK))
+        device = NULL;
+
+    switch (xact) {
+        case I801_QUICK:
+            protocol = I2C_SMBUS_QUICK;
+            bytes = 1;
+            break;
+        case I801_BYTE:
+            protocol = I2C_SMBUS_BYTE;
+            bytes = 2;
+            break;
+        case I801_BYTE_DATA:
+            protocol = I2C_SMBUS_BYTE_DATA;
+            data.byte = hstdat0;
+            bytes = read_write == I2C_SMBUS_READ ? 4 : 3;
+            break;
+        case I801_WORD_DATA:
+            protocol = I2C_SMBUS_WORD_DATA;
+            data.word = hstdat0 | hstdat1 << 8;
+            bytes = read_write == I2C_SMBUS_READ ? 5 : 4;
+            break;
+        case I801_BLOCK_DATA:
+            if (!(auxctl & SMBAUXCTL_E32B)) {
+                // byte-by-byte, writes are I2C block writes while I2C_EN is set
+                protocol = (config[SMBHSTCFG] & SMBHSTCFG_I2C_EN) ? I2C_SMBUS_I2C_BLOCK_DATA : I2C_SMBUS_BLOCK_DATA;
+                if (!device) {
+                    complete(SMBHSTSTS_DEV_ERR, SIM_START_STOP_NS + SIM_BYTE_TIME_NS);
+                    return;
+                }
+                if (read_write == I2C_SMBUS_WRITE) {
+                    byte_count = hstdat0;
+                    data.block[0] = hstdat0;
+                    data.block[1] = blkdat;
+                    startByteByByte(protocol == I2C_SMBUS_I2C_BLOCK_DATA ? 2 : 3);
+                    return;
+                }
+                status = device->transfer(read_write, command, protocol, &data);
+                if (status < 0) {
+                    complete(SMBHSTSTS_DEV_ERR, SIM_START_STOP_NS + 3 * SIM_BYTE_TIME_NS);
+                    return;
+                }
+                if (faultHappens(SIM_FAULT_BLOCK_LENGTH))
+                    data.block[0] = I2C_SMBUS_BLOCK_MAX + 1;
+                length_on_wire = true;
+                byte_count = data.block[0];
+                startByteByByte(4);
+                return;
+            }
+
+            protocol = I2C_SMBUS_BLOCK_DATA;
+            buffer_index = 0;
+            if (read_write == I2C_SMBUS_WRITE) {
+                data.block[0] = hstdat0;
+                memcpy(&data.block[1], buffer, sizeof(buffer));
+                bytes = 3 + hstdat0;
+            } else {
+                bytes = 4;
+            }
+            break;
+        case I801_I2C_BLOCK_DATA:
+            // always a read, the R/W bit of the address is only set with SPD write disable
+            protocol = I2C_SMBUS_I2C_BLOCK_DATA;
+            read_write = I2C_SMBUS_READ;
+            command = hstdat1;
+            if (!device) {
+                complete(SMBHSTSTS_DEV_ERR, SIM_START_STOP_NS + SIM_BYTE_TIME_NS);
+                return;
+            }
+            data.block[0] = I2C_SMBUS_BLOCK_MAX;
+            if (device->transfer(read_write, command, protocol, &data) < 0) {
+                complete(SMBHSTSTS_DEV_ERR, SIM_START_STOP_NS + 3 * SIM_BYTE_TIME_NS);
+                return;
+            }
+            byte_count = I2C_SMBUS_BLOCK_MAX;
+            startByteByByte(3);
+            return;
+        default:
+            complete(SMBHSTSTS_FAILED, 0);
+            return;
+    }
+
+    // PEC is enabled with SMBAUXCTL_CRC, SMBHSTCNT_PEC_EN only serves byte-by-byte transactions
+    pec = (control & SMBHSTCNT_PEC_EN) || (auxctl & SMBAUXCTL_CRC);
+    if (pec)
+        bytes++;
+
+    if (!device) {
+        complete(SMBHSTSTS_DEV_ERR, SIM_START_STOP_NS + SIM_BYTE_TIME_NS);
+        return;
+    }
+
+    status = device->transfer(read_write, command, protocol, &data);
+    if (status < 0) {
+        complete(SMBHSTSTS_DEV_ERR, SIM_START_STOP_NS + bytes * SIM_BYTE_TIME_NS);
+        return;
+    }
+
+    if (read_write == I2C_SMBUS_READ) {
+        switch (protocol) {
+            case I2C_SMBUS_BYTE:
+            case I2C_SMBUS_BYTE_DATA:
+                hstdat0 = data.byte;
+                break;
+            case I2C_SMBUS_WORD_DATA:
+                hstdat0 = data.word & 0xff;
+                hstdat1 = data.word >> 8;
+                break;
+            case I2C_SMBUS_BLOCK_DATA:
+                if (faultHappens(SIM_FAULT_BLOCK_LENGTH))
+                    data.block[0] = I2C_SMBUS_BLOCK_MAX + 1;
+                hstdat0 = data.block[0];
+                memcpy(buffer, &data.block[1], sizeof(buffer));
+                bytes += data.block[0] <= I2C_SMBUS_BLOCK_MAX ? data.block[0] : I2C_SMBUS_BLOCK_MAX;
+                break;
+        }
+    }
+
+    // the controller NAKs a byte with a wrong PEC and sets CRCE
+    if (pec && faultHappens(SIM_FAULT_PEC)) {
+        auxsts |= SMBAUXSTS_CRCE;
+        complete(SMBHSTSTS_DEV_ERR, SIM_START_STOP_NS + bytes * SIM_BYTE_TIME_NS);
+        return;
+    }
+
+    complete(SMBHSTSTS_INTR, SIM_START_STOP_NS + bytes * SIM_BYTE_TIME_NS);
+}
+
+void I801Simulator::fire() {
+    switch (phase) {
+        case PHASE_RUNNING:
+            phase = PHASE_IDLE;
+            hststs |= result;
+            if (faultHappens(SIM_FAULT_HOST_BUSY))
+                host_busy_until = clock + SIM_HOST_BUSY_NS;
+            break;
+        case PHASE_BYTE:
+            if (read_write == I2C_SMBUS_READ) {
+                blkdat = data.block[1 + byte_index];
+                if (length_on_wire && byte_index == 0)
+                    hstdat0 = byte_count;
+                // the host NAKs the byte if LAST_BYTE is set by the time it was received
+                last_byte = hstcnt & SMBHSTCNT_LAST_BYTE;
+            }
+            hststs |= SMBHSTSTS_BYTE_DONE;
+            phase = PHASE_BYTE_WAIT;
+            break;
+        default:
+            return;
+    }
+
+    deliverInterrupt();
+}
+
+void I801Simulator::clearByteDone() {
+    bool done;
+    int length = byte_count;
+
+    if (length < 1)
+        length = 1;
+    if (length > I2C_SMBUS_BLOCK_MAX)
+        length = I2C_SMBUS_BLOCK_MAX;
+
+    byte_index++;
+    if (read_write == I2C_SMBUS_READ)
+        done = length_on_wire ? byte_index >= length : (last_byte || byte_index >= length);
+    else
+        done = byte_index >= length;
+
+    if (!done) {
+        if (read_write == I2C_SMBUS_WRITE)
+            data.block[1 + byte_index] = blkdat;
+        phase = PHASE_BYTE;
+        event_time = clock + SIM_BYTE_TIME_NS;
+        bus_time += SIM_BYTE_TIME_NS;
+        return;
+    }
+
+    u8 status = SMBHSTSTS_INTR;
+    if (read_write == I2C_SMBUS_WRITE && device->transfer(read_write, command, protocol, &data) < 0)
+        status = SMBHSTSTS_DEV_ERR;
+    complete(status, SIM_START_STOP_NS / 2);
+}
+
+void I801Simulator::outb(u8 value, u16 port) {
+    u16 offset = port - SIM_SMBA;
+
+    if (offset == SMBHSTSTS(&registers)) {
+        // write 1 to clear, HOST_BUSY is read only
+        u8 clear = value & hststs & ~SMBHSTSTS_HOST_BUSY;
+        hststs &= ~clear;
+        if ((clear & SMBHSTSTS_BYTE_DONE) && phase == PHASE_BYTE_WAIT)
+            clearByteDone();
+    } else if (offset == SMBHSTCNT(&registers)) {
+        if ((value & SMBHSTCNT_KILL) && phase != PHASE_IDLE) {
+            phase = PHASE_IDLE;
+            hststs |= SMBHSTSTS_FAILED;
+        }
+        hstcnt = value & ~SMBHSTCNT_START;
+        if (value & SMBHSTCNT_START)
+            start(value);
+        deliverInterrupt();
+    } else if (offset == SMBHSTCMD(&registers)) {
+        hstcmd = value;
+    } else if (offset == SMBHSTADD(&registers)) {
+        hstadd = value;
+    } else if (offset == SMBHSTDAT0(&registers)) {
+        hstdat0 = value;
+    } else if (offset == SMBHSTDAT1(&registers)) {
+        hstdat1 = value;
+    } else if (offset == SMBBLKDAT(&registers)) {
+        if (auxctl & SMBAUXCTL_E32B) {
+            if (buffer_index < I2C_SMBUS_BLOCK_MAX)
+                buffer[buffer_index++] = value;
+        } else {
+            blkdat = value;
+        }
+    } else if (offset == SMBAUXSTS(&registers)) {
+        auxsts &= ~value;
+    } else if (offset == SMBAUXCTL(&registers)) {
+        auxctl = value & (SMBAUXCTL_CRC | SMBAUXCTL_E32B);
+    } else if (offset == SMBSLVSTS(&registers)) {
+        slvsts &= ~value;
+    } else if (offset == SMBSLVCMD(&registers)) {
+        slvcmd = value;
+    }
+}
+
+u8 I801Simulator::inb(u16 port) {
+    u16 offset = port - SIM_SMBA;
+
+    if (offset == SMBHSTSTS(&registers))
+        return hststs | (phase != PHASE_IDLE || clock < host_busy_until ? SMBHSTSTS_HOST_BUSY : 0);
+    if (offset == SMBHSTCNT(&registers)) {
+        // reading the control register resets the index of the block buffer
+        buffer_index = 0;
+        return hstcnt;
+    }
+    if (offset == SMBHSTCMD(&registers))
+        return hstcmd;
+    if (offset == SMBHSTADD(&registers))
+        return hstadd;
+    if (offset == SMBHSTDAT0(&registers))
+        return hstdat0;
+    if (offset == SMBHSTDAT1(&registers))
+        return hstdat1;
+    if (offset == SMBBLKDAT(&registers)) {
+        if (!(auxctl & SMBAUXCTL_E32B))
+            return blkdat;
+        return buffer_index < I2C_SMBUS_BLOCK_MAX ? buffer[buffer_index++] : 0;
+    }
+    if (offset == SMBAUXSTS(&registers))
+        return auxsts;
+    if (offset == SMBAUXCTL(&registers))
+        return auxctl;
+    if (offset == SMBSLVSTS(&registers))
+        return slvsts;
+    if (offset == SMBSLVCMD(&registers))
+        return slvcmd;
+    if (offset == SMBNTFDADD(&registers))
+        return ntfdadd;
+    return 0;
+}
+
+u8 I801Simulator::configRead8(u16 offset) {
+    return config[offset & 0xff];
+}
+
+void I801Simulator::configWrite8(u8 value, u16 offset) {
+    config[offset & 0xff] = value;
+}
@@ -0,0 +1,238 @@
+/*
+ * I801Simulator.hpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#ifndef I801Simulator_hpp
+#define I801Simulator_hpp
+
+/*
+ * Register level model of an Intel 801 SMBus controller, so the transactions
+ * of i2c_i801.cpp run unmodified against simulated devices on the host.
+ *
+ * Time is virtual: it only advances by the delays of the driver and while it
+ * waits for an interrupt, so the bus timing is deterministic and a test runs
+ * as fast as the host can execute the driver. Interrupts are delivered
+ * synchronously from within the call that advanced the clock past the event
+ * raising them, like a filter interrupt handler preempting the driver.
+ */
+#include <vector>
+#include "i2c_i801.hpp"
+#include "SMBusAlert.hpp"
+
+/* Bus clock of 100 kHz: 9 bits per byte including the ACK, plus start and stop */
+#define SIM_BIT_TIME_NS         10000
+#define SIM_BYTE_TIME_NS        (9 * SIM_BIT_TIME_NS)
+#define SIM_START_STOP_NS       (2 * SIM_BIT_TIME_NS)
+
+/* I/O base of the simulated controller */
+#define SIM_SMBA                0xefa0
+
+/* Time another master holds the bus after a SIM_FAULT_HOST_BUSY */
+#define SIM_HOST_BUSY_NS        2000000
+
+/* Faults of the bus and the controller, see I801Simulator::setFault */
+enum SimulatedFault {
+    /* The device doesn't acknowledge its address */
+    SIM_FAULT_NAK,
+    /* Another master wins the arbitration */
+    SIM_FAULT_ARBITRATION_LOSS,
+    /* Another master holds the bus for SIM_HOST_BUSY_NS after a transaction */
+    SIM_FAULT_HOST_BUSY,
+    /* The transaction raises no interrupts, the driver has to time out */
+    SIM_FAULT_DROPPED_INTERRUPT,
+    /* A block read returns a length larger than I2C_SMBUS_BLOCK_MAX */
+    SIM_FAULT_BLOCK_LENGTH,
+    /* The PEC byte of a transaction with PEC is corrupted */
+    SIM_FAULT_PEC,
+    SIM_FAULTS
+};
+
+class SimulatedDevice {
+public:
+    virtual ~SimulatedDevice() {}
+
+    /*
+     * Executes a transfer addressed to the device. `data` is laid out like
+     * for i2c_smbus_xfer, block reads set data->block[0] to the length.
+     * I2C block reads request data->block[0] bytes, but the host may stop
+     * earlier or later.
+     * @return 0 or a negative errno, which NAKs the transfer
+     */
+    virtual int transfer(char read_write, u8 command, int protocol, union i2c_smbus_data *data) = 0;
+};
+
+/* A device with 256 byte registers, words are little endian */
+class SimulatedRegisterDevice : public SimulatedDevice {
+public:
+    u8 registers[256] = {};
+    /* Transfers per protocol and direction */
+    unsigned int reads[I2C_SMBUS_I2C_BLOCK_DATA + 1] = {};
+    unsigned int writes[I2C_SMBUS_I2C_BLOCK_DATA + 1] = {};
+    u8 pointer = 0;
+
+    int transfer(char read_write, u8 command, int protocol, union i2c_smbus_data *data) override;
+};
+
+class I801Simulator {
+public:
+    typedef void (*InterruptHandler)(void *context);
+
+    I801Simulator();
+
+    /*
+     * Makes @adapter run its transactions on the simulator. The interrupt
+     * handler defaults to i801_isr for it.
+     */
+    void setup(struct i801_adapter *adapter, unsigned int features);
+
+    void attach(u8 address, SimulatedDevice *device);
+    void detach(u8 address);
+
+    /* Client that accesses the device at @address through i801_access */
+    struct i2c_smbus_client client(u8 address, unsigned short flags = 0);
+
+    /* Virtual time in ns */
+    uint64_t now() const { return clock; }
+    /* Advances the clock, delivering the interrupts that are raised meanwhile */
+    void advance(uint64_t ns);
+
+    void setInterruptHandler(InterruptHandler handler, void *context);
+
+    /*
+     * A device sends a Host Notify message
+     * @return false if the controller didn't accept it, as the previous one
+     *         was not acknowledged yet
+     */
+    bool hostNotify(u8 address);
+
+    /*
+     * A device sends a Host Notify message once the clock reaches @time, also
+     * in the middle of a transaction. Messages the controller doesn't accept
+     * are counted in `notifies_lost`.
+     */
+    void scheduleHostNotify(u8 address, uint64_t time);
+
+    /*
+     * The device at @address asserts SMBALERT# until it answered a read of
+     * the Alert Response Address, which the simulator does on its behalf.
+     * @flag is the least significant bit of its response.
+     */
+    void assertAlert(u8 address, u8 flag = 0);
+    /* Whether the device at @address still asserts SMBALERT# */
+    bool alertAsserted(u8 address) const;
+
+    /*
+     * Makes @fault happen in @permille of 1000 transactions. Faults are drawn
+     * from a pseudo random sequence, so the same seed gives the same faults.
+     */
+    void setFault(enum SimulatedFault fault, unsigned int permille);
+    void setFaultSeed(uint32_t seed);
+
+    /* Statistics */
+    uint64_t faults[SIM_FAULTS] = {};
+    uint64_t transactions = 0;
+    uint64_t notifies_lost = 0;
+    uint64_t alert_responses = 0;
+    uint64_t interrupts = 0;
+    uint64_t bus_time = 0;
+
+    /* Register access, as used by the i801_ops */
+    void outb(u8 value, u16 port);
+    u8 inb(u16 port);
+    u8 configRead8(u16 offset);
+    void configWrite8(u8 value, u16 offset);
+    int waitStatus(struct i801_adapter *priv);
+
+private:
+    enum phase {
+        PHASE_IDLE,
+        /* The transaction completes at `event_time` */
+        PHASE_RUNNING,
+        /* Byte-by-byte: the next byte is transferred at `event_time` */
+        PHASE_BYTE,
+        /* Byte-by-byte: BYTE_DONE is set, the bus is stretched until the host clears it */
+        PHASE_BYTE_WAIT,
+    };
+
+    /* Answers reads of the Alert Response Address, lowest alerting address first */
+    class AlertResponder : public SimulatedDevice {
+    public:
+        bool asserted[128] = {};
+        u8 flags[128] = {};
+        uint64_t *responses = NULL;
+
+        bool lineAsserted() const;
+        int transfer(char read_write, u8 command, int protocol, union i2c_smbus_data *data) override;
+    };
+
+    struct i801_adapter *adapter = NULL;
+    SimulatedDevice *devices[128] = {};
+    AlertResponder alert_responder;
+    u8 config[256] = {};
+
+    InterruptHandler interrupt_handler = NULL;
+    void *interrupt_context = NULL;
+    bool in_interrupt = false;
+
+    uint64_t clock = 0;
+
+    unsigned int fault_permille[SIM_FAULTS] = {};
+    uint32_t fault_seed = 1;
+    /* The interrupts of the current transaction are lost */
+    bool drop_interrupt = false;
+    /* Another master holds the bus until then */
+    uint64_t host_busy_until = 0;
+
+    struct ScheduledNotify {
+        uint64_t time;
+        u8 address;
+    };
+    /* Scheduled Host Notify messages, ordered by time */
+    std::vector<ScheduledNotify> notifies;
+
+    /* Registers */
+    u8 hststs = 0;
+    u8 hstcnt = 0;
+    u8 hstcmd = 0;
+    u8 hstadd = 0;
+    u8 hstdat0 = 0;
+    u8 hstdat1 = 0;
+    u8 blkdat = 0;
+    u8 auxsts = 0;
+    u8 auxctl = 0;
+    u8 slvsts = 0;
+    u8 slvcmd = 0;
+    u8 ntfdadd = 0;
+    /* Block buffer of the E32B mode */
+    u8 buffer[I2C_SMBUS_BLOCK_MAX];
+    int buffer_index = 0;
+
+    /* Transaction in progress */
+    enum phase phase = PHASE_IDLE;
+    uint64_t event_time = 0;
+    u8 result = 0;
+    SimulatedDevice *device = NULL;
+    char read_write = 0;
+    u8 command = 0;
+    int protocol = 0;
+    union i2c_smbus_data data;
+    /* Byte-by-byte transfers */
+    int byte_index = 0;
+    int byte_count = 0;
+    bool length_on_wire = false;
+    bool last_byte = false;
+
+    bool faultHappens(enum SimulatedFault fault);
+    void start(u8 control);
+    void complete(u8 status, uint64_t delay);
+    void startByteByByte(int header_bytes);
+    void clearByteDone();
+    void fire();
+    bool interruptAsserted();
+    void deliverInterrupt();
+    static void defaultInterruptHandler(void *context);
+};
+
+#endif /* I801Simulator_hpp */
@@ -0,0 +1,34 @@
+/*
+ * JC42Simulator.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include "JC42Simulator.hpp"
+
+SimulatedJC42Sensor::SimulatedJC42Sensor(u16 manufacturer, u16 device) {
+    // event output and 0.25 degrees resolution
+    registers[JC42_REG_CAPABILITY] = 0x0017;
+    registers[JC42_REG_MANID] = manufacturer;
+    registers[JC42_REG_DEVICEID] = device;
+    setTemperature(40000);
+}
+
+void SimulatedJC42Sensor::setTemperature(int32_t millicelsius) {
+    int sixteenths = millicelsius * 16 / 1000;
+    registers[JC42_REG_TEMP] = (u16) sixteenths & JC42_TEMP_MASK;
+}
+
+int SimulatedJC42Sensor::transfer(char read_write, u8 command, int protocol, union i2c_smbus_data *data) {
+    if (protocol != I2C_SMBUS_WORD_DATA || command >= sizeof(registers) / sizeof(registers[0]))
+        return -ENXIO;
+
+    // words are sent MSB first, the wrong way round for SMBus
+    if (read_write == I2C_SMBUS_READ) {
+        reads++;
+        data->word = (u16) (registers[command] >> 8 | registers[command] << 8);
+    } else if (command == JC42_REG_CONFIG) {
+        registers[command] = (u16) (data->word >> 8 | data->word << 8);
+    }
+    return 0;
+}
@@ -0,0 +1,36 @@
+/*
+ * JC42Simulator.hpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#ifndef JC42Simulator_hpp
+#define JC42Simulator_hpp
+
+/*
+ * A JC-42.4 DIMM temperature sensor on the simulated bus, with 16 bit
+ * registers that are sent MSB first
+ */
+#include "I801Simulator.hpp"
+#include "JC42Sensor.hpp"
+
+/* Address of the sensor of the first module */
+#define SIM_JC42_ADDRESS        0x18
+
+#define SIM_JC42_MANID          0x0054  /* Microchip */
+#define SIM_JC42_DEVID          0x2201  /* MCP98244, revision 1 */
+
+class SimulatedJC42Sensor : public SimulatedDevice {
+public:
+    SimulatedJC42Sensor(u16 manufacturer = SIM_JC42_MANID, u16 device = SIM_JC42_DEVID);
+
+    /* Sets the temperature register to @millicelsius, in steps of 1/16 degrees */
+    void setTemperature(int32_t millicelsius);
+
+    int transfer(char read_write, u8 command, int protocol, union i2c_smbus_data *data) override;
+
+    u16 registers[8] = {};
+    uint64_t reads = 0;
+};
+
+#endif /* JC42Simulator_hpp */
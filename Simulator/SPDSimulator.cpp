@@ -0,0 +1,126 @@
+/*
+ * SPDSimulator.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include <string.h>
+#include "SPDSimulator.hpp"
+
+SimulatedEE1004PageSelect::SimulatedEE1004PageSelect() {
+    for (unsigned int i = 0; i < 2; i++) {
+        addresses[i].page_select = this;
+        addresses[i].page = i;
+    }
+}
+
+void SimulatedEE1004PageSelect::attach(I801Simulator *simulator) {
+    simulator->attach(EE1004_ADDR_SET_PAGE0, &addresses[0]);
+    simulator->attach(EE1004_ADDR_SET_PAGE1, &addresses[1]);
+}
+
+int SimulatedEE1004PageSelect::Address::transfer(char read_write, u8 command, int protocol, union i2c_smbus_data *data) {
+    // the data is ignored, reading returns no page like on some chipsets
+    if (read_write != I2C_SMBUS_WRITE || (protocol != I2C_SMBUS_BYTE && protocol != I2C_SMBUS_BYTE_DATA))
+        return -ENXIO;
+
+    page_select->page = page;
+    page_select->selects++;
+    return 0;
+}
+
+SimulatedSPDDevice::SimulatedSPDDevice(enum spd_device_type device_type, const SimulatedEE1004PageSelect *page_select)
+    : device_type(device_type), page_select(page_select) {
+}
+
+void SimulatedSPDDevice::fill(u8 memory_type, const char *part_number) {
+    size_t size = spd_size(memory_type);
+    size_t crc_offset = memory_type == SPD_MEMORY_TYPE_DDR5 ? SPD_DDR5_CRC_OFFSET : SPD_DDR4_CRC_OFFSET;
+    size_t manufacturing_offset = memory_type == SPD_MEMORY_TYPE_DDR5 ? SPD_DDR5_MANUFACTURING_OFFSET : SPD_DDR4_MANUFACTURING_OFFSET;
+    size_t part_number_offset = memory_type == SPD_MEMORY_TYPE_DDR5 ? SPD_DDR5_PART_NUMBER_OFFSET : SPD_DDR4_PART_NUMBER_OFFSET;
+    size_t part_number_len = memory_type == SPD_MEMORY_TYPE_DDR5 ? SPD_DDR5_PART_NUMBER_LEN : SPD_DDR4_PART_NUMBER_LEN;
+    uint16_t crc;
+
+    for (size_t i = 0; i < sizeof(contents); i++)
+        contents[i] = (u8) (i * 13 + 7);
+    contents[SPD_MEMORY_TYPE_OFFSET] = memory_type;
+    contents[SPD_MODULE_TYPE_OFFSET] = 0x02;
+    if (size < crc_offset + 2)
+        return;
+
+    crc = spd_crc16(contents, crc_offset);
+    contents[crc_offset] = crc & 0xff;
+    contents[crc_offset + 1] = crc >> 8;
+
+    // manufacturer 0x80ce, week 12 of 2021, serial number 0x12345678
+    u8 *manufacturing = &contents[manufacturing_offset];
+    manufacturing[SPD_MANUFACTURER_ID_OFFSET] = 0x80;
+    manufacturing[SPD_MANUFACTURER_ID_OFFSET + 1] = 0xce;
+    manufacturing[SPD_MANUFACTURING_DATE_OFFSET] = 0x21;
+    manufacturing[SPD_MANUFACTURING_DATE_OFFSET + 1] = 0x12;
+    manufacturing[SPD_SERIAL_NUMBER_OFFSET] = 0x12;
+    manufacturing[SPD_SERIAL_NUMBER_OFFSET + 1] = 0x34;
+    manufacturing[SPD_SERIAL_NUMBER_OFFSET + 2] = 0x56;
+    manufacturing[SPD_SERIAL_NUMBER_OFFSET + 3] = 0x78;
+    memset(&contents[part_number_offset], ' ', part_number_len);
+    memcpy(&contents[part_number_offset], part_number, strnlen(part_number, part_number_len));
+}
+
+int SimulatedSPDDevice::contentsOffset(u8 command) {
+    switch (device_type) {
+        case SPD_DEVICE_SPD5_HUB:
+            if (command < SPD5_NVM_OFFSET)
+                return -EINVAL;
+            return (int) (hub_page * SPD5_PAGE_SIZE + command - SPD5_NVM_OFFSET);
+        case SPD_DEVICE_EE1004:
+            return (int) (page_select->page * EE1004_PAGE_SIZE + command);
+        default:
+            return command;
+    }
+}
+
+int SimulatedSPDDevice::transfer(char read_write, u8 command, int protocol, union i2c_smbus_data *data) {
+    int offset;
+
+    switch (protocol) {
+        case I2C_SMBUS_BYTE_DATA:
+            if (device_type == SPD_DEVICE_SPD5_HUB && command < SPD5_NVM_OFFSET) {
+                if (read_write == I2C_SMBUS_WRITE) {
+                    if (command == SPD5_REG_LEGACY_MODE)
+                        hub_page = data->byte & 0x07;
+                    return 0;
+                }
+                if (command == SPD5_REG_TYPE_MSB)
+                    data->byte = SPD5_DEVICE_TYPE >> 8;
+                else if (command == SPD5_REG_TYPE_LSB)
+                    data->byte = SPD5_DEVICE_TYPE & 0xff;
+                else if (command == SPD5_REG_LEGACY_MODE)
+                    data->byte = (u8) hub_page;
+                else
+                    data->byte = 0;
+                return 0;
+            }
+            // EEPROMs are read only
+            if (read_write == I2C_SMBUS_WRITE)
+                return -ENXIO;
+            offset = contentsOffset(command);
+            if (offset < 0)
+                return offset;
+            data->byte = contents[offset];
+            return 0;
+        case I2C_SMBUS_I2C_BLOCK_DATA:
+            if (read_write == I2C_SMBUS_WRITE)
+                return -ENXIO;
+            offset = contentsOffset(command);
+            if (offset < 0)
+                return offset;
+            if (fail_from >= 0 && offset + data->block[0] > fail_from)
+                return -ENXIO;
+            block_reads++;
+            for (int i = 0; i < data->block[0]; i++)
+                data->block[1 + i] = contents[(offset + i) % SPD_MAX_SIZE];
+            return 0;
+        default:
+            return -EOPNOTSUPP;
+    }
+}
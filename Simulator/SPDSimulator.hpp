@@ -0,0 +1,73 @@
+/*
+ * SPDSimulator.hpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#ifndef SPDSimulator_hpp
+#define SPDSimulator_hpp
+
+/*
+ * The SPD devices of memory modules on the simulated bus: plain EEPROMs,
+ * EE1004 EEPROMs with the page select all of them share, and SPD5 hubs that
+ * show the selected page of their NVM in the upper half of their registers.
+ */
+#include "I801Simulator.hpp"
+#include "SPDReader.hpp"
+
+/* Address of the SPD device of the first module */
+#define SIM_SPD_ADDRESS         0x50
+
+/* The page select of the EE1004 EEPROMs on the bus, a write to either address selects its page */
+class SimulatedEE1004PageSelect {
+public:
+    SimulatedEE1004PageSelect();
+
+    void attach(I801Simulator *simulator);
+
+    unsigned int page = 0;
+    uint64_t selects = 0;
+
+private:
+    class Address : public SimulatedDevice {
+    public:
+        SimulatedEE1004PageSelect *page_select;
+        unsigned int page;
+
+        int transfer(char read_write, u8 command, int protocol, union i2c_smbus_data *data) override;
+    };
+
+    Address addresses[2];
+};
+
+class SimulatedSPDDevice : public SimulatedDevice {
+public:
+    /* @page_select The page select of the bus, only used by EE1004 EEPROMs */
+    SimulatedSPDDevice(enum spd_device_type device_type, const SimulatedEE1004PageSelect *page_select = NULL);
+
+    /*
+     * Fills the contents with those of a module of @memory_type, with a valid
+     * CRC and manufacturing information
+     */
+    void fill(u8 memory_type, const char *part_number);
+
+    int transfer(char read_write, u8 command, int protocol, union i2c_smbus_data *data) override;
+
+    u8 contents[SPD_MAX_SIZE] = {};
+    /* Reads of the contents from this offset on fail, a negative offset never fails */
+    int fail_from = -1;
+
+    /* Statistics */
+    uint64_t block_reads = 0;
+
+private:
+    enum spd_device_type device_type;
+    const SimulatedEE1004PageSelect *page_select;
+    /* SPD5 hub: the page selected in MR11 */
+    unsigned int hub_page = 0;
+
+    /* Offset in the contents of @command, or a negative errno if it is none */
+    int contentsOffset(u8 command);
+};
+
+#endif /* SPDSimulator_hpp */
@@ -0,0 +1,146 @@
+/*
+ * ELANContactTests.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include <string.h>
+#include "Test.hpp"
+#include "ELANContact.hpp"
+
+#define MAX_X   3052
+#define MAX_Y   1888
+
+static bool touch(struct elan_contact_state *contact, const struct elan_palm_configuration *config,
+                  unsigned int x, unsigned int y, unsigned int width, unsigned int pressure) {
+    elan_contact_touch(contact, x, y, 0);
+    contact->palm = elan_is_palm(contact, config, MAX_X, x, y, width, pressure);
+    return contact->palm;
+}
+
+TEST(finger_is_no_palm) {
+    struct elan_palm_configuration config;
+    struct elan_contact_state contact = {};
+    
+    elan_palm_defaults(&config);
+    for (int i = 0; i < 10; i++)
+        CHECK(!touch(&contact, &config, 1500 + i * 10, 900, 4, 120));
+    CHECK_EQUAL(10, contact.frames);
+}
+
+TEST(wide_contact_is_palm_until_lifted) {
+    struct elan_palm_configuration config;
+    struct elan_contact_state contact = {};
+    
+    elan_palm_defaults(&config);
+    CHECK(!touch(&contact, &config, 1500, 900, 4, 120));
+    CHECK(touch(&contact, &config, 1500, 900, ETP_PALM_WIDTH, 120));
+    // a palm does not turn back into a finger when it gets narrower
+    CHECK(touch(&contact, &config, 1500, 900, 4, 120));
+    
+    elan_contact_lift(&contact);
+    CHECK(!touch(&contact, &config, 1500, 900, 4, 120));
+    CHECK_EQUAL(1, contact.frames);
+}
+
+TEST(hard_press_is_palm) {
+    struct elan_palm_configuration config;
+    struct elan_contact_state contact = {};
+    
+    elan_palm_defaults(&config);
+    CHECK(!touch(&contact, &config, 1500, 900, ETP_PALM_EDGE_WIDTH - 1, ETP_PALM_PRESSURE));
+    CHECK(touch(&contact, &config, 1500, 900, ETP_PALM_EDGE_WIDTH, ETP_PALM_PRESSURE));
+}
+
+TEST(landing_at_edge) {
+    struct elan_palm_configuration config;
+    struct elan_contact_state left = {}, right = {}, bottom = {}, center = {};
+    
+    elan_palm_defaults(&config);
+    CHECK(touch(&left, &config, 10, 900, ETP_PALM_EDGE_WIDTH, 100));
+    CHECK(touch(&right, &config, MAX_X - 10, 900, ETP_PALM_EDGE_WIDTH, 100));
+    CHECK(touch(&bottom, &config, 1500, 10, ETP_PALM_EDGE_WIDTH, 100));
+    CHECK(!touch(&center, &config, 1500, 900, ETP_PALM_EDGE_WIDTH, 100));
+    
+    // only the landing position counts, a finger moving into the zone stays a finger
+    CHECK(!touch(&center, &config, 10, 900, ETP_PALM_EDGE_WIDTH, 100));
+}
+
+TEST(edge_zone_wider_than_touchpad) {
+    struct elan_palm_configuration config;
+    struct elan_contact_state contact = {};
+    
+    elan_palm_defaults(&config);
+    config.edge_zone = MAX_X + 1;
+    CHECK(touch(&contact, &config, MAX_X / 2, 900, ETP_PALM_EDGE_WIDTH, 100));
+}
+
+TEST(adjust_pressure) {
+    CHECK_EQUAL(110, elan_adjust_pressure(100, 10));
+    CHECK_EQUAL(ETP_MAX_PRESSURE, elan_adjust_pressure(250, 10));
+    CHECK_EQUAL(0, elan_adjust_pressure(5, -10));
+}
+
+/* Touchpad report with a single finger in @slot */
+static void singleFinger(uint8_t *report, int slot, unsigned int x, unsigned int y) {
+    uint8_t *finger = &report[ETP_FINGER_DATA_OFFSET];
+    
+    memset(report, 0, ETP_MAX_REPORT_LEN);
+    report[ETP_REPORT_ID_OFFSET] = ETP_REPORT_ID;
+    report[ETP_TOUCH_INFO_OFFSET] = 1 << (3 + slot);
+    finger[0] = ((x >> 4) & 0xf0) | ((y >> 8) & 0x0f);
+    finger[1] = x & 0xff;
+    finger[2] = y & 0xff;
+    finger[3] = 0x11;
+    finger[4] = 40;
+}
+
+TEST(position_jump) {
+    struct elan_contact_state contacts[ETP_MAX_FINGERS] = {};
+    uint8_t report[ETP_MAX_REPORT_LEN];
+    
+    singleFinger(report, 1, 100, 100);
+    CHECK_EQUAL(ETP_REPORT_OK, elan_validate_report(report, contacts, MAX_X, MAX_Y));
+    singleFinger(report, 1, 200, 150);
+    CHECK_EQUAL(ETP_REPORT_OK, elan_validate_report(report, contacts, MAX_X, MAX_Y));
+    
+    // the jump is rejected, but the finger stays there, so the next frame is accepted
+    singleFinger(report, 1, 2500, 150);
+    CHECK_EQUAL(ETP_REPORT_POSITION_JUMP, elan_validate_report(report, contacts, MAX_X, MAX_Y));
+    singleFinger(report, 1, 2510, 150);
+    CHECK_EQUAL(ETP_REPORT_OK, elan_validate_report(report, contacts, MAX_X, MAX_Y));
+}
+
+TEST(position_jump_after_lift) {
+    struct elan_contact_state contacts[ETP_MAX_FINGERS] = {};
+    uint8_t report[ETP_MAX_REPORT_LEN];
+    
+    singleFinger(report, 0, 100, 100);
+    CHECK_EQUAL(ETP_REPORT_OK, elan_validate_report(report, contacts, MAX_X, MAX_Y));
+    
+    // the finger is lifted and lands on the other side of the touchpad
+    memset(report, 0, ETP_MAX_REPORT_LEN);
+    report[ETP_REPORT_ID_OFFSET] = ETP_REPORT_ID;
+    CHECK_EQUAL(ETP_REPORT_OK, elan_validate_report(report, contacts, MAX_X, MAX_Y));
+    singleFinger(report, 0, 2900, 1700);
+    CHECK_EQUAL(ETP_REPORT_OK, elan_validate_report(report, contacts, MAX_X, MAX_Y));
+}
+
+TEST(reset_references) {
+    struct elan_contact_state contacts[ETP_MAX_FINGERS] = {};
+    uint8_t report[ETP_MAX_REPORT_LEN];
+    
+    singleFinger(report, 2, 100, 100);
+    CHECK_EQUAL(ETP_REPORT_OK, elan_validate_report(report, contacts, MAX_X, MAX_Y));
+    
+    // frames were skipped, the finger may have moved anywhere meanwhile
+    elan_reset_references(contacts);
+    singleFinger(report, 2, 2900, 1700);
+    CHECK_EQUAL(ETP_REPORT_OK, elan_validate_report(report, contacts, MAX_X, MAX_Y));
+    
+    // a rejected report resets them as well
+    report[ETP_TOUCH_INFO_OFFSET] |= 1 << 3;
+    CHECK_EQUAL(ETP_REPORT_BAD_FINGER_COUNT, elan_validate_report(report, contacts, MAX_X, MAX_Y));
+    singleFinger(report, 2, 100, 100);
+    CHECK_EQUAL(ETP_REPORT_OK, elan_validate_report(report, contacts, MAX_X, MAX_Y));
+}
@@ -0,0 +1,110 @@
+/*
+ * ELANFirmwareTests.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include <string.h>
+#include <vector>
+#include "Test.hpp"
+#include "ELANFirmware.hpp"
+
+static const u8 signature[ETP_FW_SIGNATURE_SIZE] = { 0xAA, 0x55, 0xCC, 0x33, 0xFF, 0xFF };
+
+/* Image for @info with the application starting at @iap_start_addr */
+static std::vector<u8> makeImage(const struct elan_fw_info *info, u16 iap_start_addr) {
+    std::vector<u8> image((size_t) info->signature_address + ETP_FW_SIGNATURE_SIZE);
+    
+    for (size_t i = 0; i < image.size(); i++)
+        image[i] = (u8) i;
+    image[ETP_IAP_START_ADDR * 2] = iap_start_addr & 0xff;
+    image[ETP_IAP_START_ADDR * 2 + 1] = iap_start_addr >> 8;
+    memcpy(&image[info->signature_address], signature, ETP_FW_SIGNATURE_SIZE);
+    return image;
+}
+
+TEST(fwinfo) {
+    struct elan_fw_info info;
+    
+    CHECK_EQUAL(0, elan_get_fwinfo(0x08, 0, &info));
+    CHECK_EQUAL(512, info.validpage_count);
+    CHECK_EQUAL(512 * 64 - 6, info.signature_address);
+    CHECK_EQUAL(ETP_FW_PAGE_SIZE, info.page_size);
+    
+    CHECK_EQUAL(0, elan_get_fwinfo(0x0B, 1, &info));
+    CHECK_EQUAL(768, info.validpage_count);
+    CHECK_EQUAL(ETP_FW_PAGE_SIZE, info.page_size);
+    
+    CHECK_EQUAL(0, elan_get_fwinfo(0x13, 0, &info));
+    CHECK_EQUAL(2048, info.validpage_count);
+    CHECK_EQUAL(2048 * 64 - 6, info.signature_address);
+}
+
+TEST(fwinfo_large_pages) {
+    struct elan_fw_info info;
+    
+    // the signature address stays in units of 64 byte pages
+    CHECK_EQUAL(0, elan_get_fwinfo(0x0D, 1, &info));
+    CHECK_EQUAL(448, info.validpage_count);
+    CHECK_EQUAL(896 * 64 - 6, info.signature_address);
+    CHECK_EQUAL(ETP_FW_PAGE_SIZE_128, info.page_size);
+    
+    CHECK_EQUAL(0, elan_get_fwinfo(0x15, 2, &info));
+    CHECK_EQUAL(128, info.validpage_count);
+    CHECK_EQUAL(ETP_FW_PAGE_SIZE_512, info.page_size);
+    
+    CHECK_EQUAL(0, elan_get_fwinfo(0x15, 1, &info));
+    CHECK_EQUAL(ETP_FW_PAGE_SIZE_128, info.page_size);
+}
+
+TEST(fwinfo_unknown_ic_type) {
+    struct elan_fw_info info;
+    
+    CHECK_EQUAL(-ENXIO, elan_get_fwinfo(0x01, 0, &info));
+    CHECK_EQUAL(-ENXIO, elan_get_fwinfo(0x12, 0, &info));
+    CHECK_EQUAL(0, info.validpage_count);
+    CHECK_EQUAL(0, info.page_size);
+}
+
+TEST(check_firmware) {
+    struct elan_fw_info info;
+    int boot_page_count = 0;
+    
+    elan_get_fwinfo(0x08, 0, &info);
+    std::vector<u8> image = makeImage(&info, 0x0400);
+    CHECK_EQUAL(0, elan_check_firmware(image.data(), image.size(), &info, &boot_page_count));
+    CHECK_EQUAL(0x0400 * 2 / ETP_FW_PAGE_SIZE, boot_page_count);
+}
+
+TEST(check_firmware_other_ic_type) {
+    struct elan_fw_info small, large;
+    int boot_page_count;
+    
+    elan_get_fwinfo(0x08, 0, &small);
+    elan_get_fwinfo(0x09, 0, &large);
+    
+    // too short for the device
+    std::vector<u8> image = makeImage(&small, 0x0400);
+    CHECK_EQUAL(-EINVAL, elan_check_firmware(image.data(), image.size(), &large, &boot_page_count));
+    
+    // long enough, but the signature is not where the device expects it
+    image = makeImage(&large, 0x0400);
+    CHECK_EQUAL(-EINVAL, elan_check_firmware(image.data(), image.size(), &small, &boot_page_count));
+}
+
+TEST(check_firmware_bad_image) {
+    struct elan_fw_info info;
+    int boot_page_count;
+    
+    elan_get_fwinfo(0x08, 0, &info);
+    std::vector<u8> image = makeImage(&info, 0x0400);
+    CHECK_EQUAL(-EINVAL, elan_check_firmware(NULL, 0, &info, &boot_page_count));
+    CHECK_EQUAL(-EINVAL, elan_check_firmware(image.data(), image.size() - 1, &info, &boot_page_count));
+    
+    image[info.signature_address] ^= 1;
+    CHECK_EQUAL(-EINVAL, elan_check_firmware(image.data(), image.size(), &info, &boot_page_count));
+    
+    // the application can't start after the last page
+    image = makeImage(&info, info.validpage_count * ETP_FW_PAGE_SIZE / 2);
+    CHECK_EQUAL(-EINVAL, elan_check_firmware(image.data(), image.size(), &info, &boot_page_count));
+}
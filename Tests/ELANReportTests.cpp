@@ -0,0 +1,171 @@
+/*
+ * ELANReportTests.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include <string.h>
+#include "Test.hpp"
+#include "ELANReport.hpp"
+
+#define MAX_X   3052
+#define MAX_Y   1888
+
+static void setFinger(uint8_t *report, int slot, int record, unsigned int x, unsigned int y, unsigned int pressure) {
+    uint8_t *finger = &report[ETP_FINGER_DATA_OFFSET + record * ETP_FINGER_DATA_LEN];
+    
+    report[ETP_TOUCH_INFO_OFFSET] |= 1 << (3 + slot);
+    finger[0] = ((x >> 4) & 0xf0) | ((y >> 8) & 0x0f);
+    finger[1] = x & 0xff;
+    finger[2] = y & 0xff;
+    finger[3] = 0x21;
+    finger[4] = pressure;
+}
+
+TEST(decode_finger) {
+    uint8_t report[ETP_MAX_REPORT_LEN] = {};
+    struct elan_finger finger;
+    
+    report[ETP_REPORT_ID_OFFSET] = ETP_REPORT_ID;
+    setFinger(report, 0, 0, 3000, 1800, 77);
+    elan_decode_finger(&report[ETP_FINGER_DATA_OFFSET], &finger);
+    
+    CHECK_EQUAL(3000, finger.pos_x);
+    CHECK_EQUAL(1800, finger.pos_y);
+    CHECK_EQUAL(1, finger.mk_x);
+    CHECK_EQUAL(2, finger.mk_y);
+    CHECK_EQUAL(77, finger.pressure);
+    CHECK(elan_finger_valid(report, 0));
+    CHECK(!elan_finger_valid(report, 1));
+}
+
+TEST(decode_trackpoint) {
+    uint8_t report[ETP_MAX_REPORT_LEN] = {};
+    uint8_t *packet = &report[ETP_REPORT_ID_OFFSET + 1];
+    struct elan_trackpoint trackpoint;
+    
+    report[ETP_REPORT_ID_OFFSET] = ETP_TP_REPORT_ID;
+    packet[0] = 0x05;
+    packet[1] = 0x80;
+    packet[2] = 0x80;
+    packet[3] = 0x06;
+    packet[4] = 12;
+    packet[5] = 3;
+    elan_decode_trackpoint(report, &trackpoint);
+    
+    CHECK_EQUAL(0x05, trackpoint.buttons);
+    CHECK_EQUAL(12, trackpoint.x);
+    CHECK_EQUAL(-3, trackpoint.y);
+    
+    // without the motion marker only the buttons are valid
+    packet[3] = 0x00;
+    elan_decode_trackpoint(report, &trackpoint);
+    CHECK_EQUAL(0, trackpoint.x);
+    CHECK_EQUAL(0, trackpoint.y);
+}
+
+TEST(check_fingers) {
+    uint8_t report[ETP_MAX_REPORT_LEN] = {};
+    
+    report[ETP_REPORT_ID_OFFSET] = ETP_REPORT_ID;
+    setFinger(report, 1, 0, 100, 200, 30);
+    setFinger(report, 3, 1, MAX_X, MAX_Y, 30);
+    CHECK_EQUAL(ETP_REPORT_OK, elan_check_fingers(report, MAX_X, MAX_Y));
+    
+    setFinger(report, 4, 2, MAX_X + 1, 10, 30);
+    CHECK_EQUAL(ETP_REPORT_BAD_FINGER_DATA, elan_check_fingers(report, MAX_X, MAX_Y));
+}
+
+TEST(check_finger_count) {
+    uint8_t report[ETP_MAX_REPORT_LEN] = {};
+    
+    report[ETP_REPORT_ID_OFFSET] = ETP_REPORT_ID;
+    setFinger(report, 0, 0, 100, 200, 30);
+    setFinger(report, 2, 1, 300, 400, 30);
+    CHECK_EQUAL(ETP_REPORT_OK, elan_check_fingers(report, MAX_X, MAX_Y));
+    
+    // a finger in the bitmap without a record
+    report[ETP_TOUCH_INFO_OFFSET] |= 1 << (3 + 4);
+    CHECK_EQUAL(ETP_REPORT_BAD_FINGER_COUNT, elan_check_fingers(report, MAX_X, MAX_Y));
+    
+    // a record without a finger in the bitmap
+    report[ETP_TOUCH_INFO_OFFSET] &= ~(1 << (3 + 4));
+    setFinger(report, 2, 2, 500, 600, 30);
+    CHECK_EQUAL(ETP_REPORT_BAD_FINGER_COUNT, elan_check_fingers(report, MAX_X, MAX_Y));
+}
+
+TEST(hover) {
+    uint8_t report[ETP_MAX_REPORT_LEN] = {};
+    
+    CHECK(!elan_is_hovering(report));
+    report[ETP_HOVER_INFO_OFFSET] = ETP_HOVER_EVENT;
+    CHECK(elan_is_hovering(report));
+}
+
+/* A finger approaching, touching and leaving the touchpad, as recorded from a touchpad */
+static const uint8_t hover_sequence[][ETP_MAX_REPORT_LEN] = {
+    /* hovering above slot 1 */
+    { 0x00, 0x00, 0x5d, 0x10, 0x52, 0xb4, 0x08, 0x11, 0x00,
+      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40 },
+    /* touching */
+    { 0x00, 0x00, 0x5d, 0x10, 0x52, 0xb4, 0x0a, 0x33, 0x4e },
+    /* lifted, hovering again */
+    { 0x00, 0x00, 0x5d, 0x10, 0x52, 0xb9, 0x0c, 0x11, 0x00,
+      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40 },
+    /* out of range */
+    { 0x00, 0x00, 0x5d, 0x00 },
+};
+
+TEST(hover_sequence) {
+    struct elan_finger finger;
+    
+    CHECK(elan_finger_hovering(hover_sequence[0], 1));
+    // only the slot of the hovering finger is in range
+    for (int i = 0; i < ETP_MAX_FINGERS; i++) {
+        CHECK_EQUAL(i == 1, elan_finger_valid(hover_sequence[0], i));
+        CHECK_EQUAL(i == 1, elan_finger_hovering(hover_sequence[0], i));
+    }
+    elan_decode_finger(&hover_sequence[0][ETP_FINGER_DATA_OFFSET], &finger);
+    CHECK_EQUAL(0x5b4, finger.pos_x);
+    CHECK_EQUAL(0x208, finger.pos_y);
+    CHECK_EQUAL(0, finger.pressure);
+    CHECK_EQUAL(ETP_REPORT_OK, elan_check_fingers(hover_sequence[0], MAX_X, MAX_Y));
+    
+    CHECK(elan_finger_valid(hover_sequence[1], 1));
+    CHECK(!elan_finger_hovering(hover_sequence[1], 1));
+    elan_decode_finger(&hover_sequence[1][ETP_FINGER_DATA_OFFSET], &finger);
+    CHECK_EQUAL(0x4e, finger.pressure);
+    
+    CHECK(elan_finger_hovering(hover_sequence[2], 1));
+    
+    for (int i = 0; i < ETP_MAX_FINGERS; i++)
+        CHECK(!elan_finger_valid(hover_sequence[3], i) && !elan_finger_hovering(hover_sequence[3], i));
+    CHECK(!elan_is_hovering(hover_sequence[3]));
+}
+
+TEST(frame_filter) {
+    uint8_t report[ETP_MAX_REPORT_LEN] = {};
+    struct elan_frame_filter filter = {};
+    const uint64_t keep_alive = 100;
+    
+    report[ETP_REPORT_ID_OFFSET] = ETP_REPORT_ID;
+    setFinger(report, 0, 0, 1000, 1000, 50);
+    
+    // a resting finger is only dispatched again after the keep alive interval
+    CHECK(elan_frame_dispatch(&filter, report, 1, 1000, keep_alive));
+    CHECK(!elan_frame_dispatch(&filter, report, 1, 1008, keep_alive));
+    CHECK(!elan_frame_dispatch(&filter, report, 1, 1099, keep_alive));
+    CHECK(elan_frame_dispatch(&filter, report, 1, 1100, keep_alive));
+    
+    // movement is dispatched right away
+    setFinger(report, 0, 0, 1001, 1000, 50);
+    CHECK(elan_frame_dispatch(&filter, report, 1, 1108, keep_alive));
+    
+    // a contact that stops touching is never suppressed, even with an unchanged frame
+    CHECK(elan_frame_dispatch(&filter, report, 0, 1116, keep_alive));
+    
+    // without keep alive every frame is dispatched
+    CHECK(elan_frame_dispatch(&filter, report, 0, 1124, 0));
+    CHECK_EQUAL(5, filter.dispatched);
+    CHECK_EQUAL(2, filter.suppressed);
+}
@@ -0,0 +1,212 @@
+/*
+ * HostNotifyTests.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include <string.h>
+#include <vector>
+#include "Test.hpp"
+#include "ELANContact.hpp"
+#include "ELANSimulator.hpp"
+#include "ReportTrace.hpp"
+
+#define TOUCHPAD_ADDRESS    0x15
+#define REPORT_COMMAND      0x00
+#define FRAME_COUNT         200
+#define FRAME_INTERVAL_NS   8000000ULL
+
+/* Context of a single Host Notify, like the one the nub passes to its thread */
+struct Notify {
+    u8 address;
+    uint64_t interrupt;
+};
+
+/*
+ * The path of a touchpad report through the kext: the filter interrupt stamps
+ * the Host Notify, the client thread is scheduled some time later and reads
+ * the report over the bus.
+ */
+struct Pipeline {
+    I801Simulator simulator;
+    struct i801_adapter adapter;
+    SimulatedRegisterDevice touchpad;
+    struct i2c_smbus_client client;
+    std::vector<Notify> pending;
+    /* the single timestamp the nub used to keep for all notifications */
+    uint64_t last_notify = 0;
+    uint32_t random = 1;
+
+    Pipeline() {
+        simulator.setup(&adapter, FEATURE_IRQ | FEATURE_BLOCK_BUFFER | FEATURE_HOST_NOTIFY);
+        simulator.setInterruptHandler(&Pipeline::filterInterrupt, this);
+        simulator.outb(SMBSLVCMD_HST_NTFY_INTREN, SMBSLVCMD(&adapter));
+        simulator.attach(TOUCHPAD_ADDRESS, &touchpad);
+        client = simulator.client(TOUCHPAD_ADDRESS);
+
+        touchpad.registers[REPORT_COMMAND] = REPORT_TRACE_REPORT_LEN - 2;
+        for (int i = 1; i < REPORT_TRACE_REPORT_LEN; i++)
+            touchpad.registers[i] = (u8) i;
+    }
+
+    static void filterInterrupt(void *context) {
+        Pipeline *pipeline = static_cast<Pipeline*>(context);
+        struct i801_adapter *adapter = &pipeline->adapter;
+
+        if (adapter->inb_p(SMBSLVSTS(adapter)) & SMBSLVSTS_HST_NTFY_STS) {
+            Notify notify = { (u8) (adapter->inb_p(SMBNTFDADD(adapter)) >> 1), pipeline->simulator.now() };
+            pipeline->pending.push_back(notify);
+            pipeline->last_notify = notify.interrupt;
+            adapter->outb_p(SMBSLVSTS_HST_NTFY_STS, SMBSLVSTS(adapter));
+        }
+        i801_isr(adapter);
+    }
+
+    /* Scheduling latency of the client thread between 0.2 and 10 ms */
+    uint64_t schedulingDelay() {
+        random = random * 1103515245 + 12345;
+        return 200000 + (random >> 8) % 9800000;
+    }
+};
+
+/* Runs all frames through the pipeline, with and without a context per notification */
+static void replay(Pipeline *pipeline, std::vector<report_trace_record> *records, std::vector<uint64_t> *shared) {
+    for (int i = 0; i < FRAME_COUNT; i++)
+        pipeline->simulator.scheduleHostNotify(TOUCHPAD_ADDRESS, 1000000 + i * FRAME_INTERVAL_NS);
+
+    while (records->size() < FRAME_COUNT) {
+        if (pipeline->pending.empty()) {
+            pipeline->simulator.advance(100000);
+            continue;
+        }
+        Notify notify = pipeline->pending.front();
+        pipeline->pending.erase(pipeline->pending.begin());
+
+        pipeline->simulator.advance(pipeline->schedulingDelay());
+        shared->push_back(pipeline->last_notify);
+
+        report_trace_record record = {};
+        u8 report[I2C_SMBUS_BLOCK_MAX];
+        CHECK_EQUAL(REPORT_TRACE_REPORT_LEN - 2, i2c_smbus_read_block_data(&pipeline->client, REPORT_COMMAND, report));
+        record.notify_ns = notify.interrupt;
+        record.read_ns = pipeline->simulator.now();
+        memcpy(record.report + 2, report, REPORT_TRACE_REPORT_LEN - 2);
+        records->push_back(record);
+    }
+}
+
+TEST(interrupt_timestamps_keep_frame_interval) {
+    Pipeline pipeline;
+    std::vector<report_trace_record> records;
+    std::vector<uint64_t> shared;
+
+    replay(&pipeline, &records, &shared);
+    CHECK_EQUAL(0, pipeline.simulator.notifies_lost);
+
+    // replay the exported trace like elan-replay does
+    std::vector<uint8_t> trace(sizeof(report_trace_header) + records.size() * sizeof(report_trace_record));
+    report_trace_header header = { REPORT_TRACE_MAGIC, REPORT_TRACE_VERSION, sizeof(report_trace_record), (uint32_t) records.size(), 0 };
+    memcpy(trace.data(), &header, sizeof(header));
+    memcpy(trace.data() + sizeof(header), records.data(), records.size() * sizeof(report_trace_record));
+
+    uint32_t count = 0;
+    const report_trace_record *parsed = report_trace_parse(trace.data(), trace.size(), &count);
+    CHECK(parsed);
+    CHECK_EQUAL(FRAME_COUNT, count);
+
+    uint64_t read_min = UINT64_MAX, read_max = 0;
+    for (uint32_t i = 1; i < count; i++) {
+        CHECK_EQUAL(FRAME_INTERVAL_NS, parsed[i].notify_ns - parsed[i - 1].notify_ns);
+
+        uint64_t read_interval = parsed[i].read_ns - parsed[i - 1].read_ns;
+        if (read_interval < read_min)
+            read_min = read_interval;
+        if (read_interval > read_max)
+            read_max = read_interval;
+    }
+
+    // stamped after the read, the intervals vary by the scheduling latency
+    CHECK(read_max - read_min > FRAME_INTERVAL_NS / 2);
+}
+
+TEST(shared_timestamp_is_overwritten) {
+    Pipeline pipeline;
+    std::vector<report_trace_record> records;
+    std::vector<uint64_t> shared;
+
+    replay(&pipeline, &records, &shared);
+
+    // when the next notification arrives before the thread runs, its time is reported for both frames
+    int wrong = 0;
+    for (size_t i = 0; i < records.size(); i++) {
+        if (shared[i] != records[i].notify_ns)
+            wrong++;
+    }
+    CHECK(wrong > 0);
+}
+
+TEST(notify_during_transfer) {
+    Pipeline pipeline;
+    u8 report[I2C_SMBUS_BLOCK_MAX];
+
+    // the block read takes about 3 ms, the notification arrives in its middle
+    pipeline.simulator.scheduleHostNotify(TOUCHPAD_ADDRESS, 1000000);
+    CHECK_EQUAL(REPORT_TRACE_REPORT_LEN - 2, i2c_smbus_read_block_data(&pipeline.client, REPORT_COMMAND, report));
+    CHECK(pipeline.simulator.now() > 1000000);
+    CHECK_EQUAL(1, pipeline.pending.size());
+    CHECK_EQUAL(TOUCHPAD_ADDRESS, pipeline.pending[0].address);
+    CHECK_EQUAL(1000000, pipeline.pending[0].interrupt);
+}
+
+static unsigned int touchpad_notifies;
+
+static void countNotify(void *context) {
+    struct i801_adapter *adapter = static_cast<struct i801_adapter*>(context);
+
+    if (adapter->inb_p(SMBSLVSTS(adapter)) & SMBSLVSTS_HST_NTFY_STS) {
+        touchpad_notifies++;
+        adapter->outb_p(SMBSLVSTS_HST_NTFY_STS, SMBSLVSTS(adapter));
+    }
+    i801_isr(adapter);
+}
+
+TEST(simulated_touchpad_swipe) {
+    I801Simulator simulator;
+    struct i801_adapter adapter;
+    SimulatedELANTouchpad touchpad(&simulator);
+    struct elan_contact_state contacts[ETP_MAX_FINGERS] = {};
+    u8 report[ETP_MAX_REPORT_LEN] = {};
+    unsigned int touching = 0, lifted = 0, last_x = 0;
+
+    simulator.setup(&adapter, FEATURE_IRQ | FEATURE_BLOCK_BUFFER | FEATURE_HOST_NOTIFY);
+    simulator.outb(SMBSLVCMD_HST_NTFY_INTREN, SMBSLVCMD(&adapter));
+    simulator.attach(SIM_ELAN_ADDRESS, &touchpad);
+    simulator.setInterruptHandler(countNotify, &adapter);
+    struct i2c_smbus_client client = simulator.client(SIM_ELAN_ADDRESS);
+
+    touchpad.queueSwipe(FRAME_COUNT, 1000000, FRAME_INTERVAL_NS);
+    for (int i = 0; i <= FRAME_COUNT; i++) {
+        // every frame is announced once, and read before the next one is ready
+        touchpad_notifies = 0;
+        simulator.advance(1000000 + i * FRAME_INTERVAL_NS - simulator.now());
+        CHECK_EQUAL(1, touchpad_notifies);
+
+        CHECK_EQUAL(SIM_ELAN_BLOCK_LEN, i2c_smbus_read_block_data(&client, SIM_ELAN_PACKET_QUERY, &report[2]));
+        CHECK_EQUAL(ETP_REPORT_OK, elan_validate_report(report, contacts, SIM_ELAN_MAX_X, SIM_ELAN_MAX_Y));
+        if (!elan_finger_valid(report, 0)) {
+            lifted++;
+            continue;
+        }
+
+        struct elan_finger finger;
+        elan_decode_finger(&report[ETP_FINGER_DATA_OFFSET], &finger);
+        CHECK(finger.pos_x != last_x);
+        last_x = finger.pos_x;
+        touching++;
+    }
+
+    CHECK_EQUAL(FRAME_COUNT, touching);
+    CHECK_EQUAL(1, lifted);
+    CHECK_EQUAL(0, touchpad.stale_queries);
+    CHECK_EQUAL(0, simulator.notifies_lost);
+}
@@ -0,0 +1,273 @@
+/*
+ * I801Tests.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include <string.h>
+#include "Test.hpp"
+#include "I801Simulator.hpp"
+
+#define DEVICE_ADDRESS  0x50
+
+/* The configuration of the kext, and the fallbacks of controllers without the features */
+#define FEATURES_KEXT           (FEATURE_IRQ | FEATURE_BLOCK_BUFFER | FEATURE_I2C_BLOCK_READ | FEATURE_SMBUS_PEC)
+#define FEATURES_IRQ_BYTES      (FEATURE_IRQ | FEATURE_I2C_BLOCK_READ)
+#define FEATURES_POLL_BUFFER    (FEATURE_BLOCK_BUFFER | FEATURE_I2C_BLOCK_READ)
+#define FEATURES_POLL_BYTES     (FEATURE_I2C_BLOCK_READ)
+
+struct Bus {
+    I801Simulator simulator;
+    struct i801_adapter adapter;
+    SimulatedRegisterDevice device;
+    struct i2c_smbus_client client;
+    
+    Bus(unsigned int features) {
+        simulator.setup(&adapter, features);
+        simulator.attach(DEVICE_ADDRESS, &device);
+        client = simulator.client(DEVICE_ADDRESS);
+        for (int i = 0; i < 256; i++)
+            device.registers[i] = (u8) (i * 7 + 3);
+    }
+};
+
+static void checkProtocols(unsigned int features) {
+    Bus bus(features);
+    u8 values[I2C_SMBUS_BLOCK_MAX];
+    u8 block[I2C_SMBUS_BLOCK_MAX];
+    
+    CHECK_EQUAL(0, i2c_smbus_write_byte_data(&bus.client, 0x10, 0xab));
+    CHECK_EQUAL(0xab, bus.device.registers[0x10]);
+    CHECK_EQUAL(0xab, i2c_smbus_read_byte_data(&bus.client, 0x10));
+    
+    CHECK_EQUAL(0, i2c_smbus_write_word_data(&bus.client, 0x20, 0x1234));
+    CHECK_EQUAL(0x34, bus.device.registers[0x20]);
+    CHECK_EQUAL(0x1234, i2c_smbus_read_word_data(&bus.client, 0x20));
+    
+    CHECK_EQUAL(0, i2c_smbus_write_byte(&bus.client, 0x30));
+    CHECK_EQUAL(bus.device.registers[0x30], i2c_smbus_read_byte(&bus.client));
+    
+    CHECK_EQUAL(0, i801_access(&bus.adapter, DEVICE_ADDRESS, 0, I2C_SMBUS_WRITE, 0, I2C_SMBUS_QUICK, NULL));
+    CHECK_EQUAL(1, bus.device.writes[I2C_SMBUS_QUICK]);
+    
+    for (int length = 1; length <= I2C_SMBUS_BLOCK_MAX; length += 7) {
+        for (int i = 0; i < length; i++)
+            block[i] = (u8) (0xc0 + i + length);
+        
+        CHECK_EQUAL(0, i2c_smbus_write_block_data(&bus.client, 0x40, length, block));
+        CHECK_EQUAL(length, bus.device.registers[0x40]);
+        memset(values, 0, sizeof(values));
+        CHECK_EQUAL(length, i2c_smbus_read_block_data(&bus.client, 0x40, values));
+        CHECK(!memcmp(block, values, length));
+    }
+    
+    for (int length = 1; length <= I2C_SMBUS_BLOCK_MAX; length += 5) {
+        memset(values, 0, sizeof(values));
+        CHECK_EQUAL(length, i2c_smbus_read_i2c_block_data(&bus.client, 0x80, length, values));
+        CHECK(!memcmp(&bus.device.registers[0x80], values, length));
+    }
+    
+    // the I2C block write needs I2C_EN, which must be restored afterwards
+    union i2c_smbus_data data;
+    data.block[0] = 3;
+    data.block[1] = 1;
+    data.block[2] = 2;
+    data.block[3] = 3;
+    CHECK_EQUAL(0, i801_access(&bus.adapter, DEVICE_ADDRESS, 0, I2C_SMBUS_WRITE, 0xf0, I2C_SMBUS_I2C_BLOCK_DATA, &data));
+    CHECK_EQUAL(1, bus.device.writes[I2C_SMBUS_I2C_BLOCK_DATA]);
+    CHECK_EQUAL(3, bus.device.registers[0xf2]);
+    CHECK_EQUAL(SMBHSTCFG_HST_EN, bus.simulator.configRead8(SMBHSTCFG));
+    
+    struct i2c_smbus_client missing = bus.simulator.client(0x51);
+    CHECK_EQUAL(-ENXIO, i2c_smbus_read_byte_data(&missing, 0));
+    CHECK_EQUAL(-ENXIO, i2c_smbus_read_block_data(&missing, 0, values));
+    CHECK_EQUAL(-ENXIO, i2c_smbus_read_i2c_block_data(&missing, 0, 4, values));
+    
+    // a failed transfer must not affect the next one
+    CHECK_EQUAL(0xab, i2c_smbus_read_byte_data(&bus.client, 0x10));
+}
+
+TEST(protocols_interrupt_block_buffer) {
+    checkProtocols(FEATURES_KEXT);
+}
+
+TEST(protocols_interrupt_byte_by_byte) {
+    checkProtocols(FEATURES_IRQ_BYTES);
+}
+
+TEST(protocols_polling_block_buffer) {
+    checkProtocols(FEATURES_POLL_BUFFER);
+}
+
+TEST(protocols_polling_byte_by_byte) {
+    checkProtocols(FEATURES_POLL_BYTES);
+}
+
+TEST(interrupt_per_transfer) {
+    Bus bus(FEATURES_KEXT);
+    u8 values[I2C_SMBUS_BLOCK_MAX];
+    
+    i2c_smbus_read_byte_data(&bus.client, 0);
+    CHECK_EQUAL(1, bus.simulator.interrupts);
+    
+    // the block buffer completes a block with one interrupt, byte-by-byte takes one per byte
+    bus.device.registers[0x40] = 8;
+    i2c_smbus_read_block_data(&bus.client, 0x40, values);
+    CHECK_EQUAL(2, bus.simulator.interrupts);
+    
+    Bus bytes(FEATURES_IRQ_BYTES);
+    bytes.device.registers[0x40] = 8;
+    i2c_smbus_read_block_data(&bytes.client, 0x40, values);
+    CHECK(bytes.simulator.interrupts >= 8);
+}
+
+TEST(transfer_takes_bus_time) {
+    Bus bus(FEATURES_KEXT);
+    
+    // address, command, address and data byte at 100 kHz
+    i2c_smbus_read_byte_data(&bus.client, 0);
+    CHECK(bus.simulator.now() >= 4 * SIM_BYTE_TIME_NS);
+    CHECK(bus.simulator.now() < 6 * SIM_BYTE_TIME_NS);
+}
+
+TEST(i2c_block_read_unsupported) {
+    Bus bus(FEATURE_IRQ);
+    u8 values[4];
+    
+    CHECK_EQUAL(-EOPNOTSUPP, i2c_smbus_read_i2c_block_data(&bus.client, 0, 4, values));
+    CHECK_EQUAL(0, bus.simulator.transactions);
+}
+
+TEST(missing_interrupt_times_out) {
+    Bus bus(FEATURES_KEXT);
+    
+    bus.simulator.setInterruptHandler(NULL, NULL);
+    CHECK_EQUAL(-ETIMEDOUT, i2c_smbus_read_byte_data(&bus.client, 0x10));
+    CHECK(bus.simulator.now() >= (uint64_t) bus.adapter.timeout);
+}
+
+TEST(dropped_interrupt_kills_transaction) {
+    Bus bus(FEATURES_KEXT);
+    
+    bus.simulator.setFault(SIM_FAULT_DROPPED_INTERRUPT, 1000);
+    CHECK_EQUAL(-ETIMEDOUT, i2c_smbus_read_byte_data(&bus.client, 0x10));
+    CHECK_EQUAL(1, bus.simulator.faults[SIM_FAULT_DROPPED_INTERRUPT]);
+    CHECK_EQUAL(0, bus.adapter.status);
+    CHECK_EQUAL(0, bus.simulator.inb(SMBHSTSTS(&bus.adapter)) & (STATUS_FLAGS | SMBHSTSTS_HOST_BUSY));
+    
+    // nothing of the timed out transaction is left for the next one
+    bus.simulator.setFault(SIM_FAULT_DROPPED_INTERRUPT, 0);
+    CHECK_EQUAL(bus.device.registers[0x20], i2c_smbus_read_byte_data(&bus.client, 0x20));
+}
+
+TEST(fault_errors) {
+    Bus bus(FEATURES_KEXT);
+    u8 values[I2C_SMBUS_BLOCK_MAX];
+    
+    bus.simulator.setFault(SIM_FAULT_NAK, 1000);
+    CHECK_EQUAL(-ENXIO, i2c_smbus_read_byte_data(&bus.client, 0x10));
+    bus.simulator.setFault(SIM_FAULT_NAK, 0);
+    
+    bus.simulator.setFault(SIM_FAULT_ARBITRATION_LOSS, 1000);
+    CHECK_EQUAL(-EAGAIN, i2c_smbus_read_byte_data(&bus.client, 0x10));
+    bus.simulator.setFault(SIM_FAULT_ARBITRATION_LOSS, 0);
+    
+    bus.device.registers[0x40] = 8;
+    bus.simulator.setFault(SIM_FAULT_BLOCK_LENGTH, 1000);
+    CHECK_EQUAL(-EPROTO, i2c_smbus_read_block_data(&bus.client, 0x40, values));
+    bus.simulator.setFault(SIM_FAULT_BLOCK_LENGTH, 0);
+    
+    // the PEC is only checked for clients that use it
+    bus.simulator.setFault(SIM_FAULT_PEC, 1000);
+    CHECK_EQUAL(bus.device.registers[0x10], i2c_smbus_read_byte_data(&bus.client, 0x10));
+    bus.client.flags |= I2C_CLIENT_PEC;
+    CHECK_EQUAL(-EBADMSG, i2c_smbus_read_byte_data(&bus.client, 0x10));
+    bus.simulator.setFault(SIM_FAULT_PEC, 0);
+    CHECK_EQUAL(bus.device.registers[0x10], i2c_smbus_read_byte_data(&bus.client, 0x10));
+}
+
+TEST(host_busy_fault) {
+    Bus bus(FEATURES_KEXT);
+    
+    // another master takes the bus after the transaction
+    bus.simulator.setFault(SIM_FAULT_HOST_BUSY, 1000);
+    CHECK_EQUAL(bus.device.registers[0x10], i2c_smbus_read_byte_data(&bus.client, 0x10));
+    bus.simulator.setFault(SIM_FAULT_HOST_BUSY, 0);
+    CHECK_EQUAL(-EBUSY, i2c_smbus_read_byte_data(&bus.client, 0x10));
+    
+    bus.simulator.advance(SIM_HOST_BUSY_NS);
+    CHECK_EQUAL(bus.device.registers[0x10], i2c_smbus_read_byte_data(&bus.client, 0x10));
+}
+
+TEST(faults_replay_with_seed) {
+    Bus first(FEATURES_KEXT), second(FEATURES_KEXT);
+    
+    first.simulator.setFault(SIM_FAULT_NAK, 300);
+    second.simulator.setFault(SIM_FAULT_NAK, 300);
+    for (int i = 0; i < 100; i++)
+        CHECK_EQUAL(i2c_smbus_read_byte_data(&first.client, 0x10), i2c_smbus_read_byte_data(&second.client, 0x10));
+    CHECK(first.simulator.faults[SIM_FAULT_NAK] > 10);
+    CHECK(first.simulator.faults[SIM_FAULT_NAK] < 60);
+}
+
+/*
+ * A second transfer that starts while the first one waits for its completion,
+ * as a thread entering the command gate the wait opened would. It runs from
+ * the interrupt handler, after i801_isr stored the status of the first one.
+ */
+struct OverlappingTransfer {
+    Bus *bus;
+    struct i2c_smbus_client client;
+    s32 result = 0;
+    unsigned int started = 0;
+    
+    static void interrupt(void *context) {
+        OverlappingTransfer *overlap = static_cast<OverlappingTransfer*>(context);
+        
+        i801_isr(&overlap->bus->adapter);
+        if (!overlap->started++)
+            overlap->result = i2c_smbus_read_byte_data(&overlap->client, 0x20);
+    }
+};
+
+TEST(overlapping_transfers) {
+    Bus bus(FEATURES_KEXT);
+    SimulatedRegisterDevice other;
+    OverlappingTransfer overlap;
+    u8 values[I2C_SMBUS_BLOCK_MAX];
+    
+    other.registers[0x20] = 0x5a;
+    bus.simulator.attach(0x51, &other);
+    overlap.bus = &bus;
+    overlap.client = bus.simulator.client(0x51);
+    bus.simulator.setInterruptHandler(&OverlappingTransfer::interrupt, &overlap);
+    
+    // the second transfer is refused before it touches the host, the first one keeps its status and data
+    CHECK_EQUAL(bus.device.registers[0x10], i2c_smbus_read_byte_data(&bus.client, 0x10));
+    CHECK_EQUAL(-EBUSY, overlap.result);
+    CHECK_EQUAL(1, bus.simulator.transactions);
+    CHECK_EQUAL(0, other.reads[I2C_SMBUS_BYTE_DATA]);
+    
+    // also in the middle of a byte-by-byte block read
+    Bus bytes(FEATURES_IRQ_BYTES);
+    bytes.simulator.attach(0x51, &other);
+    overlap.bus = &bytes;
+    overlap.client = bytes.simulator.client(0x51);
+    overlap.started = 0;
+    bytes.simulator.setInterruptHandler(&OverlappingTransfer::interrupt, &overlap);
+    bytes.device.registers[0x40] = 8;
+    CHECK_EQUAL(8, i2c_smbus_read_block_data(&bytes.client, 0x40, values));
+    CHECK(!memcmp(&bytes.device.registers[0x41], values, 8));
+    CHECK_EQUAL(-EBUSY, overlap.result);
+    
+    // once the first one is done the second one runs
+    CHECK_EQUAL(0x5a, i2c_smbus_read_byte_data(&overlap.client, 0x20));
+}
+
+TEST(polling_without_interrupts) {
+    Bus bus(FEATURES_POLL_BUFFER);
+    
+    bus.simulator.setInterruptHandler(NULL, NULL);
+    CHECK_EQUAL(bus.device.registers[0x10], i2c_smbus_read_byte_data(&bus.client, 0x10));
+    CHECK_EQUAL(0, bus.simulator.interrupts);
+}
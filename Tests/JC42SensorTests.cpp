@@ -0,0 +1,79 @@
+/*
+ * JC42SensorTests.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include "Test.hpp"
+#include "JC42Simulator.hpp"
+
+struct SensorBus {
+    I801Simulator simulator;
+    struct i801_adapter adapter;
+    struct i2c_smbus_client client;
+    
+    SensorBus(SimulatedDevice *device) {
+        simulator.setup(&adapter, FEATURE_IRQ | FEATURE_BLOCK_BUFFER | FEATURE_I2C_BLOCK_READ);
+        if (device)
+            simulator.attach(SIM_JC42_ADDRESS, device);
+        client = simulator.client(SIM_JC42_ADDRESS);
+    }
+};
+
+TEST(detects_known_sensor) {
+    SimulatedJC42Sensor sensor;
+    SensorBus bus(&sensor);
+    
+    CHECK(jc42_detect(&bus.client));
+    CHECK_EQUAL(SIM_JC42_MANID, jc42_read_register(&bus.client, JC42_REG_MANID));
+}
+
+TEST(detects_device_id_under_mask) {
+    // the revision in the low bits of an STTS424E doesn't matter, for an STTS3000 it does
+    SimulatedJC42Sensor stts424e(0x104a, 0x0001), stts3000(0x104a, 0x0201);
+    SensorBus first(&stts424e), second(&stts3000);
+    
+    CHECK(jc42_detect(&first.client));
+    CHECK(!jc42_detect(&second.client));
+}
+
+TEST(rejects_unknown_manufacturer) {
+    SimulatedJC42Sensor sensor(0x1234, SIM_JC42_DEVID);
+    SensorBus bus(&sensor);
+    
+    CHECK(!jc42_detect(&bus.client));
+}
+
+TEST(rejects_reserved_bits) {
+    SimulatedJC42Sensor sensor;
+    SensorBus bus(&sensor);
+    
+    sensor.registers[JC42_REG_CAPABILITY] |= 0x0100;
+    CHECK(!jc42_detect(&bus.client));
+    sensor.registers[JC42_REG_CAPABILITY] &= ~0x0100;
+    sensor.registers[JC42_REG_CONFIG] |= 0x0800;
+    CHECK(!jc42_detect(&bus.client));
+}
+
+TEST(rejects_other_devices) {
+    // an EEPROM in the address range answers every register
+    SimulatedRegisterDevice eeprom;
+    for (int i = 0; i < 256; i++)
+        eeprom.registers[i] = (u8) (i * 7 + 3);
+    SensorBus other(&eeprom), empty(NULL);
+    
+    CHECK(!jc42_detect(&other.client));
+    CHECK(!jc42_detect(&empty.client));
+}
+
+TEST(temperature_conversion) {
+    SimulatedJC42Sensor sensor;
+    SensorBus bus(&sensor);
+    
+    sensor.setTemperature(45250);
+    CHECK_EQUAL(45250, jc42_temperature_millicelsius((u16) jc42_read_register(&bus.client, JC42_REG_TEMP)));
+    sensor.setTemperature(-1500);
+    CHECK_EQUAL(-1500, jc42_temperature_millicelsius((u16) jc42_read_register(&bus.client, JC42_REG_TEMP)));
+    // the alarm flags in the upper bits are not part of the temperature
+    CHECK_EQUAL(25000, jc42_temperature_millicelsius(0xe000 | (25 * 16)));
+}
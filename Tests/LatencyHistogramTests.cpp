@@ -0,0 +1,80 @@
+/*
+ * LatencyHistogramTests.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include <thread>
+#include <vector>
+#include "Test.hpp"
+#include "LatencyHistogram.hpp"
+
+TEST(empty) {
+    LatencyHistogram histogram;
+    
+    CHECK_EQUAL(0, histogram.count());
+    CHECK_EQUAL(0, histogram.percentile(500));
+    CHECK_EQUAL(0, histogram.maximum());
+}
+
+TEST(percentiles_are_bucket_bounds) {
+    LatencyHistogram histogram;
+    
+    // 90 samples of 100us, 10 of 5000us
+    for (int i = 0; i < 90; i++)
+        histogram.recordMicroseconds(100);
+    for (int i = 0; i < 10; i++)
+        histogram.recordMicroseconds(5000);
+    
+    CHECK_EQUAL(100, histogram.count());
+    CHECK_EQUAL(128, histogram.percentile(500));
+    CHECK_EQUAL(128, histogram.percentile(900));
+    // the bound of the last populated bucket is capped by the maximum
+    CHECK_EQUAL(5000, histogram.percentile(990));
+    CHECK_EQUAL(5000, histogram.maximum());
+}
+
+TEST(record_converts_absolute_time) {
+    LatencyHistogram histogram;
+    
+    // absolute time units are nanoseconds on the host
+    histogram.record(1500000);
+    CHECK_EQUAL(1500, histogram.maximum());
+    CHECK_EQUAL(1, histogram.count());
+}
+
+TEST(sub_microsecond_and_overflow) {
+    LatencyHistogram histogram;
+    
+    histogram.recordMicroseconds(0);
+    histogram.recordMicroseconds(1ULL << 40);
+    CHECK_EQUAL(2, histogram.count());
+    CHECK_EQUAL(1, histogram.percentile(500));
+    CHECK_EQUAL(1ULL << 40, histogram.percentile(1000));
+}
+
+TEST(reset) {
+    LatencyHistogram histogram;
+    
+    histogram.recordMicroseconds(10);
+    histogram.reset();
+    CHECK_EQUAL(0, histogram.count());
+    CHECK_EQUAL(0, histogram.maximum());
+}
+
+TEST(concurrent_recording) {
+    LatencyHistogram histogram;
+    std::vector<std::thread> threads;
+    
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&histogram, t] {
+            for (int i = 0; i < 100000; i++)
+                histogram.recordMicroseconds((uint64_t) (i % 1000) + t);
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    
+    CHECK_EQUAL(400000, histogram.count());
+    CHECK_EQUAL(1002, histogram.maximum());
+}
@@ -0,0 +1,73 @@
+/*
+ * ReportTraceTests.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include <string.h>
+#include <vector>
+#include "Test.hpp"
+#include "ReportTrace.hpp"
+
+static std::vector<uint8_t> makeTrace(uint32_t records, uint32_t record_count) {
+    std::vector<uint8_t> trace(sizeof(report_trace_header) + records * sizeof(report_trace_record));
+    report_trace_header header = { REPORT_TRACE_MAGIC, REPORT_TRACE_VERSION, sizeof(report_trace_record), record_count, 0 };
+    
+    memcpy(trace.data(), &header, sizeof(header));
+    for (uint32_t i = 0; i < records; i++) {
+        report_trace_record record = {};
+        record.notify_ns = 1000 * i;
+        record.read_ns = 1000 * i + 300;
+        record.report[2] = 0x5d;
+        memcpy(&trace[sizeof(header) + i * sizeof(record)], &record, sizeof(record));
+    }
+    return trace;
+}
+
+TEST(layout) {
+    CHECK_EQUAL(16, sizeof(report_trace_header));
+    CHECK_EQUAL(56, sizeof(report_trace_record));
+}
+
+TEST(parse) {
+    std::vector<uint8_t> trace = makeTrace(3, 3);
+    uint32_t count = 0;
+    
+    const report_trace_record *records = report_trace_parse(trace.data(), trace.size(), &count);
+    CHECK(records);
+    CHECK_EQUAL(3, count);
+    CHECK_EQUAL(2000, records[2].notify_ns);
+    CHECK_EQUAL(2300, records[2].read_ns);
+    CHECK_EQUAL(0x5d, records[2].report[2]);
+}
+
+TEST(parse_empty) {
+    std::vector<uint8_t> trace = makeTrace(0, 0);
+    uint32_t count = 1;
+    
+    CHECK(report_trace_parse(trace.data(), trace.size(), &count));
+    CHECK_EQUAL(0, count);
+}
+
+TEST(reject_malformed) {
+    uint32_t count;
+    
+    std::vector<uint8_t> trace = makeTrace(2, 3);
+    CHECK(!report_trace_parse(trace.data(), trace.size(), &count));
+    
+    trace = makeTrace(2, 2);
+    CHECK(!report_trace_parse(trace.data(), trace.size() - 1, &count));
+    CHECK(!report_trace_parse(trace.data(), sizeof(report_trace_header) - 1, &count));
+    CHECK(!report_trace_parse(NULL, 0, &count));
+    
+    trace[0] ^= 1;
+    CHECK(!report_trace_parse(trace.data(), trace.size(), &count));
+    
+    trace = makeTrace(2, 2);
+    trace[4] = REPORT_TRACE_VERSION + 1;
+    CHECK(!report_trace_parse(trace.data(), trace.size(), &count));
+    
+    trace = makeTrace(2, 2);
+    trace[6] = sizeof(report_trace_record) - 1;
+    CHECK(!report_trace_parse(trace.data(), trace.size(), &count));
+}
@@ -0,0 +1,152 @@
+/*
+ * SMBusAlertTests.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include <vector>
+#include "Test.hpp"
+#include "I801Simulator.hpp"
+
+/* An alert response, as the controller passes it to the nub */
+struct Alert {
+    u8 address;
+    u8 flag;
+};
+
+/*
+ * The SMBALERT# path of the kext: the filter interrupt sees the status, the
+ * alert thread reads the Alert Response Address and dispatches the responses
+ * to the drivers of the devices
+ */
+struct AlertBus {
+    I801Simulator simulator;
+    struct i801_adapter adapter;
+    struct i2c_smbus_client ara;
+    struct smbus_alert_statistics statistics = {};
+    /* Addresses with a driver */
+    bool drivers[128] = {};
+    std::vector<Alert> alerts;
+    unsigned int interrupts = 0;
+    /* The device keeps alerting after every response */
+    int repeating = -1;
+    
+    AlertBus() {
+        simulator.setup(&adapter, FEATURE_IRQ | FEATURE_BLOCK_BUFFER);
+        simulator.setInterruptHandler(&AlertBus::filterInterrupt, this);
+        ara = simulator.client(SMBUS_ALERT_RESPONSE_ADDRESS);
+    }
+    
+    static void filterInterrupt(void *context) {
+        AlertBus *bus = static_cast<AlertBus*>(context);
+        
+        if (i801_isr(&bus->adapter) & SMBHSTSTS_SMBALERT_STS)
+            bus->interrupts++;
+    }
+    
+    static bool dispatch(void *context, u8 address, u8 flag) {
+        AlertBus *bus = static_cast<AlertBus*>(context);
+        Alert alert = { address, flag };
+        
+        bus->alerts.push_back(alert);
+        if (address == bus->repeating)
+            bus->simulator.assertAlert(address);
+        return bus->drivers[address];
+    }
+    
+    int respond() {
+        return smbus_alert_respond(&ara, &AlertBus::dispatch, this, &statistics);
+    }
+};
+
+/* A 7-bit address that is neither reserved nor the Alert Response Address */
+static u8 random_address(uint32_t *random) {
+    u8 address;
+    
+    do {
+        *random = *random * 1103515245 + 12345;
+        address = 0x08 + (*random >> 8) % (0x78 - 0x08);
+    } while (address == SMBUS_ALERT_RESPONSE_ADDRESS);
+    return address;
+}
+
+TEST(alert_at_random_address) {
+    uint32_t random = 1;
+    
+    for (int i = 0; i < 64; i++) {
+        AlertBus bus;
+        u8 address = random_address(&random);
+        u8 flag = i & 1;
+        
+        bus.drivers[address] = true;
+        bus.simulator.assertAlert(address, flag);
+        CHECK_EQUAL(1, bus.interrupts);
+        CHECK(bus.simulator.alertAsserted(address));
+        
+        CHECK_EQUAL(1, bus.respond());
+        CHECK_EQUAL(1, bus.alerts.size());
+        CHECK_EQUAL(address, bus.alerts[0].address);
+        CHECK_EQUAL(flag, bus.alerts[0].flag);
+        CHECK_EQUAL(1, bus.statistics.dispatched);
+        CHECK_EQUAL(0, bus.statistics.unclaimed);
+        // the device released SMBALERT# once it was answered
+        CHECK(!bus.simulator.alertAsserted(address));
+        CHECK_EQUAL(1, bus.simulator.alert_responses);
+        CHECK_EQUAL(0, bus.adapter.inb_p(SMBHSTSTS(&bus.adapter)) & SMBHSTSTS_SMBALERT_STS);
+    }
+}
+
+TEST(alerts_answered_lowest_address_first) {
+    AlertBus bus;
+    
+    bus.drivers[0x2c] = true;
+    bus.simulator.assertAlert(0x2c);
+    bus.simulator.assertAlert(0x19, 1);
+    bus.simulator.assertAlert(0x50);
+    // the line was already asserted, only the first device raised an interrupt
+    CHECK_EQUAL(1, bus.interrupts);
+    
+    CHECK_EQUAL(3, bus.respond());
+    CHECK_EQUAL(3, bus.alerts.size());
+    CHECK_EQUAL(0x19, bus.alerts[0].address);
+    CHECK_EQUAL(1, bus.alerts[0].flag);
+    CHECK_EQUAL(0x2c, bus.alerts[1].address);
+    CHECK_EQUAL(0x50, bus.alerts[2].address);
+    CHECK_EQUAL(1, bus.statistics.dispatched);
+    CHECK_EQUAL(2, bus.statistics.unclaimed);
+    
+    // with the line released, the next alert raises an interrupt again
+    bus.simulator.assertAlert(0x2c);
+    CHECK_EQUAL(2, bus.interrupts);
+}
+
+TEST(alert_without_response) {
+    AlertBus bus;
+    
+    // nothing asserts SMBALERT#, the read of the Alert Response Address is NAKed
+    CHECK_EQUAL(0, bus.respond());
+    CHECK_EQUAL(1, bus.statistics.unanswered);
+    CHECK_EQUAL(0, bus.simulator.alert_responses);
+}
+
+TEST(repeating_alert_is_bounded) {
+    AlertBus bus;
+    
+    bus.repeating = 0x1a;
+    bus.simulator.assertAlert(0x1a);
+    CHECK_EQUAL(SMBUS_ALERT_MAX_RESPONSES, bus.respond());
+    CHECK_EQUAL(SMBUS_ALERT_MAX_RESPONSES, bus.statistics.unclaimed);
+    CHECK(bus.simulator.alertAsserted(0x1a));
+}
+
+TEST(alert_interrupt_disabled) {
+    AlertBus bus;
+    
+    bus.simulator.outb(SMBSLVCMD_SMBALERT_DISABLE, SMBSLVCMD(&bus.adapter));
+    bus.simulator.assertAlert(0x30);
+    CHECK_EQUAL(0, bus.interrupts);
+    // the status is latched anyway and the device still answers
+    CHECK(bus.adapter.inb_p(SMBHSTSTS(&bus.adapter)) & SMBHSTSTS_SMBALERT_STS);
+    CHECK_EQUAL(1, bus.respond());
+    CHECK_EQUAL(0x30, bus.alerts[0].address);
+}
@@ -0,0 +1,224 @@
+/*
+ * SMBusCommandStreamTests.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include <string.h>
+#include "Test.hpp"
+#include "I801Simulator.hpp"
+#include "SMBusCommandStream.hpp"
+
+#define DEVICE_ADDRESS      0x50
+#define MISSING_ADDRESS     0x51
+#define DENIED_ADDRESS      0x36
+#define STREAM_CAPACITY     1024
+
+/*
+ * A user client on the simulated bus: the commands run through i801_access
+ * like VoodooSMBusControllerDriver::transferStreamCommand runs them through
+ * the controller
+ */
+struct StreamBus {
+    I801Simulator simulator;
+    struct i801_adapter adapter;
+    SimulatedRegisterDevice device;
+    struct smbus_stream_allowlist allowlist = {};
+    u8 stream[STREAM_CAPACITY];
+    size_t length;
+    u8 results[STREAM_CAPACITY];
+    size_t results_length = 0;
+    unsigned int transfers = 0;
+    
+    StreamBus() {
+        simulator.setup(&adapter, FEATURE_IRQ | FEATURE_BLOCK_BUFFER | FEATURE_I2C_BLOCK_READ);
+        simulator.attach(DEVICE_ADDRESS, &device);
+        for (int i = 0; i < 256; i++)
+            device.registers[i] = (u8) (i ^ 0xa5);
+        smbus_stream_allow(&allowlist, DEVICE_ADDRESS, false);
+        smbus_stream_allow(&allowlist, DEVICE_ADDRESS, true);
+        smbus_stream_allow(&allowlist, MISSING_ADDRESS, false);
+        length = smbus_stream_begin(stream, sizeof(stream));
+    }
+    
+    bool add(u8 address, u8 protocol, u8 read_write, u8 command, u8 flags, u8 data_length, const u8 *data) {
+        struct smbus_stream_command entry = { address, protocol, read_write, command, flags, data_length, data };
+        return smbus_stream_add(stream, sizeof(stream), &length, &entry);
+    }
+    
+    int execute(size_t capacity = STREAM_CAPACITY) {
+        return smbus_stream_execute(stream, length, results, capacity, &results_length, &allowlist, &StreamBus::transfer, this);
+    }
+    
+    static int transfer(void *context, const struct smbus_stream_command *command, uint8_t *data) {
+        StreamBus *bus = static_cast<StreamBus*>(context);
+        
+        bus->transfers++;
+        return i801_access(&bus->adapter, command->address, command->flags & SMBUS_STREAM_FLAG_PEC ? I2C_CLIENT_PEC : 0,
+                           command->read_write, command->command, command->protocol, reinterpret_cast<union i2c_smbus_data*>(data));
+    }
+};
+
+TEST(encode_decode_round_trip) {
+    StreamBus bus;
+    const u8 word[2] = { 0x34, 0x12 };
+    const u8 block[5] = { 1, 2, 3, 4, 5 };
+    struct smbus_stream_command command;
+    size_t offset = SMBUS_STREAM_HEADER_SIZE;
+    
+    CHECK(bus.add(0x08, SMBUS_STREAM_QUICK, SMBUS_STREAM_WRITE, 0, 0, 0, NULL));
+    CHECK(bus.add(0x19, SMBUS_STREAM_WORD_DATA, SMBUS_STREAM_WRITE, 0x02, SMBUS_STREAM_FLAG_PEC, 2, word));
+    CHECK(bus.add(0x50, SMBUS_STREAM_I2C_BLOCK_DATA, SMBUS_STREAM_READ, 0x80, SMBUS_STREAM_FLAG_STOP_ON_ERROR, 32, NULL));
+    CHECK(bus.add(0x77, SMBUS_STREAM_BLOCK_DATA, SMBUS_STREAM_WRITE, 0x10, 0, 5, block));
+    CHECK_EQUAL(SMBUS_STREAM_HEADER_SIZE + 4 * SMBUS_STREAM_COMMAND_SIZE + 2 + 5, bus.length);
+    CHECK_EQUAL(4, smbus_stream_decode_header(bus.stream, bus.length, SMBUS_STREAM_COMMAND_MAGIC));
+    
+    CHECK_EQUAL(0, smbus_stream_decode_command(bus.stream, bus.length, &offset, &command));
+    CHECK_EQUAL(0x08, command.address);
+    CHECK_EQUAL(SMBUS_STREAM_QUICK, command.protocol);
+    CHECK_EQUAL(0, smbus_stream_decode_command(bus.stream, bus.length, &offset, &command));
+    CHECK_EQUAL(0x19, command.address);
+    CHECK_EQUAL(SMBUS_STREAM_WRITE, command.read_write);
+    CHECK_EQUAL(0x02, command.command);
+    CHECK_EQUAL(SMBUS_STREAM_FLAG_PEC, command.flags);
+    CHECK(!memcmp(word, command.data, sizeof(word)));
+    CHECK_EQUAL(0, smbus_stream_decode_command(bus.stream, bus.length, &offset, &command));
+    // reads carry the requested length but no data
+    CHECK_EQUAL(32, command.length);
+    CHECK_EQUAL(SMBUS_STREAM_FLAG_STOP_ON_ERROR, command.flags);
+    CHECK_EQUAL(0, smbus_stream_decode_command(bus.stream, bus.length, &offset, &command));
+    CHECK_EQUAL(5, command.length);
+    CHECK(!memcmp(block, command.data, sizeof(block)));
+    CHECK_EQUAL(bus.length, offset);
+    CHECK_EQUAL(SMBUS_STREAM_EINVAL, smbus_stream_decode_command(bus.stream, bus.length, &offset, &command));
+}
+
+TEST(encode_rejects_invalid_commands) {
+    StreamBus bus;
+    const u8 data[SMBUS_STREAM_DATA_MAX + 1] = {};
+    size_t length = bus.length;
+    
+    CHECK(!bus.add(0x80, SMBUS_STREAM_QUICK, SMBUS_STREAM_WRITE, 0, 0, 0, NULL));
+    CHECK(!bus.add(0x50, SMBUS_STREAM_BYTE_DATA, SMBUS_STREAM_READ, 0, 0, 1, data));
+    CHECK(!bus.add(0x50, SMBUS_STREAM_WORD_DATA, SMBUS_STREAM_WRITE, 0, 0, 1, data));
+    CHECK(!bus.add(0x50, SMBUS_STREAM_BLOCK_DATA, SMBUS_STREAM_WRITE, 0, 0, 0, data));
+    CHECK(!bus.add(0x50, SMBUS_STREAM_BLOCK_DATA, SMBUS_STREAM_WRITE, 0, 0, SMBUS_STREAM_DATA_MAX + 1, data));
+    CHECK(!bus.add(0x50, SMBUS_STREAM_I2C_BLOCK_DATA, SMBUS_STREAM_READ, 0, 0, 0, NULL));
+    CHECK(!bus.add(0x50, 4, SMBUS_STREAM_READ, 0, 0, 0, NULL));
+    CHECK(!bus.add(0x50, SMBUS_STREAM_BYTE, SMBUS_STREAM_READ, 0, 0x80, 0, NULL));
+    CHECK(!bus.add(0x50, SMBUS_STREAM_BYTE, 2, 0, 0, 0, NULL));
+    CHECK_EQUAL(length, bus.length);
+    CHECK_EQUAL(0, smbus_stream_decode_header(bus.stream, bus.length, SMBUS_STREAM_COMMAND_MAGIC));
+    
+    // a command that doesn't fit leaves the stream as it was
+    struct smbus_stream_command command = { 0x50, SMBUS_STREAM_BLOCK_DATA, SMBUS_STREAM_WRITE, 0, 0, 8, data };
+    size_t capacity = bus.length + SMBUS_STREAM_COMMAND_SIZE + 7;
+    CHECK(!smbus_stream_add(bus.stream, capacity, &bus.length, &command));
+    CHECK_EQUAL(length, bus.length);
+    CHECK_EQUAL(0, smbus_stream_begin(bus.stream, SMBUS_STREAM_HEADER_SIZE - 1));
+}
+
+TEST(decode_rejects_malformed_streams) {
+    StreamBus bus;
+    const u8 data[4] = { 1, 2, 3, 4 };
+    struct smbus_stream_command command;
+    size_t offset = SMBUS_STREAM_HEADER_SIZE;
+    
+    CHECK(bus.add(DEVICE_ADDRESS, SMBUS_STREAM_BLOCK_DATA, SMBUS_STREAM_WRITE, 0, 0, 4, data));
+    CHECK_EQUAL(SMBUS_STREAM_EINVAL, smbus_stream_decode_header(bus.stream, SMBUS_STREAM_HEADER_SIZE - 1, SMBUS_STREAM_COMMAND_MAGIC));
+    CHECK_EQUAL(SMBUS_STREAM_EINVAL, smbus_stream_decode_header(bus.stream, bus.length, SMBUS_STREAM_RESULT_MAGIC));
+    // the data of the write is cut off
+    CHECK_EQUAL(SMBUS_STREAM_EINVAL, smbus_stream_decode_command(bus.stream, bus.length - 1, &offset, &command));
+    CHECK_EQUAL(SMBUS_STREAM_HEADER_SIZE, offset);
+    
+    bus.stream[4] = SMBUS_STREAM_VERSION + 1;
+    CHECK_EQUAL(SMBUS_STREAM_EINVAL, smbus_stream_decode_header(bus.stream, bus.length, SMBUS_STREAM_COMMAND_MAGIC));
+    CHECK_EQUAL(SMBUS_STREAM_EINVAL, bus.execute());
+    CHECK_EQUAL(0, bus.results_length);
+    
+    // a valid header announcing more commands than the stream holds is rejected before any transfer
+    bus.stream[4] = SMBUS_STREAM_VERSION;
+    bus.stream[6] = 2;
+    CHECK_EQUAL(SMBUS_STREAM_EINVAL, bus.execute());
+    CHECK_EQUAL(0, bus.transfers);
+    CHECK_EQUAL(0, bus.device.writes[I2C_SMBUS_BLOCK_DATA]);
+}
+
+TEST(execute_on_simulated_bus) {
+    StreamBus bus;
+    const u8 word[2] = { 0xef, 0xbe };
+    const u8 block[3] = { 0x11, 0x22, 0x33 };
+    struct smbus_stream_result result;
+    size_t offset = SMBUS_STREAM_HEADER_SIZE;
+    
+    CHECK(bus.add(DEVICE_ADDRESS, SMBUS_STREAM_BYTE_DATA, SMBUS_STREAM_READ, 0x10, 0, 0, NULL));
+    CHECK(bus.add(DEVICE_ADDRESS, SMBUS_STREAM_WORD_DATA, SMBUS_STREAM_WRITE, 0x20, 0, 2, word));
+    CHECK(bus.add(DEVICE_ADDRESS, SMBUS_STREAM_WORD_DATA, SMBUS_STREAM_READ, 0x20, 0, 0, NULL));
+    CHECK(bus.add(DEVICE_ADDRESS, SMBUS_STREAM_BLOCK_DATA, SMBUS_STREAM_WRITE, 0x30, 0, 3, block));
+    CHECK(bus.add(DEVICE_ADDRESS, SMBUS_STREAM_BLOCK_DATA, SMBUS_STREAM_READ, 0x30, 0, 0, NULL));
+    CHECK(bus.add(DEVICE_ADDRESS, SMBUS_STREAM_I2C_BLOCK_DATA, SMBUS_STREAM_READ, 0x80, 0, 16, NULL));
+    CHECK_EQUAL(6, bus.execute());
+    CHECK_EQUAL(6, smbus_stream_decode_header(bus.results, bus.results_length, SMBUS_STREAM_RESULT_MAGIC));
+    
+    CHECK_EQUAL(0, smbus_stream_decode_result(bus.results, bus.results_length, &offset, &result));
+    CHECK_EQUAL(0, result.status);
+    CHECK_EQUAL(1, result.length);
+    CHECK_EQUAL(0x10 ^ 0xa5, result.data[0]);
+    CHECK_EQUAL(0, smbus_stream_decode_result(bus.results, bus.results_length, &offset, &result));
+    CHECK_EQUAL(0, result.length);
+    CHECK_EQUAL(0xef, bus.device.registers[0x20]);
+    CHECK_EQUAL(0, smbus_stream_decode_result(bus.results, bus.results_length, &offset, &result));
+    CHECK_EQUAL(2, result.length);
+    CHECK(!memcmp(word, result.data, sizeof(word)));
+    CHECK_EQUAL(0, smbus_stream_decode_result(bus.results, bus.results_length, &offset, &result));
+    CHECK_EQUAL(0, smbus_stream_decode_result(bus.results, bus.results_length, &offset, &result));
+    // the block comes back without its length byte
+    CHECK_EQUAL(3, result.length);
+    CHECK(!memcmp(block, result.data, sizeof(block)));
+    CHECK_EQUAL(0, smbus_stream_decode_result(bus.results, bus.results_length, &offset, &result));
+    CHECK_EQUAL(16, result.length);
+    for (int i = 0; i < 16; i++)
+        CHECK_EQUAL(bus.device.registers[0x80 + i], result.data[i]);
+    CHECK_EQUAL(bus.results_length, offset);
+}
+
+TEST(execute_denied_and_failed_commands) {
+    StreamBus bus;
+    struct smbus_stream_result result;
+    size_t offset = SMBUS_STREAM_HEADER_SIZE;
+    
+    CHECK(bus.add(DENIED_ADDRESS, SMBUS_STREAM_BYTE, SMBUS_STREAM_READ, 0, 0, 0, NULL));
+    // reads are allowed for the address, writes are not
+    CHECK(bus.add(DEVICE_ADDRESS, SMBUS_STREAM_QUICK, SMBUS_STREAM_WRITE, 0, 0, 0, NULL));
+    CHECK(bus.add(MISSING_ADDRESS, SMBUS_STREAM_BYTE_DATA, SMBUS_STREAM_READ, 0, 0, 0, NULL));
+    CHECK(bus.add(MISSING_ADDRESS, SMBUS_STREAM_BYTE_DATA, SMBUS_STREAM_READ, 0, SMBUS_STREAM_FLAG_STOP_ON_ERROR, 0, NULL));
+    CHECK(bus.add(DEVICE_ADDRESS, SMBUS_STREAM_BYTE_DATA, SMBUS_STREAM_READ, 0, 0, 0, NULL));
+    
+    bus.allowlist.write[DEVICE_ADDRESS / 8] = 0;
+    CHECK_EQUAL(4, bus.execute());
+    // the denied commands never reached the bus
+    CHECK_EQUAL(2, bus.transfers);
+    CHECK_EQUAL(0, smbus_stream_decode_result(bus.results, bus.results_length, &offset, &result));
+    CHECK_EQUAL(SMBUS_STREAM_EACCES, result.status);
+    CHECK_EQUAL(0, smbus_stream_decode_result(bus.results, bus.results_length, &offset, &result));
+    CHECK_EQUAL(SMBUS_STREAM_EACCES, result.status);
+    CHECK_EQUAL(0, smbus_stream_decode_result(bus.results, bus.results_length, &offset, &result));
+    CHECK_EQUAL(-ENXIO, result.status);
+    CHECK_EQUAL(0, result.length);
+    CHECK_EQUAL(0, smbus_stream_decode_result(bus.results, bus.results_length, &offset, &result));
+    CHECK_EQUAL(-ENXIO, result.status);
+    CHECK_EQUAL(bus.results_length, offset);
+}
+
+TEST(execute_stops_when_results_are_full) {
+    StreamBus bus;
+    
+    for (int i = 0; i < 4; i++)
+        CHECK(bus.add(DEVICE_ADDRESS, SMBUS_STREAM_I2C_BLOCK_DATA, SMBUS_STREAM_READ, (u8) (i * 32), 0, 32, NULL));
+    
+    // room for two results of 32 bytes and a part of the third
+    CHECK_EQUAL(2, bus.execute(SMBUS_STREAM_HEADER_SIZE + 3 * (SMBUS_STREAM_RESULT_SIZE + 32) - 1));
+    CHECK_EQUAL(2, bus.transfers);
+    CHECK_EQUAL(SMBUS_STREAM_HEADER_SIZE + 2 * (SMBUS_STREAM_RESULT_SIZE + 32), bus.results_length);
+    CHECK_EQUAL(SMBUS_STREAM_ENOSPC, bus.execute(SMBUS_STREAM_HEADER_SIZE - 1));
+}
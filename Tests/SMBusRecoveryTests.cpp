@@ -0,0 +1,149 @@
+/*
+ * SMBusRecoveryTests.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include "Test.hpp"
+#include "I801Simulator.hpp"
+#include "SMBusRecovery.hpp"
+
+#define DEVICE_ADDRESS  0x50
+#define OTHER_ADDRESS   0x51
+
+#define RECOVERY_INTERVAL_NS    1000000000ULL
+
+/*
+ * The transfer path of the controller driver on a bus that can get stuck:
+ * every transfer is supervised, a hung bus is recovered right away
+ */
+struct StuckBus {
+    I801Simulator simulator;
+    struct i801_adapter adapter;
+    SimulatedRegisterDevice device;
+    SimulatedRegisterDevice other;
+    struct i2c_smbus_client client;
+    struct i2c_smbus_client other_client;
+    struct smbus_recovery recovery = {};
+    unsigned int hangs = 0;
+    /* Starts a transfer to the other device from every interrupt */
+    bool overlap = false;
+    s32 overlap_result = 0;
+    unsigned int overlaps = 0;
+    
+    StuckBus(unsigned int features = FEATURE_IRQ | FEATURE_BLOCK_BUFFER) {
+        simulator.setup(&adapter, features);
+        simulator.attach(DEVICE_ADDRESS, &device);
+        simulator.attach(OTHER_ADDRESS, &other);
+        simulator.setInterruptHandler(&StuckBus::interrupt, this);
+        client = simulator.client(DEVICE_ADDRESS);
+        other_client = simulator.client(OTHER_ADDRESS);
+        recovery.interval = RECOVERY_INTERVAL_NS;
+        device.registers[0x10] = 0x3c;
+        other.registers[0x20] = 0x5a;
+    }
+    
+    s32 transfer(struct i2c_smbus_client *target, u8 command) {
+        bool host_owned = !adapter.transfer_active;
+        s32 result = i2c_smbus_read_byte_data(target, command);
+        
+        if (smbus_recovery_supervise(&recovery, result, host_owned, simulator.now()) == BUS_HEALTH_HUNG) {
+            smbus_recovery_start(&recovery, simulator.now());
+            hangs++;
+        }
+        return result;
+    }
+    
+    static void interrupt(void *context) {
+        StuckBus *bus = static_cast<StuckBus*>(context);
+        
+        i801_isr(&bus->adapter);
+        if (bus->overlap) {
+            bus->overlap_result = bus->transfer(&bus->other_client, 0x20);
+            bus->overlaps++;
+        }
+    }
+};
+
+TEST(stuck_bus_is_recovered) {
+    StuckBus bus;
+    
+    // another master holds the bus after every transaction, no transfer owns the host meanwhile
+    bus.simulator.setFault(SIM_FAULT_HOST_BUSY, 1000);
+    CHECK_EQUAL(0x3c, bus.transfer(&bus.client, 0x10));
+    for (int i = 1; i < BUS_RECOVERY_FAILURES; i++) {
+        CHECK_EQUAL(-EBUSY, bus.transfer(&bus.client, 0x10));
+        CHECK_EQUAL(0, bus.hangs);
+    }
+    uint64_t failure = bus.recovery.ts_failure;
+    CHECK(failure != 0);
+    CHECK_EQUAL(-EBUSY, bus.transfer(&bus.client, 0x10));
+    CHECK_EQUAL(1, bus.hangs);
+    CHECK_EQUAL(1, bus.recovery.recoveries[BUS_RECOVERY_KILL]);
+    
+    // the bus works again once the other master let go of it
+    bus.simulator.setFault(SIM_FAULT_HOST_BUSY, 0);
+    bus.simulator.advance(SIM_HOST_BUSY_NS);
+    CHECK_EQUAL(0x3c, bus.transfer(&bus.client, 0x10));
+    CHECK_EQUAL(1, bus.recovery.recovered);
+    CHECK_EQUAL(bus.simulator.now() - failure, bus.recovery.last_outage);
+    CHECK_EQUAL(0, bus.recovery.ts_failure);
+    CHECK_EQUAL(0, bus.recovery.level);
+}
+
+TEST(recovery_is_rate_limited_and_escalates) {
+    StuckBus bus;
+    
+    // the host stops completing transfers, every one of them times out
+    bus.simulator.setFault(SIM_FAULT_DROPPED_INTERRUPT, 1000);
+    for (int i = 0; i < BUS_RECOVERY_FAILURES; i++)
+        CHECK_EQUAL(-ETIMEDOUT, bus.transfer(&bus.client, 0x10));
+    CHECK_EQUAL(1, bus.hangs);
+    uint64_t first_recovery = bus.recovery.ts_recovery;
+    
+    // the next recovery waits for the interval
+    for (int i = 0; i < BUS_RECOVERY_FAILURES; i++)
+        bus.transfer(&bus.client, 0x10);
+    CHECK_EQUAL(1, bus.hangs);
+    CHECK_EQUAL(1, bus.recovery.rate_limited);
+    
+    // every recovery that did not help goes further, up to the device reset
+    for (int i = 0; i < 100 && bus.hangs < 4; i++)
+        bus.transfer(&bus.client, 0x10);
+    CHECK_EQUAL(4, bus.hangs);
+    CHECK_EQUAL(1, bus.recovery.recoveries[BUS_RECOVERY_KILL]);
+    CHECK_EQUAL(1, bus.recovery.recoveries[BUS_RECOVERY_HOST_RESET]);
+    CHECK_EQUAL(2, bus.recovery.recoveries[BUS_RECOVERY_DEVICE_RESET]);
+    CHECK(bus.recovery.ts_recovery - first_recovery >= 3 * RECOVERY_INTERVAL_NS);
+    
+    bus.simulator.setFault(SIM_FAULT_DROPPED_INTERRUPT, 0);
+    CHECK_EQUAL(0x3c, bus.transfer(&bus.client, 0x10));
+    CHECK_EQUAL(1, bus.recovery.recovered);
+    CHECK_EQUAL(0, bus.recovery.level);
+}
+
+TEST(overlapping_transfers_are_no_hang) {
+    // a block read byte by byte takes an interrupt per byte, enough for a transfer to overlap it repeatedly
+    StuckBus bus(FEATURE_IRQ | FEATURE_I2C_BLOCK_READ);
+    u8 values[I2C_SMBUS_BLOCK_MAX];
+    
+    bus.device.registers[0x40] = 8;
+    bus.overlap = true;
+    CHECK_EQUAL(8, i2c_smbus_read_block_data(&bus.client, 0x40, values));
+    bus.overlap = false;
+    
+    // transfers that are refused because another one owns the host say nothing about the bus
+    CHECK(bus.overlaps >= BUS_RECOVERY_FAILURES);
+    CHECK_EQUAL(-EBUSY, bus.overlap_result);
+    CHECK_EQUAL(0, bus.hangs);
+    CHECK_EQUAL(0, bus.recovery.consecutive_failures);
+    CHECK_EQUAL(0, bus.recovery.ts_failure);
+    CHECK_EQUAL(0, bus.other.reads[I2C_SMBUS_BYTE_DATA]);
+    
+    // they don't hide a hang either
+    bus.simulator.setFault(SIM_FAULT_HOST_BUSY, 1000);
+    CHECK_EQUAL(0x3c, bus.transfer(&bus.client, 0x10));
+    for (int i = 0; i < BUS_RECOVERY_FAILURES; i++)
+        CHECK_EQUAL(-EBUSY, bus.transfer(&bus.client, 0x10));
+    CHECK_EQUAL(1, bus.hangs);
+}
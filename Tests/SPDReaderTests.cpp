@@ -0,0 +1,120 @@
+/*
+ * SPDReaderTests.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include <string.h>
+#include "Test.hpp"
+#include "SPDSimulator.hpp"
+
+#define FEATURES_KEXT   (FEATURE_IRQ | FEATURE_BLOCK_BUFFER | FEATURE_I2C_BLOCK_READ | FEATURE_SMBUS_PEC)
+
+struct MemoryBus {
+    I801Simulator simulator;
+    struct i801_adapter adapter;
+    SimulatedEE1004PageSelect page_select;
+    SimulatedSPDDevice module;
+    struct i2c_smbus_client client;
+    u8 buffer[SPD_MAX_SIZE];
+    
+    MemoryBus(enum spd_device_type device_type) : module(device_type, &page_select) {
+        simulator.setup(&adapter, FEATURES_KEXT);
+        if (device_type == SPD_DEVICE_EE1004)
+            page_select.attach(&simulator);
+        simulator.attach(SIM_SPD_ADDRESS, &module);
+        client = simulator.client(SIM_SPD_ADDRESS);
+        memset(buffer, 0, sizeof(buffer));
+    }
+};
+
+TEST(detects_device_types) {
+    MemoryBus eeprom(SPD_DEVICE_EEPROM), ee1004(SPD_DEVICE_EE1004), hub(SPD_DEVICE_SPD5_HUB);
+    
+    // on EEPROMs before DDR4 the page select addresses set the write protection
+    eeprom.page_select.attach(&eeprom.simulator);
+    eeprom.module.fill(0x0B, "DDR3-TEST");
+    ee1004.module.fill(SPD_MEMORY_TYPE_DDR4, "DDR4-TEST");
+    hub.module.fill(SPD_MEMORY_TYPE_DDR5, "DDR5-TEST");
+    
+    CHECK_EQUAL(SPD_DEVICE_EEPROM, spd_detect_device(&eeprom.client));
+    CHECK_EQUAL(0, eeprom.page_select.selects);
+    CHECK_EQUAL(SPD_DEVICE_EE1004, spd_detect_device(&ee1004.client));
+    CHECK_EQUAL(SPD_DEVICE_SPD5_HUB, spd_detect_device(&hub.client));
+}
+
+TEST(reads_ddr4_from_ee1004) {
+    MemoryBus bus(SPD_DEVICE_EE1004);
+    struct spd_info info;
+    
+    bus.module.fill(SPD_MEMORY_TYPE_DDR4, "DDR4-TEST");
+    CHECK_EQUAL(SPD_DDR4_SIZE, spd_read_contents(&bus.client, SPD_DEVICE_EE1004, bus.buffer));
+    CHECK(!memcmp(bus.module.contents, bus.buffer, SPD_DDR4_SIZE));
+    // the firmware expects page 0 again
+    CHECK_EQUAL(0, bus.page_select.page);
+    
+    CHECK(spd_decode(bus.buffer, SPD_DDR4_SIZE, &info));
+    CHECK(info.crc_valid);
+    CHECK(!strcmp("DDR4-TEST", info.part_number));
+}
+
+TEST(reads_ddr5_from_spd5_hub) {
+    MemoryBus bus(SPD_DEVICE_SPD5_HUB);
+    struct spd_info info;
+    
+    bus.module.fill(SPD_MEMORY_TYPE_DDR5, "DDR5-TEST");
+    CHECK_EQUAL(SPD_DDR5_SIZE, spd_read_contents(&bus.client, SPD_DEVICE_SPD5_HUB, bus.buffer));
+    CHECK(!memcmp(bus.module.contents, bus.buffer, SPD_DDR5_SIZE));
+    CHECK_EQUAL(0, i2c_smbus_read_byte_data(&bus.client, SPD5_REG_LEGACY_MODE));
+    
+    CHECK(spd_decode(bus.buffer, SPD_DDR5_SIZE, &info));
+    CHECK(info.crc_valid);
+    CHECK(!strcmp("DDR5-TEST", info.part_number));
+}
+
+TEST(plain_eeprom_reads_one_page) {
+    MemoryBus bus(SPD_DEVICE_EEPROM);
+    
+    bus.module.fill(0x0B, "DDR3-TEST");
+    CHECK_EQUAL(SPD_EEPROM_SIZE, spd_read_contents(&bus.client, SPD_DEVICE_EEPROM, bus.buffer));
+    CHECK(!memcmp(bus.module.contents, bus.buffer, SPD_EEPROM_SIZE));
+    
+    // a DDR4 image behind an EEPROM without pages is not cut at its size
+    bus.module.fill(SPD_MEMORY_TYPE_DDR4, "DDR4-TEST");
+    CHECK(spd_read_contents(&bus.client, SPD_DEVICE_EEPROM, bus.buffer) < 0);
+}
+
+TEST(ddr4_without_page_select_fails) {
+    MemoryBus bus(SPD_DEVICE_EE1004);
+    
+    // the firmware locked the page select, so the second page can't be read
+    bus.module.fill(SPD_MEMORY_TYPE_DDR4, "DDR4-TEST");
+    bus.simulator.detach(EE1004_ADDR_SET_PAGE0);
+    bus.simulator.detach(EE1004_ADDR_SET_PAGE1);
+    CHECK_EQUAL(SPD_DEVICE_EE1004, spd_detect_device(&bus.client));
+    CHECK(spd_read_contents(&bus.client, SPD_DEVICE_EE1004, bus.buffer) < 0);
+}
+
+TEST(failed_read_returns_no_contents) {
+    MemoryBus bus(SPD_DEVICE_EE1004);
+    
+    // the second page fails, the first half must not be mistaken for the contents
+    bus.module.fill(SPD_MEMORY_TYPE_DDR4, "DDR4-TEST");
+    bus.module.fail_from = EE1004_PAGE_SIZE + SPD_BLOCK_LEN;
+    CHECK(spd_read_contents(&bus.client, SPD_DEVICE_EE1004, bus.buffer) < 0);
+    CHECK_EQUAL(0, bus.page_select.page);
+    
+    // a later read gets everything
+    bus.module.fail_from = -1;
+    CHECK_EQUAL(SPD_DDR4_SIZE, spd_read_contents(&bus.client, SPD_DEVICE_EE1004, bus.buffer));
+}
+
+TEST(failed_block_is_retried) {
+    MemoryBus bus(SPD_DEVICE_EE1004);
+    
+    bus.module.fill(SPD_MEMORY_TYPE_DDR4, "DDR4-TEST");
+    bus.simulator.setFault(SIM_FAULT_ARBITRATION_LOSS, 100);
+    CHECK_EQUAL(SPD_DDR4_SIZE, spd_read_contents(&bus.client, SPD_DEVICE_EE1004, bus.buffer));
+    CHECK(!memcmp(bus.module.contents, bus.buffer, SPD_DDR4_SIZE));
+    CHECK(bus.simulator.faults[SIM_FAULT_ARBITRATION_LOSS] > 0);
+}
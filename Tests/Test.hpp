@@ -0,0 +1,58 @@
+/*
+ * Test.hpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#ifndef Test_hpp
+#define Test_hpp
+
+/*
+ * Minimal unit test support for the host build. Every test executable links
+ * TestMain.cpp, which runs the tests defined with TEST in registration order,
+ * or only those whose name contains the first argument.
+ */
+#include <stdio.h>
+
+struct TestCase {
+    const char* name;
+    void (*function)();
+    TestCase* next;
+};
+
+struct TestRegistration {
+    TestRegistration(TestCase* test);
+};
+
+/* Marks the running test as failed */
+void test_fail(const char* file, int line, const char* message);
+
+#define TEST(name) \
+    static void test_##name(); \
+    static TestCase test_case_##name = { #name, test_##name, NULL }; \
+    static TestRegistration test_registration_##name(&test_case_##name); \
+    static void test_##name()
+
+/* Fails the test and returns from it if @condition is false */
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            test_fail(__FILE__, __LINE__, #condition); \
+            return; \
+        } \
+    } while (0)
+
+#define CHECK_EQUAL(expected, actual) \
+    do { \
+        long long check_expected = (long long) (expected); \
+        long long check_actual = (long long) (actual); \
+        if (check_expected != check_actual) { \
+            char check_message[256]; \
+            snprintf(check_message, sizeof(check_message), "%s == %s, expected %lld but was %lld", \
+                     #expected, #actual, check_expected, check_actual); \
+            test_fail(__FILE__, __LINE__, check_message); \
+            return; \
+        } \
+    } while (0)
+
+#endif /* Test_hpp */
@@ -0,0 +1,45 @@
+/*
+ * TestMain.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include <string.h>
+#include "Test.hpp"
+
+static TestCase* first_test = NULL;
+static TestCase** last_test = &first_test;
+static bool failed;
+
+TestRegistration::TestRegistration(TestCase* test) {
+    *last_test = test;
+    last_test = &test->next;
+}
+
+void test_fail(const char* file, int line, const char* message) {
+    fprintf(stderr, "  %s:%d: check failed: %s\n", file, line, message);
+    failed = true;
+}
+
+int main(int argc, char** argv) {
+    const char* filter = argc > 1 ? argv[1] : NULL;
+    int run = 0, failures = 0;
+    
+    for (TestCase* test = first_test; test; test = test->next) {
+        if (filter && !strstr(test->name, filter))
+            continue;
+        
+        failed = false;
+        test->function();
+        run++;
+        if (failed) {
+            failures++;
+            fprintf(stderr, "FAIL %s\n", test->name);
+        } else {
+            printf("ok   %s\n", test->name);
+        }
+    }
+    
+    printf("%d tests, %d failures\n", run, failures);
+    return failures || !run ? 1 : 0;
+}
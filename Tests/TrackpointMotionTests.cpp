@@ -0,0 +1,190 @@
+/*
+ * TrackpointMotionTests.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include <string.h>
+#include "Test.hpp"
+#include "ELANReport.hpp"
+#include "TrackpointMotion.hpp"
+
+TEST(linear) {
+    struct trackpoint_acceleration accel;
+    int64_t remainder = 0;
+    
+    trackpoint_set_acceleration(&accel, 100, 0, 0);
+    CHECK_EQUAL(5, trackpoint_accelerate(&accel, 5, &remainder));
+    CHECK_EQUAL(-70, trackpoint_accelerate(&accel, -70, &remainder));
+    CHECK_EQUAL(0, remainder);
+}
+
+TEST(sub_pixel_accumulation) {
+    struct trackpoint_acceleration accel;
+    int64_t remainder = 0;
+    int moved = 0;
+    
+    // half a pixel per count: two packets of one count move one pixel
+    trackpoint_set_acceleration(&accel, 50, 0, 0);
+    for (int i = 0; i < 10; i++)
+        moved += trackpoint_accelerate(&accel, 1, &remainder);
+    CHECK_EQUAL(5, moved);
+    
+    // a reversal is not slowed down by the remainder of the other direction
+    trackpoint_accelerate(&accel, 1, &remainder);
+    CHECK(remainder > 0);
+    CHECK_EQUAL(-1, trackpoint_accelerate(&accel, -2, &remainder));
+}
+
+TEST(deadzone) {
+    struct trackpoint_acceleration accel;
+    int64_t remainder = 0;
+    
+    trackpoint_set_acceleration(&accel, 100, 0, 2);
+    CHECK_EQUAL(0, trackpoint_accelerate(&accel, 2, &remainder));
+    CHECK_EQUAL(0, trackpoint_accelerate(&accel, -2, &remainder));
+    // movement beyond the deadzone starts at zero
+    CHECK_EQUAL(1, trackpoint_accelerate(&accel, 3, &remainder));
+    CHECK_EQUAL(-4, trackpoint_accelerate(&accel, -6, &remainder));
+}
+
+TEST(acceleration_curve) {
+    struct trackpoint_acceleration accel;
+    int64_t remainder = 0;
+    
+    // 100% added per TRACKPOINT_ACCEL_KNEE counts
+    trackpoint_set_acceleration(&accel, 100, 100, 0);
+    CHECK_EQUAL(1, trackpoint_accelerate(&accel, 1, &remainder));
+    remainder = 0;
+    CHECK_EQUAL(2 * TRACKPOINT_ACCEL_KNEE, trackpoint_accelerate(&accel, TRACKPOINT_ACCEL_KNEE, &remainder));
+    
+    // the gain is capped, as are deltas beyond the table
+    remainder = 0;
+    CHECK_EQUAL(1000 * TRACKPOINT_ACCEL_MAX_GAIN, trackpoint_accelerate(&accel, 1000, &remainder));
+}
+
+/* 1 ms in absolute time, which is nanoseconds on the host */
+#define MS      1000000ULL
+
+TEST(scroll_rate_cap) {
+    struct trackpoint_scroll scroll;
+    struct trackpoint_scroll_event event;
+    int events = 0, lines = 0;
+    
+    trackpoint_set_scrolling(&scroll, 100, 16 * MS, 100);
+    // the first movement is dispatched immediately
+    CHECK(trackpoint_scroll_update(&scroll, 0, 2, 1000 * MS, &event));
+    CHECK_EQUAL(2, event.lines_y);
+    CHECK_EQUAL(0, event.lines_x);
+    
+    // packets every 4 ms are merged into one event per interval
+    for (int i = 1; i <= 40; i++) {
+        if (trackpoint_scroll_update(&scroll, 0, 1, 1000 * MS + i * 4 * MS, &event)) {
+            events++;
+            lines += event.lines_y;
+        }
+    }
+    CHECK_EQUAL(10, events);
+    CHECK_EQUAL(40, lines);
+}
+
+TEST(scroll_sub_line_accumulation) {
+    struct trackpoint_scroll scroll;
+    struct trackpoint_scroll_event event;
+    int lines = 0;
+    
+    // a quarter line per count
+    trackpoint_set_scrolling(&scroll, 25, 10 * MS, 100);
+    for (int i = 0; i < 16; i++) {
+        if (trackpoint_scroll_update(&scroll, -1, 0, (i + 1) * 20 * MS, &event))
+            lines += event.lines_x;
+    }
+    CHECK_EQUAL(-4, lines);
+}
+
+TEST(scroll_without_momentum) {
+    struct trackpoint_scroll scroll;
+    struct trackpoint_scroll_event event;
+    
+    trackpoint_set_scrolling(&scroll, 100, 10 * MS, 100);
+    for (int i = 0; i < 5; i++)
+        trackpoint_scroll_update(&scroll, 0, 8, (i + 1) * 10 * MS, &event);
+    trackpoint_scroll_end(&scroll, 55 * MS, &event);
+    CHECK(!scroll.momentum);
+    CHECK(!trackpoint_scroll_momentum(&scroll, 60 * MS, &event));
+}
+
+/* Trackpoint reports of a middle button scroll, as recorded from a touchpad */
+static const uint8_t scroll_stream[][9] = {
+    { 0x00, 0x00, 0x5e, 0x04, 0x80, 0x80, 0x06, 0x00, 0x00 },
+    { 0x00, 0x00, 0x5e, 0x04, 0x80, 0x80, 0x06, 0x00, 0x02 },
+    { 0x00, 0x00, 0x5e, 0x04, 0x80, 0x80, 0x06, 0x00, 0x05 },
+    { 0x00, 0x00, 0x5e, 0x04, 0x80, 0x80, 0x06, 0x00, 0x06 },
+    { 0x00, 0x00, 0x5e, 0x04, 0x80, 0x80, 0x06, 0x00, 0x06 },
+    { 0x00, 0x00, 0x5e, 0x04, 0x80, 0x80, 0x06, 0x00, 0x05 },
+};
+
+TEST(scroll_momentum_from_recorded_stream) {
+    struct trackpoint_scroll scroll;
+    struct trackpoint_scroll_event event;
+    uint8_t report[ETP_MAX_REPORT_LEN] = {};
+    uint64_t now = 0;
+    int lines = 0, momentum_events = 0, momentum_lines = 0;
+    
+    trackpoint_set_scrolling(&scroll, 100, 16 * MS, 15);
+    for (const uint8_t* packet : scroll_stream) {
+        struct elan_trackpoint trackpoint;
+        
+        memcpy(report, packet, sizeof(scroll_stream[0]));
+        elan_decode_trackpoint(report, &trackpoint);
+        CHECK_EQUAL(0x04, trackpoint.buttons);
+        
+        now += 10 * MS;
+        if (trackpoint_scroll_update(&scroll, -trackpoint.x, -trackpoint.y, now, &event))
+            lines += event.lines_y;
+    }
+    if (trackpoint_scroll_end(&scroll, now, &event))
+        lines += event.lines_y;
+    CHECK(lines > 0);
+    CHECK(scroll.momentum);
+    
+    // the momentum is deterministic and slows down until it stops
+    int64_t velocity = scroll.velocity_y;
+    while (scroll.momentum && momentum_events < 100) {
+        now += 16 * MS;
+        if (trackpoint_scroll_momentum(&scroll, now, &event)) {
+            CHECK(event.lines_y > 0);
+            CHECK(scroll.velocity_y < velocity);
+            velocity = scroll.velocity_y;
+            momentum_events++;
+            momentum_lines += event.lines_y;
+        }
+    }
+    CHECK(!scroll.momentum);
+    CHECK(momentum_events > 3);
+    CHECK(momentum_lines > lines);
+    
+    // a new scroll starts from rest
+    CHECK(!trackpoint_scroll_momentum(&scroll, now + 16 * MS, &event));
+}
+
+TEST(scroll_stops_momentum) {
+    struct trackpoint_scroll scroll;
+    struct trackpoint_scroll_event event;
+    
+    trackpoint_set_scrolling(&scroll, 100, 10 * MS, 10);
+    for (int i = 0; i < 5; i++)
+        trackpoint_scroll_update(&scroll, 0, 8, (i + 1) * 10 * MS, &event);
+    trackpoint_scroll_end(&scroll, 55 * MS, &event);
+    CHECK(scroll.momentum);
+    
+    trackpoint_scroll_stop(&scroll);
+    CHECK(!scroll.momentum);
+    CHECK(!trackpoint_scroll_momentum(&scroll, 70 * MS, &event));
+    
+    // releasing the button after a pause doesn't start momentum
+    trackpoint_scroll_update(&scroll, 0, 8, 100 * MS, &event);
+    trackpoint_scroll_update(&scroll, 0, 8, 110 * MS, &event);
+    trackpoint_scroll_end(&scroll, 500 * MS, &event);
+    CHECK(!scroll.momentum);
+}
@@ -0,0 +1,301 @@
+/*
+ * ELANReplay.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+/*
+ * Feeds report traces exported by the kext (see "Recording reports" in the
+ * README) through the decoder of the kext at full speed. It measures the
+ * decode throughput and prints a hash of the decoded events, so the output of
+ * two versions of the decoder can be compared on the same trace. With --dump
+ * it prints every decoded event, one per line, for diffing.
+ *
+ * With --palm the contacts also go through the palm classifier of the kext,
+ * and every contact is summarized when it is lifted: how many frames it
+ * touched and in which frame it was classified as palm. The thresholds can be
+ * overridden to evaluate other settings on the same trace.
+ *
+ * With --keep-alive the touchpad frames go through the filter of unchanged
+ * frames with the given interval in ms, and the frames that would have been
+ * sent to the multitouch interface are counted.
+ *
+ *   elan-replay [--dump] [--repeat N] [--max-x X] [--max-y Y]
+ *               [--palm] [--palm-width W] [--palm-pressure P] [--palm-edge-zone Z]
+ *               [--palm-edge-width W] [--pressure-adjustment A] [--keep-alive MS] trace.bin
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include "ELANReport.hpp"
+#include "ELANContact.hpp"
+#include "ReportTrace.hpp"
+
+struct replay_options {
+    bool dump = false;
+    unsigned int repeat = 1;
+    /* Touchpad size used to check the finger records */
+    unsigned int max_x = 0xfff;
+    unsigned int max_y = 0xfff;
+    /* Palm classifier, disabled unless --palm is given */
+    struct elan_palm_configuration palm;
+    int pressure_adjustment = 0;
+    /* Keep alive interval of the frame filter in ns, 0 unless --keep-alive is given */
+    uint64_t keep_alive = 0;
+};
+
+struct replay_statistics {
+    uint64_t reports = 0;
+    uint64_t rejected[ETP_REPORT_ERRORS] = {};
+    uint64_t touchpad = 0;
+    uint64_t trackpoint = 0;
+    /* Palm classification */
+    struct elan_contact_state contacts[ETP_MAX_FINGERS] = {};
+    unsigned int palm_frame[ETP_MAX_FINGERS] = {};
+    uint64_t contact_count = 0;
+    uint64_t palm_contacts = 0;
+    uint64_t contact_frames = 0;
+    uint64_t palm_frames = 0;
+    /* Frames sent to the multitouch interface */
+    struct elan_frame_filter frames = {};
+    /* FNV-1a hash of the decoded events */
+    uint64_t hash = 14695981039346656037ULL;
+};
+
+static void hash_value(struct replay_statistics *statistics, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        statistics->hash ^= (value >> (8 * i)) & 0xff;
+        statistics->hash *= 1099511628211ULL;
+    }
+}
+
+static uint64_t monotonic_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Classifies a touching contact, @return true if it is a palm */
+static bool replay_contact(int slot, const struct elan_finger *finger, uint64_t time,
+                           const struct replay_options *options, struct replay_statistics *statistics) {
+    struct elan_contact_state *contact = &statistics->contacts[slot];
+    unsigned int pressure = elan_adjust_pressure(finger->pressure, options->pressure_adjustment);
+    unsigned int width = finger->mk_x > finger->mk_y ? finger->mk_x : finger->mk_y;
+    
+    elan_contact_touch(contact, finger->pos_x, finger->pos_y, time);
+    if (contact->frames == 1) {
+        statistics->contact_count++;
+        statistics->palm_frame[slot] = 0;
+    }
+    statistics->contact_frames++;
+    
+    contact->palm = elan_is_palm(contact, &options->palm, options->max_x, finger->pos_x, finger->pos_y, width, pressure);
+    if (contact->palm) {
+        statistics->palm_frames++;
+        if (!statistics->palm_frame[slot]) {
+            statistics->palm_frame[slot] = contact->frames;
+            statistics->palm_contacts++;
+        }
+    }
+    return contact->palm;
+}
+
+static void lift_contact(int slot, uint64_t time, const struct replay_options *options, struct replay_statistics *statistics) {
+    struct elan_contact_state *contact = &statistics->contacts[slot];
+    
+    if (!contact->touching)
+        return;
+    if (options->dump) {
+        if (statistics->palm_frame[slot])
+            printf("%llu lifted %d after %u frames, palm from frame %u\n", (unsigned long long) time, slot,
+                   contact->frames, statistics->palm_frame[slot]);
+        else
+            printf("%llu lifted %d after %u frames\n", (unsigned long long) time, slot, contact->frames);
+    }
+    elan_contact_lift(contact);
+}
+
+static const char *error_names[ETP_REPORT_ERRORS] = {
+    "ok", "bad-id", "bad-finger-data", "position-jump", "bad-finger-count"
+};
+
+static void replay_report(const struct report_trace_record *record, uint64_t start_ns,
+                          const struct replay_options *options, struct replay_statistics *statistics) {
+    const uint8_t *report = record->report;
+    uint64_t time = record->notify_ns - start_ns;
+    
+    statistics->reports++;
+    enum elan_report_error error = elan_validate_report(report, statistics->contacts, options->max_x, options->max_y);
+    if (error != ETP_REPORT_OK) {
+        statistics->rejected[error]++;
+        if (options->dump)
+            printf("%llu rejected %s id 0x%02x\n", (unsigned long long) time, error_names[error], report[ETP_REPORT_ID_OFFSET]);
+        return;
+    }
+    
+    switch (report[ETP_REPORT_ID_OFFSET]) {
+        case ETP_REPORT_ID: {
+            const uint8_t *finger_data = &report[ETP_FINGER_DATA_OFFSET];
+            bool hovering = elan_is_hovering(report);
+            unsigned int touching = 0;
+            statistics->touchpad++;
+            hash_value(statistics, hovering);
+            for (int i = 0; i < ETP_MAX_FINGERS; i++) {
+                if (!elan_finger_valid(report, i)) {
+                    if (options->palm.enabled)
+                        lift_contact(i, time, options, statistics);
+                    continue;
+                }
+                
+                struct elan_finger finger;
+                elan_decode_finger(finger_data, &finger);
+                finger_data += ETP_FINGER_DATA_LEN;
+                bool palm = options->palm.enabled && replay_contact(i, &finger, time, options, statistics);
+                if (!hovering && !palm)
+                    touching++;
+                hash_value(statistics, i | palm << 8);
+                hash_value(statistics, finger.pos_x | (uint64_t) finger.pos_y << 16 |
+                           (uint64_t) finger.mk_x << 32 | (uint64_t) finger.mk_y << 40 | (uint64_t) finger.pressure << 48);
+                if (options->dump)
+                    printf("%llu finger %d x %u y %u width %u %u pressure %u%s%s\n", (unsigned long long) time, i,
+                           finger.pos_x, finger.pos_y, finger.mk_x, finger.mk_y, finger.pressure,
+                           hovering ? " hover" : "", palm ? " palm" : "");
+            }
+            if (options->keep_alive)
+                elan_frame_dispatch(&statistics->frames, report, touching, record->notify_ns, options->keep_alive);
+            break;
+        }
+        case ETP_TP_REPORT_ID: {
+            struct elan_trackpoint trackpoint;
+            elan_decode_trackpoint(report, &trackpoint);
+            statistics->trackpoint++;
+            hash_value(statistics, (uint32_t) trackpoint.x | (uint64_t) (uint32_t) trackpoint.y << 32);
+            hash_value(statistics, trackpoint.buttons);
+            if (options->dump)
+                printf("%llu trackpoint x %d y %d buttons %d\n", (unsigned long long) time,
+                       trackpoint.x, trackpoint.y, trackpoint.buttons);
+            break;
+        }
+    }
+}
+
+static bool read_file(const char *path, std::vector<uint8_t> *contents) {
+    FILE *file = fopen(path, "rb");
+    if (!file)
+        return false;
+    
+    uint8_t buffer[65536];
+    size_t length;
+    while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        contents->insert(contents->end(), buffer, buffer + length);
+    bool ok = !ferror(file);
+    fclose(file);
+    return ok;
+}
+
+static int usage(const char *name) {
+    fprintf(stderr, "usage: %s [--dump] [--repeat N] [--max-x X] [--max-y Y]\n"
+                    "       [--palm] [--palm-width W] [--palm-pressure P] [--palm-edge-zone Z]\n"
+                    "       [--palm-edge-width W] [--pressure-adjustment A] [--keep-alive MS] trace.bin\n", name);
+    return 2;
+}
+
+int main(int argc, char **argv) {
+    struct replay_options options;
+    const char *path = NULL;
+    
+    elan_palm_defaults(&options.palm);
+    options.palm.enabled = false;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--dump"))
+            options.dump = true;
+        else if (!strcmp(argv[i], "--repeat") && i + 1 < argc)
+            options.repeat = (unsigned int) strtoul(argv[++i], NULL, 0);
+        else if (!strcmp(argv[i], "--max-x") && i + 1 < argc)
+            options.max_x = (unsigned int) strtoul(argv[++i], NULL, 0);
+        else if (!strcmp(argv[i], "--max-y") && i + 1 < argc)
+            options.max_y = (unsigned int) strtoul(argv[++i], NULL, 0);
+        else if (!strcmp(argv[i], "--palm"))
+            options.palm.enabled = true;
+        else if (!strcmp(argv[i], "--palm-width") && i + 1 < argc)
+            options.palm.width = strtoull(argv[++i], NULL, 0);
+        else if (!strcmp(argv[i], "--palm-pressure") && i + 1 < argc)
+            options.palm.pressure = strtoull(argv[++i], NULL, 0);
+        else if (!strcmp(argv[i], "--palm-edge-zone") && i + 1 < argc)
+            options.palm.edge_zone = strtoull(argv[++i], NULL, 0);
+        else if (!strcmp(argv[i], "--palm-edge-width") && i + 1 < argc)
+            options.palm.edge_width = strtoull(argv[++i], NULL, 0);
+        else if (!strcmp(argv[i], "--pressure-adjustment") && i + 1 < argc)
+            options.pressure_adjustment = (int) strtol(argv[++i], NULL, 0);
+        else if (!strcmp(argv[i], "--keep-alive") && i + 1 < argc)
+            options.keep_alive = strtoull(argv[++i], NULL, 0) * 1000000;
+        else if (argv[i][0] != '-' && !path)
+            path = argv[i];
+        else
+            return usage(argv[0]);
+    }
+    if (!path || options.repeat == 0)
+        return usage(argv[0]);
+    
+    std::vector<uint8_t> trace;
+    if (!read_file(path, &trace)) {
+        perror(path);
+        return 1;
+    }
+    
+    uint32_t count;
+    const struct report_trace_record *records = report_trace_parse(trace.data(), trace.size(), &count);
+    if (!records) {
+        fprintf(stderr, "%s: not a report trace of version %d\n", path, REPORT_TRACE_VERSION);
+        return 1;
+    }
+    
+    // the records may be unaligned in the file
+    std::vector<struct report_trace_record> aligned(records, records + count);
+    struct replay_statistics statistics;
+    uint64_t start_ns = count ? aligned[0].notify_ns : 0;
+    uint64_t begin = monotonic_ns();
+    for (unsigned int pass = 0; pass < options.repeat; pass++) {
+        for (uint32_t i = 0; i < count; i++)
+            replay_report(&aligned[i], start_ns, &options, &statistics);
+        // every pass starts without contacts
+        for (int i = 0; options.palm.enabled && count && i < ETP_MAX_FINGERS; i++)
+            lift_contact(i, aligned[count - 1].notify_ns - start_ns, &options, &statistics);
+        // only the first pass is dumped
+        options.dump = false;
+    }
+    uint64_t elapsed = monotonic_ns() - begin;
+    
+    uint64_t rejected = 0;
+    for (int i = 0; i < ETP_REPORT_ERRORS; i++)
+        rejected += statistics.rejected[i];
+    fprintf(stderr, "reports %llu touchpad %llu trackpoint %llu rejected %llu (bad id %llu, bad finger data %llu, "
+                    "bad finger count %llu, position jump %llu)\n",
+            (unsigned long long) statistics.reports, (unsigned long long) statistics.touchpad,
+            (unsigned long long) statistics.trackpoint, (unsigned long long) rejected,
+            (unsigned long long) statistics.rejected[ETP_REPORT_BAD_ID],
+            (unsigned long long) statistics.rejected[ETP_REPORT_BAD_FINGER_DATA],
+            (unsigned long long) statistics.rejected[ETP_REPORT_BAD_FINGER_COUNT],
+            (unsigned long long) statistics.rejected[ETP_REPORT_POSITION_JUMP]);
+    if (statistics.reports)
+        fprintf(stderr, "%.1f ns/report, %.0f reports/s\n", (double) elapsed / statistics.reports,
+                elapsed ? statistics.reports * 1e9 / elapsed : 0.0);
+    if (options.palm.enabled)
+        fprintf(stderr, "contacts %llu palm %llu, frames %llu palm %llu (%.1f%%)\n",
+                (unsigned long long) statistics.contact_count, (unsigned long long) statistics.palm_contacts,
+                (unsigned long long) statistics.contact_frames, (unsigned long long) statistics.palm_frames,
+                statistics.contact_frames ? 100.0 * statistics.palm_frames / statistics.contact_frames : 0.0);
+    if (options.keep_alive) {
+        uint64_t frames = statistics.frames.dispatched + statistics.frames.suppressed;
+        uint64_t duration_ns = count ? (aligned[count - 1].notify_ns - start_ns) * options.repeat : 0;
+        fprintf(stderr, "frames %llu dispatched %llu suppressed %llu (%.1f%%), %.1f dispatched/s\n",
+                (unsigned long long) frames, (unsigned long long) statistics.frames.dispatched,
+                (unsigned long long) statistics.frames.suppressed,
+                frames ? 100.0 * statistics.frames.suppressed / frames : 0.0,
+                duration_ns ? statistics.frames.dispatched * 1e9 / duration_ns : 0.0);
+    }
+    fprintf(stderr, "events %016llx\n", (unsigned long long) statistics.hash);
+    return 0;
+}
@@ -13,26 +13,97 @@ bool Configuration::loadBoolConfiguration(IOService* service, const char* config
     OSDictionary *configuration;
     configuration = OSDynamicCast(OSDictionary, service->getProperty("Configuration"));
     
-    if (configuration) {
-        OSBoolean* value = OSDynamicCast(OSBoolean, configuration->getObject(configurationKey));
-        if (value != nullptr) {
-            return value->getValue();
-        }
+    bool value = defaultValue;
+    if (configuration && !readBool(configuration, configurationKey, &value)) {
+        IOLog("%s Invalid value for configuration %s\n", service->getName(), configurationKey);
+        return defaultValue;
     }
     
-    return defaultValue;
+    return value;
 }
 
 UInt64 Configuration::loadUInt64Configuration(IOService* service, const char* configurationKey, UInt64 defaultValue) {
     OSDictionary *configuration;
     configuration = OSDynamicCast(OSDictionary, service->getProperty("Configuration"));
     
-    if (configuration) {
-        OSNumber* value = OSDynamicCast(OSNumber, configuration->getObject(configurationKey));
-        if (value != nullptr) {
-            return value->unsigned64BitValue();
+    UInt64 value = defaultValue;
+    if (configuration && !readUInt64(configuration, configurationKey, &value)) {
+        IOLog("%s Invalid value for configuration %s\n", service->getName(), configurationKey);
+        return defaultValue;
+    }
+    
+    return value;
+}
+
+bool Configuration::readBool(OSDictionary* configuration, const char* configurationKey, bool* value) {
+    OSObject* object = configuration->getObject(configurationKey);
+    if (!object)
+        return true;
+    
+    OSBoolean* boolean = OSDynamicCast(OSBoolean, object);
+    if (boolean) {
+        *value = boolean->getValue();
+        return true;
+    }
+    
+    OSNumber* number = OSDynamicCast(OSNumber, object);
+    if (number) {
+        *value = number->unsigned64BitValue() != 0;
+        return true;
+    }
+    
+    return false;
+}
+
+UInt32 Configuration::loadUInt64ArrayConfiguration(IOService* service, const char* configurationKey, UInt64* values, UInt32 capacity) {
+    OSDictionary *configuration;
+    configuration = OSDynamicCast(OSDictionary, service->getProperty("Configuration"));
+    if (!configuration || !configuration->getObject(configurationKey))
+        return 0;
+    
+    OSArray* array = OSDynamicCast(OSArray, configuration->getObject(configurationKey));
+    if (!array) {
+        IOLog("%s Invalid value for configuration %s\n", service->getName(), configurationKey);
+        return 0;
+    }
+    
+    UInt32 count = 0;
+    for (unsigned int i = 0; i < array->getCount() && count < capacity; i++) {
+        if (convertUInt64(array->getObject(i), &values[count]))
+            count++;
+        else
+            IOLog("%s Invalid value at index %u of configuration %s\n", service->getName(), i, configurationKey);
+    }
+    
+    return count;
+}
+
+bool Configuration::readUInt64(OSDictionary* configuration, const char* configurationKey, UInt64* value) {
+    OSObject* object = configuration->getObject(configurationKey);
+    if (!object)
+        return true;
+    
+    return convertUInt64(object, value);
+}
+
+bool Configuration::convertUInt64(OSObject* object, UInt64* value) {
+    OSNumber* number = OSDynamicCast(OSNumber, object);
+    if (number) {
+        *value = number->unsigned64BitValue();
+        return true;
+    }
+    
+    // plists edited by hand often contain numbers as strings
+    OSString* string = OSDynamicCast(OSString, object);
+    if (string && string->getLength()) {
+        const char* text = string->getCStringNoCopy();
+        char* end;
+        UInt64 parsed = strtoul(text, &end, 0);
+        if (*end == '\0' && text[0] != '-') {
+            *value = parsed;
+            return true;
         }
     }
     
-    return defaultValue;
+    return false;
 }
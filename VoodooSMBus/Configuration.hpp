@@ -18,8 +18,25 @@ public:
     static bool loadBoolConfiguration(IOService* service, const char* configurationKey, bool defaultValue);
     static UInt64 loadUInt64Configuration(IOService* service, const char* configurationKey, UInt64 defaultValue);
     
+    /*
+     * Loads an array of numbers, invalid elements are skipped
+     * @return Number of values stored, 0 if the key does not exist
+     */
+    static UInt32 loadUInt64ArrayConfiguration(IOService* service, const char* configurationKey, UInt64* values, UInt32 capacity);
+    
+    /*
+     * Reads a value from a configuration dictionary. Numbers may also be given
+     * as strings and booleans as numbers. The value is left unchanged if the
+     * key does not exist.
+     * @return false if the key exists but its value can not be converted
+     */
+    static bool readBool(OSDictionary* configuration, const char* configurationKey, bool* value);
+    static bool readUInt64(OSDictionary* configuration, const char* configurationKey, UInt64* value);
+    
 private:
     Configuration() {}
+    
+    static bool convertUInt64(OSObject* object, UInt64* value);
 
 };
 
@@ -0,0 +1,100 @@
+/*
+ * ELANContact.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include "ELANContact.hpp"
+
+void elan_contact_touch(struct elan_contact_state *contact, unsigned int pos_x, unsigned int pos_y, uint64_t timestamp) {
+    if (!contact->touching) {
+        contact->touching = true;
+        contact->palm = false;
+        contact->frames = 0;
+        contact->last_x = pos_x;
+        contact->last_y = pos_y;
+        contact->ts_moved = timestamp;
+    }
+    contact->frames++;
+}
+
+void elan_contact_lift(struct elan_contact_state *contact) {
+    contact->touching = false;
+    contact->palm = false;
+}
+
+bool elan_is_palm(struct elan_contact_state *contact, const struct elan_palm_configuration *config,
+                  unsigned int max_x, unsigned int pos_x, unsigned int pos_y, unsigned int width, unsigned int pressure) {
+    if (contact->palm)
+        return true;
+    
+    // contacts that are large or pressed down very hard are palms or thumbs
+    if (width >= config->width)
+        return true;
+    if (pressure >= config->pressure && width >= config->edge_width)
+        return true;
+    
+    // a wide contact landing at the left, right or bottom edge is most likely
+    // the heel of the hand resting on the touchpad while typing
+    if (contact->frames == 1) {
+        contact->started_at_edge = pos_x < config->edge_zone ||
+                                   pos_x + config->edge_zone > max_x ||
+                                   pos_y < config->edge_zone;
+    }
+    if (contact->started_at_edge && width >= config->edge_width)
+        return true;
+    
+    return false;
+}
+
+enum elan_report_error elan_validate_report(const uint8_t *report, struct elan_contact_state *contacts,
+                                            unsigned int max_x, unsigned int max_y) {
+    uint8_t report_id = report[ETP_REPORT_ID_OFFSET];
+    enum elan_report_error error;
+    
+    if (report_id == ETP_TP_REPORT_ID)
+        return ETP_REPORT_OK;
+    
+    error = report_id == ETP_REPORT_ID ? elan_check_fingers(report, max_x, max_y) : ETP_REPORT_BAD_ID;
+    if (error != ETP_REPORT_OK) {
+        elan_reset_references(contacts);
+        return error;
+    }
+    
+    const uint8_t *finger_data = &report[ETP_FINGER_DATA_OFFSET];
+    unsigned int max_jump_x = max_x / ETP_MAX_POSITION_JUMP_DIVIDER;
+    unsigned int max_jump_y = max_y / ETP_MAX_POSITION_JUMP_DIVIDER;
+    struct elan_finger finger;
+    
+    for (int i = 0; i < ETP_MAX_FINGERS; i++) {
+        struct elan_contact_state *contact = &contacts[i];
+        
+        // a lift ends the reference, the next touch may land anywhere
+        if (!elan_finger_valid(report, i)) {
+            contact->has_reference = false;
+            continue;
+        }
+        
+        elan_decode_finger(finger_data, &finger);
+        finger_data += ETP_FINGER_DATA_LEN;
+        
+        // a palm may roll across the touchpad, it is not reported anyway
+        if (contact->has_reference && !contact->palm) {
+            unsigned int dx = finger.pos_x > contact->reference_x ? finger.pos_x - contact->reference_x : contact->reference_x - finger.pos_x;
+            unsigned int dy = finger.pos_y > contact->reference_y ? finger.pos_y - contact->reference_y : contact->reference_y - finger.pos_y;
+            if (dx > max_jump_x || dy > max_jump_y)
+                error = ETP_REPORT_POSITION_JUMP;
+        }
+        
+        contact->has_reference = true;
+        contact->reference_x = finger.pos_x;
+        contact->reference_y = finger.pos_y;
+    }
+    
+    return error;
+}
+
+void elan_reset_references(struct elan_contact_state *contacts) {
+    for (int i = 0; i < ETP_MAX_FINGERS; i++)
+        contacts[i].has_reference = false;
+}
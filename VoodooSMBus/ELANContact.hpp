@@ -0,0 +1,107 @@
+/*
+ * ELANContact.hpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#ifndef ELANContact_hpp
+#define ELANContact_hpp
+
+/*
+ * History and palm classification of touchpad contacts. This file must not
+ * depend on IOKit, so the classifier can be evaluated on recorded reports
+ * outside of the kext.
+ */
+#include <stdint.h>
+#include "ELANReport.hpp"
+
+#define ETP_MAX_PRESSURE                    255
+
+/* Default thresholds of the palm classifier */
+#define ETP_PALM_WIDTH                      10
+#define ETP_PALM_PRESSURE                   230
+#define ETP_PALM_EDGE_ZONE                  150
+#define ETP_PALM_EDGE_WIDTH                 6
+
+/* Thresholds of the palm classifier, widths are in sensor traces */
+struct elan_palm_configuration {
+    bool                enabled;
+    /* contacts at least this wide are palms */
+    uint64_t            width;
+    /* contacts pressing at least this hard and at least edge_width wide are palms */
+    uint64_t            pressure;
+    /* size of the zone at the left, right and bottom edge in touchpad units */
+    uint64_t            edge_zone;
+    /* contacts landing in the edge zone at least this wide are palms */
+    uint64_t            edge_width;
+};
+
+/* Per-finger history used to classify a contact as palm */
+struct elan_contact_state {
+    bool                touching;
+    bool                palm;
+    unsigned int        frames;
+    bool                started_at_edge;
+    /* Position and time of the last movement, used to detect phantom contacts */
+    unsigned int        last_x;
+    unsigned int        last_y;
+    uint64_t            ts_moved;
+    /* Position in the last validated frame, the reference of the position jump check */
+    bool                has_reference;
+    unsigned int        reference_x;
+    unsigned int        reference_y;
+};
+
+static inline void elan_palm_defaults(struct elan_palm_configuration *config) {
+    config->enabled = true;
+    config->width = ETP_PALM_WIDTH;
+    config->pressure = ETP_PALM_PRESSURE;
+    config->edge_zone = ETP_PALM_EDGE_ZONE;
+    config->edge_width = ETP_PALM_EDGE_WIDTH;
+}
+
+/* Applies the pressure adjustment of the device and clamps the result to ETP_MAX_PRESSURE */
+static inline unsigned int elan_adjust_pressure(unsigned int pressure, int adjustment) {
+    int scaled = (int) pressure + adjustment;
+    if (scaled < 0)
+        return 0;
+    return scaled > ETP_MAX_PRESSURE ? ETP_MAX_PRESSURE : (unsigned int) scaled;
+}
+
+/* Counts a frame the contact touches in, a contact that lands starts a new history */
+void elan_contact_touch(struct elan_contact_state *contact, unsigned int pos_x, unsigned int pos_y, uint64_t timestamp);
+
+/* The contact was lifted */
+void elan_contact_lift(struct elan_contact_state *contact);
+
+/*
+ * Classifies a touching contact as palm. Once a contact is classified as palm
+ * it stays a palm until it is lifted, so a resting palm can not flicker back
+ * into a finger and trigger gestures.
+ * @max_x Width of the touchpad
+ * @width Larger of the widths in sensor traces
+ * @pressure Adjusted pressure
+ */
+bool elan_is_palm(struct elan_contact_state *contact, const struct elan_palm_configuration *config,
+                  unsigned int max_x, unsigned int pos_x, unsigned int pos_y, unsigned int width, unsigned int pressure);
+
+/*
+ * Checks a report before it is decoded. A corrupted report, e.g. with a lost
+ * byte or a stale block buffer, would otherwise move the pointer to a random
+ * position. A finger can not jump across the touchpad between two frames, the
+ * positions of every touchpad report that passed the other checks become the
+ * reference for the next one, so a finger that really moved there is accepted
+ * with the next frame.
+ * @contacts ETP_MAX_FINGERS contacts, their references are updated
+ * @return ETP_REPORT_OK or the reason the report has to be dropped
+ */
+enum elan_report_error elan_validate_report(const uint8_t *report, struct elan_contact_state *contacts,
+                                            unsigned int max_x, unsigned int max_y);
+
+/*
+ * Forgets the positions of the last frame. Frames that are not read or
+ * dropped may have moved the fingers anywhere.
+ */
+void elan_reset_references(struct elan_contact_state *contacts);
+
+#endif /* ELANContact_hpp */
@@ -0,0 +1,87 @@
+/*
+ * ELANFirmware.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include <string.h>
+#include "ELANFirmware.hpp"
+
+// elan_get_fwinfo
+int elan_get_fwinfo(u16 ic_type, u8 iap_version, struct elan_fw_info *info) {
+    switch (ic_type) {
+        case 0x00:
+        case 0x06:
+        case 0x08:
+            info->validpage_count = 512;
+            break;
+        case 0x03:
+        case 0x07:
+        case 0x09:
+        case 0x0A:
+        case 0x0B:
+        case 0x0C:
+            info->validpage_count = 768;
+            break;
+        case 0x0D:
+            info->validpage_count = 896;
+            break;
+        case 0x0E:
+            info->validpage_count = 640;
+            break;
+        case 0x10:
+            info->validpage_count = 1024;
+            break;
+        case 0x11:
+            info->validpage_count = 1280;
+            break;
+        case 0x13:
+            info->validpage_count = 2048;
+            break;
+        case 0x14:
+        case 0x15:
+            info->validpage_count = 1024;
+            break;
+        default:
+            /* unknown ic type clear value */
+            info->validpage_count = 0;
+            info->signature_address = 0;
+            info->page_size = 0;
+            return -ENXIO;
+    }
+    
+    info->signature_address = (info->validpage_count * ETP_FW_PAGE_SIZE) - ETP_FW_SIGNATURE_SIZE;
+    
+    if ((ic_type == 0x14 || ic_type == 0x15) && iap_version >= 2) {
+        info->validpage_count /= 8;
+        info->page_size = ETP_FW_PAGE_SIZE_512;
+    } else if (ic_type >= 0x0D && iap_version >= 1) {
+        info->validpage_count /= 2;
+        info->page_size = ETP_FW_PAGE_SIZE_128;
+    } else {
+        info->page_size = ETP_FW_PAGE_SIZE;
+    }
+    
+    return 0;
+}
+
+int elan_check_firmware(const u8 *image, size_t size, const struct elan_fw_info *info, int *boot_page_count) {
+    static const u8 signature[ETP_FW_SIGNATURE_SIZE] = { 0xAA, 0x55, 0xCC, 0x33, 0xFF, 0xFF };
+    
+    if (!image || !info->page_size ||
+        size < (size_t) info->validpage_count * info->page_size ||
+        size < info->signature_address + ETP_FW_SIGNATURE_SIZE ||
+        size < ETP_IAP_START_ADDR * 2 + 2)
+        return -EINVAL;
+    
+    // an image for another IC type has its signature elsewhere
+    if (memcmp(&image[info->signature_address], signature, ETP_FW_SIGNATURE_SIZE))
+        return -EINVAL;
+    
+    u16 iap_start_addr = image[ETP_IAP_START_ADDR * 2] | (image[ETP_IAP_START_ADDR * 2 + 1] << 8);
+    *boot_page_count = (iap_start_addr * 2) / info->page_size;
+    if (*boot_page_count >= info->validpage_count)
+        return -EINVAL;
+    
+    return 0;
+}
@@ -0,0 +1,48 @@
+/*
+ * ELANFirmware.hpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#ifndef ELANFirmware_hpp
+#define ELANFirmware_hpp
+
+/*
+ * Checks of ELAN firmware images against the device they are written to.
+ */
+#include "smbus_platform.h"
+
+/* from https://github.com/torvalds/linux/blob/master/drivers/input/mouse/elan_i2c.h */
+#define ETP_FW_PAGE_SIZE                    64
+#define ETP_FW_PAGE_SIZE_128                128
+#define ETP_FW_PAGE_SIZE_512                512
+#define ETP_IAP_START_ADDR                  0x0083
+#define ETP_FW_SIGNATURE_SIZE               6
+
+/* Flash layout of a device */
+struct elan_fw_info {
+    /* Number of pages of the firmware, including the boot pages */
+    u16                 validpage_count;
+    /* Offset of the signature in the image */
+    u32                 signature_address;
+    u16                 page_size;
+};
+
+/*
+ * Looks up the flash layout of a device, elan_get_fwinfo in Linux
+ * @ic_type IC type, as read with ETP_SMBUS_SM_VERSION_CMD
+ * @iap_version IAP version, as read with ETP_SMBUS_IAP_VERSION_CMD
+ * @return 0 or -ENXIO for an unknown IC type
+ */
+int elan_get_fwinfo(u16 ic_type, u8 iap_version, struct elan_fw_info *info);
+
+/*
+ * Checks that a firmware image fits the flash layout of the device: it has to
+ * cover all valid pages, carry the signature at the signature address of the
+ * device and start the application after the boot pages.
+ * @boot_page_count Number of pages before the IAP start address, which are not written
+ * @return 0 or -EINVAL
+ */
+int elan_check_firmware(const u8 *image, size_t size, const struct elan_fw_info *info, int *boot_page_count);
+
+#endif /* ELANFirmware_hpp */
@@ -0,0 +1,78 @@
+/*
+ * ELANReport.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include <string.h>
+#include "ELANReport.hpp"
+
+// elan_report_contact
+void elan_decode_finger(const uint8_t *finger_data, struct elan_finger *finger) {
+    finger->pos_x = ((finger_data[0] & 0xf0) << 4) | finger_data[1];
+    finger->pos_y = ((finger_data[0] & 0x0f) << 8) | finger_data[2];
+    finger->mk_x = (finger_data[3] & 0x0f);
+    finger->mk_y = (finger_data[3] >> 4);
+    finger->pressure = finger_data[4];
+}
+
+// elan_report_trackpoint
+void elan_decode_trackpoint(const uint8_t *report, struct elan_trackpoint *trackpoint) {
+    const uint8_t *packet = &report[ETP_REPORT_ID_OFFSET + 1];
+    
+    trackpoint->buttons = packet[0] & 0x07;
+    trackpoint->x = 0;
+    trackpoint->y = 0;
+    if ((packet[3] & 0x0F) == 0x06) {
+        trackpoint->x = packet[4] - (int)((packet[1] ^ 0x80) << 1);
+        trackpoint->y = (int)((packet[2] ^ 0x80) << 1) - packet[5];
+    }
+}
+
+static bool finger_record_empty(const uint8_t *finger_data) {
+    for (int i = 0; i < ETP_FINGER_DATA_LEN; i++) {
+        if (finger_data[i])
+            return false;
+    }
+    return true;
+}
+
+enum elan_report_error elan_check_fingers(const uint8_t *report, unsigned int max_x, unsigned int max_y) {
+    const uint8_t *finger_data = &report[ETP_FINGER_DATA_OFFSET];
+    struct elan_finger finger;
+    int count = __builtin_popcount(report[ETP_TOUCH_INFO_OFFSET] & ETP_TOUCH_INFO_FINGERS);
+    
+    // a lost or stale byte shifts the records against the bitmap
+    for (int i = 0; i < ETP_MAX_FINGERS; i++) {
+        if (finger_record_empty(&finger_data[i * ETP_FINGER_DATA_LEN]) != (i >= count))
+            return ETP_REPORT_BAD_FINGER_COUNT;
+    }
+    
+    for (int i = 0; i < count; i++) {
+        elan_decode_finger(finger_data, &finger);
+        if (finger.pos_x > max_x || finger.pos_y > max_y)
+            return ETP_REPORT_BAD_FINGER_DATA;
+        
+        finger_data += ETP_FINGER_DATA_LEN;
+    }
+    
+    return ETP_REPORT_OK;
+}
+
+bool elan_frame_dispatch(struct elan_frame_filter *filter, const uint8_t *report,
+                         unsigned int contact_count, uint64_t timestamp, uint64_t keep_alive) {
+    const uint8_t *frame = &report[ETP_TOUCH_INFO_OFFSET];
+    
+    if (keep_alive && contact_count >= filter->last_contact_count &&
+        timestamp - filter->ts_dispatched < keep_alive &&
+        !memcmp(filter->last_frame, frame, ETP_FRAME_LEN)) {
+        filter->suppressed++;
+        return false;
+    }
+    
+    memcpy(filter->last_frame, frame, ETP_FRAME_LEN);
+    filter->last_contact_count = contact_count;
+    filter->ts_dispatched = timestamp;
+    filter->dispatched++;
+    return true;
+}
@@ -0,0 +1,113 @@
+/*
+ * ELANReport.hpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#ifndef ELANReport_hpp
+#define ELANReport_hpp
+
+/*
+ * Decoding of ELAN touchpad and trackpoint reports. This file must not depend
+ * on IOKit, so the decoder can be built and exercised outside of the kext.
+ */
+#include <stdint.h>
+
+/* Report layout, from https://github.com/torvalds/linux/blob/master/drivers/input/mouse/elan_i2c_core.c */
+#define ETP_MAX_FINGERS                     5
+#define ETP_FINGER_DATA_LEN                 5
+#define ETP_REPORT_ID                       0x5D
+#define ETP_TP_REPORT_ID                    0x5E
+#define ETP_REPORT_ID_OFFSET                2
+#define ETP_TOUCH_INFO_OFFSET               3
+#define ETP_FINGER_DATA_OFFSET              4
+#define ETP_HOVER_INFO_OFFSET               30
+#define ETP_HOVER_EVENT                     0x40
+#define ETP_TOUCH_INFO_FINGERS              0xf8
+#define ETP_MAX_REPORT_LEN                  34
+
+/* Part of a report that describes a touchpad frame, from touch info to hover info */
+#define ETP_FRAME_LEN                       (ETP_HOVER_INFO_OFFSET - ETP_TOUCH_INFO_OFFSET + 1)
+
+/* Fraction of the touchpad a finger may move between two frames */
+#define ETP_MAX_POSITION_JUMP_DIVIDER       3
+
+enum elan_report_error {
+    ETP_REPORT_OK,
+    ETP_REPORT_BAD_ID,
+    ETP_REPORT_BAD_FINGER_DATA,
+    ETP_REPORT_POSITION_JUMP,
+    ETP_REPORT_BAD_FINGER_COUNT,
+    ETP_REPORT_ERRORS
+};
+
+struct elan_finger {
+    unsigned int        pos_x;
+    unsigned int        pos_y;
+    unsigned int        mk_x;
+    unsigned int        mk_y;
+    unsigned int        pressure;
+};
+
+/* Last frame sent to the multitouch interface, unchanged frames are not sent again */
+struct elan_frame_filter {
+    uint8_t             last_frame[ETP_FRAME_LEN];
+    unsigned int        last_contact_count;
+    uint64_t            ts_dispatched;
+    uint64_t            dispatched;
+    uint64_t            suppressed;
+};
+
+struct elan_trackpoint {
+    int                 x;
+    int                 y;
+    /* bit 0 left, bit 1 right and bit 2 middle button */
+    int                 buttons;
+};
+
+/* Whether finger @finger is in the touch bitmap of a touchpad report */
+static inline bool elan_finger_valid(const uint8_t *report, int finger) {
+    return report[ETP_TOUCH_INFO_OFFSET] & (1U << (3 + finger));
+}
+
+/*
+ * The hover bit is only set while a finger is above the touchpad
+ * without touching it. The finger keeps its record and its bit in
+ * the touch bitmap.
+ */
+static inline bool elan_is_hovering(const uint8_t *report) {
+    return report[ETP_HOVER_INFO_OFFSET] & ETP_HOVER_EVENT;
+}
+
+/* Whether finger @finger is reported above the touchpad instead of touching it */
+static inline bool elan_finger_hovering(const uint8_t *report, int finger) {
+    return elan_finger_valid(report, finger) && elan_is_hovering(report);
+}
+
+/* Decodes a finger record of ETP_FINGER_DATA_LEN bytes */
+void elan_decode_finger(const uint8_t *finger_data, struct elan_finger *finger);
+
+/* Decodes a trackpoint report */
+void elan_decode_trackpoint(const uint8_t *report, struct elan_trackpoint *trackpoint);
+
+/*
+ * Checks the finger records of a touchpad report against the touch bitmap and
+ * the touchpad size. The records of the fingers in the bitmap are packed, so
+ * there is a record for every finger in the bitmap and the unused records are
+ * empty.
+ * @return ETP_REPORT_OK, ETP_REPORT_BAD_FINGER_COUNT or ETP_REPORT_BAD_FINGER_DATA
+ */
+enum elan_report_error elan_check_fingers(const uint8_t *report, unsigned int max_x, unsigned int max_y);
+
+/*
+ * Decides whether a touchpad frame is sent to the multitouch interface. A
+ * resting finger reports the same frame over and over again, which is only
+ * sent again after @keep_alive. A lifted contact always changes the frame, so
+ * it is never suppressed.
+ * @contact_count Contacts of the frame that touch the touchpad
+ * @keep_alive Absolute time, 0 sends every frame
+ */
+bool elan_frame_dispatch(struct elan_frame_filter *filter, const uint8_t *report,
+                         unsigned int contact_count, uint64_t timestamp, uint64_t keep_alive);
+
+#endif /* ELANReport_hpp */
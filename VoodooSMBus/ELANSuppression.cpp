@@ -0,0 +1,16 @@
+/*
+ * ELANSuppression.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include "ELANSuppression.hpp"
+
+void elan_suppression_extend(volatile uint64_t *until, uint64_t deadline) {
+    uint64_t current;
+    do {
+        current = *until;
+        if (deadline <= current)
+            return;
+    } while (!__sync_bool_compare_and_swap(until, current, deadline));
+}
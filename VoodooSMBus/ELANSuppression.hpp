@@ -0,0 +1,42 @@
+/*
+ * ELANSuppression.hpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#ifndef ELANSuppression_hpp
+#define ELANSuppression_hpp
+
+/*
+ * Disable-while-typing and disable-while-trackpoint. This file must not depend
+ * on IOKit, so the check every report passes can be measured outside of the
+ * kext.
+ *
+ * Suppression is kept as deadlines in absolute time. Only a key press or
+ * trackpoint movement moves a deadline, with the timeouts converted to
+ * absolute time when the configuration is parsed, so checking a report is a
+ * single compare.
+ */
+#include <stdint.h>
+
+struct elan_suppression {
+    /*
+     * Absolute time until which reports are ignored. Typing suppresses both
+     * the touchpad and trackpoint, trackpoint movement only the touchpad.
+     */
+    volatile uint64_t touchpad_until;
+    volatile uint64_t trackpoint_until;
+};
+
+/*
+ * Moves a suppression deadline forward. Keyboard messages and trackpoint
+ * reports arrive on different threads, so the deadline is never moved back.
+ */
+void elan_suppression_extend(volatile uint64_t *until, uint64_t deadline);
+
+/* Whether a report read at @now is ignored */
+static inline bool elan_suppressed(const volatile uint64_t *until, uint64_t now) {
+    return now < *until;
+}
+
+#endif /* ELANSuppression_hpp */
@@ -30,18 +30,170 @@
 OSDefineMetaClassAndStructors(ELANTouchpadDriver, IOService);
 
 void ELANTouchpadDriver::loadConfiguration() {
-    disable_while_typing = Configuration::loadBoolConfiguration(this, CONFIG_DISABLE_WHILE_TYPING, true);
-    disable_while_trackpoint = Configuration::loadBoolConfiguration(this, CONFIG_DISABLE_WHILE_TRACKPOINT, true);
+    report_recorder_size = (UInt32) Configuration::loadUInt64Configuration(this, CONFIG_REPORT_RECORDER_SIZE, 0);
     
-    ignore_set_touchpad_status = Configuration::loadBoolConfiguration(this, CONFIG_IGNORE_SET_TOUCHPAD_STATUS, false);
+    elan_configuration* config = reinterpret_cast<elan_configuration*>(IOMalloc(sizeof(elan_configuration)));
+    if (!config) {
+        configuration = NULL;
+        return;
+    }
+    
+    config->disable_while_typing = true;
+    config->disable_while_trackpoint = true;
+    config->ignore_set_touchpad_status = false;
+    config->sleep_while_disabled = true;
+    config->disable_while_typing_timeout_ms = 500;
+    config->disable_while_trackpoint_timeout_ms = 500;
+    
+    config->references = 1;
+    elan_palm_defaults(&config->palm);
+    
+    config->trackpoint_sensitivity = 100;
+    config->trackpoint_acceleration = 0;
+    config->trackpoint_deadzone = 0;
+    config->trackpoint_scroll_gain = TRACKPOINT_SCROLL_GAIN;
+    config->trackpoint_scroll_rate = TRACKPOINT_SCROLL_RATE;
+    config->trackpoint_scroll_friction = TRACKPOINT_SCROLL_FRICTION;
+    
+    config->auto_calibration_timeout_ms = 0;
+    config->auto_calibration_interval_ms = 60000;
+    config->idle_timeout_ms = 10000;
+    config->frame_keep_alive_ms = 100;
+    
+    OSDictionary* dict = OSDynamicCast(OSDictionary, getProperty(PROPERTY_CONFIGURATION));
+    if (dict && !parseConfiguration(dict, config)) {
+        IOLogError("Invalid configuration, some values are ignored\n");
+    }
+    configuration = config;
+}
+
+bool ELANTouchpadDriver::parseConfiguration(OSDictionary* dict, elan_configuration* config) {
+    elan_configuration parsed = *config;
+    bool valid = true;
+    
+    valid &= Configuration::readBool(dict, CONFIG_DISABLE_WHILE_TYPING, &parsed.disable_while_typing);
+    valid &= Configuration::readBool(dict, CONFIG_DISABLE_WHILE_TRACKPOINT, &parsed.disable_while_trackpoint);
+    valid &= Configuration::readBool(dict, CONFIG_IGNORE_SET_TOUCHPAD_STATUS, &parsed.ignore_set_touchpad_status);
+    valid &= Configuration::readBool(dict, CONFIG_SLEEP_WHILE_DISABLED, &parsed.sleep_while_disabled);
+    valid &= Configuration::readUInt64(dict, CONFIG_DISABLE_WHILE_TYPING_TIMEOUT_MS, &parsed.disable_while_typing_timeout_ms);
+    valid &= Configuration::readUInt64(dict, CONFIG_DISABLE_WHILE_TRACKPOINT_TIMEOUT_MS, &parsed.disable_while_trackpoint_timeout_ms);
+    
+    valid &= Configuration::readBool(dict, CONFIG_PALM_REJECTION, &parsed.palm.enabled);
+    valid &= Configuration::readUInt64(dict, CONFIG_PALM_REJECTION_WIDTH, &parsed.palm.width);
+    valid &= Configuration::readUInt64(dict, CONFIG_PALM_REJECTION_PRESSURE, &parsed.palm.pressure);
+    valid &= Configuration::readUInt64(dict, CONFIG_PALM_REJECTION_EDGE_ZONE, &parsed.palm.edge_zone);
+    valid &= Configuration::readUInt64(dict, CONFIG_PALM_REJECTION_EDGE_WIDTH, &parsed.palm.edge_width);
+    
+    valid &= Configuration::readUInt64(dict, CONFIG_TRACKPOINT_SENSITIVITY, &parsed.trackpoint_sensitivity);
+    valid &= Configuration::readUInt64(dict, CONFIG_TRACKPOINT_ACCELERATION, &parsed.trackpoint_acceleration);
+    valid &= Configuration::readUInt64(dict, CONFIG_TRACKPOINT_DEADZONE, &parsed.trackpoint_deadzone);
+    valid &= Configuration::readUInt64(dict, CONFIG_TRACKPOINT_SCROLL_GAIN, &parsed.trackpoint_scroll_gain);
+    valid &= Configuration::readUInt64(dict, CONFIG_TRACKPOINT_SCROLL_RATE, &parsed.trackpoint_scroll_rate);
+    valid &= Configuration::readUInt64(dict, CONFIG_TRACKPOINT_SCROLL_FRICTION, &parsed.trackpoint_scroll_friction);
+    
+    valid &= Configuration::readUInt64(dict, CONFIG_AUTO_CALIBRATION_TIMEOUT_MS, &parsed.auto_calibration_timeout_ms);
+    valid &= Configuration::readUInt64(dict, CONFIG_AUTO_CALIBRATION_INTERVAL_MS, &parsed.auto_calibration_interval_ms);
+    valid &= Configuration::readUInt64(dict, CONFIG_IDLE_TIMEOUT_MS, &parsed.idle_timeout_ms);
+    valid &= Configuration::readUInt64(dict, CONFIG_FRAME_KEEP_ALIVE_MS, &parsed.frame_keep_alive_ms);
+    
+    // timeouts above a day are typos and would overflow the conversion to absolute time
+    const UInt64 max_timeout_ms = 24 * 3600 * 1000;
+    valid &= parsed.disable_while_typing_timeout_ms <= max_timeout_ms;
+    valid &= parsed.disable_while_trackpoint_timeout_ms <= max_timeout_ms;
+    valid &= parsed.auto_calibration_timeout_ms <= max_timeout_ms;
+    valid &= parsed.auto_calibration_interval_ms <= max_timeout_ms;
+    valid &= parsed.idle_timeout_ms <= max_timeout_ms;
+    valid &= parsed.frame_keep_alive_ms <= max_timeout_ms;
+    valid &= parsed.palm.width <= 0xff && parsed.palm.pressure <= 0xff && parsed.palm.edge_width <= 0xff;
+    valid &= parsed.palm.edge_zone <= 0xffff;
+    valid &= parsed.trackpoint_sensitivity <= 1000 && parsed.trackpoint_acceleration <= 1000;
+    valid &= parsed.trackpoint_deadzone <= 127;
+    valid &= parsed.trackpoint_scroll_gain <= 1000;
+    valid &= parsed.trackpoint_scroll_rate >= 1 && parsed.trackpoint_scroll_rate <= 1000;
+    valid &= parsed.trackpoint_scroll_friction <= 100;
+    if (!valid)
+        return false;
+    
+    nanoseconds_to_absolutetime(parsed.disable_while_typing_timeout_ms * 1000000, &parsed.disable_while_typing_timeout);
+    nanoseconds_to_absolutetime(parsed.disable_while_trackpoint_timeout_ms * 1000000, &parsed.disable_while_trackpoint_timeout);
+    nanoseconds_to_absolutetime(parsed.auto_calibration_timeout_ms * 1000000, &parsed.auto_calibration_timeout);
+    nanoseconds_to_absolutetime(parsed.auto_calibration_interval_ms * 1000000, &parsed.auto_calibration_interval);
+    nanoseconds_to_absolutetime(parsed.frame_keep_alive_ms * 1000000, &parsed.frame_keep_alive);
+    
+    *config = parsed;
+    return true;
+}
+
+IOReturn ELANTouchpadDriver::setConfigurationGated(OSDictionary* dict) {
+    const elan_configuration* old_config = configuration;
+    
+    elan_configuration* config = reinterpret_cast<elan_configuration*>(IOMalloc(sizeof(elan_configuration)));
+    if (!config)
+        return kIOReturnNoMemory;
+    
+    *config = *old_config;
+    config->references = 1;
+    if (!parseConfiguration(dict, config)) {
+        IOLogError("Rejected invalid configuration\n");
+        IOFree(config, sizeof(elan_configuration));
+        return kIOReturnBadArgument;
+    }
+    
+    // writers are serialized by the command gate, readers pick up the new snapshot with their next report
+    IOLockLock(configuration_lock);
+    configuration = config;
+    IOLockUnlock(configuration_lock);
+    
+    applyConfiguration(config, old_config);
+    
+    // readers still using the old snapshot hold their own reference to it
+    releaseConfiguration(old_config);
+    
+    OSDictionary* published = OSDynamicCast(OSDictionary, getProperty(PROPERTY_CONFIGURATION));
+    published = published ? OSDictionary::withDictionary(published) : OSDictionary::withCapacity(dict->getCount());
+    if (published) {
+        published->merge(dict);
+        setProperty(PROPERTY_CONFIGURATION, published);
+        OSSafeReleaseNULL(published);
+    }
+    return kIOReturnSuccess;
+}
+
+const elan_configuration* ELANTouchpadDriver::copyConfiguration() {
+    IOLockLock(configuration_lock);
+    const elan_configuration* config = configuration;
+    OSIncrementAtomic(&const_cast<elan_configuration*>(config)->references);
+    IOLockUnlock(configuration_lock);
+    return config;
+}
+
+void ELANTouchpadDriver::releaseConfiguration(const elan_configuration* config) {
+    if (OSDecrementAtomic(&const_cast<elan_configuration*>(config)->references) == 1)
+        IOFree(const_cast<elan_configuration*>(config), sizeof(elan_configuration));
+}
+
+void ELANTouchpadDriver::applyConfiguration(const elan_configuration* config, const elan_configuration* old_config) {
+    if (trackpoint) {
+        trackpoint->setAcceleration((UInt32) config->trackpoint_sensitivity, (UInt32) config->trackpoint_acceleration, (UInt32) config->trackpoint_deadzone);
+        trackpoint->setScrolling((UInt32) config->trackpoint_scroll_gain, (UInt32) config->trackpoint_scroll_rate, (UInt32) config->trackpoint_scroll_friction);
+    }
     
-    disable_while_typing_timeout = Configuration::loadUInt64Configuration(this, CONFIG_DISABLE_WHILE_TYPING_TIMEOUT_MS, 500) * 1000000 ;
-    disable_while_trackpoint_timeout = Configuration::loadUInt64Configuration(this, CONFIG_DISABLE_WHILE_TRACKPOINT_TIMEOUT_MS, 500) * 1000000 ;
+    if (config->idle_timeout_ms != old_config->idle_timeout_ms && idle_state == ELAN_IDLE_ACTIVE) {
+        if (config->idle_timeout_ms)
+            idle_timer->setTimeoutMS((UInt32) config->idle_timeout_ms);
+        else
+            idle_timer->cancelTimeout();
+    }
 }
 
 bool ELANTouchpadDriver::init(OSDictionary *dict) {
     bool result = super::init(dict);
+    configuration_lock = IOLockAlloc();
     loadConfiguration();
+    if (!configuration_lock || !configuration) {
+        IOLogError("No memory to allocate configuration\n");
+        return false;
+    }
     
     data = reinterpret_cast<elan_tp_data*>(IOMalloc(sizeof(elan_tp_data)));
 
@@ -52,17 +204,80 @@ bool ELANTouchpadDriver::init(OSDictionary *dict) {
         VoodooI2CDigitiserTransducer* transducer = VoodooI2CDigitiserTransducer::transducer(type, NULL);
         transducers->setObject(transducer);
     }
+    memset(contacts, 0, sizeof(contacts));
+    memset(&frame_filter, 0, sizeof(frame_filter));
+    memset(bad_reports, 0, sizeof(bad_reports));
+    consecutive_bad_reports = 0;
+    unlogged_bad_reports = 0;
+    resyncs = 0;
+    bus_resets = 0;
+    ts_bad_report_logged = 0;
+    ts_resync = 0;
+    suppressed_asleep = false;
+    suppressed_reports = 0;
+    typing_skipped_reports = 0;
+    suppressed_bus_time = 0;
+    suppression_statistics_stale = false;
+    report_read_time = 0;
+    device_busy = 0;
+    calibration_requested = false;
+    ts_latency_published = 0;
+    suppression.touchpad_until = 0;
+    suppression.trackpoint_until = 0;
+    work_loop = NULL;
+    command_gate = NULL;
+    idle_timer = NULL;
+    calibration_timer = NULL;
+    idle_state = ELAN_IDLE_ACTIVE;
+    ts_last_activity = 0;
+    ts_idle_state = 0;
+    memset(idle_state_time, 0, sizeof(idle_state_time));
+    idle_entries = 0;
+    idle_wakes = 0;
+    ts_last_calibration = 0;
+    auto_calibrations = 0;
+    if (!recorder.init(report_recorder_size)) {
+        IOLogError("No memory to allocate report recorder\n");
+    }
     awake = true;
     trackpointScrolling = false;
     return result;
 }
 
 void ELANTouchpadDriver::free(void) {
+    if (configuration) {
+        releaseConfiguration(configuration);
+        configuration = NULL;
+    }
+    if (configuration_lock) {
+        IOLockFree(configuration_lock);
+        configuration_lock = NULL;
+    }
+    recorder.free();
     IOFree(data, sizeof(elan_tp_data));
     super::free();
 }
 
 void ELANTouchpadDriver::releaseResources() {
+    if (idle_timer) {
+        idle_timer->cancelTimeout();
+        work_loop->removeEventSource(idle_timer);
+        OSSafeReleaseNULL(idle_timer);
+    }
+    
+    if (calibration_timer) {
+        calibration_timer->cancelTimeout();
+        work_loop->removeEventSource(calibration_timer);
+        OSSafeReleaseNULL(calibration_timer);
+    }
+    
+    if (command_gate) {
+        work_loop->removeEventSource(command_gate);
+        OSSafeReleaseNULL(command_gate);
+    }
+    
+    OSSafeReleaseNULL(work_loop);
+    
     sendSleepCommand();
     OSSafeReleaseNULL(device_nub);
     
@@ -88,6 +303,30 @@ bool ELANTouchpadDriver::start(IOService* provider) {
     provider->joinPMtree(this);
     registerPowerDriver(this, VoodooI2CIOPMPowerStates, kVoodooI2CIOPMNumberPowerStates);
     
+    work_loop = IOWorkLoop::workLoop();
+    if (!work_loop) {
+        IOLogError("%s Could not create work loop\n", getName());
+        return false;
+    }
+    
+    command_gate = IOCommandGate::commandGate(this);
+    if (!command_gate || (work_loop->addEventSource(command_gate) != kIOReturnSuccess)) {
+        IOLogError("%s Could not open command gate\n", getName());
+        return false;
+    }
+    
+    idle_timer = IOTimerEventSource::timerEventSource(this, OSMemberFunctionCast(IOTimerEventSource::Action, this, &ELANTouchpadDriver::idleTimeout));
+    if (!idle_timer || (work_loop->addEventSource(idle_timer) != kIOReturnSuccess)) {
+        IOLogError("%s Could not add idle timer to work loop\n", getName());
+        return false;
+    }
+    
+    calibration_timer = IOTimerEventSource::timerEventSource(this, OSMemberFunctionCast(IOTimerEventSource::Action, this, &ELANTouchpadDriver::calibrationTimeout));
+    if (!calibration_timer || (work_loop->addEventSource(calibration_timer) != kIOReturnSuccess)) {
+        IOLogError("%s Could not add calibration timer to work loop\n", getName());
+        return false;
+    }
+    
     device_nub->setSlaveDeviceFlags(I2C_CLIENT_HOST_NOTIFY);
     publishMultitouchInterface();
     publishTrackpoint();
@@ -99,6 +338,7 @@ bool ELANTouchpadDriver::start(IOService* provider) {
         return false;
     }
     
+    command_gate->runAction(OSMemberFunctionCast(IOCommandGate::Action, this, &ELANTouchpadDriver::resetIdleGated));
     registerService();
     return true;
 }
@@ -141,11 +381,99 @@ IOReturn ELANTouchpadDriver::setPowerState(unsigned long whichState, IOService*
                 IOLogError("Could not initialize ELAN device.");
             }
             awake = true;
+            if (command_gate)
+                command_gate->runAction(OSMemberFunctionCast(IOCommandGate::Action, this, &ELANTouchpadDriver::resetIdleGated));
+            
+            // initialization woke up the device, put it back to sleep if input is still disabled
+            suppressed_asleep = false;
+            const elan_configuration* config = copyConfiguration();
+            if (ignoreall && !config->ignore_set_touchpad_status) {
+                setInputSuppressed(true);
+            }
+            releaseConfiguration(config);
         }
     }
     return kIOPMAckImplied;
 }
 
+bool ELANTouchpadDriver::callerIsAdministrator() {
+    // setProperties runs in the context of the task that set the properties
+    return IOUserClient::clientHasPrivilege(current_task(), kIOClientPrivilegeAdministrator) == kIOReturnSuccess;
+}
+
+IOReturn ELANTouchpadDriver::setProperties(OSObject* properties) {
+    OSDictionary* dict = OSDynamicCast(OSDictionary, properties);
+    if (!dict)
+        return kIOReturnBadArgument;
+    
+    OSDictionary* config = OSDynamicCast(OSDictionary, dict->getObject(PROPERTY_CONFIGURATION));
+    if (config) {
+        if (!command_gate)
+            return kIOReturnNotReady;
+        IOReturn result = command_gate->runAction(OSMemberFunctionCast(IOCommandGate::Action, this, &ELANTouchpadDriver::setConfigurationGated), config);
+        if (result != kIOReturnSuccess)
+            return result;
+    }
+    
+    OSBoolean* value = OSDynamicCast(OSBoolean, dict->getObject(PROPERTY_EXPORT_REPORT_TRACE));
+    if (value && value->isTrue()) {
+        if (!recorder.isEnabled())
+            return kIOReturnNotReady;
+        
+        OSData* trace = recorder.exportTrace();
+        if (!trace)
+            return kIOReturnNoMemory;
+        setProperty(PROPERTY_REPORT_TRACE, trace);
+        OSSafeReleaseNULL(trace);
+    }
+    
+    value = OSDynamicCast(OSBoolean, dict->getObject(PROPERTY_RESET_REPORT_TRACE));
+    if (value && value->isTrue()) {
+        recorder.reset();
+        removeProperty(PROPERTY_REPORT_TRACE);
+    }
+    
+    value = OSDynamicCast(OSBoolean, dict->getObject(PROPERTY_RESET_LATENCY_STATISTICS));
+    if (value && value->isTrue()) {
+        for (int i = 0; i < ELAN_LATENCY_STAGES; i++)
+            latency[i].reset();
+        publishLatencyStatistics();
+    }
+    
+    value = OSDynamicCast(OSBoolean, dict->getObject(PROPERTY_CALIBRATE));
+    if (value && value->isTrue()) {
+        if (!callerIsAdministrator())
+            return kIOReturnNotPrivileged;
+        return runCalibration(true, "Requested");
+    }
+    
+    value = OSDynamicCast(OSBoolean, dict->getObject(PROPERTY_READ_BASELINE));
+    if (value && value->isTrue()) {
+        if (!callerIsAdministrator())
+            return kIOReturnNotPrivileged;
+        return runCalibration(false, "Requested");
+    }
+    
+#ifdef DEBUG
+    // replay injects input into the session, traces are replayed on the host with elan-replay otherwise
+    OSData* trace = OSDynamicCast(OSData, dict->getObject(PROPERTY_REPLAY_REPORT_TRACE));
+    if (trace) {
+        if (!callerIsAdministrator())
+            return kIOReturnNotPrivileged;
+        return replayReportTrace(trace);
+    }
+#endif
+    
+    OSData* firmware = OSDynamicCast(OSData, dict->getObject(PROPERTY_FIRMWARE_UPDATE));
+    if (firmware) {
+        if (!callerIsAdministrator())
+            return kIOReturnNotPrivileged;
+        return updateFirmware(firmware);
+    }
+    
+    return kIOReturnSuccess;
+}
+
 bool ELANTouchpadDriver::publishMultitouchInterface() {
     mt_interface = OSTypeAlloc(VoodooI2CMultitouchInterface);
     if (!mt_interface) {
@@ -179,6 +507,8 @@ void ELANTouchpadDriver::unpublishMultitouchInterface() {
 }
 
 bool ELANTouchpadDriver::publishTrackpoint() {
+    const elan_configuration* config;
+    
     trackpoint = OSTypeAlloc(TrackpointDevice);
     if (!trackpoint) {
         IOLogError("No memory to allocate TrackpointDevice instance\n");
@@ -196,6 +526,11 @@ bool ELANTouchpadDriver::publishTrackpoint() {
         IOLogError("Failed to start TrackpointDevice \n");
         goto trackpoint_exit;
     }
+    
+    config = copyConfiguration();
+    trackpoint->setAcceleration((UInt32) config->trackpoint_sensitivity, (UInt32) config->trackpoint_acceleration, (UInt32) config->trackpoint_deadzone);
+    trackpoint->setScrolling((UInt32) config->trackpoint_scroll_gain, (UInt32) config->trackpoint_scroll_rate, (UInt32) config->trackpoint_scroll_friction);
+    releaseConfiguration(config);
   
     trackpoint->registerService();
     return true;
@@ -225,45 +560,202 @@ int ELANTouchpadDriver::tryInitialize() {
     return error;
 }
 
-void ELANTouchpadDriver::handleHostNotify() {
+void ELANTouchpadDriver::handleHostNotify(VoodooSMBusHostNotifyTimestamps* timestamps) {
     int error;
-    u8 report[ETP_MAX_REPORT_LEN];
-    error = getReport(report);
+    // the report is read behind the 2 bytes of the I2C header, which must not carry stack contents into the trace
+    u8 report[ETP_MAX_REPORT_LEN] = {};
+    
+    // the device does not send reports in IAP or calibration mode and must not be disturbed
+    if (device_busy) {
+        elan_reset_references(contacts);
+        return;
+    }
+    
+    // the snapshot stays valid for this report even if the configuration is replaced meanwhile
+    const elan_configuration* config = copyConfiguration();
+    
+    // Check if input is disabled via ApplePS2Keyboard request. All reports
+    // would be discarded, so don't spend bus time on reading them.
+    if (ignoreall && !config->ignore_set_touchpad_status) {
+        suppressed_reports++;
+        suppressed_bus_time += report_read_time;
+        elan_reset_references(contacts);
+        releaseConfiguration(config);
+        return;
+    }
+    
+    AbsoluteTime notified;
+    if (timestamps) {
+        notified = timestamps->interrupt;
+    } else {
+        clock_get_uptime(&notified);
+    }
+    
+    // a key press suppresses the touchpad and the trackpoint, whatever the report is it would be dropped
+    if (elan_suppressed(&suppression.touchpad_until, notified) &&
+        elan_suppressed(&suppression.trackpoint_until, notified)) {
+        typing_skipped_reports++;
+        suppressed_bus_time += report_read_time;
+        suppression_statistics_stale = true;
+        elan_reset_references(contacts);
+        releaseConfiguration(config);
+        return;
+    }
+    
+    if (suppression_statistics_stale) {
+        suppression_statistics_stale = false;
+        publishSuppressionStatistics();
+    }
+    
+    noteActivity(notified);
+    
+    AbsoluteTime read_start, read_end, bus_acquired, decoded;
+    clock_get_uptime(&read_start);
+    error = getReport(report, &bus_acquired);
     if (error) {
+        elan_reset_references(contacts);
+        releaseConfiguration(config);
         return;
     }
+    clock_get_uptime(&read_end);
+    report_read_time = (report_read_time * 7 + (read_end - read_start)) / 8;
+    
+    recorder.record(timestamps ? timestamps->interrupt : read_start, read_end, report);
+    
+    // events are stamped with the time the device reported them, independent of
+    // thread scheduling and bus time, so the gesture engine sees the real intervals
+    AbsoluteTime timestamp = timestamps ? timestamps->interrupt : read_start;
     
-    // Check if input is disabled via ApplePS2Keyboard request
-    if (ignoreall && !ignore_set_touchpad_status) {
+    if (!processReport(report, config, timestamp, read_end, &decoded)) {
+        releaseConfiguration(config);
         return;
     }
     
-    // Ignore input for specified time after keyboard usage
-    uint64_t timestamp_ns = clock_get_uptime_nanoseconds();
-    if (disable_while_typing) {
-        if (timestamp_ns - ts_last_keyboard < disable_while_typing_timeout) {
-            return;
-        }
+    if (timestamps && decoded) {
+        recordLatency(timestamps, bus_acquired, read_end, decoded);
     }
     
+    /*
+     * A calibration with a finger on the touchpad would take the finger into the
+     * baseline, so a requested calibration waits for a frame without contacts,
+     * like the one the device sends when the last finger is lifted.
+     */
+    if (calibration_requested && report[ETP_REPORT_ID_OFFSET] == ETP_REPORT_ID &&
+        !(report[ETP_TOUCH_INFO_OFFSET] & ETP_TOUCH_INFO_FINGERS) && !elan_is_hovering(report)) {
+        calibration_requested = false;
+        
+        // a calibration takes seconds, the next Host Notify must not wait for it
+        calibration_timer->setTimeoutMS(0);
+    }
+    releaseConfiguration(config);
+}
+
+bool ELANTouchpadDriver::processReport(u8 *report, const elan_configuration* config, AbsoluteTime timestamp, AbsoluteTime read_end, AbsoluteTime* decoded) {
+    *decoded = 0;
+    
+    // suppressed reports are validated too, so the first frame after suppression is checked against the last one
+    elan_report_error report_error = elan_validate_report(report, contacts, data->max_x, data->max_y);
+    if (report_error != ETP_REPORT_OK) {
+        handleBadReport(report_error, report, read_end);
+        return false;
+    }
+    consecutive_bad_reports = 0;
+    
     switch (report[ETP_REPORT_ID_OFFSET]) {
         case ETP_REPORT_ID:
-            // ignore touchpad for specified time after trackpoint usage
-            if(disable_while_trackpoint) {
-                if(timestamp_ns - ts_last_trackpoint < disable_while_trackpoint_timeout) {
-                    break;
-                }
+            // ignore touchpad for specified time after keyboard or trackpoint usage
+            if (elan_suppressed(&suppression.touchpad_until, read_end)) {
+                break;
             }
-            reportAbsolute(report);
+            *decoded = reportAbsolute(report, config, timestamp);
             break;
         case ETP_TP_REPORT_ID:
-            reportTrackpoint(report);
+            // ignore trackpoint for specified time after keyboard usage
+            if (elan_suppressed(&suppression.trackpoint_until, read_end)) {
+                break;
+            }
+            *decoded = reportTrackpoint(report, config, timestamp);
             break;
-        default:
-            IOLogError("invalid report id data (%x)\n",
-                    report[ETP_REPORT_ID_OFFSET]);
     }
+    return true;
+}
+
+#ifdef DEBUG
+IOReturn ELANTouchpadDriver::replayReportTrace(OSData* trace) {
+    u8 report[ETP_MAX_REPORT_LEN];
+    UInt32 count, rejected = 0;
+    uint64_t processing_ns = 0, duration_ns;
+    AbsoluteTime start, end;
+    
+    const report_trace_record* records = ReportRecorder::parseTrace(trace, &count);
+    if (!records) {
+        IOLogError("Invalid report trace\n");
+        return kIOReturnBadArgument;
+    }
+    
+    clock_get_uptime(&start);
+    noteActivity(start);
+    
+    // live reports are not read while the trace is replayed, so they can't interleave with it
+    if (!OSCompareAndSwap(0, 1, &device_busy))
+        return kIOReturnBusy;
+    
+    const elan_configuration* config = copyConfiguration();
+    elan_reset_references(contacts);
+    for (UInt32 i = 0; i < count; i++) {
+        // keep the recorded spacing between reports, the gesture engine depends on it
+        if (i) {
+            uint64_t gap_ms = (records[i].notify_ns - records[i - 1].notify_ns) / 1000000;
+            if (records[i].notify_ns < records[i - 1].notify_ns)
+                gap_ms = 0;
+            IOSleep(gap_ms < ETP_REPLAY_MAX_GAP_MS ? (unsigned) gap_ms : ETP_REPLAY_MAX_GAP_MS);
+        }
+        
+        memcpy(report, records[i].report, ETP_MAX_REPORT_LEN);
+        
+        AbsoluteTime process_start, process_end, decoded;
+        clock_get_uptime(&process_start);
+        if (!processReport(report, config, process_start, process_start, &decoded))
+            rejected++;
+        clock_get_uptime(&process_end);
+        
+        uint64_t ns;
+        absolutetime_to_nanoseconds(process_end - process_start, &ns);
+        processing_ns += ns;
+    }
+    
+    clock_get_uptime(&end);
+    absolutetime_to_nanoseconds(end - start, &duration_ns);
+    
+    releaseConfiguration(config);
+    
+    // phantom contacts in a replayed trace say nothing about the real sensor
+    calibration_requested = false;
+    device_busy = 0;
+    
+    IOLog("%s Replayed %u reports in %llu ms, %u rejected\n", getName(), count, duration_ns / 1000000, rejected);
+    
+    OSDictionary* statistics = OSDictionary::withCapacity(4);
+    if (statistics) {
+        OSNumber* number = OSNumber::withNumber(count, 32);
+        statistics->setObject("Reports", number);
+        OSSafeReleaseNULL(number);
+        number = OSNumber::withNumber(rejected, 32);
+        statistics->setObject("Rejected", number);
+        OSSafeReleaseNULL(number);
+        number = OSNumber::withNumber(duration_ns / 1000000, 64);
+        statistics->setObject("DurationMs", number);
+        OSSafeReleaseNULL(number);
+        number = OSNumber::withNumber(count ? processing_ns / count : 0, 64);
+        statistics->setObject("ProcessingNsPerReport", number);
+        OSSafeReleaseNULL(number);
+        
+        setProperty(PROPERTY_REPLAY_STATISTICS, statistics);
+        OSSafeReleaseNULL(statistics);
+    }
+    return kIOReturnSuccess;
 }
+#endif
 
 
 
@@ -351,12 +843,12 @@ unsigned int ELANTouchpadDriver::convertResolution(u8 val) {
 
 
 // elan_smbus_get_report
-int ELANTouchpadDriver::getReport(u8 *report)
+int ELANTouchpadDriver::getReport(u8 *report, AbsoluteTime* transfer_start)
 {
     int len;
     
     len = device_nub->readBlockData(ETP_SMBUS_PACKET_QUERY,
-                                    &report[ETP_SMBUS_REPORT_OFFSET]);
+                                    &report[ETP_SMBUS_REPORT_OFFSET], transfer_start);
     if (len < 0) {
         IOLogError("failed to read report data: %d\n", len);
         return len;
@@ -371,23 +863,18 @@ int ELANTouchpadDriver::getReport(u8 *report)
     return 0;
 }
 
-void ELANTouchpadDriver::reportTrackpoint(u8 *report) {
-    u8 *packet = &report[ETP_REPORT_ID_OFFSET + 1];
-    int x = 0, y = 0;
+AbsoluteTime ELANTouchpadDriver::reportTrackpoint(u8 *report, const elan_configuration* config, AbsoluteTime timestamp) {
+    AbsoluteTime decoded;
+    elan_trackpoint packet;
+    elan_decode_trackpoint(report, &packet);
     
-    int btn_left = packet[0] & 0x01;
-    int btn_right = packet[0] & 0x02;
-    int btn_middle = packet[0] & 0x04;
-
-    int button = btn_left | btn_right | btn_middle;
-    if ((packet[3] & 0x0F) == 0x06) {
-        x = packet[4] - (int)((packet[1] ^ 0x80) << 1);
-        y = (int)((packet[2] ^ 0x80) << 1) - packet[5];
-    }
+    int x = packet.x, y = packet.y;
+    int button = packet.buttons;
+    int btn_middle = packet.buttons & 0x04;
     
     // trackpoint was used
-    if(x != 0 || y != 0) {
-        ts_last_trackpoint = clock_get_uptime_nanoseconds();
+    if((x != 0 || y != 0) && config->disable_while_trackpoint) {
+        elan_suppression_extend(&suppression.touchpad_until, timestamp + config->disable_while_trackpoint_timeout);
     }
     
     // enable trackpoint scroll mode when middle button was pressed and the trackpoint moved
@@ -398,37 +885,49 @@ void ELANTouchpadDriver::reportTrackpoint(u8 *report) {
     // disable trackpoint scrolling mode always when middle button is released
     if (trackpointScrolling && btn_middle == 0) {
         trackpointScrolling = false;
+        trackpoint->endScroll(timestamp);
     }
     
+    clock_get_uptime(&decoded);
     if(trackpointScrolling) {
-        trackpoint->updateScrollwheel(-y, -x, 0);
+        trackpoint->updateScroll(-x, -y, timestamp);
     } else {
-        trackpoint->updateRelativePointer(x, y, button);
+        trackpoint->updateRelativePointer(x, y, button, timestamp);
     }
+    return decoded;
 }
 
 // elan_report_contact
-void ELANTouchpadDriver::reportContact(VoodooI2CDigitiserTransducer* transducer, bool contact_valid, u8 *finger_data, AbsoluteTime timestamp) {
+bool ELANTouchpadDriver::reportContact(VoodooI2CDigitiserTransducer* transducer, const elan_configuration* config, bool contact_valid, bool hovering, u8 *finger_data, AbsoluteTime timestamp) {
     unsigned int pos_x, pos_y;
     unsigned int pressure, mk_x, mk_y;
     unsigned int area_x, area_y, major, minor;
     unsigned int scaled_pressure;
-
+    elan_contact_state* contact = &contacts[transducer->id];
     
     if (contact_valid) {
-        pos_x = ((finger_data[0] & 0xf0) << 4) |
-        finger_data[1];
-        pos_y = ((finger_data[0] & 0x0f) << 8) |
-        finger_data[2];
-        mk_x = (finger_data[3] & 0x0f);
-        mk_y = (finger_data[3] >> 4);
-        pressure = finger_data[4];
+        elan_finger finger;
+        elan_decode_finger(finger_data, &finger);
+        pos_x = finger.pos_x;
+        pos_y = finger.pos_y;
+        mk_x = finger.mk_x;
+        mk_y = finger.mk_y;
+        pressure = finger.pressure;
         
         if (pos_x > data->max_x || pos_y > data->max_y) {
             IOLogDebug("[%d] x=%d y=%d over max (%d, %d)",
                     transducer->id, pos_x, pos_y,
                     data->max_x, data->max_y);
-            return;
+            return transducer->is_valid;
+        }
+        
+        if (hovering) {
+            // the finger is tracked above the touchpad, but a touch only starts when it lands
+            elan_contact_lift(contact);
+            transducer->coordinates.x.update(pos_x, timestamp);
+            transducer->coordinates.y.update(transducer->logical_max_y - pos_y, timestamp);
+            transducer->tip_switch.update(0, timestamp);
+            return false;
         }
         
         /*
@@ -441,40 +940,61 @@ void ELANTouchpadDriver::reportContact(VoodooI2CDigitiserTransducer* transducer,
         major = max(area_x, area_y);
         minor = min(area_x, area_y);
         
-        scaled_pressure = pressure + data->pressure_adjustment;
+        scaled_pressure = elan_adjust_pressure(pressure, data->pressure_adjustment);
+        
+        elan_contact_touch(contact, pos_x, pos_y, timestamp);
+        
+        // a contact that does not move at all for a long time is a phantom contact of a drifted baseline
+        if (pos_x - contact->last_x + ETP_PHANTOM_TOLERANCE > 2 * ETP_PHANTOM_TOLERANCE ||
+            pos_y - contact->last_y + ETP_PHANTOM_TOLERANCE > 2 * ETP_PHANTOM_TOLERANCE) {
+            contact->last_x = pos_x;
+            contact->last_y = pos_y;
+            contact->ts_moved = timestamp;
+        } else if (config->auto_calibration_timeout && timestamp - contact->ts_moved > config->auto_calibration_timeout) {
+            contact->ts_moved = timestamp;
+            calibration_requested = true;
+        }
+        
+        if (config->palm.enabled) {
+            contact->palm = elan_is_palm(contact, &config->palm, data->max_x, pos_x, pos_y, max(mk_x, mk_y), scaled_pressure);
+        }
         
-        if (scaled_pressure > ETP_MAX_PRESSURE)
-            scaled_pressure = ETP_MAX_PRESSURE;
+        if (contact->palm) {
+            // report a lift for the palm so no gesture keeps tracking it
+            transducer->is_valid = false;
+            transducer->coordinates.x.update(transducer->coordinates.x.last.value, timestamp);
+            transducer->coordinates.y.update(transducer->coordinates.y.last.value, timestamp);
+            transducer->tip_switch.update(0, timestamp);
+            return false;
+        }
         
         transducer->coordinates.x.update(pos_x, timestamp);
         transducer->coordinates.y.update(transducer->logical_max_y - pos_y, timestamp);
         transducer->tip_switch.update(1, timestamp);
 
     } else {
+        elan_contact_lift(contact);
+        
         transducer->coordinates.x.update(transducer->coordinates.x.last.value, timestamp);
         transducer->coordinates.y.update(transducer->coordinates.y.last.value, timestamp);
         transducer->tip_switch.update(0, timestamp);
     }
+    return contact_valid;
 }
 
 // elan_report_absolute
-void ELANTouchpadDriver::reportAbsolute(u8 *packet) {
+AbsoluteTime ELANTouchpadDriver::reportAbsolute(u8 *packet, const elan_configuration* config, AbsoluteTime timestamp) {
     u8 *finger_data = &packet[ETP_FINGER_DATA_OFFSET];
     int i;
     u8 tp_info = packet[ETP_TOUCH_INFO_OFFSET];
-    u8 hover_info = packet[ETP_HOVER_INFO_OFFSET];
-    bool contact_valid, hover_event;
+    bool contact_valid;
     
     VoodooI2CMultitouchEvent event;
     event.contact_count = 0;
     event.transducers = transducers;
-
-    AbsoluteTime timestamp;
-    clock_get_uptime(&timestamp);
     
-    hover_event = hover_info & 0x40;
     for (i = 0; i < ETP_MAX_FINGERS; i++) {
-        contact_valid = tp_info & (1U << (3 + i));
+        contact_valid = elan_finger_valid(packet, i);
         
         VoodooI2CDigitiserTransducer* transducer = OSDynamicCast(VoodooI2CDigitiserTransducer,
                                                                  transducers->getObject(i));
@@ -486,23 +1006,827 @@ void ELANTouchpadDriver::reportAbsolute(u8 *packet) {
         transducer->physical_button.update(tp_info & BIT(0), timestamp);
         transducer->type = kDigitiserTransducerFinger;
         transducer->is_valid = contact_valid;
+        // a hovering finger has a record of its own, so only its slot is in range without touching
+        transducer->in_range.update(contact_valid, timestamp);
         
-        reportContact(transducer, contact_valid, finger_data, timestamp);
+        if (reportContact(transducer, config, contact_valid, elan_finger_hovering(packet, i), finger_data, timestamp)) {
+            event.contact_count++;
+        }
         
         if (contact_valid) {
             finger_data += ETP_FINGER_DATA_LEN;
-            event.contact_count++;
         }
     }
    
+    // the contacts are still decoded above to keep their history, but the gesture engine only gets changed frames
+    if (!elan_frame_dispatch(&frame_filter, packet, event.contact_count, timestamp, config->frame_keep_alive)) {
+        return 0;
+    }
+    
     // send the event into the multitouch interface
+    AbsoluteTime decoded;
+    clock_get_uptime(&decoded);
     mt_interface->handleInterruptReport(event, timestamp);
+    return decoded;
+}
+
+void ELANTouchpadDriver::handleBadReport(elan_report_error error, u8 *report, AbsoluteTime now) {
+    static const char* error_names[ETP_REPORT_ERRORS] = {
+        "ok", "invalid report id", "invalid finger data", "position jump", "inconsistent finger bitmap"
+    };
+    uint64_t elapsed_ns;
+    
+    bad_reports[error]++;
+    consecutive_bad_reports++;
+    
+    // a corrupted stream produces a bad report on every frame, so the log is rate limited
+    absolutetime_to_nanoseconds(now - ts_bad_report_logged, &elapsed_ns);
+    if (!ts_bad_report_logged || elapsed_ns > ETP_BAD_REPORT_LOG_INTERVAL_MS * 1000000ULL) {
+        IOLogError("Dropped report with %s (id %#04x), %u more not logged\n",
+                   error_names[error], report[ETP_REPORT_ID_OFFSET], unlogged_bad_reports);
+        ts_bad_report_logged = now;
+        unlogged_bad_reports = 0;
+        publishReportStatistics();
+    } else {
+        unlogged_bad_reports++;
+    }
+    
+    if (consecutive_bad_reports < ETP_RESYNC_BAD_REPORTS)
+        return;
+    
+    absolutetime_to_nanoseconds(now - ts_resync, &elapsed_ns);
+    if (ts_resync && elapsed_ns < ETP_RESYNC_INTERVAL_MS * 1000000ULL)
+        return;
+    
+    if (!OSCompareAndSwap(0, 1, &device_busy))
+        return;
+    
+    IOLogError("Re-initializing device after %u bad reports\n", consecutive_bad_reports);
+    resyncs++;
+    reinitialize(now);
+}
+
+void ELANTouchpadDriver::handleBusReset() {
+    AbsoluteTime now;
+    clock_get_uptime(&now);
+    
+    if (!OSCompareAndSwap(0, 1, &device_busy))
+        return;
+    
+    IOLogError("Re-initializing device after bus reset\n");
+    bus_resets++;
+    reinitialize(now);
+}
+
+void ELANTouchpadDriver::reinitialize(AbsoluteTime now) {
+    ts_resync = now;
+    elan_reset_references(contacts);
+    consecutive_bad_reports = 0;
+    
+    int init_error = initialize();
+    if (init_error) {
+        IOLogError("Could not re-initialize ELAN device: %d\n", init_error);
+    }
+    device_busy = 0;
+    publishReportStatistics();
+}
+
+void ELANTouchpadDriver::publishReportStatistics() {
+    OSDictionary* statistics = OSDictionary::withCapacity(6);
+    if (!statistics)
+        return;
+    
+    OSNumber* number = OSNumber::withNumber(bad_reports[ETP_REPORT_BAD_ID], 64);
+    statistics->setObject("BadReportId", number);
+    OSSafeReleaseNULL(number);
+    number = OSNumber::withNumber(bad_reports[ETP_REPORT_BAD_FINGER_DATA], 64);
+    statistics->setObject("BadFingerData", number);
+    OSSafeReleaseNULL(number);
+    number = OSNumber::withNumber(bad_reports[ETP_REPORT_POSITION_JUMP], 64);
+    statistics->setObject("PositionJumps", number);
+    OSSafeReleaseNULL(number);
+    number = OSNumber::withNumber(bad_reports[ETP_REPORT_BAD_FINGER_COUNT], 64);
+    statistics->setObject("BadFingerCount", number);
+    OSSafeReleaseNULL(number);
+    number = OSNumber::withNumber(resyncs, 32);
+    statistics->setObject("Resyncs", number);
+    OSSafeReleaseNULL(number);
+    number = OSNumber::withNumber(bus_resets, 32);
+    statistics->setObject("BusResets", number);
+    OSSafeReleaseNULL(number);
+    
+    setProperty(PROPERTY_REPORT_STATISTICS, statistics);
+    OSSafeReleaseNULL(statistics);
 }
 
 void ELANTouchpadDriver::sendSleepCommand() {
     device_nub->writeByte(ETP_SMBUS_SLEEP_CMD);
 }
 
+// elan_smbus_iap_get_mode
+int ELANTouchpadDriver::iapGetMode(bool* iap_mode) {
+    u8 val[I2C_SMBUS_BLOCK_MAX] = {0};
+    
+    int error = device_nub->readBlockData(ETP_SMBUS_IAP_CTRL_CMD, val);
+    if (error < 0) {
+        IOLogError("failed to read iap control register: %d\n", error);
+        return error;
+    }
+    
+    u16 constant = (val[0] << 8) | val[1];
+    *iap_mode = constant & ETP_SMBUS_IAP_MODE_ON;
+    return 0;
+}
+
+// elan_smbus_set_flash_key
+int ELANTouchpadDriver::iapSetFlashKey() {
+    u8 cmd[4] = { 0x00, 0x0B, 0x00, 0x5A };
+    
+    return device_nub->writeBlockData(ETP_SMBUS_IAP_CMD, sizeof(cmd), cmd);
+}
+
+// elan_smbus_prepare_fw_update
+int ELANTouchpadDriver::iapPrepareFirmwareUpdate() {
+    u8 cmd[4] = { 0x0F, 0x78, 0x00, 0x06 };
+    u8 val[I2C_SMBUS_BLOCK_MAX] = {0};
+    bool iap_mode;
+    int error, len;
+    
+    /* Get FW in which mode (IAP_MODE/MAIN_MODE) */
+    error = iapGetMode(&iap_mode);
+    if (error)
+        return error;
+    
+    if (!iap_mode) {
+        error = iapSetFlashKey();
+        if (error)
+            return error;
+        
+        /* write iap password */
+        if (device_nub->writeByte(ETP_SMBUS_IAP_PASSWORD_WRITE) < 0) {
+            IOLogError("cannot write iap password\n");
+            return -EIO;
+        }
+        
+        error = device_nub->writeBlockData(ETP_SMBUS_IAP_CMD, sizeof(cmd), cmd);
+        if (error) {
+            IOLogError("failed to write iap password: %d\n", error);
+            return error;
+        }
+        
+        /* Read back password */
+        len = device_nub->readBlockData(ETP_SMBUS_IAP_PASSWORD_READ, val);
+        if (len < (int) sizeof(u16)) {
+            error = len < 0 ? len : -EIO;
+            IOLogError("failed to read iap password: %d\n", error);
+            return error;
+        }
+        
+        u16 password = (val[0] << 8) | val[1];
+        if (password != ETP_SMBUS_IAP_PASSWORD) {
+            IOLogError("wrong iap password = 0x%X\n", password);
+            return -EIO;
+        }
+        
+        /* Wait 30ms for MAIN_MODE change to IAP_MODE */
+        IOSleep(30);
+    }
+    
+    error = iapSetFlashKey();
+    if (error)
+        return error;
+    
+    /* Reset IC */
+    error = device_nub->writeByte(ETP_SMBUS_IAP_RESET_CMD);
+    if (error) {
+        IOLogError("cannot reset IC: %d\n", error);
+        return error;
+    }
+    
+    return 0;
+}
+
+// elan_smbus_write_fw_block
+int ELANTouchpadDriver::iapWritePage(const u8 *page) {
+    u8 val[I2C_SMBUS_BLOCK_MAX] = {0};
+    int error;
+    
+    /*
+     * SMBus limits a block write to I2C_SMBUS_BLOCK_MAX bytes,
+     * so the page is sent in two halves.
+     */
+    error = device_nub->writeBlockData(ETP_SMBUS_WRITE_FW_BLOCK, ETP_FW_PAGE_SIZE / 2, page);
+    if (error) {
+        IOLogDebug("Failed to write page first half: %d\n", error);
+        return error;
+    }
+    
+    error = device_nub->writeBlockData(ETP_SMBUS_WRITE_FW_BLOCK, ETP_FW_PAGE_SIZE / 2, page + ETP_FW_PAGE_SIZE / 2);
+    if (error) {
+        IOLogDebug("Failed to write page second half: %d\n", error);
+        return error;
+    }
+    
+    /* Wait for F/W to update one page ROM data. */
+    IOSleep(8);
+    
+    error = device_nub->readBlockData(ETP_SMBUS_IAP_CTRL_CMD, val);
+    if (error < 0) {
+        IOLogDebug("Failed to read IAP write result: %d\n", error);
+        return error;
+    }
+    
+    u16 result = (val[0] << 8) | val[1];
+    if (result & (ETP_FW_IAP_PAGE_ERR | ETP_FW_IAP_INTF_ERR)) {
+        IOLogDebug("IAP reports failed write: %04hx\n", result);
+        return -EIO;
+    }
+    return 0;
+}
+
+// elan_smbus_get_checksum
+int ELANTouchpadDriver::iapGetChecksum(bool iap, u16 *checksum) {
+    u8 val[I2C_SMBUS_BLOCK_MAX] = {0};
+    
+    int error = device_nub->readBlockData(iap ? ETP_SMBUS_IAP_CHECKSUM_CMD : ETP_SMBUS_FW_CHECKSUM_CMD, val);
+    if (error < 0)
+        return error;
+    
+    *checksum = (val[0] << 8) | val[1];
+    return 0;
+}
+
+// __elan_update_firmware
+// elan_smbus_get_sm_version, elan_smbus_get_version and elan_get_fwinfo
+int ELANTouchpadDriver::getFirmwareInfo(elan_fw_info* info) {
+    u8 val[I2C_SMBUS_BLOCK_MAX] = {0};
+    int error;
+    
+    error = device_nub->readBlockData(ETP_SMBUS_SM_VERSION_CMD, val);
+    if (error < 0) {
+        IOLogError("failed to get sm version: %d\n", error);
+        return error;
+    }
+    u8 ic_type = val[1];
+    
+    error = device_nub->readBlockData(ETP_SMBUS_IAP_VERSION_CMD, val);
+    if (error < 0) {
+        IOLogError("failed to get iap version: %d\n", error);
+        return error;
+    }
+    u8 iap_version = val[2];
+    
+    error = elan_get_fwinfo(ic_type, iap_version, info);
+    if (error) {
+        IOLogError("unknown ic type %#04x\n", ic_type);
+        return error;
+    }
+    
+    // pages are written in two blocks of 32 bytes, which only fits the 64 byte pages
+    if (info->page_size != ETP_FW_PAGE_SIZE) {
+        IOLogError("page size %d of ic type %#04x, iap version %d is not supported over SMBus\n",
+                   info->page_size, ic_type, iap_version);
+        return -EOPNOTSUPP;
+    }
+    return 0;
+}
+
+IOReturn ELANTouchpadDriver::updateFirmware(OSData* firmware) {
+    const u8 *image = reinterpret_cast<const u8*>(firmware->getBytesNoCopy());
+    unsigned int size = firmware->getLength();
+    int page_count, boot_page_count;
+    int error = 0, retries = 0, pages_written = 0;
+    u16 sw_checksum = 0, fw_checksum;
+    AbsoluteTime start_time;
+    elan_fw_info fw_info;
+    
+    clock_get_uptime(&start_time);
+    noteActivity(start_time);
+    
+    if (!OSCompareAndSwap(0, 1, &device_busy))
+        return kIOReturnBusy;
+    
+    // the image has to match the flash layout of this device before anything is erased
+    error = getFirmwareInfo(&fw_info);
+    if (error) {
+        device_busy = 0;
+        return error == -ENXIO || error == -EOPNOTSUPP ? kIOReturnUnsupported : kIOReturnIOError;
+    }
+    if (elan_check_firmware(image, size, &fw_info, &boot_page_count)) {
+        IOLogError("Invalid firmware image for %d pages\n", fw_info.validpage_count);
+        device_busy = 0;
+        return kIOReturnBadArgument;
+    }
+    page_count = fw_info.validpage_count;
+    
+    IOLog("%s Updating firmware, %d pages\n", getName(), page_count - boot_page_count);
+    publishFirmwareUpdateStatus("Preparing", 0, page_count - boot_page_count, 0, start_time, 0);
+    
+    error = iapPrepareFirmwareUpdate();
+    if (error)
+        goto exit;
+    
+    for (int i = boot_page_count; i < page_count; i++) {
+        const u8 *page = &image[i * ETP_FW_PAGE_SIZE];
+        u16 checksum = 0;
+        
+        for (int j = 0; j < ETP_FW_PAGE_SIZE; j += 2)
+            checksum += (page[j + 1] << 8) | page[j];
+        
+        // a page that failed verification is written again
+        int retry = ETP_RETRY_COUNT;
+        do {
+            error = iapWritePage(page);
+            if (!error)
+                break;
+            retries++;
+        } while (--retry > 0);
+        
+        if (error) {
+            IOLogError("write page %d fail: %d\n", i, error);
+            goto exit;
+        }
+        sw_checksum += checksum;
+        pages_written++;
+        
+        if (pages_written % ETP_FW_PROGRESS_INTERVAL == 0)
+            publishFirmwareUpdateStatus("Writing", pages_written, page_count - boot_page_count, retries, start_time, 0);
+    }
+    
+    /* Wait WDT reset and power on reset */
+    IOSleep(600);
+    
+    error = iapGetChecksum(true, &fw_checksum);
+    if (error)
+        goto exit;
+    
+    if (sw_checksum != fw_checksum) {
+        IOLogError("checksum diff sw=[%04hx], fw=[%04hx]\n", sw_checksum, fw_checksum);
+        error = -EIO;
+        goto exit;
+    }
+    
+exit:
+    if (error) {
+        IOLogError("firmware update failed: %d\n", error);
+        device_nub->writeByte(ETP_SMBUS_IAP_RESET_CMD);
+    }
+    
+    /* Reinitialize TP after fw is updated */
+    int init_error = tryInitialize();
+    if (init_error) {
+        IOLogError("Could not initialize ELAN device.");
+    }
+    
+    publishFirmwareUpdateStatus(error ? "Failed" : "Done", pages_written, page_count - boot_page_count, retries, start_time, error);
+    device_busy = 0;
+    return error ? kIOReturnIOError : kIOReturnSuccess;
+}
+
+// elan_smbus_get_baseline_data
+int ELANTouchpadDriver::readBaseline(elan_baseline* baseline) {
+    u8 val[I2C_SMBUS_BLOCK_MAX] = {0};
+    int error;
+    
+    error = setMode(ETP_ENABLE_CALIBRATE | ETP_ENABLE_ABS);
+    if (error) {
+        IOLogError("failed to enable calibration mode to get baseline: %d\n", error);
+        return error;
+    }
+    
+    IOSleep(ETP_CALIBRATE_POLL_MS);
+    
+    error = device_nub->readBlockData(ETP_SMBUS_MAX_BASELINE_CMD, val);
+    if (error < 0) {
+        IOLogError("failed to read max baseline: %d\n", error);
+        goto exit;
+    }
+    baseline->max = (val[0] << 8) | val[1];
+    
+    error = device_nub->readBlockData(ETP_SMBUS_MIN_BASELINE_CMD, val);
+    if (error < 0) {
+        IOLogError("failed to read min baseline: %d\n", error);
+        goto exit;
+    }
+    baseline->min = (val[0] << 8) | val[1];
+    error = 0;
+    
+exit:
+    int mode_error = setMode(ETP_ENABLE_ABS);
+    if (mode_error) {
+        IOLogError("failed to disable calibration mode: %d\n", mode_error);
+        return error ? error : mode_error;
+    }
+    return error;
+}
+
+// calibrate_store
+int ELANTouchpadDriver::calibrate() {
+    u8 cmd[4] = { 0x00, 0x08, 0x00, 0x01 };
+    u8 val[I2C_SMBUS_BLOCK_MAX] = {0};
+    int tries = ETP_CALIBRATE_TRIES;
+    int error;
+    
+    error = setMode(ETP_ENABLE_CALIBRATE | ETP_ENABLE_ABS);
+    if (error) {
+        IOLogError("failed to enable calibration mode: %d\n", error);
+        return error;
+    }
+    
+    error = device_nub->writeBlockData(ETP_SMBUS_IAP_CMD, sizeof(cmd), cmd);
+    if (error) {
+        IOLogError("failed to start calibration: %d\n", error);
+        goto exit;
+    }
+    
+    // the calibration is polled for at most ETP_CALIBRATE_TRIES * ETP_CALIBRATE_POLL_MS
+    do {
+        IOSleep(ETP_CALIBRATE_POLL_MS);
+        
+        error = device_nub->readBlockData(ETP_SMBUS_CALIBRATE_QUERY, val);
+        if (error < 0)
+            IOLogError("failed to check calibrate result: %d\n", error);
+        else if (val[0] == 0)
+            break; /* calibration done */
+    } while (--tries);
+    
+    if (tries == 0) {
+        // the result of a failed read is unknown, so the read error is reported instead of the timeout
+        if (error >= 0)
+            error = -ETIMEDOUT;
+        IOLogError("failed to calibrate: %d\n", error);
+    } else {
+        error = 0;
+    }
+    
+exit:
+    int mode_error = setMode(ETP_ENABLE_ABS);
+    if (mode_error) {
+        IOLogError("failed to disable calibration mode: %d\n", mode_error);
+        return error ? error : mode_error;
+    }
+    return error;
+}
+
+IOReturn ELANTouchpadDriver::runCalibration(bool calibrate, const char* reason) {
+    elan_baseline before = {}, after = {};
+    AbsoluteTime start, end;
+    uint64_t duration_ns;
+    int error;
+    
+    clock_get_uptime(&start);
+    noteActivity(start);
+    
+    if (!OSCompareAndSwap(0, 1, &device_busy))
+        return kIOReturnBusy;
+    
+    error = readBaseline(&before);
+    if (!error && calibrate) {
+        error = this->calibrate();
+        if (!error)
+            error = readBaseline(&after);
+    }
+    clock_get_uptime(&end);
+    absolutetime_to_nanoseconds(end - start, &duration_ns);
+    
+    if (calibrate) {
+        ts_last_calibration = end;
+        IOLog("%s Calibration (%s) %s, baseline before %d-%d, after %d-%d\n", getName(), reason,
+              error ? "failed" : "done", before.min, before.max, after.min, after.max);
+    }
+    
+    OSDictionary* status = OSDictionary::withCapacity(7);
+    if (status) {
+        OSString* string = OSString::withCString(reason);
+        status->setObject("Reason", string);
+        OSSafeReleaseNULL(string);
+        
+        OSNumber* number = OSNumber::withNumber(-error, 32);
+        status->setObject("Error", number);
+        OSSafeReleaseNULL(number);
+        number = OSNumber::withNumber(duration_ns / 1000000, 32);
+        status->setObject("DurationMs", number);
+        OSSafeReleaseNULL(number);
+        number = OSNumber::withNumber(auto_calibrations, 32);
+        status->setObject("AutoCalibrations", number);
+        OSSafeReleaseNULL(number);
+        
+        OSDictionary* baseline = baselineDictionary(&before);
+        status->setObject(calibrate ? "BaselineBefore" : "Baseline", baseline);
+        OSSafeReleaseNULL(baseline);
+        if (calibrate) {
+            baseline = baselineDictionary(&after);
+            status->setObject("BaselineAfter", baseline);
+            OSSafeReleaseNULL(baseline);
+        }
+        
+        setProperty(PROPERTY_CALIBRATION_STATUS, status);
+        OSSafeReleaseNULL(status);
+    }
+    
+    device_busy = 0;
+    return error ? kIOReturnIOError : kIOReturnSuccess;
+}
+
+void ELANTouchpadDriver::calibrationTimeout(IOTimerEventSource* timer) {
+    const elan_configuration* config = copyConfiguration();
+    AbsoluteTime now;
+    
+    clock_get_uptime(&now);
+    if (!ts_last_calibration || now - ts_last_calibration > config->auto_calibration_interval) {
+        auto_calibrations++;
+        runCalibration(true, "PhantomContact");
+    }
+    releaseConfiguration(config);
+}
+
+OSDictionary* ELANTouchpadDriver::baselineDictionary(elan_baseline* baseline) {
+    OSDictionary* dictionary = OSDictionary::withCapacity(2);
+    if (!dictionary)
+        return NULL;
+    
+    OSNumber* number = OSNumber::withNumber(baseline->max, 32);
+    dictionary->setObject("Max", number);
+    OSSafeReleaseNULL(number);
+    number = OSNumber::withNumber(baseline->min, 32);
+    dictionary->setObject("Min", number);
+    OSSafeReleaseNULL(number);
+    return dictionary;
+}
+
+void ELANTouchpadDriver::publishFirmwareUpdateStatus(const char* state, int pages_written, int page_count, int retries, uint64_t start_time, int error) {
+    OSDictionary* status = OSDictionary::withCapacity(6);
+    if (!status)
+        return;
+    
+    AbsoluteTime now;
+    uint64_t elapsed_ns;
+    clock_get_uptime(&now);
+    absolutetime_to_nanoseconds(now - start_time, &elapsed_ns);
+    uint64_t bytes_per_second = elapsed_ns ? (uint64_t) pages_written * ETP_FW_PAGE_SIZE * 1000000000 / elapsed_ns : 0;
+    
+    OSString* string = OSString::withCString(state);
+    status->setObject("State", string);
+    OSSafeReleaseNULL(string);
+    
+    OSNumber* number = OSNumber::withNumber(pages_written, 32);
+    status->setObject("PagesWritten", number);
+    OSSafeReleaseNULL(number);
+    number = OSNumber::withNumber(page_count, 32);
+    status->setObject("PageCount", number);
+    OSSafeReleaseNULL(number);
+    number = OSNumber::withNumber(retries, 32);
+    status->setObject("Retries", number);
+    OSSafeReleaseNULL(number);
+    number = OSNumber::withNumber(bytes_per_second, 64);
+    status->setObject("BytesPerSecond", number);
+    OSSafeReleaseNULL(number);
+    number = OSNumber::withNumber(-error, 32);
+    status->setObject("Error", number);
+    OSSafeReleaseNULL(number);
+    
+    setProperty(PROPERTY_FIRMWARE_UPDATE_STATUS, status);
+    OSSafeReleaseNULL(status);
+}
+
+void ELANTouchpadDriver::setInputSuppressed(bool suppressed) {
+    if (suppressed) {
+        /*
+         * No report is read while input is disabled, the trackpoint's are
+         * dropped as well, so the device may just as well sleep.
+         */
+        const elan_configuration* config = copyConfiguration();
+        if (config->sleep_while_disabled && awake) {
+            sendSleepCommand();
+            suppressed_asleep = true;
+        }
+        releaseConfiguration(config);
+        return;
+    }
+    
+    AbsoluteTime now;
+    clock_get_uptime(&now);
+    noteActivity(now);
+    
+    if (suppressed_asleep) {
+        suppressed_asleep = false;
+        int error = initialize();
+        if (error) {
+            IOLogError("Could not wake up ELAN device: %d\n", error);
+        }
+    } else {
+        // drain a report that may have been queued while the reports were not read
+        u8 report[ETP_MAX_REPORT_LEN] = {};
+        getReport(report);
+    }
+    publishSuppressionStatistics();
+}
+
+void ELANTouchpadDriver::publishSuppressionStatistics() {
+    OSDictionary* statistics = OSDictionary::withCapacity(3);
+    if (!statistics)
+        return;
+    
+    uint64_t bus_time_saved_ns;
+    absolutetime_to_nanoseconds(suppressed_bus_time, &bus_time_saved_ns);
+    
+    OSNumber* number = OSNumber::withNumber(suppressed_reports, 64);
+    statistics->setObject("SkippedReports", number);
+    OSSafeReleaseNULL(number);
+    number = OSNumber::withNumber(typing_skipped_reports, 64);
+    statistics->setObject("SkippedWhileTyping", number);
+    OSSafeReleaseNULL(number);
+    number = OSNumber::withNumber(bus_time_saved_ns / 1000, 64);
+    statistics->setObject("BusTimeSavedUs", number);
+    OSSafeReleaseNULL(number);
+    
+    setProperty(PROPERTY_SUPPRESSION_STATISTICS, statistics);
+    OSSafeReleaseNULL(statistics);
+}
+
+void ELANTouchpadDriver::recordLatency(VoodooSMBusHostNotifyTimestamps* timestamps, AbsoluteTime bus_acquired, AbsoluteTime read_end, AbsoluteTime decoded) {
+    AbsoluteTime delivered;
+    clock_get_uptime(&delivered);
+    
+    latency[ELAN_LATENCY_DISPATCH].record(timestamps->dispatch - timestamps->interrupt);
+    latency[ELAN_LATENCY_BUS_WAIT].record(bus_acquired - timestamps->dispatch);
+    latency[ELAN_LATENCY_BUS_READ].record(read_end - bus_acquired);
+    latency[ELAN_LATENCY_DECODE].record(decoded - read_end);
+    latency[ELAN_LATENCY_DELIVER].record(delivered - decoded);
+    latency[ELAN_LATENCY_TOTAL].record(delivered - timestamps->interrupt);
+    
+    uint64_t delivered_ns, published_ns;
+    absolutetime_to_nanoseconds(delivered, &delivered_ns);
+    absolutetime_to_nanoseconds(ts_latency_published, &published_ns);
+    if (delivered_ns - published_ns > ELAN_LATENCY_PUBLISH_INTERVAL * 1000000ULL) {
+        ts_latency_published = delivered;
+        publishLatencyStatistics();
+        publishFrameStatistics();
+    }
+}
+
+void ELANTouchpadDriver::publishLatencyStatistics() {
+    static const char* stage_names[ELAN_LATENCY_STAGES] = {
+        "Dispatch", "BusWait", "BusRead", "Decode", "Deliver", "Total"
+    };
+    
+    OSDictionary* statistics = OSDictionary::withCapacity(ELAN_LATENCY_STAGES);
+    if (!statistics)
+        return;
+    
+    for (int i = 0; i < ELAN_LATENCY_STAGES; i++) {
+        OSDictionary* stage = latency[i].copyStatistics();
+        if (stage) {
+            statistics->setObject(stage_names[i], stage);
+            OSSafeReleaseNULL(stage);
+        }
+    }
+    setProperty(PROPERTY_LATENCY_STATISTICS, statistics);
+    OSSafeReleaseNULL(statistics);
+}
+
+void ELANTouchpadDriver::noteActivity(AbsoluteTime timestamp) {
+    ts_last_activity = timestamp;
+    
+    /*
+     * Only leaving the idle state needs the gate, active reports stay lock free.
+     * idleTimeout stores the idle state before it checks the activity again, so
+     * either it sees this report or the report sees the idle state.
+     */
+    OSMemoryBarrier();
+    if (idle_state != ELAN_IDLE_ACTIVE && command_gate) {
+        command_gate->runAction(OSMemberFunctionCast(IOCommandGate::Action, this, &ELANTouchpadDriver::wakeFromIdleGated), &timestamp);
+    }
+}
+
+IOReturn ELANTouchpadDriver::wakeFromIdleGated(AbsoluteTime* timestamp) {
+    const elan_configuration* config = configuration;
+    
+    if (idle_state == ELAN_IDLE_ACTIVE)
+        return kIOReturnSuccess;
+    
+    AbsoluteTime now;
+    clock_get_uptime(&now);
+    setIdleState(ELAN_IDLE_ACTIVE, now);
+    idle_wakes++;
+    wake_latency.record(now - *timestamp);
+    if (config->idle_timeout_ms) {
+        idle_timer->setTimeoutMS((UInt32) config->idle_timeout_ms);
+    }
+    publishIdleStatistics();
+    return kIOReturnSuccess;
+}
+
+IOReturn ELANTouchpadDriver::resetIdleGated() {
+    const elan_configuration* config = configuration;
+    
+    AbsoluteTime now;
+    clock_get_uptime(&now);
+    
+    // the device was initialized, so it is active again
+    setIdleState(ELAN_IDLE_ACTIVE, now);
+    ts_last_activity = now;
+    if (config->idle_timeout_ms) {
+        idle_timer->setTimeoutMS((UInt32) config->idle_timeout_ms);
+    }
+    publishIdleStatistics();
+    return kIOReturnSuccess;
+}
+
+void ELANTouchpadDriver::idleTimeout(IOTimerEventSource* timer) {
+    const elan_configuration* config = configuration;
+    
+    if (idle_state != ELAN_IDLE_ACTIVE || !config->idle_timeout_ms)
+        return;
+    
+    AbsoluteTime now;
+    AbsoluteTime last_activity = ts_last_activity;
+    uint64_t inactive_ns;
+    clock_get_uptime(&now);
+    absolutetime_to_nanoseconds(now - last_activity, &inactive_ns);
+    
+    // the timer is not rearmed on every report, so check when the last one arrived
+    uint64_t inactive_ms = inactive_ns / 1000000;
+    if (last_activity <= now && inactive_ms < config->idle_timeout_ms) {
+        idle_timer->setTimeoutMS((UInt32) (config->idle_timeout_ms - inactive_ms));
+        return;
+    }
+    
+    // a report that arrived meanwhile saw the active state and didn't wake the device
+    setIdleState(ELAN_IDLE_IDLE, now);
+    OSMemoryBarrier();
+    if (ts_last_activity != last_activity) {
+        setIdleState(ELAN_IDLE_ACTIVE, now);
+        idle_timer->setTimeoutMS((UInt32) config->idle_timeout_ms);
+        return;
+    }
+    
+    idle_entries++;
+    publishIdleStatistics();
+}
+
+void ELANTouchpadDriver::setIdleState(elan_idle_state state, AbsoluteTime now) {
+    if (ts_idle_state) {
+        idle_state_time[idle_state] += now - ts_idle_state;
+    }
+    ts_idle_state = now;
+    idle_state = state;
+}
+
+void ELANTouchpadDriver::publishIdleStatistics() {
+    static const char* state_names[ELAN_IDLE_STATES] = {
+        "TimeActiveMs", "TimeIdleMs"
+    };
+    
+    OSDictionary* statistics = OSDictionary::withCapacity(ELAN_IDLE_STATES + 3);
+    if (!statistics)
+        return;
+    
+    AbsoluteTime now;
+    clock_get_uptime(&now);
+    
+    for (int i = 0; i < ELAN_IDLE_STATES; i++) {
+        uint64_t time_ns;
+        absolutetime_to_nanoseconds(idle_state_time[i] + (i == idle_state ? now - ts_idle_state : 0), &time_ns);
+        
+        OSNumber* number = OSNumber::withNumber(time_ns / 1000000, 64);
+        statistics->setObject(state_names[i], number);
+        OSSafeReleaseNULL(number);
+    }
+    
+    OSNumber* number = OSNumber::withNumber(idle_entries, 32);
+    statistics->setObject("IdleEntries", number);
+    OSSafeReleaseNULL(number);
+    number = OSNumber::withNumber(idle_wakes, 32);
+    statistics->setObject("Wakes", number);
+    OSSafeReleaseNULL(number);
+    
+    OSDictionary* latency = wake_latency.copyStatistics();
+    if (latency) {
+        statistics->setObject("WakeLatency", latency);
+        OSSafeReleaseNULL(latency);
+    }
+    
+    setProperty(PROPERTY_IDLE_STATISTICS, statistics);
+    OSSafeReleaseNULL(statistics);
+}
+
+void ELANTouchpadDriver::publishFrameStatistics() {
+    OSDictionary* statistics = OSDictionary::withCapacity(2);
+    if (!statistics)
+        return;
+    
+    OSNumber* number = OSNumber::withNumber(frame_filter.dispatched, 64);
+    statistics->setObject("DispatchedFrames", number);
+    OSSafeReleaseNULL(number);
+    number = OSNumber::withNumber(frame_filter.suppressed, 64);
+    statistics->setObject("SuppressedFrames", number);
+    OSSafeReleaseNULL(number);
+    
+    setProperty(PROPERTY_FRAME_STATISTICS, statistics);
+    OSSafeReleaseNULL(statistics);
+}
+
 IOReturn ELANTouchpadDriver::message(UInt32 type, IOService* provider, void* argument) {
     switch (type) {
         case kKeyboardGetTouchStatus: {
@@ -517,16 +1841,32 @@ IOReturn ELANTouchpadDriver::message(UInt32 type, IOService* provider, void* arg
             if (enable == ignoreall) {
                 // save state, and update LED
                 ignoreall = !enable;
+                const elan_configuration* config = copyConfiguration();
+                if (!config->ignore_set_touchpad_status) {
+                    setInputSuppressed(ignoreall);
+                }
+                releaseConfiguration(config);
             }
             break;
         }
         case kKeyboardKeyPressTime: {
-            //  Remember last time key was pressed
-            ts_last_keyboard = *((uint64_t*)argument);
+            //  Ignore input for specified time after the key press
+            const elan_configuration* config = copyConfiguration();
+            if (config->disable_while_typing) {
+                uint64_t key_time;
+                nanoseconds_to_absolutetime(*((uint64_t*)argument), &key_time);
+                elan_suppression_extend(&suppression.touchpad_until, key_time + config->disable_while_typing_timeout);
+                elan_suppression_extend(&suppression.trackpoint_until, key_time + config->disable_while_typing_timeout);
+            }
+            releaseConfiguration(config);
             break;
         }
         case kIOMessageVoodooSMBusHostNotify: {
-            handleHostNotify();
+            handleHostNotify((VoodooSMBusHostNotifyTimestamps*) argument);
+            break;
+        }
+        case kIOMessageVoodooSMBusBusReset: {
+            handleBusReset();
             break;
         }
     }
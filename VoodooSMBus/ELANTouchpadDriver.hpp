@@ -29,12 +29,21 @@
 #include <IOKit/IOKitKeys.h>
 #include <IOKit/IOService.h>
 #include <IOKit/IOCommandGate.h>
+#include <IOKit/IOTimerEventSource.h>
+#include <IOKit/IOWorkLoop.h>
+#include <IOKit/IOUserClient.h>
 #include <IOKit/acpi/IOACPIPlatformDevice.h>
 #include "VoodooSMBusDeviceNub.hpp"
 #include "i2c_smbus.h"
 #include "helpers.hpp"
 #include "TrackpointDevice.hpp"
 #include "Configuration.hpp"
+#include "ReportRecorder.hpp"
+#include "LatencyHistogram.hpp"
+#include "ELANReport.hpp"
+#include "ELANContact.hpp"
+#include "ELANSuppression.hpp"
+#include "ELANFirmware.hpp"
 #include "../Dependencies/VoodooI2C/Multitouch Support/VoodooI2CMultitouchInterface.hpp"
 
 /* https://github.com/torvalds/linux/blob/master/drivers/input/mouse/elan_i2c.h */
@@ -76,21 +85,30 @@
 #define ETP_SMBUS_IAP_PASSWORD              0x1234
 #define ETP_SMBUS_IAP_MODE_ON               (1 << 6)
 
+/* Firmware update, from https://github.com/torvalds/linux/blob/master/drivers/input/mouse/elan_i2c.h */
+#define ETP_FW_IAP_PAGE_ERR                 (1 << 5)
+#define ETP_FW_IAP_INTF_ERR                 (1 << 4)
+#define ETP_FW_PROGRESS_INTERVAL            16
+
+/* Calibration */
+#define ETP_CALIBRATE_MAX_LEN               3
+#define ETP_CALIBRATE_TRIES                 20
+#define ETP_CALIBRATE_POLL_MS               250
+/* Movement in touchpad units a contact may jitter and still be stationary */
+#define ETP_PHANTOM_TOLERANCE               4
+
 #define ELAN_VENDOR_ID                      0x04f3
-#define ETP_MAX_PRESSURE                    255
 #define ETP_FWIDTH_REDUCE                   90
 #define ETP_FINGER_WIDTH                    15
 #define ETP_RETRY_COUNT                     10
 
-#define ETP_MAX_FINGERS                     5
-#define ETP_FINGER_DATA_LEN                 5
-#define ETP_REPORT_ID                       0x5D
-#define ETP_TP_REPORT_ID                    0x5E
-#define ETP_REPORT_ID_OFFSET                2
-#define ETP_TOUCH_INFO_OFFSET               3
-#define ETP_FINGER_DATA_OFFSET              4
-#define ETP_HOVER_INFO_OFFSET               30
-#define ETP_MAX_REPORT_LEN                  34
+/* Report validation */
+#define ETP_RESYNC_BAD_REPORTS              5       /* consecutive bad reports that trigger a re-sync */
+#define ETP_RESYNC_INTERVAL_MS              5000
+#define ETP_BAD_REPORT_LOG_INTERVAL_MS      1000
+
+/* Longest pause between two replayed reports, recorded traces may contain idle periods */
+#define ETP_REPLAY_MAX_GAP_MS               1000
 
 struct elan_tp_data {
     unsigned int        max_x;
@@ -103,6 +121,75 @@ struct elan_tp_data {
     int                 pressure_adjustment;
 };
 
+/* Stages of a report from the Host Notify interrupt to the HID event */
+enum elan_latency_stage {
+    ELAN_LATENCY_DISPATCH,      /* interrupt to message dispatch */
+    ELAN_LATENCY_BUS_WAIT,      /* message dispatch to bus acquired */
+    ELAN_LATENCY_BUS_READ,      /* bus acquired to report read */
+    ELAN_LATENCY_DECODE,        /* report read to report decoded */
+    ELAN_LATENCY_DELIVER,       /* report decoded to HID event delivered */
+    ELAN_LATENCY_TOTAL,         /* interrupt to HID event delivered */
+    ELAN_LATENCY_STAGES
+};
+
+/*
+ * Configuration snapshot. A snapshot is never modified after it was
+ * published. Readers outside of the command gate hold a reference while they
+ * use it, so a snapshot replaced meanwhile is only freed after them.
+ */
+struct elan_configuration {
+    /* References of readers and the published pointer */
+    volatile SInt32     references;
+    
+    bool                disable_while_typing;
+    bool                disable_while_trackpoint;
+    bool                ignore_set_touchpad_status;
+    bool                sleep_while_disabled;
+    UInt64              disable_while_typing_timeout_ms;
+    UInt64              disable_while_trackpoint_timeout_ms;
+    
+    elan_palm_configuration palm;
+    
+    UInt64              trackpoint_sensitivity;
+    UInt64              trackpoint_acceleration;
+    UInt64              trackpoint_deadzone;
+    UInt64              trackpoint_scroll_gain;
+    UInt64              trackpoint_scroll_rate;
+    UInt64              trackpoint_scroll_friction;
+    
+    UInt64              auto_calibration_timeout_ms;
+    UInt64              auto_calibration_interval_ms;
+    /* Time without reports until the device is idle, 0 disables idle management */
+    UInt64              idle_timeout_ms;
+    /* Unchanged frames are dispatched at least this often, 0 dispatches every frame */
+    UInt64              frame_keep_alive_ms;
+    
+    /* Timeouts converted to absolute time */
+    uint64_t            disable_while_typing_timeout;
+    uint64_t            disable_while_trackpoint_timeout;
+    uint64_t            auto_calibration_timeout;
+    uint64_t            auto_calibration_interval;
+    uint64_t            frame_keep_alive;
+};
+
+/*
+ * Activity of the device while the system is awake. The device stays awake
+ * when idle, in its sleep mode it could not report the touch that ends it.
+ */
+enum elan_idle_state {
+    ELAN_IDLE_ACTIVE,           /* device is in use */
+    ELAN_IDLE_IDLE,             /* nothing was reported for the idle timeout */
+    ELAN_IDLE_STATES
+};
+
+/* Interval in ms the latency statistics are published at most */
+#define ELAN_LATENCY_PUBLISH_INTERVAL       1000
+
+struct elan_baseline {
+    int                 max;
+    int                 min;
+};
+
 // Message types defined by ApplePS2Keyboard
 enum {
     // from keyboard to mouse/touchpad
@@ -120,13 +207,36 @@ public:
     bool start(IOService* provider) override;
     void stop(IOService* provider) override;
     ELANTouchpadDriver* probe(IOService* provider, SInt32* score) override;
-    void handleHostNotify();
+    /*
+     * Reads and dispatches a report
+     * @timestamps Times the Host Notify passed the controller and nub, may be NULL
+     */
+    void handleHostNotify(VoodooSMBusHostNotifyTimestamps* timestamps);
     bool init(OSDictionary *dict) override;
     void free(void) override;
     IOReturn setPowerState(unsigned long whichState, IOService* whatDevice) override;
+    IOReturn setProperties(OSObject* properties) override;
 
 private:
     void loadConfiguration();
+    
+    /*
+     * Validates a configuration dictionary and applies it on top of a snapshot
+     * @return false if a value has the wrong type or is out of range
+     */
+    static bool parseConfiguration(OSDictionary* dict, elan_configuration* config);
+    IOReturn setConfigurationGated(OSDictionary* dict);
+    
+    /* Returns a reference to the current snapshot, which must be released after use */
+    const elan_configuration* copyConfiguration();
+    void releaseConfiguration(const elan_configuration* config);
+    
+    /*
+     * Whether the task that sets properties runs as administrator. Properties
+     * that write the flash or put the device into a diagnostic mode require it.
+     */
+    static bool callerIsAdministrator();
+    void applyConfiguration(const elan_configuration* config, const elan_configuration* old_config);
     VoodooSMBusDeviceNub* device_nub;
     VoodooI2CMultitouchInterface *mt_interface;
     TrackpointDevice *trackpoint;
@@ -140,16 +250,98 @@ private:
     static constexpr const char* CONFIG_DISABLE_WHILE_TYPING_TIMEOUT_MS = "DisableWhileTypingTimeoutMs";
     static constexpr const char* CONFIG_DISABLE_WHILE_TRACKPOINT_TIMEOUT_MS = "DisableWhileTrackpointTimeoutMs";
     static constexpr const char* CONFIG_IGNORE_SET_TOUCHPAD_STATUS = "IgnoreSetTouchpadStatus";
+    static constexpr const char* CONFIG_SLEEP_WHILE_DISABLED = "SleepWhileDisabled";
+    static constexpr const char* CONFIG_REPORT_RECORDER_SIZE = "ReportRecorderSize";
+    static constexpr const char* CONFIG_AUTO_CALIBRATION_TIMEOUT_MS = "AutoCalibrationTimeoutMs";
+    static constexpr const char* CONFIG_AUTO_CALIBRATION_INTERVAL_MS = "AutoCalibrationIntervalMs";
+    static constexpr const char* CONFIG_IDLE_TIMEOUT_MS = "IdleTimeoutMs";
+    static constexpr const char* CONFIG_FRAME_KEEP_ALIVE_MS = "FrameKeepAliveMs";
+    static constexpr const char* CONFIG_PALM_REJECTION = "PalmRejection";
+    static constexpr const char* CONFIG_PALM_REJECTION_WIDTH = "PalmRejectionWidth";
+    static constexpr const char* CONFIG_PALM_REJECTION_PRESSURE = "PalmRejectionPressure";
+    static constexpr const char* CONFIG_PALM_REJECTION_EDGE_ZONE = "PalmRejectionEdgeZone";
+    static constexpr const char* CONFIG_PALM_REJECTION_EDGE_WIDTH = "PalmRejectionEdgeWidth";
+    static constexpr const char* CONFIG_TRACKPOINT_SENSITIVITY = "TrackpointSensitivity";
+    static constexpr const char* CONFIG_TRACKPOINT_ACCELERATION = "TrackpointAcceleration";
+    static constexpr const char* CONFIG_TRACKPOINT_DEADZONE = "TrackpointDeadzone";
+    static constexpr const char* CONFIG_TRACKPOINT_SCROLL_GAIN = "TrackpointScrollGain";
+    static constexpr const char* CONFIG_TRACKPOINT_SCROLL_RATE = "TrackpointScrollRate";
+    static constexpr const char* CONFIG_TRACKPOINT_SCROLL_FRICTION = "TrackpointScrollFriction";
+    
+    static constexpr const char* PROPERTY_CONFIGURATION = "Configuration";
+    static constexpr const char* PROPERTY_EXPORT_REPORT_TRACE = "ExportReportTrace";
+    static constexpr const char* PROPERTY_RESET_REPORT_TRACE = "ResetReportTrace";
+    static constexpr const char* PROPERTY_REPORT_TRACE = "ReportTrace";
+    static constexpr const char* PROPERTY_REPLAY_REPORT_TRACE = "ReplayReportTrace";
+    static constexpr const char* PROPERTY_REPLAY_STATISTICS = "ReplayStatistics";
+    static constexpr const char* PROPERTY_FIRMWARE_UPDATE = "FirmwareUpdate";
+    static constexpr const char* PROPERTY_FIRMWARE_UPDATE_STATUS = "FirmwareUpdateStatus";
+    static constexpr const char* PROPERTY_CALIBRATE = "Calibrate";
+    static constexpr const char* PROPERTY_READ_BASELINE = "ReadBaseline";
+    static constexpr const char* PROPERTY_CALIBRATION_STATUS = "CalibrationStatus";
+    static constexpr const char* PROPERTY_LATENCY_STATISTICS = "LatencyStatistics";
+    static constexpr const char* PROPERTY_RESET_LATENCY_STATISTICS = "ResetLatencyStatistics";
+    static constexpr const char* PROPERTY_IDLE_STATISTICS = "IdleStatistics";
+    static constexpr const char* PROPERTY_FRAME_STATISTICS = "FrameStatistics";
+    static constexpr const char* PROPERTY_REPORT_STATISTICS = "ReportStatistics";
+    static constexpr const char* PROPERTY_SUPPRESSION_STATISTICS = "SuppressionStatistics";
     
-    bool disable_while_typing;
-    bool disable_while_trackpoint;
-    bool ignore_set_touchpad_status;
-    uint64_t disable_while_typing_timeout;
-    uint64_t disable_while_trackpoint_timeout;
+    /* Replaced in the command gate, loading and referencing it takes the lock */
+    const elan_configuration* configuration;
+    IOLock* configuration_lock;
+    
+    elan_contact_state contacts[ETP_MAX_FINGERS];
+    
+    elan_frame_filter frame_filter;
+    
+    /* Reports dropped by the validation, by error */
+    UInt64 bad_reports[ETP_REPORT_ERRORS];
+    UInt32 consecutive_bad_reports;
+    UInt32 unlogged_bad_reports;
+    UInt32 resyncs;
+    UInt32 bus_resets;
+    AbsoluteTime ts_bad_report_logged;
+    AbsoluteTime ts_resync;
     
     bool ignoreall;
-    uint64_t ts_last_keyboard = 0;
-    uint64_t ts_last_trackpoint = 0;
+    elan_suppression suppression;
+    
+    /* Statistics about reports that were not read while input was disabled or suppressed by typing */
+    bool suppressed_asleep;
+    UInt64 suppressed_reports;
+    UInt64 typing_skipped_reports;
+    uint64_t suppressed_bus_time;
+    /* Reports were skipped since the statistics were published */
+    bool suppression_statistics_stale;
+    /* Moving average of the bus time of a report read in absolute time */
+    uint64_t report_read_time;
+    
+    UInt32 report_recorder_size;
+    ReportRecorder recorder;
+    
+    LatencyHistogram latency[ELAN_LATENCY_STAGES];
+    AbsoluteTime ts_latency_published;
+    
+    IOWorkLoop* work_loop;
+    IOCommandGate* command_gate;
+    IOTimerEventSource* idle_timer;
+    
+    volatile UInt32 idle_state;
+    volatile AbsoluteTime ts_last_activity;
+    AbsoluteTime ts_idle_state;
+    uint64_t idle_state_time[ELAN_IDLE_STATES];
+    UInt32 idle_entries;
+    UInt32 idle_wakes;
+    LatencyHistogram wake_latency;
+    
+    /* Reports are ignored while the firmware is updated or the device is calibrated */
+    volatile UInt32 device_busy;
+    
+    bool calibration_requested;
+    /* Runs a calibration on the work loop, so it doesn't block the report path */
+    IOTimerEventSource* calibration_timer;
+    AbsoluteTime ts_last_calibration;
+    UInt32 auto_calibrations;
 
     void releaseResources();
     void unpublishMultitouchInterface();
@@ -161,15 +353,68 @@ private:
     /* ELAN device functions */
     int tryInitialize();
     int initialize();
-    int getReport(u8 *report);
-    void reportTrackpoint(u8 *report);
+    /* @transfer_start If not NULL, set to the time the read acquired the bus */
+    int getReport(u8 *report, AbsoluteTime* transfer_start = NULL);
+    /* @return the time the events were decoded, 0 if none were dispatched */
+    AbsoluteTime reportTrackpoint(u8 *report, const elan_configuration* config, AbsoluteTime timestamp);
     static unsigned int convertResolution(u8 val);
     int setMode(u8 mode);
     bool setDeviceParameters();
-    void reportContact(VoodooI2CDigitiserTransducer* transducer, bool contact_valid, u8 *finger_data, AbsoluteTime timestamp);
-    void reportAbsolute(u8 *packet);
+    bool reportContact(VoodooI2CDigitiserTransducer* transducer, const elan_configuration* config, bool contact_valid, bool hovering, u8 *finger_data, AbsoluteTime timestamp);
+    AbsoluteTime reportAbsolute(u8 *packet, const elan_configuration* config, AbsoluteTime timestamp);
     void sendSleepCommand();
     
+    /* ELAN in-application programming (IAP), used to update the firmware */
+    int iapGetMode(bool* iap_mode);
+    int iapSetFlashKey();
+    int iapPrepareFirmwareUpdate();
+    int iapWritePage(const u8 *page);
+    int iapGetChecksum(bool iap, u16 *checksum);
+    int getFirmwareInfo(elan_fw_info* info);
+    IOReturn updateFirmware(OSData* firmware);
+    
+    /* Baseline and calibration diagnostics */
+    int readBaseline(elan_baseline* baseline);
+    int calibrate();
+    IOReturn runCalibration(bool calibrate, const char* reason);
+    void calibrationTimeout(IOTimerEventSource* timer);
+    OSDictionary* baselineDictionary(elan_baseline* baseline);
+    void publishFirmwareUpdateStatus(const char* state, int pages_written, int page_count, int retries, uint64_t start_time, int error);
+    void setInputSuppressed(bool suppressed);
+    void publishSuppressionStatistics();
+    
+    void recordLatency(VoodooSMBusHostNotifyTimestamps* timestamps, AbsoluteTime bus_acquired, AbsoluteTime read_end, AbsoluteTime decoded);
+    void publishLatencyStatistics();
+    void publishFrameStatistics();
+    
+    /*
+     * Validates and dispatches a report
+     * @config Snapshot used for the whole report
+     * @timestamp Time the events are stamped with
+     * @read_end Time the report was read
+     * @decoded Set to the time the events were decoded, 0 if none were dispatched
+     * @return false if the report was dropped as invalid
+     */
+    bool processReport(u8 *report, const elan_configuration* config, AbsoluteTime timestamp, AbsoluteTime read_end, AbsoluteTime* decoded);
+#ifdef DEBUG
+    IOReturn replayReportTrace(OSData* trace);
+#endif
+    
+    /* Report validation */
+    void handleBadReport(elan_report_error error, u8 *report, AbsoluteTime now);
+    void handleBusReset();
+    /* Initializes the device again, must be called with device_busy set and clears it */
+    void reinitialize(AbsoluteTime now);
+    void publishReportStatistics();
+    
+    /* Idle management */
+    void noteActivity(AbsoluteTime timestamp);
+    IOReturn wakeFromIdleGated(AbsoluteTime* timestamp);
+    IOReturn resetIdleGated();
+    void idleTimeout(IOTimerEventSource* timer);
+    void setIdleState(elan_idle_state state, AbsoluteTime now);
+    void publishIdleStatistics();
+    
     /*
      * Called by ApplePS2Controller to notify of keyboard interactions
      * @type Custom message type in iokit_vendor_specific_msg range
@@ -11,4 +11,32 @@
 
 #define kIOMessageVoodooSMBusHostNotify iokit_vendor_specific_msg(420)
 
+/*
+ * Sent after the controller reset a hung bus. The device may have lost its
+ * state and should be initialized again. No argument.
+ */
+#define kIOMessageVoodooSMBusBusReset iokit_vendor_specific_msg(421)
+
+/* Sent when the device answered the Alert Response Address after an SMBALERT# */
+#define kIOMessageVoodooSMBusAlert iokit_vendor_specific_msg(422)
+
+/*
+ * Argument of kIOMessageVoodooSMBusHostNotify, all times are absolute
+ * times. Only valid for the duration of the message.
+ */
+typedef struct {
+    /* Host Notify interrupt was handled by the controller */
+    uint64_t interrupt;
+    /* message is dispatched to the client */
+    uint64_t dispatch;
+} VoodooSMBusHostNotifyTimestamps;
+
+/* Argument of kIOMessageVoodooSMBusAlert, only valid for the duration of the message */
+typedef struct {
+    /* absolute time the SMBALERT# interrupt was handled by the controller */
+    uint64_t interrupt;
+    /* least significant bit of the alert response, its meaning is up to the device */
+    uint8_t data;
+} VoodooSMBusAlert;
+
 #endif /* HostNotifyMessage_h */
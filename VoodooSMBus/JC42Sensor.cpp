@@ -0,0 +1,90 @@
+/*
+ * JC42Sensor.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ * Register layout and detection based on the linux driver:
+ * https://github.com/torvalds/linux/blob/master/drivers/hwmon/jc42.c
+ */
+
+#include "JC42Sensor.hpp"
+
+/* Manufacturer ids */
+#define ADT_MANID           0x11d4  /* Analog Devices */
+#define ATMEL_MANID         0x001f  /* Atmel */
+#define ATMEL_MANID2        0x1114  /* Atmel */
+#define MAX_MANID           0x004d  /* Maxim */
+#define IDT_MANID           0x00b3  /* IDT */
+#define MCP_MANID           0x0054  /* Microchip */
+#define NXP_MANID           0x1131  /* NXP Semiconductors */
+#define ONS_MANID           0x1b09  /* ON Semiconductor */
+#define STM_MANID           0x104a  /* ST Microelectronics */
+#define GT_MANID            0x1c68  /* Giantec */
+#define GT_MANID2           0x132d  /* Giantec, 2nd mfg ID */
+#define SI_MANID            0x1c85  /* Seiko Instruments */
+
+struct jc42_chip {
+    u16 manid;
+    u16 devid;
+    u16 devid_mask;
+};
+
+static const struct jc42_chip jc42_chips[] = {
+    { ADT_MANID, 0x0801, 0xffff },      /* ADT7408 */
+    { ATMEL_MANID, 0x8201, 0xffff },    /* AT30TS00 */
+    { ATMEL_MANID2, 0x2200, 0xffff },   /* AT30TSE004 */
+    { GT_MANID, 0x2200, 0xff00 },       /* GT30TS00 */
+    { GT_MANID2, 0x3300, 0xff00 },      /* GT34TS02 */
+    { IDT_MANID, 0x2200, 0xff00 },      /* TSE2004 */
+    { IDT_MANID, 0x2900, 0xff00 },      /* TS3000, TSE2002 */
+    { IDT_MANID, 0x3000, 0xff00 },      /* TS3001 */
+    { MAX_MANID, 0x3e00, 0xffff },      /* MAX6604 */
+    { MCP_MANID, 0x0200, 0xfffc },      /* MCP9804 */
+    { MCP_MANID, 0x0400, 0xfffc },      /* MCP9808 */
+    { MCP_MANID, 0x2000, 0xfffc },      /* MCP98242 */
+    { MCP_MANID, 0x2100, 0xfffc },      /* MCP98243 */
+    { MCP_MANID, 0x2200, 0xfffc },      /* MCP98244 */
+    { MCP_MANID, 0x0000, 0xfffe },      /* MCP9843, MCP9805 */
+    { NXP_MANID, 0xa200, 0xfffc },      /* SE97 */
+    { NXP_MANID, 0xa100, 0xfffc },      /* SE98 */
+    { ONS_MANID, 0x0800, 0xffe0 },      /* CAT6095, CAT34TS02 */
+    { ONS_MANID, 0x0a00, 0xfff0 },      /* CAT34TS02C */
+    { ONS_MANID, 0x2200, 0xfff0 },      /* CAT34TS04 */
+    { ONS_MANID, 0x2230, 0xfff0 },      /* N34TS04 */
+    { SI_MANID, 0x2221, 0xffff },       /* S34TS04A */
+    { STM_MANID, 0x0101, 0xffff },      /* STTS424 */
+    { STM_MANID, 0x0000, 0xfffe },      /* STTS424E */
+    { STM_MANID, 0x0300, 0xffff },      /* STTS2002 */
+    { STM_MANID, 0x2201, 0xffff },      /* STTS2004 */
+    { STM_MANID, 0x0200, 0xffff },      /* STTS3000 */
+};
+
+s32 jc42_read_register(const struct i2c_smbus_client *client, u8 reg) {
+    s32 value = i2c_smbus_read_word_data(client, reg);
+    if (value < 0)
+        return value;
+    return ((value & 0xff) << 8) | ((value >> 8) & 0xff);
+}
+
+bool jc42_detect(const struct i2c_smbus_client *client) {
+    s32 capability = jc42_read_register(client, JC42_REG_CAPABILITY);
+    s32 config = jc42_read_register(client, JC42_REG_CONFIG);
+    s32 manid = jc42_read_register(client, JC42_REG_MANID);
+    s32 devid = jc42_read_register(client, JC42_REG_DEVICEID);
+    
+    if (capability < 0 || config < 0 || manid < 0 || devid < 0)
+        return false;
+    if ((capability & JC42_CAPABILITY_RESERVED) || (config & JC42_CONFIG_RESERVED))
+        return false;
+    
+    for (size_t i = 0; i < sizeof(jc42_chips) / sizeof(jc42_chips[0]); i++) {
+        const struct jc42_chip *chip = &jc42_chips[i];
+        if (manid == chip->manid && (devid & chip->devid_mask) == chip->devid)
+            return true;
+    }
+    return false;
+}
+
+int32_t jc42_temperature_millicelsius(u16 raw) {
+    int sixteenths = (raw & JC42_TEMP_MASK & ~JC42_TEMP_SIGN) - ((raw & JC42_TEMP_SIGN) ? JC42_TEMP_SIGN : 0);
+    return sixteenths * 1000 / 16;
+}
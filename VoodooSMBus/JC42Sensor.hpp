@@ -0,0 +1,49 @@
+/*
+ * JC42Sensor.hpp
+ * SMBus Controller Driver for macOS X
+ *
+ * Register layout and detection based on the linux driver:
+ * https://github.com/torvalds/linux/blob/master/drivers/hwmon/jc42.c
+ */
+
+#ifndef JC42Sensor_hpp
+#define JC42Sensor_hpp
+
+/*
+ * Detection and reading of JC-42.4 DIMM temperature sensors. This file must
+ * not depend on IOKit, so the detection can be tested against simulated
+ * devices on the host.
+ */
+#include "i2c_smbus.h"
+
+/* JC-42.4 registers, all 16 bit and sent MSB first */
+#define JC42_REG_CAPABILITY         0x00
+#define JC42_REG_CONFIG             0x01
+#define JC42_REG_TEMP               0x05
+#define JC42_REG_MANID              0x06
+#define JC42_REG_DEVICEID           0x07
+
+#define JC42_CFG_SHUTDOWN           (1 << 8)
+/* Bits of the capability and config registers that are always 0 */
+#define JC42_CAPABILITY_RESERVED    0xff00
+#define JC42_CONFIG_RESERVED        0xf800
+
+/* Temperature in 1/16 degrees Celsius, 13 bit two's complement */
+#define JC42_TEMP_MASK              0x1fff
+#define JC42_TEMP_SIGN              0x1000
+
+/* Reads a register, swapping it to host order, @return value or negative errno */
+s32 jc42_read_register(const struct i2c_smbus_client *client, u8 reg);
+
+/*
+ * Whether the device is a JC-42.4 sensor: the reserved bits of its capability
+ * and config registers are clear and its manufacturer and device id are those
+ * of a known sensor. The address range of the sensors is shared with other
+ * devices, which could be confused by the driver's accesses.
+ */
+bool jc42_detect(const struct i2c_smbus_client *client);
+
+/* Converts the temperature register to millidegrees Celsius */
+int32_t jc42_temperature_millicelsius(u16 raw);
+
+#endif /* JC42Sensor_hpp */
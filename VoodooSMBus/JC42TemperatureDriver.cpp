@@ -0,0 +1,122 @@
+/*
+ * JC42TemperatureDriver.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include "JC42TemperatureDriver.hpp"
+
+#define super IOService
+OSDefineMetaClassAndStructors(JC42TemperatureDriver, IOService);
+
+JC42TemperatureDriver* JC42TemperatureDriver::probe(IOService* provider, SInt32* score) {
+    if (!super::probe(provider, score)) {
+        return NULL;
+    }
+    
+    device_nub = OSDynamicCast(VoodooSMBusDeviceNub, provider);
+    if (!device_nub) {
+        IOLog("%s Could not get VoodooSMBus device nub instance\n", getName());
+        return NULL;
+    }
+    
+    // the address range is shared with other devices, only accept known JC-42.4 sensors
+    client = device_nub->getSMBusClient();
+    if (!jc42_detect(&client))
+        return NULL;
+    return this;
+}
+
+bool JC42TemperatureDriver::start(IOService* provider) {
+    if (!super::start(provider)) {
+        return false;
+    }
+    
+    s32 manufacturer = jc42_read_register(&client, JC42_REG_MANID);
+    s32 device = jc42_read_register(&client, JC42_REG_DEVICEID);
+    s32 config = jc42_read_register(&client, JC42_REG_CONFIG);
+    if (manufacturer < 0 || device < 0 || config < 0) {
+        IOLogError("%s Could not read temperature sensor at %#04x\n", getName(), device_nub->getAddress());
+        return false;
+    }
+    
+    if (config & JC42_CFG_SHUTDOWN) {
+        IOLogError("%s Temperature sensor at %#04x is shut down\n", getName(), device_nub->getAddress());
+        return false;
+    }
+    
+    OSNumber* number = OSNumber::withNumber(manufacturer, 16);
+    setProperty("ManufacturerId", number);
+    OSSafeReleaseNULL(number);
+    number = OSNumber::withNumber(device, 16);
+    setProperty("DeviceId", number);
+    OSSafeReleaseNULL(number);
+    
+    min_temperature = INT32_MAX;
+    max_temperature = INT32_MIN;
+    
+    if (device_nub->registerPoll(this, OSMemberFunctionCast(VoodooSMBusPollAction, this, &JC42TemperatureDriver::poll)) != kIOReturnSuccess) {
+        IOLogError("%s Could not register temperature sensor for polling\n", getName());
+        return false;
+    }
+    polling = true;
+    
+    registerService();
+    return true;
+}
+
+void JC42TemperatureDriver::stop(IOService* provider) {
+    if (polling) {
+        device_nub->unregisterPoll();
+        polling = false;
+    }
+    super::stop(provider);
+}
+
+void JC42TemperatureDriver::poll() {
+    s32 raw = jc42_read_register(&client, JC42_REG_TEMP);
+    
+    if (raw < 0) {
+        read_errors++;
+        consecutive_errors++;
+    } else {
+        temperature = jc42_temperature_millicelsius((u16) raw);
+        if (temperature < min_temperature)
+            min_temperature = temperature;
+        if (temperature > max_temperature)
+            max_temperature = temperature;
+        reads++;
+        consecutive_errors = 0;
+    }
+    publishTemperature();
+}
+
+void JC42TemperatureDriver::publishTemperature() {
+    OSDictionary* status = OSDictionary::withCapacity(5);
+    if (!status)
+        return;
+    
+    OSNumber* number;
+    if (reads && consecutive_errors < JC42_STALE_ERRORS) {
+        number = OSNumber::withNumber((SInt64) temperature, 32);
+        status->setObject("CurrentMilliCelsius", number);
+        OSSafeReleaseNULL(number);
+    }
+    if (reads) {
+        number = OSNumber::withNumber((SInt64) min_temperature, 32);
+        status->setObject("MinMilliCelsius", number);
+        OSSafeReleaseNULL(number);
+        number = OSNumber::withNumber((SInt64) max_temperature, 32);
+        status->setObject("MaxMilliCelsius", number);
+        OSSafeReleaseNULL(number);
+    }
+    number = OSNumber::withNumber(reads, 64);
+    status->setObject("Reads", number);
+    OSSafeReleaseNULL(number);
+    number = OSNumber::withNumber(read_errors, 64);
+    status->setObject("ReadErrors", number);
+    OSSafeReleaseNULL(number);
+    
+    setProperty("Temperature", status);
+    OSSafeReleaseNULL(status);
+}
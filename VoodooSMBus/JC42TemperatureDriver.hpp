@@ -0,0 +1,48 @@
+/*
+ * JC42TemperatureDriver.hpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#ifndef JC42TemperatureDriver_hpp
+#define JC42TemperatureDriver_hpp
+
+#include <IOKit/IOLib.h>
+#include <IOKit/IOService.h>
+#include "VoodooSMBusDeviceNub.hpp"
+#include "helpers.hpp"
+#include "JC42Sensor.hpp"
+
+/* Failed reads in a row after which the reading is no longer published as current */
+#define JC42_STALE_ERRORS           3
+
+/*
+ * Reads a DIMM temperature sensor in the poll windows of the controller and
+ * publishes the current, minimum and maximum temperature.
+ */
+class JC42TemperatureDriver : public IOService {
+    OSDeclareDefaultStructors(JC42TemperatureDriver);
+    
+public:
+    JC42TemperatureDriver* probe(IOService* provider, SInt32* score) override;
+    bool start(IOService* provider) override;
+    void stop(IOService* provider) override;
+    
+private:
+    VoodooSMBusDeviceNub* device_nub;
+    struct i2c_smbus_client client;
+    bool polling;
+    
+    /* Temperatures in millidegrees Celsius */
+    SInt32 temperature;
+    SInt32 min_temperature;
+    SInt32 max_temperature;
+    UInt64 reads;
+    UInt64 read_errors;
+    UInt32 consecutive_errors;
+    
+    void poll();
+    void publishTemperature();
+};
+
+#endif /* JC42TemperatureDriver_hpp */
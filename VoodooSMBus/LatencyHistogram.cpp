@@ -0,0 +1,57 @@
+/*
+ * LatencyHistogram.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include "LatencyHistogram.hpp"
+
+void LatencyHistogram::record(uint64_t latency) {
+    recordMicroseconds(smbus_absolutetime_to_nanoseconds(latency) / 1000);
+}
+
+void LatencyHistogram::recordMicroseconds(uint64_t latency_us) {
+    int bucket = 0;
+    for (uint64_t value = latency_us; value && bucket < LATENCY_HISTOGRAM_BUCKETS - 1; value >>= 1)
+        bucket++;
+    __atomic_fetch_add(&buckets[bucket], 1, __ATOMIC_RELAXED);
+    
+    uint64_t old_max = __atomic_load_n(&max_us, __ATOMIC_RELAXED);
+    while (latency_us > old_max &&
+           !__atomic_compare_exchange_n(&max_us, &old_max, latency_us, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+void LatencyHistogram::reset() {
+    for (int i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++)
+        buckets[i] = 0;
+    max_us = 0;
+}
+
+uint32_t LatencyHistogram::count() {
+    uint32_t count = 0;
+    for (int i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++)
+        count += buckets[i];
+    return count;
+}
+
+uint64_t LatencyHistogram::maximum() {
+    return max_us;
+}
+
+uint64_t LatencyHistogram::percentile(uint32_t permille) {
+    uint64_t rank = ((uint64_t) count() * permille + 999) / 1000;
+    uint64_t seen = 0;
+    
+    if (!rank)
+        return 0;
+    
+    for (int i = 0; i < LATENCY_HISTOGRAM_BUCKETS - 1; i++) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            uint64_t bound = 1ULL << i;
+            return bound < max_us ? bound : max_us;
+        }
+    }
+    return max_us;
+}
@@ -0,0 +1,58 @@
+/*
+ * LatencyHistogram.hpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#ifndef LatencyHistogram_hpp
+#define LatencyHistogram_hpp
+
+/*
+ * Only `copyStatistics` is implemented by the kext, in LatencyStatistics.cpp.
+ */
+#include "smbus_platform.h"
+
+class OSDictionary;
+
+/*
+ * Bucket 0 counts samples below 1us, bucket i counts samples in
+ * [2^(i-1), 2^i) us and the last bucket everything above.
+ */
+#define LATENCY_HISTOGRAM_BUCKETS   24
+
+/*
+ * Log2 histogram of latencies in microseconds. Samples are added with
+ * atomic operations only, so recording is cheap enough to stay enabled
+ * and needs no lock against readers or concurrent writers.
+ */
+class LatencyHistogram {
+public:
+    /*
+     * Adds a sample
+     * @latency Latency in absolute time units
+     */
+    void record(uint64_t latency);
+    void recordMicroseconds(uint64_t latency_us);
+    void reset();
+    
+    uint32_t count();
+    uint64_t maximum();
+    
+    /*
+     * Latency in us at or below which @permille of the samples are. This is
+     * the upper bound of the bucket it falls into, 0 without samples.
+     */
+    uint64_t percentile(uint32_t permille);
+    
+    /*
+     * Creates a dictionary with Count, P50Us, P99Us and MaxUs. Percentiles
+     * are upper bounds of the bucket they fall into.
+     */
+    OSDictionary* copyStatistics();
+    
+private:
+    volatile uint32_t buckets[LATENCY_HISTOGRAM_BUCKETS] = {};
+    volatile uint64_t max_us = 0;
+};
+
+#endif /* LatencyHistogram_hpp */
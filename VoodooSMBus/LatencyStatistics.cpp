@@ -0,0 +1,29 @@
+/*
+ * LatencyStatistics.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include <IOKit/IOLib.h>
+#include <IOKit/IOService.h>
+#include "LatencyHistogram.hpp"
+
+OSDictionary* LatencyHistogram::copyStatistics() {
+    OSDictionary* statistics = OSDictionary::withCapacity(4);
+    if (!statistics)
+        return NULL;
+    
+    OSNumber* number = OSNumber::withNumber(count(), 32);
+    statistics->setObject("Count", number);
+    OSSafeReleaseNULL(number);
+    number = OSNumber::withNumber(percentile(500), 64);
+    statistics->setObject("P50Us", number);
+    OSSafeReleaseNULL(number);
+    number = OSNumber::withNumber(percentile(990), 64);
+    statistics->setObject("P99Us", number);
+    OSSafeReleaseNULL(number);
+    number = OSNumber::withNumber(maximum(), 64);
+    statistics->setObject("MaxUs", number);
+    OSSafeReleaseNULL(number);
+    return statistics;
+}
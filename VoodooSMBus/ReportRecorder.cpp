@@ -0,0 +1,86 @@
+/*
+ * ReportRecorder.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include "ReportRecorder.hpp"
+
+bool ReportRecorder::init(UInt32 capacity) {
+    free();
+    if (capacity == 0)
+        return true;
+    
+    // a power of two keeps the ring index consistent when the counter wraps
+    UInt32 size = 1;
+    while (size < capacity && size < (1U << 20))
+        size <<= 1;
+    
+    records = reinterpret_cast<report_trace_record*>(IOMalloc(size * sizeof(report_trace_record)));
+    if (!records)
+        return false;
+    
+    memset(records, 0, size * sizeof(report_trace_record));
+    this->capacity = size;
+    next = 0;
+    return true;
+}
+
+void ReportRecorder::free() {
+    if (records) {
+        IOFree(records, capacity * sizeof(report_trace_record));
+        records = NULL;
+    }
+    capacity = 0;
+    next = 0;
+}
+
+void ReportRecorder::reset() {
+    next = 0;
+}
+
+void ReportRecorder::record(uint64_t notify_time, uint64_t read_time, const UInt8 *report) {
+    if (!records)
+        return;
+    
+    UInt32 index = (UInt32) OSIncrementAtomic(&next) & (capacity - 1);
+    report_trace_record* record = &records[index];
+    
+    // times are converted to nanoseconds on export, not on the report path
+    record->notify_ns = notify_time;
+    record->read_ns = read_time;
+    memcpy(record->report, report, REPORT_TRACE_REPORT_LEN);
+}
+
+OSData* ReportRecorder::exportTrace() {
+    UInt32 total = (UInt32) next;
+    UInt32 count = total < capacity ? total : capacity;
+    
+    report_trace_header header = {
+        .magic = REPORT_TRACE_MAGIC,
+        .version = REPORT_TRACE_VERSION,
+        .record_size = sizeof(report_trace_record),
+        .record_count = count,
+        .dropped_count = total - count,
+    };
+    
+    OSData* trace = OSData::withCapacity(sizeof(header) + count * sizeof(report_trace_record));
+    if (!trace)
+        return NULL;
+    
+    trace->appendBytes(&header, sizeof(header));
+    for (UInt32 i = total - count; i != total; i++) {
+        report_trace_record record = records[i & (capacity - 1)];
+        uint64_t notify_ns, read_ns;
+        absolutetime_to_nanoseconds(record.notify_ns, &notify_ns);
+        absolutetime_to_nanoseconds(record.read_ns, &read_ns);
+        record.notify_ns = notify_ns;
+        record.read_ns = read_ns;
+        trace->appendBytes(&record, sizeof(record));
+    }
+    return trace;
+}
+
+const report_trace_record* ReportRecorder::parseTrace(OSData* trace, UInt32* count) {
+    return report_trace_parse(reinterpret_cast<const UInt8*>(trace->getBytesNoCopy()), trace->getLength(), count);
+}
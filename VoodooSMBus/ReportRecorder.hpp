@@ -0,0 +1,59 @@
+/*
+ * ReportRecorder.hpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#ifndef ReportRecorder_hpp
+#define ReportRecorder_hpp
+
+#include <IOKit/IOLib.h>
+#include <IOKit/IOService.h>
+#include "helpers.hpp"
+#include "ReportTrace.hpp"
+
+/*
+ * Records raw reports into a preallocated ring buffer. Recording does not
+ * allocate memory or take locks, so it can stay enabled on the report path.
+ */
+class ReportRecorder {
+public:
+    /*
+     * Allocates the ring buffer
+     * @capacity Number of records, rounded up to a power of two
+     */
+    bool init(UInt32 capacity);
+    void free();
+    
+    bool isEnabled() { return records != NULL; }
+    
+    /*
+     * Stores a report in the ring buffer, overwriting the oldest one if it is full
+     * @notify_time Absolute time the Host Notify arrived
+     * @read_time Absolute time the report was read
+     * @report Raw report of REPORT_TRACE_REPORT_LEN bytes
+     */
+    void record(uint64_t notify_time, uint64_t read_time, const UInt8 *report);
+    
+    /*
+     * Serializes the recorded reports into the binary trace format.
+     * Reports recorded while exporting may be torn.
+     */
+    OSData* exportTrace();
+    void reset();
+    
+    /*
+     * Checks a trace in the binary trace format
+     * @trace Trace as published by exportTrace
+     * @count Number of records in the trace
+     * @return First record or NULL if the trace is malformed
+     */
+    static const report_trace_record* parseTrace(OSData* trace, UInt32* count);
+    
+private:
+    report_trace_record* records = NULL;
+    UInt32 capacity = 0;
+    volatile SInt32 next = 0;
+};
+
+#endif /* ReportRecorder_hpp */
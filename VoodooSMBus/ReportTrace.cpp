@@ -0,0 +1,24 @@
+/*
+ * ReportTrace.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include <string.h>
+#include "ReportTrace.hpp"
+
+const struct report_trace_record* report_trace_parse(const uint8_t *trace, size_t length, uint32_t *count) {
+    struct report_trace_header header;
+    
+    if (!trace || length < sizeof(header))
+        return NULL;
+    
+    memcpy(&header, trace, sizeof(header));
+    if (header.magic != REPORT_TRACE_MAGIC || header.version != REPORT_TRACE_VERSION ||
+        header.record_size != sizeof(struct report_trace_record) ||
+        header.record_count > (length - sizeof(header)) / sizeof(struct report_trace_record))
+        return NULL;
+    
+    *count = header.record_count;
+    return reinterpret_cast<const struct report_trace_record*>(trace + sizeof(header));
+}
@@ -0,0 +1,51 @@
+/*
+ * ReportTrace.hpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#ifndef ReportTrace_hpp
+#define ReportTrace_hpp
+
+/*
+ * Binary trace format of recorded ELAN reports. This file must not depend on
+ * IOKit, so traces exported by the kext can be read by the replay tool.
+ *
+ * All values are little endian:
+ *
+ *   report_trace_header
+ *   report_trace_record[record_count], oldest record first
+ */
+#include <stddef.h>
+#include <stdint.h>
+
+#define REPORT_TRACE_MAGIC          0x43525445  /* "ETRC" */
+#define REPORT_TRACE_VERSION        1
+#define REPORT_TRACE_REPORT_LEN     34
+
+struct __attribute__((packed)) report_trace_header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_size;
+    uint32_t record_count;
+    /* number of records that were overwritten before they were exported */
+    uint32_t dropped_count;
+};
+
+struct __attribute__((packed)) report_trace_record {
+    /* time the Host Notify for this report arrived in ns since boot */
+    uint64_t notify_ns;
+    /* time the report read completed in ns since boot */
+    uint64_t read_ns;
+    uint8_t report[REPORT_TRACE_REPORT_LEN];
+    uint8_t reserved[6];
+};
+
+/*
+ * Checks a trace in the binary trace format
+ * @count Number of records in the trace
+ * @return First record or NULL if the trace is malformed
+ */
+const struct report_trace_record* report_trace_parse(const uint8_t *trace, size_t length, uint32_t *count);
+
+#endif /* ReportTrace_hpp */
@@ -0,0 +1,28 @@
+/*
+ * SMBusAlert.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include "SMBusAlert.hpp"
+
+int smbus_alert_respond(const struct i2c_smbus_client *ara, smbus_alert_handler handler, void *context,
+                        struct smbus_alert_statistics *statistics) {
+    int responses;
+    
+    // every device that asserts SMBALERT# answers in turn, lowest address first
+    for (responses = 0; responses < SMBUS_ALERT_MAX_RESPONSES; responses++) {
+        s32 response = i2c_smbus_read_byte(ara);
+        if (response < 0)
+            break;
+        
+        if (handler(context, (u8) (response >> 1), response & 1))
+            statistics->dispatched++;
+        else
+            statistics->unclaimed++;
+    }
+    
+    if (!responses)
+        statistics->unanswered++;
+    return responses;
+}
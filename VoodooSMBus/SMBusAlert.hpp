@@ -0,0 +1,47 @@
+/*
+ * SMBusAlert.hpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#ifndef SMBusAlert_hpp
+#define SMBusAlert_hpp
+
+/*
+ * Handling of SMBALERT#: devices that assert it answer a read of the Alert
+ * Response Address with their own address, lowest address first, and release
+ * it once they were answered.
+ */
+#include <stdint.h>
+#include "i2c_smbus.h"
+
+/* Devices asserting SMBALERT# answer a read from this address with their own address */
+#define SMBUS_ALERT_RESPONSE_ADDRESS    0x0c
+/* Alert responses read per SMBALERT#, so a device that keeps alerting can't stall the bus */
+#define SMBUS_ALERT_MAX_RESPONSES       8
+
+struct smbus_alert_statistics {
+    /* Responses of devices with a driver */
+    uint64_t dispatched;
+    /* Responses of devices without a driver */
+    uint64_t unclaimed;
+    /* Alerts no device answered */
+    uint64_t unanswered;
+};
+
+/*
+ * Passes an alert response of the device at @address to its driver
+ * @flag is the least significant bit of the response, its meaning is up to the device
+ * @return false if there is no driver for the device
+ */
+typedef bool (*smbus_alert_handler)(void *context, u8 address, u8 flag);
+
+/*
+ * Reads the Alert Response Address through @ara until no device answers,
+ * at most SMBUS_ALERT_MAX_RESPONSES times, and passes every response to @handler
+ * @return the number of responses
+ */
+int smbus_alert_respond(const struct i2c_smbus_client *ara, smbus_alert_handler handler, void *context,
+                        struct smbus_alert_statistics *statistics);
+
+#endif /* SMBusAlert_hpp */
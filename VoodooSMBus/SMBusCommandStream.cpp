@@ -0,0 +1,265 @@
+/*
+ * SMBusCommandStream.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include "SMBusCommandStream.hpp"
+
+/* Size of union i2c_smbus_data, the block holds a length byte and room for PEC */
+#define SMBUS_STREAM_TRANSFER_SIZE      (SMBUS_STREAM_DATA_MAX + 2)
+
+static uint16_t get_le16(const uint8_t *p) {
+    return (uint16_t) (p[0] | p[1] << 8);
+}
+
+static uint32_t get_le32(const uint8_t *p) {
+    return (uint32_t) get_le16(p) | (uint32_t) get_le16(p + 2) << 16;
+}
+
+static void put_le16(uint8_t *p, uint16_t value) {
+    p[0] = value & 0xff;
+    p[1] = value >> 8;
+}
+
+static void put_le32(uint8_t *p, uint32_t value) {
+    put_le16(p, value & 0xffff);
+    put_le16(p + 2, value >> 16);
+}
+
+static size_t put_header(uint8_t *stream, uint32_t magic, uint16_t count) {
+    put_le32(stream, magic);
+    put_le16(stream + 4, SMBUS_STREAM_VERSION);
+    put_le16(stream + 6, count);
+    return SMBUS_STREAM_HEADER_SIZE;
+}
+
+/* Checks that the data length fits the protocol and direction of a command */
+static bool command_valid(const struct smbus_stream_command *command) {
+    if (command->address > 0x7f || command->read_write > SMBUS_STREAM_READ ||
+        (command->flags & ~SMBUS_STREAM_FLAGS) || command->length > SMBUS_STREAM_DATA_MAX)
+        return false;
+
+    bool read = command->read_write == SMBUS_STREAM_READ;
+    switch (command->protocol) {
+        case SMBUS_STREAM_QUICK:
+        case SMBUS_STREAM_BYTE:
+            /* "send byte" sends the command byte */
+            return command->length == 0;
+        case SMBUS_STREAM_BYTE_DATA:
+            return command->length == (read ? 0 : 1);
+        case SMBUS_STREAM_WORD_DATA:
+            return command->length == (read ? 0 : 2);
+        case SMBUS_STREAM_BLOCK_DATA:
+            return read ? command->length == 0 : command->length > 0;
+        case SMBUS_STREAM_I2C_BLOCK_DATA:
+            return command->length > 0;
+        default:
+            return false;
+    }
+}
+
+/* Most data bytes the result of a command can hold */
+static size_t result_capacity(const struct smbus_stream_command *command) {
+    if (command->read_write == SMBUS_STREAM_WRITE)
+        return 0;
+
+    switch (command->protocol) {
+        case SMBUS_STREAM_BYTE:
+        case SMBUS_STREAM_BYTE_DATA:
+            return 1;
+        case SMBUS_STREAM_WORD_DATA:
+            return 2;
+        case SMBUS_STREAM_BLOCK_DATA:
+            return SMBUS_STREAM_DATA_MAX;
+        case SMBUS_STREAM_I2C_BLOCK_DATA:
+            return command->length;
+        default:
+            return 0;
+    }
+}
+
+void smbus_stream_allow(struct smbus_stream_allowlist *allowlist, uint8_t address, bool write) {
+    if (address > 0x7f)
+        return;
+    uint8_t *bitmap = write ? allowlist->write : allowlist->read;
+    bitmap[address / 8] |= 1 << (address % 8);
+}
+
+bool smbus_stream_allowed(const struct smbus_stream_allowlist *allowlist, const struct smbus_stream_command *command) {
+    if (command->address > 0x7f)
+        return false;
+    const uint8_t *bitmap = command->read_write == SMBUS_STREAM_WRITE ? allowlist->write : allowlist->read;
+    return bitmap[command->address / 8] & (1 << (command->address % 8));
+}
+
+size_t smbus_stream_begin(uint8_t *stream, size_t capacity) {
+    if (capacity < SMBUS_STREAM_HEADER_SIZE)
+        return 0;
+    return put_header(stream, SMBUS_STREAM_COMMAND_MAGIC, 0);
+}
+
+bool smbus_stream_add(uint8_t *stream, size_t capacity, size_t *length, const struct smbus_stream_command *command) {
+    uint16_t count = get_le16(stream + 6);
+    size_t data_length = command->read_write == SMBUS_STREAM_WRITE ? command->length : 0;
+
+    if (!command_valid(command) || count == SMBUS_STREAM_MAX_COMMANDS ||
+        *length + SMBUS_STREAM_COMMAND_SIZE + data_length > capacity)
+        return false;
+
+    uint8_t *p = stream + *length;
+    p[0] = command->address;
+    p[1] = command->protocol;
+    p[2] = command->read_write;
+    p[3] = command->command;
+    p[4] = command->flags;
+    p[5] = command->length;
+    for (size_t i = 0; i < data_length; i++)
+        p[SMBUS_STREAM_COMMAND_SIZE + i] = command->data[i];
+
+    *length += SMBUS_STREAM_COMMAND_SIZE + data_length;
+    put_le16(stream + 6, count + 1);
+    return true;
+}
+
+int smbus_stream_decode_header(const uint8_t *stream, size_t length, uint32_t magic) {
+    if (length < SMBUS_STREAM_HEADER_SIZE || get_le32(stream) != magic ||
+        get_le16(stream + 4) != SMBUS_STREAM_VERSION)
+        return SMBUS_STREAM_EINVAL;
+    return get_le16(stream + 6);
+}
+
+int smbus_stream_decode_command(const uint8_t *stream, size_t length, size_t *offset, struct smbus_stream_command *command) {
+    if (*offset > length || length - *offset < SMBUS_STREAM_COMMAND_SIZE)
+        return SMBUS_STREAM_EINVAL;
+
+    const uint8_t *p = stream + *offset;
+    command->address = p[0];
+    command->protocol = p[1];
+    command->read_write = p[2];
+    command->command = p[3];
+    command->flags = p[4];
+    command->length = p[5];
+    command->data = p + SMBUS_STREAM_COMMAND_SIZE;
+
+    if (!command_valid(command))
+        return SMBUS_STREAM_EINVAL;
+
+    size_t data_length = command->read_write == SMBUS_STREAM_WRITE ? command->length : 0;
+    if (length - *offset - SMBUS_STREAM_COMMAND_SIZE < data_length)
+        return SMBUS_STREAM_EINVAL;
+
+    *offset += SMBUS_STREAM_COMMAND_SIZE + data_length;
+    return 0;
+}
+
+int smbus_stream_decode_result(const uint8_t *results, size_t length, size_t *offset, struct smbus_stream_result *result) {
+    if (*offset > length || length - *offset < SMBUS_STREAM_RESULT_SIZE)
+        return SMBUS_STREAM_EINVAL;
+
+    const uint8_t *p = results + *offset;
+    result->status = (int16_t) get_le16(p);
+    result->length = p[2];
+    result->data = p + SMBUS_STREAM_RESULT_SIZE;
+
+    if (length - *offset - SMBUS_STREAM_RESULT_SIZE < result->length)
+        return SMBUS_STREAM_EINVAL;
+
+    *offset += SMBUS_STREAM_RESULT_SIZE + result->length;
+    return 0;
+}
+
+/* Moves the data to write into the layout of union i2c_smbus_data */
+static void prepare_transfer(const struct smbus_stream_command *command, uint8_t *data) {
+    switch (command->protocol) {
+        case SMBUS_STREAM_BYTE_DATA:
+        case SMBUS_STREAM_WORD_DATA:
+            for (size_t i = 0; i < command->length; i++)
+                data[i] = command->data[i];
+            break;
+        case SMBUS_STREAM_BLOCK_DATA:
+        case SMBUS_STREAM_I2C_BLOCK_DATA:
+            data[0] = command->length;
+            if (command->read_write == SMBUS_STREAM_WRITE) {
+                for (size_t i = 0; i < command->length; i++)
+                    data[1 + i] = command->data[i];
+            }
+            break;
+    }
+}
+
+/* Copies the data read from the layout of union i2c_smbus_data into a result */
+static uint8_t complete_transfer(const struct smbus_stream_command *command, const uint8_t *data, uint8_t *result) {
+    size_t length = result_capacity(command);
+    const uint8_t *source = data;
+
+    if (command->protocol == SMBUS_STREAM_BLOCK_DATA || command->protocol == SMBUS_STREAM_I2C_BLOCK_DATA) {
+        if (data[0] < length)
+            length = data[0];
+        source = data + 1;
+    }
+
+    for (size_t i = 0; i < length; i++)
+        result[i] = source[i];
+    return (uint8_t) length;
+}
+
+int smbus_stream_execute(const uint8_t *stream, size_t length,
+                         uint8_t *results, size_t capacity, size_t *results_length,
+                         const struct smbus_stream_allowlist *allowlist,
+                         smbus_stream_transfer transfer, void *context) {
+    struct smbus_stream_command command;
+    size_t offset = SMBUS_STREAM_HEADER_SIZE;
+    int count = smbus_stream_decode_header(stream, length, SMBUS_STREAM_COMMAND_MAGIC);
+
+    *results_length = 0;
+    if (count < 0)
+        return count;
+    if (capacity < SMBUS_STREAM_HEADER_SIZE)
+        return SMBUS_STREAM_ENOSPC;
+
+    // a malformed stream is rejected as a whole instead of being executed in part
+    for (int i = 0; i < count; i++) {
+        int error = smbus_stream_decode_command(stream, length, &offset, &command);
+        if (error)
+            return error;
+    }
+
+    size_t result_offset = SMBUS_STREAM_HEADER_SIZE;
+    int executed = 0;
+    offset = SMBUS_STREAM_HEADER_SIZE;
+    for (; executed < count; executed++) {
+        smbus_stream_decode_command(stream, length, &offset, &command);
+        if (capacity - result_offset < SMBUS_STREAM_RESULT_SIZE + result_capacity(&command))
+            break;
+
+        uint8_t *result = results + result_offset;
+        uint8_t data[SMBUS_STREAM_TRANSFER_SIZE] = {};
+        int status;
+        uint8_t data_length = 0;
+
+        if (!smbus_stream_allowed(allowlist, &command)) {
+            status = SMBUS_STREAM_EACCES;
+        } else {
+            prepare_transfer(&command, data);
+            status = transfer(context, &command, data);
+            if (status > 0)
+                status = 0;
+            if (status == 0)
+                data_length = complete_transfer(&command, data, result + SMBUS_STREAM_RESULT_SIZE);
+        }
+
+        put_le16(result, (uint16_t) (int16_t) status);
+        result[2] = data_length;
+        result_offset += SMBUS_STREAM_RESULT_SIZE + data_length;
+
+        if (status < 0 && (command.flags & SMBUS_STREAM_FLAG_STOP_ON_ERROR)) {
+            executed++;
+            break;
+        }
+    }
+
+    put_header(results, SMBUS_STREAM_RESULT_MAGIC, (uint16_t) executed);
+    *results_length = result_offset;
+    return executed;
+}
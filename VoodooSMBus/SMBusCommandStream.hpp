@@ -0,0 +1,152 @@
+/*
+ * SMBusCommandStream.hpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#ifndef SMBusCommandStream_hpp
+#define SMBusCommandStream_hpp
+
+/*
+ * Encoding, decoding and execution of the command streams userspace passes to
+ * the user client, so many transfers only cost one call into the kernel. Tools
+ * in userspace include this file too.
+ *
+ * All fields are little endian. A command stream is a header followed by
+ * `count` commands:
+ *
+ *   header:  magic (4) version (2) count (2)
+ *   command: address (1) protocol (1) read_write (1) command (1) flags (1) length (1) data (length)
+ *
+ * `length` is the number of data bytes: the bytes written for writes, the
+ * bytes requested for I2C block reads and 0 for all other reads. A result
+ * stream has the same header, `count` is the number of executed commands:
+ *
+ *   result:  status (2) length (1) data (length)
+ *
+ * `status` is 0 or a negative errno, `data` holds the bytes read.
+ */
+#include <stddef.h>
+#include <stdint.h>
+
+#define SMBUS_STREAM_COMMAND_MAGIC      0x53424d53  /* 'SMBS' */
+#define SMBUS_STREAM_RESULT_MAGIC       0x52424d53  /* 'SMBR' */
+#define SMBUS_STREAM_VERSION            1
+
+#define SMBUS_STREAM_HEADER_SIZE        8
+#define SMBUS_STREAM_COMMAND_SIZE       6
+#define SMBUS_STREAM_RESULT_SIZE        3
+/* Largest data of a single transfer, as specified in SMBus standard */
+#define SMBUS_STREAM_DATA_MAX           32
+#define SMBUS_STREAM_MAX_COMMANDS       0xffff
+
+/* Protocols and directions, same values as I2C_SMBUS_* */
+#define SMBUS_STREAM_WRITE              0
+#define SMBUS_STREAM_READ               1
+#define SMBUS_STREAM_QUICK              0
+#define SMBUS_STREAM_BYTE               1
+#define SMBUS_STREAM_BYTE_DATA          2
+#define SMBUS_STREAM_WORD_DATA          3
+#define SMBUS_STREAM_BLOCK_DATA         5
+#define SMBUS_STREAM_I2C_BLOCK_DATA     8
+
+/* Command flags */
+#define SMBUS_STREAM_FLAG_PEC           0x01    /* Use Packet Error Checking */
+#define SMBUS_STREAM_FLAG_STOP_ON_ERROR 0x02    /* Don't execute the rest of the stream if this command fails */
+#define SMBUS_STREAM_FLAGS              (SMBUS_STREAM_FLAG_PEC | SMBUS_STREAM_FLAG_STOP_ON_ERROR)
+
+/* Errors, negative errno values as returned by the transfers */
+#define SMBUS_STREAM_EACCES             (-13)   /* address not allowed */
+#define SMBUS_STREAM_EINVAL             (-22)   /* malformed stream or command */
+#define SMBUS_STREAM_ENOSPC             (-28)   /* result buffer too small */
+
+/* User client interface */
+#define SMBUS_STREAM_BUFFER_SIZE        65536
+enum {
+    /* scalar in: command stream length, scalar out: executed commands, result stream length */
+    kVoodooSMBusUserClientExecute,
+    kVoodooSMBusUserClientMethods
+};
+enum {
+    kVoodooSMBusUserClientCommandBuffer,
+    kVoodooSMBusUserClientResultBuffer
+};
+
+struct smbus_stream_command {
+    uint8_t address;
+    uint8_t protocol;
+    uint8_t read_write;
+    uint8_t command;
+    uint8_t flags;
+    uint8_t length;
+    const uint8_t *data;
+};
+
+struct smbus_stream_result {
+    int16_t status;
+    uint8_t length;
+    const uint8_t *data;
+};
+
+/* 7-bit addresses commands may be executed for, separately for reads and writes */
+struct smbus_stream_allowlist {
+    uint8_t read[16];
+    uint8_t write[16];
+};
+
+void smbus_stream_allow(struct smbus_stream_allowlist *allowlist, uint8_t address, bool write);
+bool smbus_stream_allowed(const struct smbus_stream_allowlist *allowlist, const struct smbus_stream_command *command);
+
+/*
+ * Executes a single transfer of a command stream
+ * @data Buffer in the layout of union i2c_smbus_data, holding the data to
+ *       write and receiving the data read
+ * @return 0 or a negative errno
+ */
+typedef int (*smbus_stream_transfer)(void *context, const struct smbus_stream_command *command, uint8_t *data);
+
+/*
+ * Writes the header of an empty command stream
+ * @return Length of the stream, 0 if the buffer is too small
+ */
+size_t smbus_stream_begin(uint8_t *stream, size_t capacity);
+
+/*
+ * Appends a command to a stream started with `smbus_stream_begin`
+ * @length Current length of the stream, updated on success
+ * @return false if the command is invalid or doesn't fit
+ */
+bool smbus_stream_add(uint8_t *stream, size_t capacity, size_t *length, const struct smbus_stream_command *command);
+
+/*
+ * Decodes the header of a command or result stream
+ * @return Number of entries or a negative errno if the header is invalid
+ */
+int smbus_stream_decode_header(const uint8_t *stream, size_t length, uint32_t magic);
+
+/*
+ * Decodes the command at `*offset` and advances it to the next command
+ * @return 0 or a negative errno if the command is malformed or truncated
+ */
+int smbus_stream_decode_command(const uint8_t *stream, size_t length, size_t *offset, struct smbus_stream_command *command);
+
+/*
+ * Decodes the result at `*offset` and advances it to the next result
+ * @return 0 or a negative errno if the result is truncated
+ */
+int smbus_stream_decode_result(const uint8_t *results, size_t length, size_t *offset, struct smbus_stream_result *result);
+
+/*
+ * Executes all commands of a stream in order and writes their results. Commands
+ * for addresses not in the allowlist fail with SMBUS_STREAM_EACCES without a
+ * transfer. Execution stops early if the result buffer is full or a command
+ * flagged with SMBUS_STREAM_FLAG_STOP_ON_ERROR fails.
+ * @results_length Length of the result stream
+ * @return Number of executed commands or a negative errno if the stream is malformed
+ */
+int smbus_stream_execute(const uint8_t *stream, size_t length,
+                         uint8_t *results, size_t capacity, size_t *results_length,
+                         const struct smbus_stream_allowlist *allowlist,
+                         smbus_stream_transfer transfer, void *context);
+
+#endif /* SMBusCommandStream_hpp */
@@ -0,0 +1,34 @@
+/*
+ * SMBusPoll.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include "SMBusPoll.hpp"
+
+void smbus_poll_start(struct smbus_poll_schedule *schedule, uint64_t now) {
+    schedule->due = now;
+}
+
+bool smbus_poll_defer(struct smbus_poll_schedule *schedule, uint64_t now, uint64_t last_input) {
+    // input can defer the window by at most one interval, so the devices are not starved
+    if (now - last_input < schedule->backoff && now - schedule->due < schedule->interval) {
+        schedule->deferrals++;
+        return true;
+    }
+    return false;
+}
+
+bool smbus_poll_continue(struct smbus_poll_schedule *schedule, uint32_t polled, uint64_t window_start, uint64_t now) {
+    if (polled && now - window_start > schedule->budget) {
+        schedule->budget_exceeded++;
+        return false;
+    }
+    return true;
+}
+
+void smbus_poll_finish(struct smbus_poll_schedule *schedule, uint32_t polled, uint32_t count, uint64_t now) {
+    schedule->next = (schedule->next + polled) % count;
+    schedule->windows++;
+    schedule->due = now + schedule->interval;
+}
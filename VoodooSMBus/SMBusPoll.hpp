@@ -0,0 +1,58 @@
+/*
+ * SMBusPoll.hpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#ifndef SMBusPoll_hpp
+#define SMBusPoll_hpp
+
+/*
+ * Scheduling of the windows in which the controller polls slow devices like
+ * temperature sensors.
+ *
+ * All polled devices are read together in one window per interval. A window
+ * waits while input devices report, for at most one interval, and stops once
+ * it took its bus time budget; the devices it left out start the next one.
+ * Times are in absolute time units of the platform.
+ */
+#include <stdint.h>
+
+struct smbus_poll_schedule {
+    uint64_t interval;
+    /* A window waits until no input arrived for this long */
+    uint64_t backoff;
+    /* Bus time a window may take */
+    uint64_t budget;
+    
+    /* Time the current window is due */
+    uint64_t due;
+    /* Device the next window starts with */
+    uint32_t next;
+    
+    /* Statistics */
+    uint64_t windows;
+    uint64_t deferrals;
+    uint64_t budget_exceeded;
+};
+
+/* The first device was added, a window is due at @now */
+void smbus_poll_start(struct smbus_poll_schedule *schedule, uint64_t now);
+
+/*
+ * Whether the window that is due is deferred by input that arrived at
+ * @last_input, the caller then checks again after the backoff
+ */
+bool smbus_poll_defer(struct smbus_poll_schedule *schedule, uint64_t now, uint64_t last_input);
+
+/*
+ * Whether a window that started at @window_start and polled @polled devices
+ * polls another one. At least one device is polled every window, so a small
+ * budget can't stop polling.
+ */
+bool smbus_poll_continue(struct smbus_poll_schedule *schedule, uint32_t polled, uint64_t window_start, uint64_t now);
+
+/* Ends a window that polled @polled of @count devices, the next one is due an interval later */
+void smbus_poll_finish(struct smbus_poll_schedule *schedule, uint32_t polled, uint32_t count, uint64_t now);
+
+#endif /* SMBusPoll_hpp */
@@ -0,0 +1,48 @@
+/*
+ * SMBusRecovery.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include "SMBusRecovery.hpp"
+
+enum bus_health smbus_recovery_supervise(struct smbus_recovery *recovery, s32 result, bool host_owned, uint64_t now) {
+    if (!host_owned)
+        return BUS_HEALTH_UNCHANGED;
+    
+    // a device that does not answer is no reason to reset the bus, only a host that is stuck is
+    if (result != -EBUSY && result != -ETIMEDOUT) {
+        recovery->consecutive_failures = 0;
+        recovery->level = 0;
+        if (!recovery->ts_failure)
+            return BUS_HEALTH_UNCHANGED;
+        
+        recovery->last_outage = now - recovery->ts_failure;
+        recovery->recovered++;
+        recovery->ts_failure = 0;
+        return BUS_HEALTH_RECOVERED;
+    }
+    
+    if (!recovery->ts_failure)
+        recovery->ts_failure = now;
+    
+    if (++recovery->consecutive_failures < BUS_RECOVERY_FAILURES)
+        return BUS_HEALTH_UNCHANGED;
+    
+    if (recovery->ts_recovery && now - recovery->ts_recovery < recovery->interval) {
+        recovery->rate_limited++;
+        return BUS_HEALTH_UNCHANGED;
+    }
+    
+    return BUS_HEALTH_HUNG;
+}
+
+enum bus_recovery_level smbus_recovery_start(struct smbus_recovery *recovery, uint64_t now) {
+    enum bus_recovery_level level = recovery->level < BUS_RECOVERY_DEVICE_RESET ? (enum bus_recovery_level) recovery->level : BUS_RECOVERY_DEVICE_RESET;
+    
+    recovery->recoveries[level]++;
+    recovery->level++;
+    recovery->consecutive_failures = 0;
+    recovery->ts_recovery = now;
+    return level;
+}
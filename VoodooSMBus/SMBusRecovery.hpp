@@ -0,0 +1,70 @@
+/*
+ * SMBusRecovery.hpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#ifndef SMBusRecovery_hpp
+#define SMBusRecovery_hpp
+
+/*
+ * Decides when a host controller that stays busy or stops completing
+ * transfers is recovered, and how far the recovery goes. Only a transfer
+ * that owned the host counts: one that was refused because another
+ * transfer was in progress says nothing about the state of the bus.
+ * Times are in absolute time units of the platform.
+ */
+#include <stdint.h>
+#include "smbus_platform.h"
+
+/* Consecutive transfers failing with a busy or timed out bus that start a recovery */
+#define BUS_RECOVERY_FAILURES           3
+
+/* Recovery steps, every failed attempt escalates to the next one */
+enum bus_recovery_level {
+    /* Kill the current transaction and clear the status */
+    BUS_RECOVERY_KILL,
+    /* Additionally disable and enable the host controller */
+    BUS_RECOVERY_HOST_RESET,
+    /* Additionally re-initialize the slave devices */
+    BUS_RECOVERY_DEVICE_RESET,
+    BUS_RECOVERY_LEVELS
+};
+
+enum bus_health {
+    /* The transfer says nothing new about the bus */
+    BUS_HEALTH_UNCHANGED,
+    /* The first transfer after a hang completed, see last_outage */
+    BUS_HEALTH_RECOVERED,
+    /* The bus hangs, recover it at the level smbus_recovery_start returns */
+    BUS_HEALTH_HUNG
+};
+
+struct smbus_recovery {
+    /* Time between two recoveries at least */
+    uint64_t interval;
+    
+    uint32_t consecutive_failures;
+    uint32_t level;
+    /* Time the first transfer of the current hang failed, 0 if the bus works */
+    uint64_t ts_failure;
+    uint64_t ts_recovery;
+    
+    /* Statistics */
+    uint64_t recoveries[BUS_RECOVERY_LEVELS];
+    uint64_t recovered;
+    uint64_t rate_limited;
+    /* Time from the first failed transfer until a transfer completed again, of the last hang */
+    uint64_t last_outage;
+};
+
+/*
+ * Accounts a transfer that ended at @now with @result. @host_owned is false
+ * for a transfer that was refused because another one owned the host.
+ */
+enum bus_health smbus_recovery_supervise(struct smbus_recovery *recovery, s32 result, bool host_owned, uint64_t now);
+
+/* A recovery of a hung bus starts at @now, @return its level */
+enum bus_recovery_level smbus_recovery_start(struct smbus_recovery *recovery, uint64_t now);
+
+#endif /* SMBusRecovery_hpp */
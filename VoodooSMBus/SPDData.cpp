@@ -0,0 +1,104 @@
+/*
+ * SPDData.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include "SPDData.hpp"
+
+size_t spd_size(uint8_t memory_type) {
+    switch (memory_type) {
+        case SPD_MEMORY_TYPE_DDR4:
+            return SPD_DDR4_SIZE;
+        case SPD_MEMORY_TYPE_DDR5:
+            return SPD_DDR5_SIZE;
+        default:
+            return 256;
+    }
+}
+
+const char* spd_memory_type_name(uint8_t memory_type) {
+    switch (memory_type) {
+        case 0x0B:
+            return "DDR3";
+        case SPD_MEMORY_TYPE_DDR4:
+            return "DDR4";
+        case 0x0E:
+            return "LPDDR4";
+        case SPD_MEMORY_TYPE_DDR5:
+            return "DDR5";
+        default:
+            return NULL;
+    }
+}
+
+uint16_t spd_crc16(const uint8_t *data, size_t length) {
+    uint16_t crc = 0;
+    
+    for (size_t i = 0; i < length; i++) {
+        crc ^= (uint16_t) data[i] << 8;
+        for (int bit = 0; bit < 8; bit++)
+            crc = crc & 0x8000 ? (uint16_t) (crc << 1) ^ 0x1021 : (uint16_t) (crc << 1);
+    }
+    return crc;
+}
+
+static uint8_t spd_bcd(uint8_t value) {
+    return (value >> 4) * 10 + (value & 0x0F);
+}
+
+bool spd_decode(const uint8_t *data, size_t length, struct spd_info *info) {
+    size_t crc_offset, manufacturing_offset, part_number_offset, part_number_len;
+    
+    *info = {};
+    if (length <= SPD_MODULE_TYPE_OFFSET)
+        return false;
+    
+    info->memory_type = data[SPD_MEMORY_TYPE_OFFSET];
+    info->module_type = data[SPD_MODULE_TYPE_OFFSET];
+    
+    switch (info->memory_type) {
+        case SPD_MEMORY_TYPE_DDR4:
+            crc_offset = SPD_DDR4_CRC_OFFSET;
+            manufacturing_offset = SPD_DDR4_MANUFACTURING_OFFSET;
+            part_number_offset = SPD_DDR4_PART_NUMBER_OFFSET;
+            part_number_len = SPD_DDR4_PART_NUMBER_LEN;
+            break;
+        case SPD_MEMORY_TYPE_DDR5:
+            crc_offset = SPD_DDR5_CRC_OFFSET;
+            manufacturing_offset = SPD_DDR5_MANUFACTURING_OFFSET;
+            part_number_offset = SPD_DDR5_PART_NUMBER_OFFSET;
+            part_number_len = SPD_DDR5_PART_NUMBER_LEN;
+            break;
+        default:
+            return true;
+    }
+    
+    if (length < crc_offset + 2)
+        return false;
+    info->crc_valid = spd_crc16(data, crc_offset) == (data[crc_offset] | data[crc_offset + 1] << 8);
+    
+    if (length < part_number_offset + part_number_len)
+        return true;
+    
+    const uint8_t *manufacturing = &data[manufacturing_offset];
+    info->has_manufacturing_info = true;
+    info->manufacturer_id = manufacturing[SPD_MANUFACTURER_ID_OFFSET] << 8 | manufacturing[SPD_MANUFACTURER_ID_OFFSET + 1];
+    info->manufacturing_year = 2000 + spd_bcd(manufacturing[SPD_MANUFACTURING_DATE_OFFSET]);
+    info->manufacturing_week = spd_bcd(manufacturing[SPD_MANUFACTURING_DATE_OFFSET + 1]);
+    info->serial_number = (uint32_t) manufacturing[SPD_SERIAL_NUMBER_OFFSET] << 24 |
+                          manufacturing[SPD_SERIAL_NUMBER_OFFSET + 1] << 16 |
+                          manufacturing[SPD_SERIAL_NUMBER_OFFSET + 2] << 8 |
+                          manufacturing[SPD_SERIAL_NUMBER_OFFSET + 3];
+    
+    // the part number is padded with spaces, non printable characters are replaced
+    size_t end = 0;
+    for (size_t i = 0; i < part_number_len; i++) {
+        uint8_t c = data[part_number_offset + i];
+        info->part_number[i] = c >= 0x20 && c < 0x7F ? (char) c : '?';
+        if (c != ' ')
+            end = i + 1;
+    }
+    info->part_number[end] = '\0';
+    return true;
+}
@@ -0,0 +1,78 @@
+/*
+ * SPDData.hpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#ifndef SPDData_hpp
+#define SPDData_hpp
+
+/*
+ * Decoding of DDR4 and DDR5 Serial Presence Detect data. This file must not
+ * depend on IOKit, so the decoder can be built and exercised outside of the kext.
+ */
+#include <stddef.h>
+#include <stdint.h>
+
+/* Layout from JEDEC Standard No. 21-C, Annex L (DDR4) and JESD400-5 (DDR5) */
+#define SPD_MEMORY_TYPE_OFFSET          2
+#define SPD_MODULE_TYPE_OFFSET          3
+#define SPD_MEMORY_TYPE_DDR4            0x0C
+#define SPD_MEMORY_TYPE_DDR5            0x12
+
+#define SPD_DDR4_SIZE                   512
+#define SPD_DDR4_CRC_OFFSET             126     /* CRC of bytes 0-125 */
+#define SPD_DDR4_MANUFACTURING_OFFSET   320
+#define SPD_DDR4_PART_NUMBER_OFFSET     329
+#define SPD_DDR4_PART_NUMBER_LEN        20
+
+#define SPD_DDR5_SIZE                   1024
+#define SPD_DDR5_CRC_OFFSET             510     /* CRC of bytes 0-509 */
+#define SPD_DDR5_MANUFACTURING_OFFSET   512
+#define SPD_DDR5_PART_NUMBER_OFFSET     521
+#define SPD_DDR5_PART_NUMBER_LEN        30
+
+#define SPD_MAX_SIZE                    SPD_DDR5_SIZE
+#define SPD_MAX_PART_NUMBER_LEN         SPD_DDR5_PART_NUMBER_LEN
+
+/*
+ * The manufacturing information block has the same layout on DDR4 and DDR5,
+ * relative to its offset: manufacturer id (2), location (1), date (2), serial number (4)
+ */
+#define SPD_MANUFACTURER_ID_OFFSET      0
+#define SPD_MANUFACTURING_DATE_OFFSET   3
+#define SPD_SERIAL_NUMBER_OFFSET        5
+
+struct spd_info {
+    uint8_t memory_type;
+    uint8_t module_type;
+    /* the contents hold the manufacturing information block */
+    bool has_manufacturing_info;
+    /* JEDEC continuation code in the high byte, manufacturer code in the low byte */
+    uint16_t manufacturer_id;
+    uint16_t manufacturing_year;
+    uint8_t manufacturing_week;
+    uint32_t serial_number;
+    char part_number[SPD_MAX_PART_NUMBER_LEN + 1];
+    /* the contents cover the base configuration and its CRC is valid */
+    bool crc_valid;
+};
+
+/* Size of the SPD contents for a memory type, 256 bytes for anything before DDR4 */
+size_t spd_size(uint8_t memory_type);
+
+/* Name of a memory type or NULL if it is not known */
+const char* spd_memory_type_name(uint8_t memory_type);
+
+/* CRC-16 with polynomial 0x1021 as used by the SPD base configuration */
+uint16_t spd_crc16(const uint8_t *data, size_t length);
+
+/*
+ * Decodes the key fields of DDR4 or DDR5 SPD contents
+ * @data SPD contents from offset 0
+ * @length Number of valid bytes, fields beyond it are not decoded
+ * @return false if the bytes don't cover the base configuration of a DDR4 or DDR5 module
+ */
+bool spd_decode(const uint8_t *data, size_t length, struct spd_info *info);
+
+#endif /* SPDData_hpp */
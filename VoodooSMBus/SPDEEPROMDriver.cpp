@@ -0,0 +1,148 @@
+/*
+ * SPDEEPROMDriver.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include "SPDEEPROMDriver.hpp"
+
+#define super IOService
+OSDefineMetaClassAndStructors(SPDEEPROMDriver, IOService);
+
+SPDEEPROMDriver* SPDEEPROMDriver::probe(IOService* provider, SInt32* score) {
+    if (!super::probe(provider, score)) {
+        return NULL;
+    }
+    
+    device_nub = OSDynamicCast(VoodooSMBusDeviceNub, provider);
+    if (!device_nub) {
+        IOLog("%s Could not get VoodooSMBus device nub instance\n", getName());
+        return NULL;
+    }
+    return this;
+}
+
+bool SPDEEPROMDriver::start(IOService* provider) {
+    if (!super::start(provider)) {
+        return false;
+    }
+    
+    OSData* contents = copySPDData();
+    if (!contents) {
+        IOLogError("%s Could not read SPD at address %#04x\n", getName(), device_nub->getAddress());
+        return false;
+    }
+    OSSafeReleaseNULL(contents);
+    
+    registerService();
+    return true;
+}
+
+void SPDEEPROMDriver::free(void) {
+    OSSafeReleaseNULL(spd_data);
+    super::free();
+}
+
+OSData* SPDEEPROMDriver::copySPDData() {
+    struct i2c_smbus_client client = device_nub->getSMBusClient();
+    u8 buffer[SPD_MAX_SIZE];
+    AbsoluteTime start, end;
+    uint64_t read_time_ns;
+    
+    // the page of EE1004 EEPROMs is shared by all modules, so reads must not interleave
+    device_nub->lockSequence();
+    if (spd_data) {
+        spd_data->retain();
+        device_nub->unlockSequence();
+        return spd_data;
+    }
+    
+    clock_get_uptime(&start);
+    device_type = spd_detect_device(&client);
+    int length = spd_read_contents(&client, device_type, buffer);
+    clock_get_uptime(&end);
+    
+    // only complete contents are kept, so a read that failed part way is tried again
+    if (length <= 0) {
+        device_nub->unlockSequence();
+        return NULL;
+    }
+    
+    absolutetime_to_nanoseconds(end - start, &read_time_ns);
+    spd_data = OSData::withBytes(buffer, length);
+    if (!spd_data) {
+        device_nub->unlockSequence();
+        return NULL;
+    }
+    spd_data->retain();
+    device_nub->unlockSequence();
+    
+    publishSPD(buffer, length, read_time_ns);
+    return spd_data;
+}
+
+void SPDEEPROMDriver::publishSPD(const u8 *contents, unsigned int length, uint64_t read_time_ns) {
+    static const char* device_type_names[] = { "EEPROM", "EE1004", "SPD5" };
+    spd_info info;
+    
+    setProperty("SPDData", spd_data);
+    
+    OSDictionary* spd = OSDictionary::withCapacity(12);
+    if (!spd)
+        return;
+    
+    bool decoded = spd_decode(contents, length, &info);
+    const char* memory_type = spd_memory_type_name(info.memory_type);
+    
+    OSString* string = OSString::withCString(device_type_names[device_type]);
+    spd->setObject("DeviceType", string);
+    OSSafeReleaseNULL(string);
+    if (memory_type) {
+        string = OSString::withCString(memory_type);
+        spd->setObject("MemoryType", string);
+        OSSafeReleaseNULL(string);
+    }
+    
+    OSNumber* number = OSNumber::withNumber(info.memory_type, 8);
+    spd->setObject("MemoryTypeId", number);
+    OSSafeReleaseNULL(number);
+    number = OSNumber::withNumber(info.module_type, 8);
+    spd->setObject("ModuleType", number);
+    OSSafeReleaseNULL(number);
+    number = OSNumber::withNumber(length, 32);
+    spd->setObject("Size", number);
+    OSSafeReleaseNULL(number);
+    spd->setObject("CRCValid", decoded && info.crc_valid ? kOSBooleanTrue : kOSBooleanFalse);
+    
+    if (info.has_manufacturing_info) {
+        number = OSNumber::withNumber(info.manufacturer_id, 16);
+        spd->setObject("ManufacturerId", number);
+        OSSafeReleaseNULL(number);
+        number = OSNumber::withNumber(info.manufacturing_year, 16);
+        spd->setObject("ManufacturingYear", number);
+        OSSafeReleaseNULL(number);
+        number = OSNumber::withNumber(info.manufacturing_week, 8);
+        spd->setObject("ManufacturingWeek", number);
+        OSSafeReleaseNULL(number);
+        number = OSNumber::withNumber(info.serial_number, 32);
+        spd->setObject("SerialNumber", number);
+        OSSafeReleaseNULL(number);
+        string = OSString::withCString(info.part_number);
+        spd->setObject("PartNumber", string);
+        OSSafeReleaseNULL(string);
+    }
+    
+    number = OSNumber::withNumber(read_time_ns / 1000, 32);
+    spd->setObject("ReadTimeUs", number);
+    OSSafeReleaseNULL(number);
+    number = OSNumber::withNumber(read_time_ns ? length * 1000000000ULL / read_time_ns : 0, 32);
+    spd->setObject("ReadBytesPerSecond", number);
+    OSSafeReleaseNULL(number);
+    
+    setProperty("SPD", spd);
+    OSSafeReleaseNULL(spd);
+    
+    IOLog("%s %s module at %#04x, part number %s, %u bytes read in %llu us\n", getName(),
+          memory_type ? memory_type : "Unknown", device_nub->getAddress(),
+          info.has_manufacturing_info ? info.part_number : "unknown", length, read_time_ns / 1000);
+}
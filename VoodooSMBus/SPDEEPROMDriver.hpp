@@ -0,0 +1,43 @@
+/*
+ * SPDEEPROMDriver.hpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#ifndef SPDEEPROMDriver_hpp
+#define SPDEEPROMDriver_hpp
+
+#include <IOKit/IOLib.h>
+#include <IOKit/IOService.h>
+#include "VoodooSMBusDeviceNub.hpp"
+#include "helpers.hpp"
+#include "SPDReader.hpp"
+
+/*
+ * Reads the SPD contents of a memory module and publishes its key fields.
+ * The contents are read once and kept in memory afterwards, a read that
+ * failed part way is tried again by the next copySPDData.
+ */
+class SPDEEPROMDriver : public IOService {
+    OSDeclareDefaultStructors(SPDEEPROMDriver);
+    
+public:
+    SPDEEPROMDriver* probe(IOService* provider, SInt32* score) override;
+    bool start(IOService* provider) override;
+    void free(void) override;
+    
+    /*
+     * Returns the SPD contents, they are only read from the device the first time
+     * @return Contents or NULL if they could not be read, to be released by the caller
+     */
+    OSData* copySPDData();
+    
+private:
+    VoodooSMBusDeviceNub* device_nub;
+    spd_device_type device_type;
+    OSData* spd_data;
+    
+    void publishSPD(const u8 *contents, unsigned int length, uint64_t read_time_ns);
+};
+
+#endif /* SPDEEPROMDriver_hpp */
@@ -0,0 +1,111 @@
+/*
+ * SPDReader.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ * Page handling based on the linux drivers:
+ * https://github.com/torvalds/linux/blob/master/drivers/misc/eeprom/ee1004.c
+ * https://github.com/torvalds/linux/blob/master/drivers/hwmon/spd5118.c
+ */
+
+#include "SPDReader.hpp"
+
+/* Writes to one of the page select addresses of EE1004 EEPROMs */
+static s32 ee1004_set_page(const struct i2c_smbus_client *client, unsigned int page) {
+    struct i2c_smbus_client page_select = *client;
+    
+    page_select.addr = page ? EE1004_ADDR_SET_PAGE1 : EE1004_ADDR_SET_PAGE0;
+    page_select.flags = 0;
+    return i2c_smbus_write_byte(&page_select, 0);
+}
+
+enum spd_device_type spd_detect_device(const struct i2c_smbus_client *client) {
+    s32 msb = i2c_smbus_read_byte_data(client, SPD5_REG_TYPE_MSB);
+    s32 lsb = i2c_smbus_read_byte_data(client, SPD5_REG_TYPE_LSB);
+    
+    if (msb >= 0 && lsb >= 0 && (msb << 8 | lsb) == SPD5_DEVICE_TYPE)
+        return SPD_DEVICE_SPD5_HUB;
+    
+    /*
+     * The page select addresses are the write protection commands of the
+     * EEPROMs before DDR4, so the memory type decides, nothing is written.
+     */
+    if (i2c_smbus_read_byte_data(client, SPD_MEMORY_TYPE_OFFSET) == SPD_MEMORY_TYPE_DDR4)
+        return SPD_DEVICE_EE1004;
+    return SPD_DEVICE_EEPROM;
+}
+
+static unsigned int spd_page_size(enum spd_device_type device_type) {
+    switch (device_type) {
+        case SPD_DEVICE_SPD5_HUB:
+            return SPD5_PAGE_SIZE;
+        case SPD_DEVICE_EE1004:
+            return EE1004_PAGE_SIZE;
+        default:
+            return SPD_EEPROM_SIZE;
+    }
+}
+
+static int spd_select_page(const struct i2c_smbus_client *client, enum spd_device_type device_type, unsigned int page) {
+    switch (device_type) {
+        case SPD_DEVICE_SPD5_HUB:
+            // keeps 1 byte addressing in bit 3
+            return i2c_smbus_write_byte_data(client, SPD5_REG_LEGACY_MODE, (u8) page);
+        case SPD_DEVICE_EE1004:
+            return ee1004_set_page(client, page);
+        default:
+            return page ? -EOPNOTSUPP : 0;
+    }
+}
+
+static int spd_read_block(const struct i2c_smbus_client *client, enum spd_device_type device_type,
+                          unsigned int offset, uint8_t *values) {
+    u8 command = offset % spd_page_size(device_type);
+    s32 result = 0;
+    
+    if (device_type == SPD_DEVICE_SPD5_HUB)
+        command |= SPD5_NVM_OFFSET;
+    
+    for (int retry = 0; retry < SPD_RETRY_COUNT; retry++) {
+        result = i2c_smbus_read_i2c_block_data(client, command, SPD_BLOCK_LEN, values);
+        if (result == SPD_BLOCK_LEN)
+            return 0;
+    }
+    return result < 0 ? result : -EIO;
+}
+
+int spd_read_contents(const struct i2c_smbus_client *client, enum spd_device_type device_type, uint8_t *buffer) {
+    unsigned int page_size = spd_page_size(device_type);
+    unsigned int size = SPD_BLOCK_LEN, offset, page = 0;
+    int error = 0;
+    
+    // fails if the firmware disabled SPD writes, page 0 is then still selected from boot
+    spd_select_page(client, device_type, 0);
+    
+    for (offset = 0; offset < size; offset += SPD_BLOCK_LEN) {
+        if (offset / page_size != page) {
+            page = offset / page_size;
+            error = spd_select_page(client, device_type, page);
+            if (error)
+                break;
+        }
+        
+        error = spd_read_block(client, device_type, offset, &buffer[offset]);
+        if (error)
+            break;
+        
+        // the memory type in the first block tells how much there is to read,
+        // a plain EEPROM fails to select the second page of a larger one instead of returning part of it
+        if (offset == 0)
+            size = (unsigned int) spd_size(buffer[SPD_MEMORY_TYPE_OFFSET]);
+    }
+    
+    // the firmware expects page 0 to be selected
+    if (page)
+        spd_select_page(client, device_type, 0);
+    
+    if (error) {
+        IOLogError("Reading SPD at %#04x failed at offset %u: %d\n", client->addr, offset, error);
+        return error;
+    }
+    return (int) offset;
+}
@@ -0,0 +1,61 @@
+/*
+ * SPDReader.hpp
+ * SMBus Controller Driver for macOS X
+ *
+ * Page handling based on the linux drivers:
+ * https://github.com/torvalds/linux/blob/master/drivers/misc/eeprom/ee1004.c
+ * https://github.com/torvalds/linux/blob/master/drivers/hwmon/spd5118.c
+ */
+
+#ifndef SPDReader_hpp
+#define SPDReader_hpp
+
+/*
+ * Reading the SPD contents of a memory module from its EEPROM or SPD5 hub.
+ */
+#include "i2c_smbus.h"
+#include "SPDData.hpp"
+
+/* EE1004: a write to these addresses selects the 256 byte page of all EEPROMs on the bus */
+#define EE1004_ADDR_SET_PAGE0           0x36
+#define EE1004_ADDR_SET_PAGE1           0x37
+#define EE1004_PAGE_SIZE                256
+
+/* SPD5 hub: registers at 0x00-0x7F, the selected 128 byte page of the NVM at 0x80-0xFF */
+#define SPD5_REG_TYPE_MSB               0x00
+#define SPD5_REG_TYPE_LSB               0x01
+#define SPD5_REG_LEGACY_MODE            0x0B    /* MR11, NVM page in bits 2:0 */
+#define SPD5_DEVICE_TYPE                0x5118
+#define SPD5_PAGE_SIZE                  128
+#define SPD5_NVM_OFFSET                 0x80
+
+/* Plain EEPROMs of modules before DDR4 */
+#define SPD_EEPROM_SIZE                 256
+
+#define SPD_BLOCK_LEN                   32
+#define SPD_RETRY_COUNT                 3
+
+enum spd_device_type {
+    SPD_DEVICE_EEPROM,
+    SPD_DEVICE_EE1004,
+    SPD_DEVICE_SPD5_HUB
+};
+
+/*
+ * Tells an SPD5 hub, an EE1004 and a plain EEPROM apart. An EEPROM that
+ * holds DDR4 contents is taken for an EE1004, whether its page select
+ * works is only known once the contents are read.
+ */
+enum spd_device_type spd_detect_device(const struct i2c_smbus_client *client);
+
+/*
+ * Reads the SPD contents of the device, as long as the memory type in the
+ * first block says. The caller keeps others from switching the page of
+ * EE1004 EEPROMs meanwhile, which is shared by all modules on the bus.
+ * @buffer Holds SPD_MAX_SIZE bytes
+ * @return Number of bytes read or a negative errno, the contents are only
+ *         valid if all of them could be read
+ */
+int spd_read_contents(const struct i2c_smbus_client *client, enum spd_device_type device_type, uint8_t *buffer);
+
+#endif /* SPDReader_hpp */
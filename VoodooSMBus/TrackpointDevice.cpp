@@ -30,28 +30,145 @@ bool TrackpointDevice::start(IOService* provider) {
     if (!super::start(provider)) {
         return false;
     }
+    
+    work_loop = IOWorkLoop::workLoop();
+    if (!work_loop) {
+        IOLogError("%s Could not create work loop\n", getName());
+        goto exit;
+    }
+    
+    command_gate = IOCommandGate::commandGate(this);
+    if (!command_gate || (work_loop->addEventSource(command_gate) != kIOReturnSuccess)) {
+        IOLogError("%s Could not open command gate\n", getName());
+        goto exit;
+    }
+    
+    momentum_timer = IOTimerEventSource::timerEventSource(this, OSMemberFunctionCast(IOTimerEventSource::Action, this, &TrackpointDevice::momentumTimeout));
+    if (!momentum_timer || (work_loop->addEventSource(momentum_timer) != kIOReturnSuccess)) {
+        IOLogError("%s Could not add momentum timer to work loop\n", getName());
+        goto exit;
+    }
+    
+    setAcceleration(100, 0, 0);
+    setScrolling(TRACKPOINT_SCROLL_GAIN, TRACKPOINT_SCROLL_RATE, TRACKPOINT_SCROLL_FRICTION);
 
     registerService();
     return true;
+    
+exit:
+    releaseResources();
+    return false;
+}
+
+void TrackpointDevice::releaseResources() {
+    if (momentum_timer) {
+        momentum_timer->cancelTimeout();
+        work_loop->removeEventSource(momentum_timer);
+        OSSafeReleaseNULL(momentum_timer);
+    }
+    
+    if (command_gate) {
+        work_loop->removeEventSource(command_gate);
+        OSSafeReleaseNULL(command_gate);
+    }
+    
+    OSSafeReleaseNULL(work_loop);
 }
 
 void TrackpointDevice::stop(IOService* provider) {
+    releaseResources();
     super::stop(provider);
 }
 
 
-void TrackpointDevice::updateRelativePointer(int dx, int dy, int buttons) {
-    uint64_t now_abs;
-    clock_get_uptime(&now_abs);
-    dispatchRelativePointerEvent(dx, dy, buttons, now_abs);
-};
+void TrackpointDevice::setAcceleration(UInt32 sensitivity, UInt32 acceleration, UInt32 deadzone) {
+    command_gate->runAction(OSMemberFunctionCast(IOCommandGate::Action, this, &TrackpointDevice::setAccelerationGated), &sensitivity, &acceleration, &deadzone);
+}
 
-void TrackpointDevice::updateScrollwheel(short deltaAxis1, short deltaAxis2, short deltaAxis3) {
-    uint64_t now_abs;
-    clock_get_uptime(&now_abs);
-    dispatchScrollWheelEvent(deltaAxis1, deltaAxis2, deltaAxis3, now_abs);
+IOReturn TrackpointDevice::setAccelerationGated(UInt32* sensitivity, UInt32* acceleration, UInt32* deadzone) {
+    trackpoint_set_acceleration(&this->acceleration, *sensitivity, *acceleration, *deadzone);
+    remainder_x = 0;
+    remainder_y = 0;
+    return kIOReturnSuccess;
+}
+
+void TrackpointDevice::updateRelativePointer(int dx, int dy, int buttons, uint64_t timestamp) {
+    // the configuration may replace the acceleration curve from another thread
+    command_gate->runAction(OSMemberFunctionCast(IOCommandGate::Action, this, &TrackpointDevice::updateRelativePointerGated), &dx, &dy, &buttons, &timestamp);
+}
+
+IOReturn TrackpointDevice::updateRelativePointerGated(int* dx, int* dy, int* buttons, uint64_t* timestamp) {
+    // any pointer activity ends momentum scrolling
+    stopMomentumGated();
     
+    dispatchRelativePointerEvent(trackpoint_accelerate(&acceleration, *dx, &remainder_x),
+                                 trackpoint_accelerate(&acceleration, *dy, &remainder_y), *buttons, *timestamp);
+    return kIOReturnSuccess;
 }
 
+void TrackpointDevice::setScrolling(UInt32 gain, UInt32 rate, UInt32 friction) {
+    command_gate->runAction(OSMemberFunctionCast(IOCommandGate::Action, this, &TrackpointDevice::setScrollingGated), &gain, &rate, &friction);
+}
+
+IOReturn TrackpointDevice::setScrollingGated(UInt32* gain, UInt32* rate, UInt32* friction) {
+    uint64_t interval;
+    
+    stopMomentumGated();
+    
+    scroll_interval_ms = 1000 / (*rate ? *rate : 1);
+    if (!scroll_interval_ms)
+        scroll_interval_ms = 1;
+    nanoseconds_to_absolutetime((UInt64) scroll_interval_ms * 1000000, &interval);
+    trackpoint_set_scrolling(&scroll, *gain, interval, *friction);
+    return kIOReturnSuccess;
+}
+
+void TrackpointDevice::updateScroll(int dx, int dy, uint64_t timestamp) {
+    command_gate->runAction(OSMemberFunctionCast(IOCommandGate::Action, this, &TrackpointDevice::updateScrollGated), &dx, &dy, &timestamp);
+}
+
+void TrackpointDevice::endScroll(uint64_t timestamp) {
+    command_gate->runAction(OSMemberFunctionCast(IOCommandGate::Action, this, &TrackpointDevice::endScrollGated), &timestamp);
+}
 
+IOReturn TrackpointDevice::updateScrollGated(int* dx, int* dy, uint64_t* timestamp) {
+    trackpoint_scroll_event event;
+    
+    stopMomentumGated();
+    if (trackpoint_scroll_update(&scroll, *dx, *dy, *timestamp, &event))
+        dispatchScroll(&event, *timestamp);
+    return kIOReturnSuccess;
+}
 
+IOReturn TrackpointDevice::endScrollGated(uint64_t* timestamp) {
+    trackpoint_scroll_event event;
+    
+    if (trackpoint_scroll_end(&scroll, *timestamp, &event))
+        dispatchScroll(&event, *timestamp);
+    if (scroll.momentum)
+        momentum_timer->setTimeoutMS(scroll_interval_ms);
+    return kIOReturnSuccess;
+}
+
+IOReturn TrackpointDevice::stopMomentumGated() {
+    if (scroll.momentum) {
+        trackpoint_scroll_stop(&scroll);
+        momentum_timer->cancelTimeout();
+    }
+    return kIOReturnSuccess;
+}
+
+void TrackpointDevice::dispatchScroll(const trackpoint_scroll_event* event, uint64_t now_abs) {
+    dispatchScrollWheelEvent(event->lines_y, event->lines_x, 0, now_abs);
+}
+
+void TrackpointDevice::momentumTimeout(OSObject* owner, IOTimerEventSource* timer) {
+    trackpoint_scroll_event event;
+    uint64_t now_abs;
+    
+    clock_get_uptime(&now_abs);
+    if (trackpoint_scroll_momentum(&scroll, now_abs, &event))
+        dispatchScroll(&event, now_abs);
+    if (scroll.momentum)
+        timer->setTimeoutMS(scroll_interval_ms);
+}
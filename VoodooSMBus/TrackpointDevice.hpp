@@ -11,7 +11,16 @@
 
 #include <IOKit/hidsystem/IOHIPointing.h>
 #include <IOKit/hidsystem/IOHIDParameter.h>
+#include <IOKit/IOWorkLoop.h>
+#include <IOKit/IOCommandGate.h>
+#include <IOKit/IOTimerEventSource.h>
 #include "helpers.hpp"
+#include "TrackpointMotion.hpp"
+
+/* Default scroll engine: 60 events per second, momentum loses 15% per event */
+#define TRACKPOINT_SCROLL_GAIN          100
+#define TRACKPOINT_SCROLL_RATE          60
+#define TRACKPOINT_SCROLL_FRICTION      15
 
 class TrackpointDevice : public IOHIPointing {
     typedef IOHIPointing super;
@@ -28,8 +37,62 @@ public:
     virtual UInt32 deviceType() override;
     virtual UInt32 interfaceID() override;
     
-    void updateRelativePointer(int dx, int dy, int buttons);
-    void updateScrollwheel(short deltaAxis1, short deltaAxis2, short deltaAxis3);
+    /*
+     * Precomputes the acceleration curve applied to relative pointer movement
+     * @sensitivity Gain for slow movements in percent
+     * @acceleration Additional gain in percent that is added for every
+     *    TRACKPOINT_ACCEL_KNEE counts of movement per report
+     * @deadzone Movement of up to this many counts per report is ignored
+     */
+    void setAcceleration(UInt32 sensitivity, UInt32 acceleration, UInt32 deadzone);
+    
+    /*
+     * Configures the scroll engine used by updateScroll
+     * @gain Scroll distance per trackpoint count in percent
+     * @rate Maximum number of scroll events per second
+     * @friction Velocity in percent that is lost on every momentum scroll
+     *    event after scrolling ended, 100 disables momentum scrolling
+     */
+    void setScrolling(UInt32 gain, UInt32 rate, UInt32 friction);
+    
+    /*
+     * Dispatches pointer movement
+     * @timestamp Absolute time the movement was reported by the device
+     */
+    void updateRelativePointer(int dx, int dy, int buttons, uint64_t timestamp);
+    
+    /*
+     * Accumulates trackpoint movement while scrolling and dispatches it as
+     * scroll events with at most the configured rate.
+     * @timestamp Absolute time the movement was reported by the device
+     */
+    void updateScroll(int dx, int dy, uint64_t timestamp);
+    
+    /* Dispatches remaining scroll movement and starts momentum scrolling */
+    void endScroll(uint64_t timestamp);
+
+private:
+    IOWorkLoop* work_loop;
+    IOCommandGate* command_gate;
+    IOTimerEventSource* momentum_timer;
+    
+    trackpoint_scroll scroll;
+    UInt32 scroll_interval_ms;
+    
+    void releaseResources();
+    IOReturn setAccelerationGated(UInt32* sensitivity, UInt32* acceleration, UInt32* deadzone);
+    IOReturn updateRelativePointerGated(int* dx, int* dy, int* buttons, uint64_t* timestamp);
+    IOReturn setScrollingGated(UInt32* gain, UInt32* rate, UInt32* friction);
+    IOReturn updateScrollGated(int* dx, int* dy, uint64_t* timestamp);
+    IOReturn endScrollGated(uint64_t* timestamp);
+    IOReturn stopMomentumGated();
+    void dispatchScroll(const trackpoint_scroll_event* event, uint64_t now_abs);
+    void momentumTimeout(OSObject* owner, IOTimerEventSource* timer);
 
+    /* The acceleration curve and remainders are only used in the command gate */
+    trackpoint_acceleration acceleration;
+    /* Sub-pixel movement that has not been dispatched yet */
+    int64_t remainder_x;
+    int64_t remainder_y;
 };
 #endif /* TrackpointDevice_hpp */
@@ -0,0 +1,162 @@
+/*
+ * TrackpointMotion.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include <limits.h>
+#include "TrackpointMotion.hpp"
+
+void trackpoint_set_acceleration(struct trackpoint_acceleration *accel, uint32_t sensitivity, uint32_t acceleration, uint32_t deadzone) {
+    const int64_t max_gain = (int64_t) TRACKPOINT_ACCEL_MAX_GAIN << TRACKPOINT_FIXED_SHIFT;
+    
+    for (int i = 0; i < TRACKPOINT_ACCEL_TABLE_SIZE; i++) {
+        // gain = sensitivity * (1 + acceleration * i / knee), both in percent
+        int64_t gain = ((int64_t) sensitivity << TRACKPOINT_FIXED_SHIFT) *
+                       (100 * TRACKPOINT_ACCEL_KNEE + (int64_t) acceleration * i) /
+                       (100 * 100 * TRACKPOINT_ACCEL_KNEE);
+        accel->table[i] = (int32_t) (gain < max_gain ? gain : max_gain);
+    }
+    
+    accel->deadzone = deadzone < TRACKPOINT_ACCEL_TABLE_SIZE ? deadzone : TRACKPOINT_ACCEL_TABLE_SIZE - 1;
+}
+
+int trackpoint_accelerate(const struct trackpoint_acceleration *accel, int delta, int64_t *remainder) {
+    int deadzone = accel->deadzone;
+    int magnitude = delta < 0 ? -delta : delta;
+    
+    if (magnitude <= deadzone) {
+        // drop the sub-pixel movement as well, otherwise the pointer drifts
+        *remainder = 0;
+        return 0;
+    }
+    
+    // sub-pixel movement in the opposite direction must not slow down a reversal
+    if ((delta < 0) != (*remainder < 0))
+        *remainder = 0;
+    
+    magnitude -= deadzone;
+    if (magnitude >= TRACKPOINT_ACCEL_TABLE_SIZE)
+        magnitude = TRACKPOINT_ACCEL_TABLE_SIZE - 1;
+    
+    int64_t scaled = (int64_t) (delta < 0 ? delta + deadzone : delta - deadzone) * accel->table[magnitude] + *remainder;
+    
+    // division truncates towards zero, so the remainder keeps the sign of the movement
+    int64_t result = scaled / (1 << TRACKPOINT_FIXED_SHIFT);
+    *remainder = scaled - result * (1 << TRACKPOINT_FIXED_SHIFT);
+    return (int) result;
+}
+
+void trackpoint_set_scrolling(struct trackpoint_scroll *scroll, uint32_t gain, uint64_t interval, uint32_t friction) {
+    scroll->gain = ((int64_t) gain << TRACKPOINT_FIXED_SHIFT) / 100;
+    scroll->interval = interval;
+    scroll->friction = friction < 100 ? friction : 100;
+    
+    scroll->scroll_x = 0;
+    scroll->scroll_y = 0;
+    scroll->velocity_x = 0;
+    scroll->velocity_y = 0;
+    scroll->ts_last_scroll = 0;
+    scroll->momentum = false;
+}
+
+void trackpoint_scroll_stop(struct trackpoint_scroll *scroll) {
+    if (scroll->momentum) {
+        scroll->momentum = false;
+        scroll->velocity_x = 0;
+        scroll->velocity_y = 0;
+    }
+}
+
+static inline int16_t clamp_scroll_delta(int64_t delta) {
+    if (delta > SHRT_MAX)
+        return SHRT_MAX;
+    if (delta < SHRT_MIN)
+        return SHRT_MIN;
+    return (int16_t) delta;
+}
+
+static bool dispatch_scroll(struct trackpoint_scroll *scroll, uint64_t now, struct trackpoint_scroll_event *event) {
+    // only whole lines are dispatched, the rest is kept for the next event
+    int64_t lines_x = scroll->scroll_x / (1 << TRACKPOINT_FIXED_SHIFT);
+    int64_t lines_y = scroll->scroll_y / (1 << TRACKPOINT_FIXED_SHIFT);
+    
+    scroll->ts_last_scroll = now;
+    if (!lines_x && !lines_y)
+        return false;
+    
+    scroll->scroll_x -= lines_x * (1 << TRACKPOINT_FIXED_SHIFT);
+    scroll->scroll_y -= lines_y * (1 << TRACKPOINT_FIXED_SHIFT);
+    event->lines_x = clamp_scroll_delta(lines_x);
+    event->lines_y = clamp_scroll_delta(lines_y);
+    return true;
+}
+
+bool trackpoint_scroll_update(struct trackpoint_scroll *scroll, int dx, int dy, uint64_t now, struct trackpoint_scroll_event *event) {
+    trackpoint_scroll_stop(scroll);
+    
+    scroll->scroll_x += dx * scroll->gain;
+    scroll->scroll_y += dy * scroll->gain;
+    
+    // the first movement is dispatched immediately, later ones at most once per interval
+    uint64_t elapsed = now - scroll->ts_last_scroll;
+    if (elapsed < scroll->interval)
+        return false;
+    
+    // velocity is the movement per interval, movement after a long pause has none
+    if (scroll->ts_last_scroll && elapsed <= TRACKPOINT_MOMENTUM_MAX_AGE * scroll->interval) {
+        scroll->velocity_x = scroll->scroll_x * (int64_t) scroll->interval / (int64_t) elapsed;
+        scroll->velocity_y = scroll->scroll_y * (int64_t) scroll->interval / (int64_t) elapsed;
+    } else {
+        scroll->velocity_x = 0;
+        scroll->velocity_y = 0;
+    }
+    
+    return dispatch_scroll(scroll, now, event);
+}
+
+bool trackpoint_scroll_end(struct trackpoint_scroll *scroll, uint64_t now, struct trackpoint_scroll_event *event) {
+    // a pause before releasing the button means the user wants to stop
+    if (now - scroll->ts_last_scroll > TRACKPOINT_MOMENTUM_MAX_AGE * scroll->interval) {
+        scroll->velocity_x = 0;
+        scroll->velocity_y = 0;
+    }
+    
+    bool dispatch = dispatch_scroll(scroll, now, event);
+    scroll->scroll_x = 0;
+    scroll->scroll_y = 0;
+    scroll->ts_last_scroll = 0;
+    
+    if (scroll->friction < 100 &&
+        (scroll->velocity_x >= TRACKPOINT_MOMENTUM_MIN || scroll->velocity_x <= -TRACKPOINT_MOMENTUM_MIN ||
+         scroll->velocity_y >= TRACKPOINT_MOMENTUM_MIN || scroll->velocity_y <= -TRACKPOINT_MOMENTUM_MIN)) {
+        scroll->momentum = true;
+    } else {
+        scroll->velocity_x = 0;
+        scroll->velocity_y = 0;
+    }
+    return dispatch;
+}
+
+bool trackpoint_scroll_momentum(struct trackpoint_scroll *scroll, uint64_t now, struct trackpoint_scroll_event *event) {
+    if (!scroll->momentum)
+        return false;
+    
+    scroll->velocity_x = scroll->velocity_x * (100 - scroll->friction) / 100;
+    scroll->velocity_y = scroll->velocity_y * (100 - scroll->friction) / 100;
+    
+    if (scroll->velocity_x < TRACKPOINT_MOMENTUM_MIN && scroll->velocity_x > -TRACKPOINT_MOMENTUM_MIN &&
+        scroll->velocity_y < TRACKPOINT_MOMENTUM_MIN && scroll->velocity_y > -TRACKPOINT_MOMENTUM_MIN) {
+        scroll->momentum = false;
+        scroll->velocity_x = 0;
+        scroll->velocity_y = 0;
+        scroll->scroll_x = 0;
+        scroll->scroll_y = 0;
+        scroll->ts_last_scroll = 0;
+        return false;
+    }
+    
+    scroll->scroll_x += scroll->velocity_x;
+    scroll->scroll_y += scroll->velocity_y;
+    return dispatch_scroll(scroll, now, event);
+}
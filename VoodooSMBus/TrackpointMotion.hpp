@@ -0,0 +1,114 @@
+/*
+ * TrackpointMotion.hpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#ifndef TrackpointMotion_hpp
+#define TrackpointMotion_hpp
+
+/*
+ * Shaping of trackpoint movement.
+ */
+#include <stdint.h>
+
+/* Size of the acceleration lookup table, larger deltas use the last entry */
+#define TRACKPOINT_ACCEL_TABLE_SIZE     128
+/* Delta at which the acceleration has added the configured percentage */
+#define TRACKPOINT_ACCEL_KNEE           8
+/* Maximum gain of the acceleration curve */
+#define TRACKPOINT_ACCEL_MAX_GAIN       16
+/* Fractional bits of the fixed point gain and remainder */
+#define TRACKPOINT_FIXED_SHIFT          16
+
+/* Momentum stops once the scroll velocity drops below a quarter line per interval */
+#define TRACKPOINT_MOMENTUM_MIN         (1 << (TRACKPOINT_FIXED_SHIFT - 2))
+/* Scroll velocity is only kept for momentum if the last event is at most this many intervals old */
+#define TRACKPOINT_MOMENTUM_MAX_AGE     3
+
+struct trackpoint_acceleration {
+    /* Gain per absolute delta in fixed point with TRACKPOINT_FIXED_SHIFT fractional bits */
+    int32_t             table[TRACKPOINT_ACCEL_TABLE_SIZE];
+    int                 deadzone;
+};
+
+/*
+ * Precomputes the acceleration curve
+ * @sensitivity Gain for slow movements in percent
+ * @acceleration Additional gain in percent that is added for every
+ *    TRACKPOINT_ACCEL_KNEE counts of movement per report
+ * @deadzone Movement of up to this many counts per report is ignored
+ */
+void trackpoint_set_acceleration(struct trackpoint_acceleration *accel, uint32_t sensitivity, uint32_t acceleration, uint32_t deadzone);
+
+/*
+ * Applies the acceleration curve to the movement of one axis. Takes a constant
+ * number of operations and doesn't allocate.
+ * @remainder Sub-pixel movement of the axis that has not been dispatched yet
+ * @return Movement in pixels
+ */
+int trackpoint_accelerate(const struct trackpoint_acceleration *accel, int delta, int64_t *remainder);
+
+/*
+ * Scroll engine. Trackpoint movement while scrolling is accumulated in fixed
+ * point and dispatched in whole lines at most once per interval. After
+ * scrolling ended, the last velocity is continued with momentum events that
+ * lose `friction` percent of it each.
+ */
+struct trackpoint_scroll {
+    /* Lines per trackpoint count in fixed point */
+    int64_t             gain;
+    /* Shortest time between two events in absolute time */
+    uint64_t            interval;
+    uint32_t            friction;
+    
+    /* Scroll movement in fixed point that has not been dispatched yet */
+    int64_t             scroll_x;
+    int64_t             scroll_y;
+    /* Scroll velocity in fixed point per interval, used for momentum */
+    int64_t             velocity_x;
+    int64_t             velocity_y;
+    uint64_t            ts_last_scroll;
+    /* Momentum events are due every interval */
+    bool                momentum;
+};
+
+/* Lines of a scroll event */
+struct trackpoint_scroll_event {
+    int16_t             lines_x;
+    int16_t             lines_y;
+};
+
+/*
+ * Configures the scroll engine and resets it
+ * @gain Scroll distance per trackpoint count in percent of a line
+ * @interval Shortest time between two events in absolute time
+ * @friction Velocity in percent that is lost on every momentum event,
+ *    100 disables momentum scrolling
+ */
+void trackpoint_set_scrolling(struct trackpoint_scroll *scroll, uint32_t gain, uint64_t interval, uint32_t friction);
+
+/*
+ * Accumulates movement while scrolling, ends momentum scrolling
+ * @now Absolute time the movement was reported by the device
+ * @return true if @event has to be dispatched
+ */
+bool trackpoint_scroll_update(struct trackpoint_scroll *scroll, int dx, int dy, uint64_t now, struct trackpoint_scroll_event *event);
+
+/*
+ * Flushes the remaining movement when scrolling ended and sets `momentum` if
+ * momentum events follow
+ * @return true if @event has to be dispatched
+ */
+bool trackpoint_scroll_end(struct trackpoint_scroll *scroll, uint64_t now, struct trackpoint_scroll_event *event);
+
+/*
+ * Computes the next momentum event, clears `momentum` once the velocity is spent
+ * @return true if @event has to be dispatched
+ */
+bool trackpoint_scroll_momentum(struct trackpoint_scroll *scroll, uint64_t now, struct trackpoint_scroll_event *event);
+
+/* Ends momentum scrolling, e.g. because the pointer moved */
+void trackpoint_scroll_stop(struct trackpoint_scroll *scroll);
+
+#endif /* TrackpointMotion_hpp */
@@ -20,8 +20,11 @@ OSDefineMetaClassAndStructors(VoodooSMBusControllerDriver, IOService)
 bool VoodooSMBusControllerDriver::init(OSDictionary *dict) {
     bool result = super::init(dict);
     
-    // For now, we support only one slave device
+    // the touchpad and the SPD EEPROMs that are found
     device_nubs = OSDictionary::withCapacity(1);
+    sequence_lock = IOLockAlloc();
+    status_lock = IOSimpleLockAlloc();
+    poll_devices = OSArray::withCapacity(JC42_LAST_ADDRESS - JC42_FIRST_ADDRESS + 1);
     adapter = reinterpret_cast<i801_adapter*>(IOMalloc(sizeof(i801_adapter)));
     awake = true;
     
@@ -31,6 +34,15 @@ bool VoodooSMBusControllerDriver::init(OSDictionary *dict) {
 void VoodooSMBusControllerDriver::free(void) {
     IOFree(adapter, sizeof(i801_adapter));
     OSSafeReleaseNULL(device_nubs);
+    OSSafeReleaseNULL(poll_devices);
+    if (sequence_lock) {
+        IOLockFree(sequence_lock);
+        sequence_lock = NULL;
+    }
+    if (status_lock) {
+        IOSimpleLockFree(status_lock);
+        status_lock = NULL;
+    }
     super::free();
 }
 
@@ -51,7 +63,8 @@ bool VoodooSMBusControllerDriver::start(IOService *provider) {
 
     pci_device->setIOEnable(true);
    
-    adapter->pci_device = pci_device;
+    adapter->ops = &adapter_ops;
+    adapter->context = this;
     adapter->name = getMatchedName(provider);
     
     pci_device->retain();
@@ -82,6 +95,7 @@ bool VoodooSMBusControllerDriver::start(IOService *provider) {
     adapter->features |= FEATURE_HOST_NOTIFY;
     adapter->retries = 3;
     adapter->timeout = 200000000;
+    adapter->illegal_len = 0;
     
     work_loop = reinterpret_cast<IOWorkLoop*>(getWorkLoop());
     if (!work_loop) {
@@ -90,7 +104,8 @@ bool VoodooSMBusControllerDriver::start(IOService *provider) {
     }
     
     interrupt_source =
-    IOInterruptEventSource::interruptEventSource(this, OSMemberFunctionCast(IOInterruptEventAction, this, &VoodooSMBusControllerDriver::handleInterrupt),provider);
+    IOFilterInterruptEventSource::filterInterruptEventSource(this, OSMemberFunctionCast(IOInterruptEventAction, this, &VoodooSMBusControllerDriver::handleInterrupt),
+                                                             OSMemberFunctionCast(IOFilterInterruptEventSource::Filter, this, &VoodooSMBusControllerDriver::filterInterrupt), provider);
     
     if (!interrupt_source || work_loop->addEventSource(interrupt_source) != kIOReturnSuccess) {
         IOLog("%s Could not add interrupt source to work loop\n", getName());
@@ -102,17 +117,48 @@ bool VoodooSMBusControllerDriver::start(IOService *provider) {
         IOLog("%s Could not open command gate\n", getName());
         goto exit;
     }
-    adapter->command_gate = command_gate;
     work_loop->retain();
     
+    poll_work_loop = IOWorkLoop::workLoop();
+    if (!poll_work_loop) {
+        IOLog("%s Could not create poll work loop\n", getName());
+        goto exit;
+    }
+    
+    poll_command_gate = IOCommandGate::commandGate(this);
+    if (!poll_command_gate || (poll_work_loop->addEventSource(poll_command_gate) != kIOReturnSuccess)) {
+        IOLog("%s Could not open poll command gate\n", getName());
+        goto exit;
+    }
+    
+    poll_timer = IOTimerEventSource::timerEventSource(this, OSMemberFunctionCast(IOTimerEventSource::Action, this, &VoodooSMBusControllerDriver::pollDevices));
+    if (!poll_timer || (poll_work_loop->addEventSource(poll_timer) != kIOReturnSuccess)) {
+        IOLog("%s Could not add poll timer to work loop\n", getName());
+        goto exit;
+    }
+    
+    poll_interval_ms = Configuration::loadUInt64Configuration(this, "PollIntervalMs", POLL_INTERVAL_MS_DEFAULT);
+    poll_backoff_ms = Configuration::loadUInt64Configuration(this, "PollBackoffMs", POLL_BACKOFF_MS_DEFAULT);
+    nanoseconds_to_absolutetime(Configuration::loadUInt64Configuration(this, "PollBudgetUs", POLL_BUDGET_US_DEFAULT) * 1000, &poll_schedule.budget);
+    nanoseconds_to_absolutetime(poll_interval_ms * 1000000, &poll_schedule.interval);
+    nanoseconds_to_absolutetime(poll_backoff_ms * 1000000, &poll_schedule.backoff);
+    nanoseconds_to_absolutetime(BUS_RECOVERY_INTERVAL_MS * 1000000ULL, &bus_recovery.interval);
+    
+    bzero(&user_client_allowlist, sizeof(user_client_allowlist));
+    loadUserClientAllowlist("UserClientReadAddresses", false);
+    loadUserClientAllowlist("UserClientWriteAddresses", true);
+    user_client_max_commands = Configuration::loadUInt64Configuration(this, "UserClientMaxCommands", USER_CLIENT_MAX_COMMANDS_DEFAULT);
+    
     PMinit();
     provider->joinPMtree(this);
     registerPowerDriver(this, VoodooI2CIOPMPowerStates, kVoodooI2CIOPMNumberPowerStates);
     pci_device->enablePCIPowerManagement(kPCIPMCSPowerStateD0);
 
-    publishNub(ELAN_TOUCHPAD_ADDRESS);
     interrupt_source->enable();
+    publishNub(ELAN_TOUCHPAD_ADDRESS, "elan-touchpad");
     enableHostNotify();
+    probeSPD();
+    probeTemperatureSensors();
 
     registerService();
 
@@ -137,6 +183,21 @@ void VoodooSMBusControllerDriver::releaseResources() {
         device_nubs->flushCollection();
     }
     
+    if (poll_timer) {
+        poll_timer->cancelTimeout();
+        poll_work_loop->removeEventSource(poll_timer);
+        poll_timer->release();
+        poll_timer = NULL;
+    }
+    if (poll_command_gate) {
+        poll_work_loop->removeEventSource(poll_command_gate);
+        poll_command_gate->release();
+        poll_command_gate = NULL;
+    }
+    OSSafeReleaseNULL(poll_work_loop);
+    if (poll_devices)
+        poll_devices->flushCollection();
+    
     if (command_gate) {
         work_loop->removeEventSource(command_gate);
         command_gate->release();
@@ -179,6 +240,8 @@ IOReturn VoodooSMBusControllerDriver::setPowerState(unsigned long whichState, IO
             command_gate->enable();
             enableHostNotify();
             awake = true;
+            if (poll_devices->getCount())
+                poll_timer->setTimeoutMS(0);
         }
         
     }
@@ -190,7 +253,8 @@ void VoodooSMBusControllerDriver::disableCommandGate() {
 }
 
 
-IOReturn VoodooSMBusControllerDriver::publishNub(UInt8 address) {
+IOReturn VoodooSMBusControllerDriver::publishNub(UInt8 address, const char* name) {
+    char key[5];
     
     VoodooSMBusDeviceNub* device_nub = OSTypeAlloc(VoodooSMBusDeviceNub);
     
@@ -204,12 +268,15 @@ IOReturn VoodooSMBusControllerDriver::publishNub(UInt8 address) {
         goto exit;
     }
     
+    device_nub->setName(name);
+    
     if (!device_nub->start(this)) {
         IOLog("%s::%s Could not start nub\n", getName(), adapter->name);
         goto exit;
     }
     
-    device_nubs->setObject("0x15", device_nub);
+    snprintf(key, sizeof(key), "%#04x", address);
+    device_nubs->setObject(key, device_nub);
     IOLogDebug("Publishing nub for slave device at address %#04x", address);
 
     return kIOReturnSuccess;
@@ -220,6 +287,47 @@ exit:
     return kIOReturnError;
 }
 
+VoodooSMBusDeviceNub* VoodooSMBusControllerDriver::getDeviceNub(UInt8 address) {
+    char key[5];
+    snprintf(key, sizeof(key), "%#04x", address);
+    return OSDynamicCast(VoodooSMBusDeviceNub, device_nubs->getObject(key));
+}
+
+void VoodooSMBusControllerDriver::probeSPD() {
+    for (UInt8 address = SPD_FIRST_ADDRESS; address <= SPD_LAST_ADDRESS; address++) {
+        VoodooSMBusSlaveDevice probe_device = { .addr = address };
+        union i2c_smbus_data data;
+        
+        // a read byte like the linux i2c core, a quick write could change an EEPROM's write protection
+        if (transfer(&probe_device, I2C_SMBUS_READ, 0, I2C_SMBUS_BYTE, &data) < 0)
+            continue;
+        
+        IOLog("%s::%s Found SPD device at address %#04x\n", getName(), adapter->name, address);
+        publishNub(address, "spd-eeprom");
+    }
+}
+
+void VoodooSMBusControllerDriver::probeTemperatureSensors() {
+    for (UInt8 address = JC42_FIRST_ADDRESS; address <= JC42_LAST_ADDRESS; address++) {
+        struct i2c_smbus_client client = getSMBusClient(address);
+        
+        // reading registers has no side effects, unlike the quick write used to probe other devices
+        if (!jc42_detect(&client))
+            continue;
+        
+        IOLog("%s::%s Found temperature sensor at address %#04x\n", getName(), adapter->name, address);
+        publishNub(address, "jc42-temperature");
+    }
+}
+
+void VoodooSMBusControllerDriver::lockSequence() {
+    IOLockLock(sequence_lock);
+}
+
+void VoodooSMBusControllerDriver::unlockSequence() {
+    IOLockUnlock(sequence_lock);
+}
+
 IOWorkLoop* VoodooSMBusControllerDriver::getWorkLoop() {
     // Do we have a work loop already?, if so return it NOW.
     if ((vm_address_t) work_loop >> 1)
@@ -241,58 +349,130 @@ IOWorkLoop* VoodooSMBusControllerDriver::getWorkLoop() {
 }
 
 
-void VoodooSMBusControllerDriver::handleInterrupt(OSObject* owner, IOInterruptEventSource* src, int intCount) {
+bool VoodooSMBusControllerDriver::filterInterrupt(IOFilterInterruptEventSource* src) {
     u8 status;
+    bool handled = false;
+    bool schedule = false;
+    AbsoluteTime timestamp;
+    
+    clock_get_uptime(&timestamp);
 
     if (adapter->features & FEATURE_HOST_NOTIFY) {
         status = adapter->inb_p(SMBSLVSTS(adapter));
         if (status & SMBSLVSTS_HST_NTFY_STS) {
-            UInt8 addr;
+            UInt8 addr = adapter->inb_p(SMBNTFDADD(adapter)) >> 1;
             
-            addr = adapter->inb_p(SMBNTFDADD(adapter)) >> 1;
+            ts_host_notify[addr] = timestamp;
             
             /*
              * With the tested platforms, reading SMBNTFDDAT (22 + (p)->smba)
              * always returns 0. Our current implementation doesn't provide
              * data, so we just ignore it.
              */
+            OSBitOrAtomic(1 << (addr % 32), &pending_host_notify[addr / 32]);
             
-            VoodooSMBusDeviceNub* nub = OSDynamicCast(VoodooSMBusDeviceNub, device_nubs->getObject("0x15"));
+            /* clear Host Notify bit to allow a new notification */
+            adapter->outb_p(SMBSLVSTS_HST_NTFY_STS, SMBSLVSTS(adapter));
+            handled = schedule = true;
+        }
+    }
+    
+    /* the next byte of a block is transferred right away, the work loop isn't needed for it */
+    IOSimpleLockLock(status_lock);
+    status = i801_isr(adapter);
+    IOSimpleLockUnlock(status_lock);
+    if (status)
+        handled = true;
+    
+    /* i801_isr stored the result in adapter->status, the transfer waiting for it continues right away */
+    if (status & (SMBHSTSTS_INTR | STATUS_ERROR_FLAGS))
+        thread_wakeup(&adapter->status);
+    
+    if (status & SMBHSTSTS_SMBALERT_STS) {
+        ts_alert = timestamp;
+        OSIncrementAtomic(&alert_requests);
+        OSBitOrAtomic(SMBHSTSTS_SMBALERT_STS, &pending_host_status);
+        schedule = true;
+    }
+    
+    if (adapter->illegal_len)
+        schedule = true;
+    
+    if (!handled) {
+        interrupts_filtered++;
+    } else {
+        interrupts_handled++;
+    }
+    if (schedule) {
+        interrupts_scheduled++;
+    }
+    return schedule;
+}
+
+void VoodooSMBusControllerDriver::handleInterrupt(OSObject* owner, IOInterruptEventSource* src, int intCount) {
+    for (UInt32 i = 0; i < 4; i++) {
+        UInt32 notified = OSBitAndAtomic(0, &pending_host_notify[i]);
+        
+        while (notified) {
+            UInt8 addr = i * 32 + __builtin_ctz(notified);
+            notified &= notified - 1;
+            
+            VoodooSMBusDeviceNub* nub = getDeviceNub(addr);
             if (nub) {
-                nub->handleHostNotify();
+                nub->handleHostNotify(ts_host_notify[addr]);
             } else {
                 IOLogError("Received Host Notify Interrupt for unknown device at address %#04x", addr);
             }
-            
-            /* clear Host Notify bit and return */
-            adapter->outb_p(SMBSLVSTS_HST_NTFY_STS, SMBSLVSTS(adapter));
-            return;
         }
     }
     
-    status = adapter->inb_p(SMBHSTSTS(adapter));
-
-    if (status & SMBHSTSTS_BYTE_DONE) {
-        i801_isr_byte_done(adapter);
+    UInt32 status = OSBitAndAtomic(0, &pending_host_status);
+    
+    if (status & SMBHSTSTS_SMBALERT_STS) {
+        // the alert response is read with transfers, which can't wait on this work loop
+        if (OSCompareAndSwap(0, 1, &alert_running)) {
+            thread_t new_thread;
+            kern_return_t ret = kernel_thread_start(OSMemberFunctionCast(thread_continue_t, this, &VoodooSMBusControllerDriver::handleAlertThreaded), this, &new_thread);
+            if (ret != KERN_SUCCESS) {
+                IOLogDebug(" Thread error while attemping to handle SMBus alert.\n");
+                alert_running = 0;
+            } else {
+                thread_deallocate(new_thread);
+            }
+        }
     }
     
-    /*
-     * Clear irq sources and report transaction result.
-     * ->status must be cleared before the next transaction is started.
-     */
-    status &= SMBHSTSTS_INTR | STATUS_ERROR_FLAGS;
-    if (status) {
-        adapter->outb_p(status, SMBHSTSTS(adapter));
-        adapter->status = status;
-        command_gate->commandWakeup(&adapter->status);
+    if (adapter->illegal_len) {
+        IOLogError("Illegal SMBus block read size %d\n", adapter->illegal_len);
+        adapter->illegal_len = 0;
     }
 }
 
+void VoodooSMBusControllerDriver::publishInterruptStatistics() {
+    OSDictionary* statistics = OSDictionary::withCapacity(3);
+    if (!statistics)
+        return;
+    
+    OSNumber* number = OSNumber::withNumber(interrupts_filtered, 64);
+    statistics->setObject("Filtered", number);
+    OSSafeReleaseNULL(number);
+    number = OSNumber::withNumber(interrupts_handled, 64);
+    statistics->setObject("Handled", number);
+    OSSafeReleaseNULL(number);
+    number = OSNumber::withNumber(interrupts_scheduled, 64);
+    statistics->setObject("Scheduled", number);
+    OSSafeReleaseNULL(number);
+    
+    setProperty("InterruptStatistics", statistics);
+    OSSafeReleaseNULL(statistics);
+}
+
 
 void VoodooSMBusControllerDriver::enableHostNotify() {
+    UInt8 slvcmd = (adapter->original_slvcmd | SMBSLVCMD_HST_NTFY_INTREN) & ~SMBSLVCMD_SMBALERT_DISABLE;
     
-    if(!(adapter->original_slvcmd & SMBSLVCMD_HST_NTFY_INTREN)) {
-        pci_device->ioWrite8(SMBSLVCMD(adapter), SMBSLVCMD_HST_NTFY_INTREN | adapter->original_slvcmd);
+    if (slvcmd != adapter->original_slvcmd) {
+        pci_device->ioWrite8(SMBSLVCMD(adapter), slvcmd);
     }
 
     /* clear Host Notify bit to allow a new notification */
@@ -314,11 +494,22 @@ IOReturn VoodooSMBusControllerDriver::readByteData(VoodooSMBusSlaveDevice *clien
     return data.byte;
 }
 
-IOReturn VoodooSMBusControllerDriver::readBlockData(VoodooSMBusSlaveDevice *client, u8 command, u8 *values) {
+IOReturn VoodooSMBusControllerDriver::readWordData(VoodooSMBusSlaveDevice *client, u8 command) {
+    union i2c_smbus_data data;
+    IOReturn status;
+    
+    status = transfer(client, I2C_SMBUS_READ, command, I2C_SMBUS_WORD_DATA, &data);
+    if (status != kIOReturnSuccess)
+        return status;
+    
+    return data.word;
+}
+
+IOReturn VoodooSMBusControllerDriver::readBlockData(VoodooSMBusSlaveDevice *client, u8 command, u8 *values, AbsoluteTime *transfer_start) {
     union i2c_smbus_data data;
     IOReturn status;
     
-    status = transfer(client, I2C_SMBUS_READ, command, I2C_SMBUS_BLOCK_DATA, &data);
+    status = transfer(client, I2C_SMBUS_READ, command, I2C_SMBUS_BLOCK_DATA, &data, transfer_start);
     if (status != kIOReturnSuccess)
         return status;
     
@@ -334,6 +525,22 @@ IOReturn VoodooSMBusControllerDriver::writeByteData(VoodooSMBusSlaveDevice *clie
 }
 
 
+IOReturn VoodooSMBusControllerDriver::readI2CBlockData(VoodooSMBusSlaveDevice *client, u8 command, u8 length, u8 *values) {
+    union i2c_smbus_data data;
+    IOReturn status;
+    
+    if (length > I2C_SMBUS_BLOCK_MAX)
+        length = I2C_SMBUS_BLOCK_MAX;
+    data.block[0] = length;
+    
+    status = transfer(client, I2C_SMBUS_READ, command, I2C_SMBUS_I2C_BLOCK_DATA, &data);
+    if (status != kIOReturnSuccess)
+        return status;
+    
+    memcpy(values, &data.block[1], data.block[0]);
+    return data.block[0];
+}
+
 IOReturn VoodooSMBusControllerDriver::writeByte(VoodooSMBusSlaveDevice *client, u8 value) {
     return transfer(client, I2C_SMBUS_WRITE, value, I2C_SMBUS_BYTE, NULL);
 }
@@ -350,7 +557,7 @@ IOReturn VoodooSMBusControllerDriver::writeBlockData(VoodooSMBusSlaveDevice *cli
     return transfer(client, I2C_SMBUS_WRITE, command, I2C_SMBUS_BLOCK_DATA, &data);
 }
 
-IOReturn VoodooSMBusControllerDriver::transfer(VoodooSMBusSlaveDevice *client, char  read_write, u8 command, int protocol, union i2c_smbus_data *data) {
+IOReturn VoodooSMBusControllerDriver::transfer(VoodooSMBusSlaveDevice *client, char  read_write, u8 command, int protocol, union i2c_smbus_data *data, AbsoluteTime *transfer_start) {
     VoodooSMBusControllerMessage message = {
         .slave_device = client,
         .read_write = read_write,
@@ -358,17 +565,128 @@ IOReturn VoodooSMBusControllerDriver::transfer(VoodooSMBusSlaveDevice *client, c
         .protocol = protocol,
     };
     
-    return command_gate->runAction(OSMemberFunctionCast(IOCommandGate::Action, this, &VoodooSMBusControllerDriver::transferGated), &message, data);
+    IOReturn result = command_gate->runAction(OSMemberFunctionCast(IOCommandGate::Action, this, &VoodooSMBusControllerDriver::transferGated), &message, data);
+    if (transfer_start)
+        *transfer_start = message.transfer_start;
+    return result;
+}
+
+struct i2c_smbus_client VoodooSMBusControllerDriver::getSMBusClient(u8 address, unsigned short flags) {
+    struct i2c_smbus_client client = {
+        .xfer = &VoodooSMBusControllerDriver::clientTransfer,
+        .context = this,
+        .addr = address,
+        .flags = flags,
+    };
+    return client;
+}
+
+s32 VoodooSMBusControllerDriver::clientTransfer(void* context, u16 addr, unsigned short flags, char read_write,
+                                                u8 command, int protocol, union i2c_smbus_data* data) {
+    VoodooSMBusSlaveDevice device = { .addr = (u8) addr, .flags = (u8) flags };
+    return reinterpret_cast<VoodooSMBusControllerDriver*>(context)->transfer(&device, read_write, command, protocol, data);
+}
+
+const struct i801_ops VoodooSMBusControllerDriver::adapter_ops = {
+    .outb = &VoodooSMBusControllerDriver::adapterOutb,
+    .inb = &VoodooSMBusControllerDriver::adapterInb,
+    .config_read8 = &VoodooSMBusControllerDriver::adapterConfigRead8,
+    .config_write8 = &VoodooSMBusControllerDriver::adapterConfigWrite8,
+    .udelay = &VoodooSMBusControllerDriver::adapterDelay,
+    .wait_status = &VoodooSMBusControllerDriver::adapterWaitStatus,
+};
+
+void VoodooSMBusControllerDriver::adapterOutb(void* context, u8 value, u16 port) {
+    reinterpret_cast<VoodooSMBusControllerDriver*>(context)->pci_device->ioWrite8(port, value);
+}
+
+u8 VoodooSMBusControllerDriver::adapterInb(void* context, u16 port) {
+    return reinterpret_cast<VoodooSMBusControllerDriver*>(context)->pci_device->ioRead8(port);
+}
+
+u8 VoodooSMBusControllerDriver::adapterConfigRead8(void* context, u16 offset) {
+    return reinterpret_cast<VoodooSMBusControllerDriver*>(context)->pci_device->configRead8(offset);
+}
+
+void VoodooSMBusControllerDriver::adapterConfigWrite8(void* context, u8 value, u16 offset) {
+    reinterpret_cast<VoodooSMBusControllerDriver*>(context)->pci_device->configWrite8(offset, value);
+}
+
+void VoodooSMBusControllerDriver::adapterDelay(void* context, unsigned int us) {
+    IODelay(us);
+}
+
+/*
+ * Runs in the command gate and releases it while waiting, like commandSleep.
+ * The filter interrupt wakes the thread itself, the status lock makes sure the
+ * wakeup can't fall between the check of the status and the wait.
+ */
+int VoodooSMBusControllerDriver::adapterWaitStatus(void* context, struct i801_adapter* priv) {
+    VoodooSMBusControllerDriver* controller = reinterpret_cast<VoodooSMBusControllerDriver*>(context);
+    AbsoluteTime deadline;
+    IOInterruptState state;
+    wait_result_t result;
+    
+    clock_interval_to_deadline(priv->timeout, kNanosecondScale, &deadline);
+    state = IOSimpleLockLockDisableInterrupt(controller->status_lock);
+    while (!priv->status) {
+        assert_wait_deadline(&priv->status, THREAD_UNINT, deadline);
+        IOSimpleLockUnlockEnableInterrupt(controller->status_lock, state);
+        
+        controller->work_loop->openGate();
+        result = thread_block(THREAD_CONTINUE_NULL);
+        controller->work_loop->closeGate();
+        
+        state = IOSimpleLockLockDisableInterrupt(controller->status_lock);
+        // the interrupt may have come right at the deadline
+        if (result == THREAD_TIMED_OUT && !priv->status) {
+            IOSimpleLockUnlockEnableInterrupt(controller->status_lock, state);
+            return -ETIMEDOUT;
+        }
+    }
+    IOSimpleLockUnlockEnableInterrupt(controller->status_lock, state);
+    return 0;
+}
+
+/*
+ * Runs in the command gate. The wait for a completion and a bus recovery open
+ * the gate, so the host is owned until the transfer is done and later
+ * transfers wait for it.
+ */
+void VoodooSMBusControllerDriver::acquireHost() {
+    while (transfer_active)
+        command_gate->commandSleep(&transfer_active, THREAD_UNINT);
+    transfer_active = true;
+}
+
+void VoodooSMBusControllerDriver::releaseHost() {
+    transfer_active = false;
+    command_gate->commandWakeup(&transfer_active, true);
 }
 
-// __i2c_smbus_xfer
 IOReturn VoodooSMBusControllerDriver::transferGated(VoodooSMBusControllerMessage *message, union i2c_smbus_data *data) {
+    acquireHost();
+    IOReturn res = transferOwned(message, data);
+    releaseHost();
+    return res;
+}
+
+// __i2c_smbus_xfer
+IOReturn VoodooSMBusControllerDriver::transferOwned(VoodooSMBusControllerMessage *message, union i2c_smbus_data *data) {
     int _try;
     s32 res;
 
     VoodooSMBusSlaveDevice* slave_device = message->slave_device;
     slave_device->flags &= I2C_M_TEN | I2C_CLIENT_PEC | I2C_CLIENT_SCCB;
     
+    clock_get_uptime(&message->transfer_start);
+    
+    /*
+     * acquireHost serializes the transfers, so i801_access only refuses one
+     * as overlapping if something bypassed it; such a refusal is no hang
+     */
+    bool host_owned = !adapter->transfer_active;
+    
     /* Retry automatically on arbitration loss */
     for (res = 0, _try = 0; _try <= adapter->retries; _try++) {
         res = i801_access(adapter, slave_device->addr, slave_device->flags, message->read_write, message->command, message->protocol, data);
@@ -376,5 +694,381 @@ IOReturn VoodooSMBusControllerDriver::transferGated(VoodooSMBusControllerMessage
             break;
     }
     
+    AbsoluteTime transfer_end;
+    clock_get_uptime(&transfer_end);
+    superviseBus(res, host_owned, transfer_end);
+    
+    if (message->protocol >= 0 && message->protocol < SMBUS_PROTOCOLS) {
+        transfer_time[message->protocol].record(transfer_end - message->transfer_start);
+        if (res < 0)
+            transfer_errors[message->protocol]++;
+        
+        uint64_t elapsed_ns;
+        absolutetime_to_nanoseconds(transfer_end - ts_transfer_statistics, &elapsed_ns);
+        if (elapsed_ns > TRANSFER_STATISTICS_INTERVAL_MS * 1000000ULL) {
+            ts_transfer_statistics = transfer_end;
+            publishTransferStatistics();
+            publishInterruptStatistics();
+        }
+    }
+    
     return res;
 }
+
+void VoodooSMBusControllerDriver::loadUserClientAllowlist(const char* key, bool write) {
+    UInt64 addresses[128];
+    UInt32 count = Configuration::loadUInt64ArrayConfiguration(this, key, addresses, 128);
+    
+    for (UInt32 i = 0; i < count; i++) {
+        if (addresses[i] > 0x7f) {
+            IOLog("%s Ignoring invalid address %#llx in %s\n", getName(), addresses[i], key);
+            continue;
+        }
+        smbus_stream_allow(&user_client_allowlist, (uint8_t) addresses[i], write);
+    }
+}
+
+IOReturn VoodooSMBusControllerDriver::executeCommandStream(const u8* stream, size_t length, u8* results, size_t capacity,
+                                                           size_t* results_length, UInt32* executed) {
+    *results_length = 0;
+    *executed = 0;
+    
+    // checked before taking the gate, a long stream would hold off all other devices
+    int count = smbus_stream_decode_header(stream, length, SMBUS_STREAM_COMMAND_MAGIC);
+    if (count < 0 || (UInt64) count > user_client_max_commands) {
+        return kIOReturnBadArgument;
+    }
+    
+    VoodooSMBusCommandStream command_stream = {
+        .stream = stream,
+        .length = length,
+        .results = results,
+        .capacity = capacity,
+    };
+    
+    // the stream may select an EE1004 page, which must not happen in the middle of a sequence of a driver
+    lockSequence();
+    IOReturn ret = command_gate->runAction(OSMemberFunctionCast(IOCommandGate::Action, this, &VoodooSMBusControllerDriver::executeCommandStreamGated), &command_stream);
+    unlockSequence();
+    if (ret != kIOReturnSuccess) {
+        return ret;
+    }
+    
+    *results_length = command_stream.results_length;
+    switch (command_stream.executed) {
+        case SMBUS_STREAM_EINVAL:
+            return kIOReturnBadArgument;
+        case SMBUS_STREAM_ENOSPC:
+            return kIOReturnNoSpace;
+        default:
+            *executed = command_stream.executed;
+            return kIOReturnSuccess;
+    }
+}
+
+IOReturn VoodooSMBusControllerDriver::executeCommandStreamGated(VoodooSMBusCommandStream* command_stream) {
+    if (!awake) {
+        return kIOReturnOffline;
+    }
+    
+    // owned for the whole stream, no other transfer runs in between
+    acquireHost();
+    command_stream->executed = smbus_stream_execute(command_stream->stream, command_stream->length,
+                                                    command_stream->results, command_stream->capacity, &command_stream->results_length,
+                                                    &user_client_allowlist, &VoodooSMBusControllerDriver::transferStreamCommand, this);
+    releaseHost();
+    return kIOReturnSuccess;
+}
+
+int VoodooSMBusControllerDriver::transferStreamCommand(void* context, const struct smbus_stream_command* command, uint8_t* data) {
+    VoodooSMBusControllerDriver* controller = reinterpret_cast<VoodooSMBusControllerDriver*>(context);
+    
+    VoodooSMBusSlaveDevice slave_device = {
+        .addr = command->address,
+        .flags = static_cast<UInt8>(command->flags & SMBUS_STREAM_FLAG_PEC ? I2C_CLIENT_PEC : 0),
+    };
+    VoodooSMBusControllerMessage message = {
+        .slave_device = &slave_device,
+        .read_write = static_cast<char>(command->read_write),
+        .command = command->command,
+        .protocol = command->protocol,
+    };
+    
+    return controller->transferOwned(&message, reinterpret_cast<union i2c_smbus_data*>(data));
+}
+
+IOReturn VoodooSMBusControllerDriver::addPollDevice(VoodooSMBusDeviceNub* device_nub) {
+    return poll_command_gate->runAction(OSMemberFunctionCast(IOCommandGate::Action, this, &VoodooSMBusControllerDriver::addPollDeviceGated), device_nub);
+}
+
+void VoodooSMBusControllerDriver::removePollDevice(VoodooSMBusDeviceNub* device_nub) {
+    poll_command_gate->runAction(OSMemberFunctionCast(IOCommandGate::Action, this, &VoodooSMBusControllerDriver::removePollDeviceGated), device_nub);
+}
+
+IOReturn VoodooSMBusControllerDriver::addPollDeviceGated(VoodooSMBusDeviceNub* device_nub) {
+    if (!poll_devices || !poll_devices->setObject(device_nub))
+        return kIOReturnNoMemory;
+    
+    // the first device starts the schedule, later ones join its windows
+    if (poll_devices->getCount() == 1) {
+        AbsoluteTime now;
+        clock_get_uptime(&now);
+        smbus_poll_start(&poll_schedule, now);
+        poll_timer->setTimeoutMS(0);
+    }
+    return kIOReturnSuccess;
+}
+
+IOReturn VoodooSMBusControllerDriver::removePollDeviceGated(VoodooSMBusDeviceNub* device_nub) {
+    int index = poll_devices->getNextIndexOfObject(device_nub, 0);
+    if (index < 0)
+        return kIOReturnNotFound;
+    
+    poll_devices->removeObject(index);
+    if (!poll_devices->getCount())
+        poll_timer->cancelTimeout();
+    return kIOReturnSuccess;
+}
+
+AbsoluteTime VoodooSMBusControllerDriver::lastHostNotify() {
+    AbsoluteTime last = 0;
+    
+    for (int addr = 0; addr < 128; addr++) {
+        if (ts_host_notify[addr] > last)
+            last = ts_host_notify[addr];
+    }
+    return last;
+}
+
+void VoodooSMBusControllerDriver::pollDevices(IOTimerEventSource* timer) {
+    AbsoluteTime now, window_start;
+    UInt32 count = poll_devices->getCount();
+    UInt32 polled;
+    
+    if (!count || !awake)
+        return;
+    
+    // the touchpad reports while it is used, its reports must not wait for the window
+    clock_get_uptime(&now);
+    if (smbus_poll_defer(&poll_schedule, now, lastHostNotify())) {
+        timer->setTimeoutMS((UInt32) poll_backoff_ms);
+        return;
+    }
+    
+    window_start = now;
+    for (polled = 0; polled < count && smbus_poll_continue(&poll_schedule, polled, window_start, now); polled++) {
+        VoodooSMBusDeviceNub* device_nub = OSDynamicCast(VoodooSMBusDeviceNub, poll_devices->getObject((poll_schedule.next + polled) % count));
+        if (device_nub)
+            device_nub->poll();
+        clock_get_uptime(&now);
+    }
+    smbus_poll_finish(&poll_schedule, polled, count, now);
+    
+    poll_window_time.record(now - window_start);
+    publishPollStatistics();
+    timer->setTimeoutMS((UInt32) poll_interval_ms);
+}
+
+void VoodooSMBusControllerDriver::publishPollStatistics() {
+    OSDictionary* statistics = OSDictionary::withCapacity(5);
+    if (!statistics)
+        return;
+    
+    OSNumber* number = OSNumber::withNumber(poll_devices->getCount(), 32);
+    statistics->setObject("Devices", number);
+    OSSafeReleaseNULL(number);
+    number = OSNumber::withNumber(poll_schedule.windows, 64);
+    statistics->setObject("Windows", number);
+    OSSafeReleaseNULL(number);
+    number = OSNumber::withNumber(poll_schedule.deferrals, 64);
+    statistics->setObject("Deferrals", number);
+    OSSafeReleaseNULL(number);
+    number = OSNumber::withNumber(poll_schedule.budget_exceeded, 64);
+    statistics->setObject("BudgetExceeded", number);
+    OSSafeReleaseNULL(number);
+    
+    OSDictionary* window_time = poll_window_time.copyStatistics();
+    if (window_time) {
+        statistics->setObject("WindowTime", window_time);
+        OSSafeReleaseNULL(window_time);
+    }
+    
+    setProperty("PollStatistics", statistics);
+    OSSafeReleaseNULL(statistics);
+}
+
+void VoodooSMBusControllerDriver::handleAlertThreaded() {
+    SInt32 handled;
+    
+    do {
+        do {
+            handled = alert_requests;
+            respondToAlerts();
+        } while (handled != alert_requests);
+        alert_running = 0;
+        // an alert between the last check and clearing the flag did not start a thread
+    } while (handled != alert_requests && OSCompareAndSwap(0, 1, &alert_running));
+    
+    publishAlertStatistics();
+}
+
+void VoodooSMBusControllerDriver::respondToAlerts() {
+    struct i2c_smbus_client ara = getSMBusClient(SMBUS_ALERT_RESPONSE_ADDRESS);
+    smbus_alert_respond(&ara, &VoodooSMBusControllerDriver::dispatchAlert, this, &alert_statistics);
+}
+
+bool VoodooSMBusControllerDriver::dispatchAlert(void* context, u8 address, u8 flag) {
+    VoodooSMBusControllerDriver* controller = static_cast<VoodooSMBusControllerDriver*>(context);
+    VoodooSMBusDeviceNub* device_nub = controller->getDeviceNub(address);
+    
+    if (!device_nub) {
+        IOLogError("%s::%s Received SMBus alert for unknown device at address %#04x\n", controller->getName(), controller->adapter->name, address);
+        return false;
+    }
+    device_nub->handleAlert(flag, controller->ts_alert);
+    return true;
+}
+
+void VoodooSMBusControllerDriver::publishAlertStatistics() {
+    OSDictionary* statistics = OSDictionary::withCapacity(4);
+    if (!statistics)
+        return;
+    
+    OSNumber* number = OSNumber::withNumber(alert_requests, 32);
+    statistics->setObject("Alerts", number);
+    OSSafeReleaseNULL(number);
+    number = OSNumber::withNumber(alert_statistics.dispatched, 64);
+    statistics->setObject("Dispatched", number);
+    OSSafeReleaseNULL(number);
+    number = OSNumber::withNumber(alert_statistics.unclaimed, 64);
+    statistics->setObject("UnknownDevice", number);
+    OSSafeReleaseNULL(number);
+    number = OSNumber::withNumber(alert_statistics.unanswered, 64);
+    statistics->setObject("NoResponse", number);
+    OSSafeReleaseNULL(number);
+    
+    setProperty("AlertStatistics", statistics);
+    OSSafeReleaseNULL(statistics);
+}
+
+void VoodooSMBusControllerDriver::superviseBus(s32 result, bool host_owned, AbsoluteTime now) {
+    switch (smbus_recovery_supervise(&bus_recovery, result, host_owned, now)) {
+        case BUS_HEALTH_RECOVERED:
+            IOLog("%s::%s Bus recovered\n", getName(), adapter->name);
+            recovery_time.record(bus_recovery.last_outage);
+            publishRecoveryStatistics();
+            break;
+        case BUS_HEALTH_HUNG:
+            recoverBus(now);
+            break;
+        default:
+            break;
+    }
+}
+
+void VoodooSMBusControllerDriver::recoverBus(AbsoluteTime now) {
+    UInt32 failures = bus_recovery.consecutive_failures;
+    enum bus_recovery_level level = smbus_recovery_start(&bus_recovery, now);
+    
+    IOLogError("%s::%s Bus hung after %u failed transfers, recovery level %u\n", getName(), adapter->name, failures, level);
+    
+    adapter->outb_p(adapter->inb_p(SMBHSTCNT(adapter)) | SMBHSTCNT_KILL, SMBHSTCNT(adapter));
+    recoverySleep(1);
+    adapter->outb_p(adapter->inb_p(SMBHSTCNT(adapter)) & (~SMBHSTCNT_KILL), SMBHSTCNT(adapter));
+    adapter->outb_p(STATUS_FLAGS, SMBHSTSTS(adapter));
+    if (adapter->features & FEATURE_SMBUS_PEC)
+        adapter->outb_p(SMBAUXSTS_CRCE, SMBAUXSTS(adapter));
+    adapter->status = 0;
+    
+    if (level >= BUS_RECOVERY_HOST_RESET) {
+        UInt8 host_config = pci_device->configRead8(SMBHSTCFG);
+        pci_device->configWrite8(SMBHSTCFG, host_config & ~SMBHSTCFG_HST_EN);
+        recoverySleep(1);
+        pci_device->configWrite8(SMBHSTCFG, host_config | SMBHSTCFG_HST_EN);
+        enableHostNotify();
+    }
+    
+    if (level >= BUS_RECOVERY_DEVICE_RESET) {
+        OSCollectionIterator* iterator = OSCollectionIterator::withCollection(device_nubs);
+        if (iterator) {
+            while (OSSymbol* key = OSDynamicCast(OSSymbol, iterator->getNextObject())) {
+                VoodooSMBusDeviceNub* device_nub = OSDynamicCast(VoodooSMBusDeviceNub, device_nubs->getObject(key));
+                if (device_nub)
+                    device_nub->handleBusReset();
+            }
+            iterator->release();
+        }
+    }
+    
+    publishRecoveryStatistics();
+}
+
+// runs in the command gate, which is released while sleeping so the work loop isn't blocked,
+// the failed transfer still owns the host so no other one starts meanwhile
+void VoodooSMBusControllerDriver::recoverySleep(UInt32 ms) {
+    AbsoluteTime deadline;
+    
+    clock_interval_to_deadline(ms, kMillisecondScale, &deadline);
+    command_gate->commandSleep(&bus_recovery, deadline, THREAD_UNINT);
+}
+
+void VoodooSMBusControllerDriver::publishRecoveryStatistics() {
+    static const char* level_names[BUS_RECOVERY_LEVELS] = {
+        "Kill", "HostReset", "DeviceReset"
+    };
+    
+    OSDictionary* statistics = OSDictionary::withCapacity(BUS_RECOVERY_LEVELS + 3);
+    if (!statistics)
+        return;
+    
+    OSNumber* number;
+    for (int i = 0; i < BUS_RECOVERY_LEVELS; i++) {
+        number = OSNumber::withNumber(bus_recovery.recoveries[i], 64);
+        statistics->setObject(level_names[i], number);
+        OSSafeReleaseNULL(number);
+    }
+    number = OSNumber::withNumber(bus_recovery.recovered, 64);
+    statistics->setObject("Recovered", number);
+    OSSafeReleaseNULL(number);
+    number = OSNumber::withNumber(bus_recovery.rate_limited, 64);
+    statistics->setObject("RateLimited", number);
+    OSSafeReleaseNULL(number);
+    
+    OSDictionary* time = recovery_time.copyStatistics();
+    if (time) {
+        statistics->setObject("RecoveryTime", time);
+        OSSafeReleaseNULL(time);
+    }
+    
+    setProperty("RecoveryStatistics", statistics);
+    OSSafeReleaseNULL(statistics);
+}
+
+void VoodooSMBusControllerDriver::publishTransferStatistics() {
+    static const char* protocol_names[SMBUS_PROTOCOLS] = {
+        "Quick", "Byte", "ByteData", "WordData", "ProcessCall",
+        "BlockData", "I2CBlockBroken", "BlockProcessCall", "I2CBlockData"
+    };
+    
+    OSDictionary* statistics = OSDictionary::withCapacity(SMBUS_PROTOCOLS);
+    if (!statistics)
+        return;
+    
+    for (int i = 0; i < SMBUS_PROTOCOLS; i++) {
+        OSDictionary* protocol = transfer_time[i].copyStatistics();
+        if (!protocol)
+            continue;
+        OSNumber* count = OSDynamicCast(OSNumber, protocol->getObject("Count"));
+        if (count && count->unsigned64BitValue()) {
+            OSNumber* number = OSNumber::withNumber(transfer_errors[i], 64);
+            protocol->setObject("Errors", number);
+            OSSafeReleaseNULL(number);
+            statistics->setObject(protocol_names[i], protocol);
+        }
+        OSSafeReleaseNULL(protocol);
+    }
+    
+    setProperty("TransferStatistics", statistics);
+    OSSafeReleaseNULL(statistics);
+}
+
@@ -18,15 +18,57 @@
 #include <IOKit/IOKitKeys.h>
 #include <IOKit/IOService.h>
 #include <IOKit/IOFilterInterruptEventSource.h>
+#include <IOKit/IOTimerEventSource.h>
 #include <IOKit/pci/IOPCIDevice.h>
 #include <IOKit/acpi/IOACPIPlatformDevice.h>
 #include <IOKit/IOPlatformExpert.h>
 #include "../Dependencies/VoodooI2C/Dependencies/helpers.hpp"
-#include "i2c_i801.cpp"
+#include "i2c_i801.hpp"
 #include "VoodooSMBusDeviceNub.hpp"
 #include "HostNotifyMessage.h"
+#include "LatencyHistogram.hpp"
+#include "Configuration.hpp"
+#include "SMBusCommandStream.hpp"
+#include "JC42Sensor.hpp"
+#include "SMBusPoll.hpp"
+#include "SMBusAlert.hpp"
+#include "SMBusRecovery.hpp"
 
 #define ELAN_TOUCHPAD_ADDRESS 0x15
+/* DIMM SPD EEPROMs or SPD5 hubs, one per memory slot */
+#define SPD_FIRST_ADDRESS     0x50
+#define SPD_LAST_ADDRESS      0x57
+/* DIMM temperature sensors (JC-42.4), one per memory slot */
+#define JC42_FIRST_ADDRESS    0x18
+#define JC42_LAST_ADDRESS     0x1f
+
+/* Polling of slow devices like temperature sensors, can be changed in the Configuration */
+#define POLL_INTERVAL_MS_DEFAULT    5000
+#define POLL_BUDGET_US_DEFAULT      2000
+#define POLL_BACKOFF_MS_DEFAULT     50
+
+/* Commands of a user client stream, the stream holds the bus for all of them */
+#define USER_CLIENT_MAX_COMMANDS_DEFAULT    256
+
+/* Number of SMBus protocols transfer times are tracked for, up to I2C_SMBUS_I2C_BLOCK_DATA */
+#define SMBUS_PROTOCOLS                 9
+/* Interval in ms the transfer and interrupt statistics are published at most */
+#define TRANSFER_STATISTICS_INTERVAL_MS 1000
+
+/* Interval in ms between two recovery attempts at least */
+#define BUS_RECOVERY_INTERVAL_MS        1000
+
+class VoodooSMBusDeviceNub;
+
+/* Helper struct so we are able to pass a command stream to `executeCommandStreamGated(..)` */
+typedef struct {
+    const u8* stream;
+    size_t length;
+    u8* results;
+    size_t capacity;
+    size_t results_length;
+    int executed;
+} VoodooSMBusCommandStream;
 
 /* Helper struct so we are able to pass more than 4 arguments to `transferGated(..)` */
 typedef struct  {
@@ -34,6 +76,8 @@ typedef struct  {
     char read_write;
     u8 command;
     int protocol;
+    /* Set to the time the transfer acquired the bus */
+    AbsoluteTime transfer_start;
 } VoodooSMBusControllerMessage;
 
 
@@ -52,6 +96,14 @@ public:
     IOReturn setPowerState(unsigned long whichState, IOService* whatDevice);
 
     IOWorkLoop* getWorkLoop();
+    
+    /*
+     * Reads and acknowledges the status in primary interrupt context and wakes
+     * the transfer waiting for a completion directly. The work loop is only
+     * scheduled if there is a Host Notify or SMBALERT# to hand on, interrupts
+     * of other devices on the shared line are filtered.
+     */
+    bool filterInterrupt(IOFilterInterruptEventSource* src);
     void handleInterrupt(OSObject* owner, IOInterruptEventSource* src, int intCount);
 
     /**
@@ -64,6 +116,16 @@ public:
      */
     IOReturn readByteData(VoodooSMBusSlaveDevice *client, u8 command);
     
+    /**
+     * readWordData - SMBus "read word" protocol
+     * @client: Handle to slave device
+     * @command: Byte interpreted by slave
+     *
+     * This executes the SMBus "read word" protocol, returning negative errno
+     * else a 16-bit unsigned "word" received from the device.
+     */
+    IOReturn readWordData(VoodooSMBusSlaveDevice *client, u8 command);
+    
     /**
      * readBlockData - SMBus "block read" protocol
      * @client: Handle to slave device
@@ -78,8 +140,23 @@ public:
      * the I2C_FUNC_SMBUS_READ_BLOCK_DATA functionality.  Not all adapter drivers
      * support this; its emulation through I2C messaging relies on a specific
      * mechanism (I2C_M_RECV_LEN) which may not be implemented.
+     *
+     * If @transfer_start is not NULL, it is set to the time the transfer
+     * acquired the bus.
+     */
+    IOReturn readBlockData(VoodooSMBusSlaveDevice *client, u8 command, u8 *values, AbsoluteTime *transfer_start = NULL);
+    
+    /**
+     * readI2CBlockData - I2C "block read" with a fixed length
+     * @client: Handle to slave device
+     * @command: Byte interpreted by slave, usually the offset to read from
+     * @length: Number of bytes to read, at most 32
+     * @values: Byte array into which data will be read
+     *
+     * This reads @length bytes without a length byte from the slave, as used
+     * by EEPROMs, returning negative errno else the number of bytes read.
      */
-    IOReturn readBlockData(VoodooSMBusSlaveDevice *client, u8 command, u8 *values);
+    IOReturn readI2CBlockData(VoodooSMBusSlaveDevice *client, u8 command, u8 length, u8 *values);
     
     /**
      * writeByteData - SMBus "write byte" protocol
@@ -128,24 +205,143 @@ public:
      * This executes an SMBus protocol operation, and returns a negative
      * errno code else zero on success.
      */
-    IOReturn transfer(VoodooSMBusSlaveDevice *client, char read_write, u8 command, int protocol, union i2c_smbus_data *data);
+    IOReturn transfer(VoodooSMBusSlaveDevice *client, char read_write, u8 command, int protocol, union i2c_smbus_data *data, AbsoluteTime *transfer_start = NULL);
+    
+    /*
+     * Client for the protocol helpers of i2c_smbus.h, used by the portable
+     * parts of the drivers. Its transfers go through transfer.
+     */
+    struct i2c_smbus_client getSMBusClient(u8 address, unsigned short flags = 0);
+    
+    /*
+     * Serializes sequences of transfers that depend on state shared by several
+     * devices, like the EE1004 page which is selected for all DIMMs at once.
+     * Single transfers are serialized by the command gate anyway.
+     */
+    void lockSequence();
+    void unlockSequence();
+    
+    /*
+     * Adds a nub with a poll handler to the devices that are polled together
+     * in one window per poll interval
+     */
+    IOReturn addPollDevice(VoodooSMBusDeviceNub* device_nub);
+    void removePollDevice(VoodooSMBusDeviceNub* device_nub);
+    
+    /*
+     * Executes a command stream of the user client in one pass of the command
+     * gate, so other transfers can't interleave with it. Only addresses in the
+     * UserClientReadAddresses and UserClientWriteAddresses are accessed.
+     * @results Buffer receiving the result stream
+     * @executed Number of commands executed
+     */
+    IOReturn executeCommandStream(const u8* stream, size_t length, u8* results, size_t capacity,
+                                  size_t* results_length, UInt32* executed);
     
     
 private:
     IOCommandGate* command_gate;
     IOWorkLoop* work_loop;
-    IOInterruptEventSource* interrupt_source;
+    IOFilterInterruptEventSource* interrupt_source;
     bool awake;
+    IOLock* sequence_lock;
+    /* Taken by the filter while it updates adapter->status, so a transfer can't miss the wakeup */
+    IOSimpleLock* status_lock;
+    /* A transfer or command stream owns the host, see acquireHost */
+    bool transfer_active;
+    
+    /* Status acknowledged by the filter and not yet handled by the work loop, only SMBALERT# */
+    volatile UInt32 pending_host_status;
+    /* Addresses of devices that sent a Host Notify, one bit per address */
+    volatile UInt32 pending_host_notify[4];
+    /* Time of the last Host Notify per address, so notifies of two devices don't overwrite each other */
+    AbsoluteTime ts_host_notify[128];
+    /* Only written by the filter, which never runs concurrently with itself */
+    UInt64 interrupts_filtered;
+    UInt64 interrupts_handled;
+    UInt64 interrupts_scheduled;
     
-    IOReturn publishNub(UInt8 address);
+    /* SMBALERT# handling */
+    volatile SInt32 alert_requests;
+    volatile UInt32 alert_running;
+    AbsoluteTime ts_alert;
+    struct smbus_alert_statistics alert_statistics;
+    
+    /*
+     * Polling scheduler. It runs on its own work loop, a transfer on the
+     * controller's work loop would wait for its own completion interrupt.
+     */
+    IOWorkLoop* poll_work_loop;
+    IOCommandGate* poll_command_gate;
+    IOTimerEventSource* poll_timer;
+    OSArray* poll_devices;
+    struct smbus_poll_schedule poll_schedule;
+    UInt64 poll_interval_ms;
+    UInt64 poll_backoff_ms;
+    LatencyHistogram poll_window_time;
+    
+    /* Addresses and stream size the user client is limited to */
+    struct smbus_stream_allowlist user_client_allowlist;
+    UInt64 user_client_max_commands;
+    
+    /* Time from the start of a transfer until it completed, per protocol */
+    LatencyHistogram transfer_time[SMBUS_PROTOCOLS];
+    UInt64 transfer_errors[SMBUS_PROTOCOLS];
+    AbsoluteTime ts_transfer_statistics;
+    
+    /* Bus recovery */
+    struct smbus_recovery bus_recovery;
+    /* Time from the first failed transfer until a transfer completes again */
+    LatencyHistogram recovery_time;
+    
+    IOReturn publishNub(UInt8 address, const char* name);
+    VoodooSMBusDeviceNub* getDeviceNub(UInt8 address);
+    void probeSPD();
+    void probeTemperatureSensors();
+    
+    IOReturn addPollDeviceGated(VoodooSMBusDeviceNub* device_nub);
+    IOReturn removePollDeviceGated(VoodooSMBusDeviceNub* device_nub);
+    void pollDevices(IOTimerEventSource* timer);
+    /* Latest Host Notify of any device, input defers the poll windows */
+    AbsoluteTime lastHostNotify();
+    void publishPollStatistics();
+    
+    void publishInterruptStatistics();
+    void handleAlertThreaded();
+    void respondToAlerts();
+    void publishAlertStatistics();
     void releaseResources();
     
+    /* Enables Host Notify and SMBALERT# interrupts */
     void enableHostNotify();
     void disableHostNotify();
     
     void disableCommandGate();
     
+    /* i801_ops of the adapter, the context is the controller */
+    static const struct i801_ops adapter_ops;
+    static void adapterOutb(void* context, u8 value, u16 port);
+    static u8 adapterInb(void* context, u16 port);
+    static u8 adapterConfigRead8(void* context, u16 offset);
+    static void adapterConfigWrite8(void* context, u8 value, u16 offset);
+    static void adapterDelay(void* context, unsigned int us);
+    static int adapterWaitStatus(void* context, struct i801_adapter* priv);
+    static s32 clientTransfer(void* context, u16 addr, unsigned short flags, char read_write,
+                              u8 command, int protocol, union i2c_smbus_data* data);
+    static bool dispatchAlert(void* context, u8 address, u8 flag);
+    
+    void acquireHost();
+    void releaseHost();
     IOReturn transferGated(VoodooSMBusControllerMessage *message, union i2c_smbus_data *data);
+    IOReturn transferOwned(VoodooSMBusControllerMessage *message, union i2c_smbus_data *data);
+    void loadUserClientAllowlist(const char* key, bool write);
+    IOReturn executeCommandStreamGated(VoodooSMBusCommandStream* command_stream);
+    static int transferStreamCommand(void* context, const struct smbus_stream_command* command, uint8_t* data);
+    void publishTransferStatistics();
+    void superviseBus(s32 result, bool host_owned, AbsoluteTime now);
+    void recoverBus(AbsoluteTime now);
+    void recoverySleep(UInt32 ms);
+    void publishRecoveryStatistics();
 
 };
 
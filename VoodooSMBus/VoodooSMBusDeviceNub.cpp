@@ -23,25 +23,91 @@ void VoodooSMBusDeviceNub::free(void) {
     super::free();
 }
 
-void VoodooSMBusDeviceNub::handleHostNotifyThreaded () {
-    IOService* device_driver = getClient();
+/*
+ * Every Host Notify gets its own context, so a notification arriving while the
+ * thread of the previous one has not run yet doesn't overwrite its timestamp
+ */
+typedef struct {
+    VoodooSMBusDeviceNub* nub;
+    AbsoluteTime interrupt;
+} VoodooSMBusHostNotifyContext;
+
+void VoodooSMBusDeviceNub::handleHostNotifyThreaded(void* parameter, wait_result_t wait_result) {
+    VoodooSMBusHostNotifyContext* context = reinterpret_cast<VoodooSMBusHostNotifyContext*>(parameter);
+    VoodooSMBusDeviceNub* nub = context->nub;
+    VoodooSMBusHostNotifyTimestamps timestamps;
     
-    if(device_driver) {
-        super::messageClient(kIOMessageVoodooSMBusHostNotify, device_driver);
+    timestamps.interrupt = context->interrupt;
+    clock_get_uptime(&timestamps.dispatch);
+    IOFree(context, sizeof(VoodooSMBusHostNotifyContext));
+    
+    IOService* device_driver = nub->getClient();
+    if (device_driver) {
+        nub->messageClient(kIOMessageVoodooSMBusHostNotify, device_driver, &timestamps, sizeof(timestamps));
     }
+    nub->release();
 }
 
-void VoodooSMBusDeviceNub::handleHostNotify() {
+void VoodooSMBusDeviceNub::handleHostNotify(AbsoluteTime timestamp) {
+    VoodooSMBusHostNotifyContext* context = reinterpret_cast<VoodooSMBusHostNotifyContext*>(IOMalloc(sizeof(VoodooSMBusHostNotifyContext)));
+    if (!context) {
+        IOLogError("Could not allocate the context of a host notify in device nub.\n");
+        return;
+    }
+    context->nub = this;
+    context->interrupt = timestamp;
+    
+    /* the thread may run after the nub was terminated */
+    retain();
+    
     thread_t new_thread;
-    kern_return_t ret = kernel_thread_start(OSMemberFunctionCast(thread_continue_t, this, &VoodooSMBusDeviceNub::handleHostNotifyThreaded), this, &new_thread);
+    kern_return_t ret = kernel_thread_start(&VoodooSMBusDeviceNub::handleHostNotifyThreaded, context, &new_thread);
 
     if (ret != KERN_SUCCESS) {
         IOLogDebug(" Thread error while attemping to handle host notify in device nub.\n");
+        IOFree(context, sizeof(VoodooSMBusHostNotifyContext));
+        release();
+    } else {
+        thread_deallocate(new_thread);
+    }
+}
+
+void VoodooSMBusDeviceNub::handleBusResetThreaded() {
+    IOService* device_driver = getClient();
+    
+    if (device_driver) {
+        super::messageClient(kIOMessageVoodooSMBusBusReset, device_driver);
+    }
+    release();
+}
+
+void VoodooSMBusDeviceNub::handleBusReset() {
+    /* the thread may run after the nub was terminated */
+    retain();
+    
+    thread_t new_thread;
+    kern_return_t ret = kernel_thread_start(OSMemberFunctionCast(thread_continue_t, this, &VoodooSMBusDeviceNub::handleBusResetThreaded), this, &new_thread);
+    
+    if (ret != KERN_SUCCESS) {
+        IOLogError("Thread error while attemping to handle bus reset in device nub.\n");
+        release();
     } else {
         thread_deallocate(new_thread);
     }
 }
 
+void VoodooSMBusDeviceNub::handleAlert(UInt8 data, AbsoluteTime timestamp) {
+    IOService* device_driver = getClient();
+    VoodooSMBusAlert alert = {
+        .interrupt = timestamp,
+        .data = data,
+    };
+    
+    if (device_driver) {
+        super::messageClient(kIOMessageVoodooSMBusAlert, device_driver, &alert, sizeof(alert));
+    }
+}
+
 
 bool VoodooSMBusDeviceNub::attach(IOService* provider, UInt8 address) {
     if (!super::attach(provider))
@@ -61,6 +127,10 @@ bool VoodooSMBusDeviceNub::attach(IOService* provider, UInt8 address) {
 }
 
 
+UInt8 VoodooSMBusDeviceNub::getAddress() {
+    return slave_device->addr;
+}
+
 void VoodooSMBusDeviceNub::releaseResources() {
 
 }
@@ -86,8 +156,12 @@ IOReturn VoodooSMBusDeviceNub::readByteData(u8 command) {
     return controller->readByteData(slave_device, command);
 }
 
-IOReturn VoodooSMBusDeviceNub::readBlockData(u8 command, u8 *values) {
-    return controller->readBlockData(slave_device, command, values);
+IOReturn VoodooSMBusDeviceNub::readWordData(u8 command) {
+    return controller->readWordData(slave_device, command);
+}
+
+IOReturn VoodooSMBusDeviceNub::readBlockData(u8 command, u8 *values, AbsoluteTime* transfer_start) {
+    return controller->readBlockData(slave_device, command, values, transfer_start);
 }
 
 IOReturn VoodooSMBusDeviceNub::writeByteData(u8 command, u8 value) {
@@ -101,3 +175,36 @@ IOReturn VoodooSMBusDeviceNub::writeByte(u8 value) {
 IOReturn VoodooSMBusDeviceNub::writeBlockData(u8 command, u8 length, const u8 *values) {
     return controller->writeBlockData(slave_device, command, length, values);
 }
+
+IOReturn VoodooSMBusDeviceNub::readI2CBlockData(u8 command, u8 length, u8 *values) {
+    return controller->readI2CBlockData(slave_device, command, length, values);
+}
+
+struct i2c_smbus_client VoodooSMBusDeviceNub::getSMBusClient() {
+    return controller->getSMBusClient(slave_device->addr, slave_device->flags);
+}
+
+void VoodooSMBusDeviceNub::lockSequence() {
+    controller->lockSequence();
+}
+
+void VoodooSMBusDeviceNub::unlockSequence() {
+    controller->unlockSequence();
+}
+
+IOReturn VoodooSMBusDeviceNub::registerPoll(OSObject* owner, VoodooSMBusPollAction action) {
+    poll_owner = owner;
+    poll_action = action;
+    return controller->addPollDevice(this);
+}
+
+void VoodooSMBusDeviceNub::unregisterPoll() {
+    controller->removePollDevice(this);
+    poll_action = NULL;
+    poll_owner = NULL;
+}
+
+void VoodooSMBusDeviceNub::poll() {
+    if (poll_action)
+        poll_action(poll_owner);
+}
@@ -20,6 +20,9 @@
 
 class VoodooSMBusControllerDriver;
 
+/* Called on the poll work loop of the controller in the poll window of the device */
+typedef void (*VoodooSMBusPollAction)(OSObject* owner);
+
 class VoodooSMBusDeviceNub : public IOService {
     OSDeclareDefaultStructors(VoodooSMBusDeviceNub);
     
@@ -30,20 +33,61 @@ public:
     void stop(IOService* provider) override;
     void free(void) override;
 
-    void handleHostNotify();
+    /*
+     * Notifies the client on a new thread
+     * @timestamp Absolute time the Host Notify interrupt was handled
+     */
+    void handleHostNotify(AbsoluteTime timestamp);
+    
+    /* Asks the client on a new thread to re-initialize the device after a bus reset */
+    void handleBusReset();
+    
+    /*
+     * Notifies the client of an alert of the device, on the calling thread
+     * @data Least significant bit of the alert response
+     * @timestamp Absolute time the SMBALERT# interrupt was handled
+     */
+    void handleAlert(UInt8 data, AbsoluteTime timestamp);
     void setSlaveDeviceFlags(unsigned short flags);
+    UInt8 getAddress();
     
     IOReturn writeByteData(u8 command, u8 value);
     IOReturn readByteData(u8 command);
-    IOReturn readBlockData(u8 command, u8 *values);
+    IOReturn readWordData(u8 command);
+    /* @transfer_start If not NULL, set to the time the transfer acquired the bus */
+    IOReturn readBlockData(u8 command, u8 *values, AbsoluteTime* transfer_start = NULL);
     IOReturn writeByte(u8 value);
     IOReturn writeBlockData(u8 command, u8 length, const u8 *values);
+    IOReturn readI2CBlockData(u8 command, u8 length, u8 *values);
+    
+    /*
+     * Client for the protocol helpers of i2c_smbus.h, used by the portable
+     * parts of the drivers. A copy with another address reaches the device
+     * there, for devices that are also controlled through shared addresses
+     * like the EE1004 page select.
+     */
+    struct i2c_smbus_client getSMBusClient();
+    
+    /*
+     * Polls the device periodically. All polled devices on the bus are read
+     * together in one window, which is deferred while the bus carries input.
+     */
+    IOReturn registerPoll(OSObject* owner, VoodooSMBusPollAction action);
+    void unregisterPoll();
+    void poll();
+    
+    /* Serializes a sequence of transfers with other devices on the bus */
+    void lockSequence();
+    void unlockSequence();
 
 private:
     VoodooSMBusControllerDriver* controller;
     void releaseResources();
     VoodooSMBusSlaveDevice* slave_device;
-    void handleHostNotifyThreaded();
+    OSObject* poll_owner;
+    VoodooSMBusPollAction poll_action;
+    static void handleHostNotifyThreaded(void* parameter, wait_result_t wait_result);
+    void handleBusResetThreaded();
 };
 
 #endif /* VoodooSMBusDeviceNub_hpp */
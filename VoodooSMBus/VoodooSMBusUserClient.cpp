@@ -0,0 +1,151 @@
+/*
+ * VoodooSMBusUserClient.cpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#include "VoodooSMBusUserClient.hpp"
+
+#define super IOUserClient
+OSDefineMetaClassAndStructors(VoodooSMBusUserClient, IOUserClient);
+
+const IOExternalMethodDispatch VoodooSMBusUserClient::methods[kVoodooSMBusUserClientMethods] = {
+    // kVoodooSMBusUserClientExecute
+    { &VoodooSMBusUserClient::sExecute, 1, 0, 2, 0 },
+};
+
+bool VoodooSMBusUserClient::initWithTask(task_t owningTask, void* securityToken, UInt32 type, OSDictionary* properties) {
+    // raw bus access can change the configuration of any allowed device
+    if (clientHasPrivilege(securityToken, kIOClientPrivilegeAdministrator) != kIOReturnSuccess) {
+        return false;
+    }
+    
+    if (!super::initWithTask(owningTask, securityToken, type, properties)) {
+        return false;
+    }
+    
+    lock = IOLockAlloc();
+    return lock != NULL;
+}
+
+bool VoodooSMBusUserClient::start(IOService* provider) {
+    if (!super::start(provider)) {
+        return false;
+    }
+    
+    controller = OSDynamicCast(VoodooSMBusControllerDriver, provider);
+    if (!controller) {
+        IOLog("%s Could not get VoodooSMBus controller instance\n", getName());
+        return false;
+    }
+    // execute may still run on another thread when the controller is stopped
+    controller->retain();
+    
+    command_buffer = IOBufferMemoryDescriptor::withOptions(kIODirectionInOut | kIOMemoryKernelUserShared, SMBUS_STREAM_BUFFER_SIZE, PAGE_SIZE);
+    result_buffer = IOBufferMemoryDescriptor::withOptions(kIODirectionInOut | kIOMemoryKernelUserShared, SMBUS_STREAM_BUFFER_SIZE, PAGE_SIZE);
+    if (!command_buffer || !result_buffer) {
+        IOLog("%s Could not allocate shared buffers\n", getName());
+        OSSafeReleaseNULL(command_buffer);
+        OSSafeReleaseNULL(result_buffer);
+        OSSafeReleaseNULL(controller);
+        return false;
+    }
+    
+    return true;
+}
+
+void VoodooSMBusUserClient::stop(IOService* provider) {
+    // waits for a stream that is being executed
+    IOLockLock(lock);
+    OSSafeReleaseNULL(controller);
+    IOLockUnlock(lock);
+    super::stop(provider);
+}
+
+void VoodooSMBusUserClient::free() {
+    OSSafeReleaseNULL(command_buffer);
+    OSSafeReleaseNULL(result_buffer);
+    if (lock) {
+        IOLockFree(lock);
+        lock = NULL;
+    }
+    super::free();
+}
+
+IOReturn VoodooSMBusUserClient::clientClose() {
+    if (!isInactive()) {
+        terminate();
+    }
+    return kIOReturnSuccess;
+}
+
+IOReturn VoodooSMBusUserClient::clientMemoryForType(UInt32 type, IOOptionBits* options, IOMemoryDescriptor** memory) {
+    IOBufferMemoryDescriptor* buffer;
+    
+    switch (type) {
+        case kVoodooSMBusUserClientCommandBuffer:
+            buffer = command_buffer;
+            break;
+        case kVoodooSMBusUserClientResultBuffer:
+            buffer = result_buffer;
+            break;
+        default:
+            return kIOReturnBadArgument;
+    }
+    
+    buffer->retain();
+    *memory = buffer;
+    return kIOReturnSuccess;
+}
+
+IOReturn VoodooSMBusUserClient::externalMethod(uint32_t selector, IOExternalMethodArguments* arguments,
+                                               IOExternalMethodDispatch* dispatch, OSObject* target, void* reference) {
+    if (selector >= kVoodooSMBusUserClientMethods) {
+        return kIOReturnUnsupported;
+    }
+    
+    dispatch = const_cast<IOExternalMethodDispatch*>(&methods[selector]);
+    target = this;
+    return super::externalMethod(selector, arguments, dispatch, target, reference);
+}
+
+IOReturn VoodooSMBusUserClient::sExecute(OSObject* target, void* reference, IOExternalMethodArguments* arguments) {
+    VoodooSMBusUserClient* client = OSDynamicCast(VoodooSMBusUserClient, target);
+    if (!client) {
+        return kIOReturnBadArgument;
+    }
+    return client->execute(arguments->scalarInput[0], &arguments->scalarOutput[0], &arguments->scalarOutput[1]);
+}
+
+IOReturn VoodooSMBusUserClient::execute(UInt64 length, UInt64* executed, UInt64* results_length) {
+    if (length < SMBUS_STREAM_HEADER_SIZE || length > SMBUS_STREAM_BUFFER_SIZE) {
+        return kIOReturnBadArgument;
+    }
+    
+    IOLockLock(lock);
+    if (!controller) {
+        IOLockUnlock(lock);
+        return kIOReturnNotAttached;
+    }
+    
+    // the client can still write to the shared buffer, so the stream is copied
+    // before it is validated and executed
+    u8* stream = reinterpret_cast<u8*>(IOMalloc((size_t) length));
+    if (!stream) {
+        IOLockUnlock(lock);
+        return kIOReturnNoMemory;
+    }
+    memcpy(stream, command_buffer->getBytesNoCopy(), (size_t) length);
+    
+    size_t result_bytes = 0;
+    UInt32 count = 0;
+    IOReturn ret = controller->executeCommandStream(stream, (size_t) length,
+                                                    reinterpret_cast<u8*>(result_buffer->getBytesNoCopy()), SMBUS_STREAM_BUFFER_SIZE,
+                                                    &result_bytes, &count);
+    IOFree(stream, (size_t) length);
+    IOLockUnlock(lock);
+    
+    *executed = count;
+    *results_length = result_bytes;
+    return ret;
+}
@@ -0,0 +1,49 @@
+/*
+ * VoodooSMBusUserClient.hpp
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#ifndef VoodooSMBusUserClient_hpp
+#define VoodooSMBusUserClient_hpp
+
+#include <IOKit/IOLib.h>
+#include <IOKit/IOUserClient.h>
+#include <IOKit/IOBufferMemoryDescriptor.h>
+#include "VoodooSMBusControllerDriver.hpp"
+#include "SMBusCommandStream.hpp"
+
+/*
+ * Gives administrators access to the bus for tools like SPD or sensor dumps.
+ * The client writes a command stream to the shared command buffer, calls
+ * `kVoodooSMBusUserClientExecute` with its length and reads the results from
+ * the shared result buffer. Only addresses in the allowlist of the controller
+ * can be accessed.
+ */
+class VoodooSMBusUserClient : public IOUserClient {
+    OSDeclareDefaultStructors(VoodooSMBusUserClient);
+    
+public:
+    bool initWithTask(task_t owningTask, void* securityToken, UInt32 type, OSDictionary* properties) override;
+    bool start(IOService* provider) override;
+    void stop(IOService* provider) override;
+    void free() override;
+    IOReturn clientClose() override;
+    IOReturn clientMemoryForType(UInt32 type, IOOptionBits* options, IOMemoryDescriptor** memory) override;
+    IOReturn externalMethod(uint32_t selector, IOExternalMethodArguments* arguments,
+                            IOExternalMethodDispatch* dispatch, OSObject* target, void* reference) override;
+    
+private:
+    VoodooSMBusControllerDriver* controller;
+    IOBufferMemoryDescriptor* command_buffer;
+    IOBufferMemoryDescriptor* result_buffer;
+    /* Serializes calls of the client, they share the buffers */
+    IOLock* lock;
+    
+    static const IOExternalMethodDispatch methods[kVoodooSMBusUserClientMethods];
+    
+    static IOReturn sExecute(OSObject* target, void* reference, IOExternalMethodArguments* arguments);
+    IOReturn execute(UInt64 length, UInt64* executed, UInt64* results_length);
+};
+
+#endif /* VoodooSMBusUserClient_hpp */
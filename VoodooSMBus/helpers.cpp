@@ -7,3 +7,16 @@ uint64_t clock_get_uptime_nanoseconds() {
     absolutetime_to_nanoseconds(timestamp, &timestamp_ns);
     return timestamp_ns;
 }
+
+void smbus_log(const char* format, ...) {
+    va_list arguments;
+    va_start(arguments, format);
+    IOLogv(format, arguments);
+    va_end(arguments);
+}
+
+uint64_t smbus_absolutetime_to_nanoseconds(uint64_t absolutetime) {
+    uint64_t nanoseconds;
+    absolutetime_to_nanoseconds(absolutetime, &nanoseconds);
+    return nanoseconds;
+}
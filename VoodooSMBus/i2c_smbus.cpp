@@ -0,0 +1,116 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ SMBus protocol helpers, ported from the linux kernel at
+ https://github.com/torvalds/linux/blob/master/drivers/i2c/i2c-core-smbus.c
+ 
+ Copyright (C) 1995-2000 Simon G. Vogl
+ SMBus 2.0 support by Mark Studebaker <mdsxyz123@yahoo.com> and
+ Jean Delvare <jdelvare@suse.de>
+ */
+
+#include <string.h>
+#include "i2c_smbus.h"
+
+static s32 i2c_smbus_xfer(const struct i2c_smbus_client *client, char read_write,
+                          u8 command, int protocol, union i2c_smbus_data *data)
+{
+    return client->xfer(client->context, client->addr, client->flags,
+                        read_write, command, protocol, data);
+}
+
+s32 i2c_smbus_read_byte(const struct i2c_smbus_client *client)
+{
+    union i2c_smbus_data data;
+    int status;
+    
+    status = i2c_smbus_xfer(client, I2C_SMBUS_READ, 0,
+                            I2C_SMBUS_BYTE, &data);
+    return (status < 0) ? status : data.byte;
+}
+
+s32 i2c_smbus_write_byte(const struct i2c_smbus_client *client, u8 value)
+{
+    return i2c_smbus_xfer(client, I2C_SMBUS_WRITE, value,
+                          I2C_SMBUS_BYTE, NULL);
+}
+
+s32 i2c_smbus_read_byte_data(const struct i2c_smbus_client *client, u8 command)
+{
+    union i2c_smbus_data data;
+    int status;
+    
+    status = i2c_smbus_xfer(client, I2C_SMBUS_READ, command,
+                            I2C_SMBUS_BYTE_DATA, &data);
+    return (status < 0) ? status : data.byte;
+}
+
+s32 i2c_smbus_write_byte_data(const struct i2c_smbus_client *client, u8 command, u8 value)
+{
+    union i2c_smbus_data data;
+    data.byte = value;
+    return i2c_smbus_xfer(client, I2C_SMBUS_WRITE, command,
+                          I2C_SMBUS_BYTE_DATA, &data);
+}
+
+s32 i2c_smbus_read_word_data(const struct i2c_smbus_client *client, u8 command)
+{
+    union i2c_smbus_data data;
+    int status;
+    
+    status = i2c_smbus_xfer(client, I2C_SMBUS_READ, command,
+                            I2C_SMBUS_WORD_DATA, &data);
+    return (status < 0) ? status : data.word;
+}
+
+s32 i2c_smbus_write_word_data(const struct i2c_smbus_client *client, u8 command, u16 value)
+{
+    union i2c_smbus_data data;
+    data.word = value;
+    return i2c_smbus_xfer(client, I2C_SMBUS_WRITE, command,
+                          I2C_SMBUS_WORD_DATA, &data);
+}
+
+s32 i2c_smbus_read_block_data(const struct i2c_smbus_client *client, u8 command, u8 *values)
+{
+    union i2c_smbus_data data;
+    int status;
+    
+    status = i2c_smbus_xfer(client, I2C_SMBUS_READ, command,
+                            I2C_SMBUS_BLOCK_DATA, &data);
+    if (status)
+        return status;
+    
+    memcpy(values, &data.block[1], data.block[0]);
+    return data.block[0];
+}
+
+s32 i2c_smbus_write_block_data(const struct i2c_smbus_client *client, u8 command,
+                               u8 length, const u8 *values)
+{
+    union i2c_smbus_data data;
+    
+    if (length > I2C_SMBUS_BLOCK_MAX)
+        length = I2C_SMBUS_BLOCK_MAX;
+    data.block[0] = length;
+    memcpy(&data.block[1], values, length);
+    return i2c_smbus_xfer(client, I2C_SMBUS_WRITE, command,
+                          I2C_SMBUS_BLOCK_DATA, &data);
+}
+
+s32 i2c_smbus_read_i2c_block_data(const struct i2c_smbus_client *client, u8 command,
+                                  u8 length, u8 *values)
+{
+    union i2c_smbus_data data;
+    int status;
+    
+    if (length > I2C_SMBUS_BLOCK_MAX)
+        length = I2C_SMBUS_BLOCK_MAX;
+    data.block[0] = length;
+    status = i2c_smbus_xfer(client, I2C_SMBUS_READ, command,
+                            I2C_SMBUS_I2C_BLOCK_DATA, &data);
+    if (status < 0)
+        return status;
+    
+    memcpy(values, &data.block[1], data.block[0]);
+    return data.block[0];
+}
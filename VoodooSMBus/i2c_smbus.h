@@ -25,8 +25,7 @@
 #ifndef i2c_smbus_h
 #define i2c_smbus_h
 
-#include "helpers.hpp"
-#include "i2c_i801.cpp"
+#include "smbus_platform.h"
 
 /*
  * Data for SMBus Messages
@@ -69,4 +68,32 @@ union i2c_smbus_data {
 
 #define I2C_M_TEN                   0x0010    /* this is a ten bit chip address */
 
+/*
+ * A device on an SMBus, a mix of i2c_client and i2c_adapter. The protocol
+ * helpers below execute their transfers through `xfer`, which behaves like
+ * i2c_smbus_xfer and returns a negative errno on error.
+ */
+struct i2c_smbus_client {
+    s32 (*xfer)(void *context, u16 addr, unsigned short flags, char read_write,
+                u8 command, int protocol, union i2c_smbus_data *data);
+    void *context;
+    u16 addr;
+    unsigned short flags;
+};
+
+/* From https://github.com/torvalds/linux/blob/master/drivers/i2c/i2c-core-smbus.c */
+s32 i2c_smbus_read_byte(const struct i2c_smbus_client *client);
+s32 i2c_smbus_write_byte(const struct i2c_smbus_client *client, u8 value);
+s32 i2c_smbus_read_byte_data(const struct i2c_smbus_client *client, u8 command);
+s32 i2c_smbus_write_byte_data(const struct i2c_smbus_client *client, u8 command, u8 value);
+s32 i2c_smbus_read_word_data(const struct i2c_smbus_client *client, u8 command);
+s32 i2c_smbus_write_word_data(const struct i2c_smbus_client *client, u8 command, u16 value);
+/* Returns the number of bytes read, @values must hold I2C_SMBUS_BLOCK_MAX bytes */
+s32 i2c_smbus_read_block_data(const struct i2c_smbus_client *client, u8 command, u8 *values);
+s32 i2c_smbus_write_block_data(const struct i2c_smbus_client *client, u8 command,
+                               u8 length, const u8 *values);
+/* Reads @length bytes without a length byte, like EEPROMs send them */
+s32 i2c_smbus_read_i2c_block_data(const struct i2c_smbus_client *client, u8 command,
+                                  u8 length, u8 *values);
+
 #endif /* i2c_smbus_h */
@@ -0,0 +1,51 @@
+/*
+ * smbus_platform.h
+ * SMBus Controller Driver for macOS X
+ *
+ */
+
+#ifndef smbus_platform_h
+#define smbus_platform_h
+
+/*
+ * Types and services the portable parts of the driver use. This file must not
+ * depend on IOKit: the kext implements the functions in helpers.cpp, the host
+ * build of the core in Host/HostPlatform.cpp.
+ */
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint8_t __u8;
+typedef __u8 u8;
+typedef uint16_t __u16;
+typedef __u16 u16;
+typedef int32_t s32;
+typedef uint32_t u32;
+
+#ifndef BIT
+#define BIT(nr) (1UL << (nr))
+#endif
+
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+// from https://github.com/torvalds/linux/blob/master/include/uapi/asm-generic/errno-base.h
+
+#define EIO              5      /* I/O error */
+#define ENXIO            6      /* No such device or address */
+#define EAGAIN          11      /* Try again */
+#define EBUSY           16      /* Device or resource busy */
+#define EINVAL          22      /* Invalid argument */
+#define EPROTO          71      /* Protocol error */
+#define EBADMSG         74      /* Not a data message */
+#define EOPNOTSUPP      95      /* Operation not supported on transport endpoint */
+#define ETIMEDOUT       110     /* Connection timed out */
+
+/* Writes a message to the system log, like IOLog */
+void smbus_log(const char* format, ...) __attribute__((format(printf, 1, 2)));
+
+#define IOLogError(arg...) smbus_log("Error: " arg)
+#define IOLogDebug(arg...) smbus_log("Debug: " arg)
+
+/* Converts a duration in absolute time units of the platform to nanoseconds */
+uint64_t smbus_absolutetime_to_nanoseconds(uint64_t absolutetime);
+
+#endif /* smbus_platform_h */